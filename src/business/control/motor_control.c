@@ -20,6 +20,7 @@ static struct {
     DmaId dmaId;
     DmaChannel dmaChannel;
     MemoryBuffer controlBuffer;
+    void* driverReg;
 } g_motorControl = {0};
 
 /* Private functions */
@@ -42,6 +43,30 @@ static int MotorControlSetupDma(void)
                                   &g_motorControl.dmaChannel);
 }
 
+static int MotorControlSendFrame(float targetSpeed)
+{
+    /* The buffer still feeds the previous frame until its transfer is done */
+    bool busy = false;
+    if (HAL_DMA_IsBusy(g_motorControl.dmaChannel, &busy) != HAL_OK) {
+        return HAL_ERROR;
+    }
+    if (busy) {
+        return HAL_BUSY;
+    }
+
+    MotorControlFrame* frame;
+    if (HAL_MEMORY_GetAddr(g_motorControl.controlBuffer, (void**) &frame) != HAL_OK) {
+        return HAL_ERROR;
+    }
+
+    frame->mode = (uint32_t) g_motorControl.mode;
+    frame->targetSpeed = targetSpeed;
+    HAL_MEMORY_FlushBuffer(g_motorControl.controlBuffer, 0, sizeof(*frame));
+
+    return HAL_DMA_StartTransfer(g_motorControl.dmaChannel, frame, g_motorControl.driverReg,
+                                 sizeof(*frame));
+}
+
 /* Public functions */
 int MOTOR_CONTROL_Init(DmaId dmaId)
 {
@@ -94,6 +119,16 @@ int MOTOR_CONTROL_Deinit(void)
     return HAL_OK;
 }
 
+int MOTOR_CONTROL_AttachDriver(void* driverReg)
+{
+    if (!g_motorControl.initialized) {
+        return HAL_ERROR;
+    }
+
+    g_motorControl.driverReg = driverReg;
+    return HAL_OK;
+}
+
 int MOTOR_CONTROL_SetMode(MotorMode mode)
 {
     if (!g_motorControl.initialized) {
@@ -110,10 +145,15 @@ int MOTOR_CONTROL_SetSpeed(float speed)
         return HAL_ERROR;
     }
 
-    g_motorControl.targetSpeed = speed;
-
-    /* TODO: Use DMA to transfer control data to motor controller */
+    /* Without a driver attached the setpoint is only recorded */
+    if (g_motorControl.driverReg) {
+        int status = MotorControlSendFrame(speed);
+        if (status != HAL_OK) {
+            return status;
+        }
+    }
 
+    g_motorControl.targetSpeed = speed;
     return HAL_OK;
 }
 
@@ -21,6 +21,12 @@ typedef struct {
     bool isRunning;
 } MotorStatus;
 
+/* Control frame sent to the motor driver on every setpoint change */
+typedef struct {
+    uint32_t mode;
+    float targetSpeed;
+} MotorControlFrame;
+
 /**
  * @brief Initialize motor control
  * @param dmaId DMA instance ID for data transfer
@@ -34,6 +40,13 @@ int MOTOR_CONTROL_Init(DmaId dmaId);
  */
 int MOTOR_CONTROL_Deinit(void);
 
+/**
+ * @brief Attach the motor driver that receives control frames
+ * @param driverReg Driver data register (DMA destination), NULL to detach
+ * @return HAL_OK on success, HAL_ERROR on failure
+ */
+int MOTOR_CONTROL_AttachDriver(void* driverReg);
+
 /**
  * @brief Set motor mode
  * @param mode Motor control mode
@@ -44,7 +57,11 @@ int MOTOR_CONTROL_SetMode(MotorMode mode);
 /**
  * @brief Set target speed
  * @param speed Target speed (RPM)
- * @return HAL_OK on success, HAL_ERROR on failure
+ * @return HAL_OK on success, HAL_BUSY if the previous frame is still in flight,
+ *         HAL_ERROR on failure
+ * @note With a driver attached, the target speed only changes once its frame is on the
+ *       way; after HAL_BUSY or HAL_ERROR it stays at the last setpoint sent, and the
+ *       caller retries
  */
 int MOTOR_CONTROL_SetSpeed(float speed);
 
@@ -6,6 +6,8 @@
 #ifndef HAL_DMA_H
 #define HAL_DMA_H
 
+#include "hal_memory.h"
+#include "hal_timer.h"
 #include "hal_types.h"
 
 /* DMA instance ID */
@@ -17,6 +19,9 @@ typedef void* DmaChannel;
 /* DMA configuration (opaque, platform-specific) */
 typedef void* DmaConfig;
 
+/* Prepared (reusable) transfer handle */
+typedef void* DmaPreparedTransfer;
+
 /* DMA transfer direction */
 typedef enum {
     DMA_DIR_MEM_TO_MEM = 0,
@@ -34,6 +39,9 @@ typedef enum {
 /* DMA callback function */
 typedef void (*DmaCallback)(DmaChannel channel, DmaEvent event, void* userData);
 
+/* Coalesced completion callback, completed = transfers finished since the previous call */
+typedef void (*DmaBatchCallback)(DmaChannel channel, uint32_t completed, void* userData);
+
 /**
  * @brief Initialize DMA controller
  * @param dmaId DMA instance ID
@@ -86,7 +94,95 @@ int HAL_DMA_Configure(DmaChannel channel, DmaConfig config);
 int HAL_DMA_StartTransfer(DmaChannel channel, const void* srcAddr, void* dstAddr, size_t size);
 
 /**
- * @brief Stop DMA transfer
+ * @brief Start DMA transfer between memory buffers with automatic cache maintenance
+ * @param channel Channel handle
+ * @param srcBuffer Source buffer
+ * @param srcOffset Offset within source buffer
+ * @param dstBuffer Destination buffer
+ * @param dstOffset Offset within destination buffer
+ * @param size Transfer size in bytes
+ * @return HAL_OK on success, HAL_BUSY if the channel is busy, HAL_ERROR on failure
+ * @note Only the transferred ranges are maintained, on any channel direction: source range
+ *       flushed, destination range invalidated
+ */
+int HAL_DMA_StartBufferTransfer(DmaChannel channel, MemoryBuffer srcBuffer, size_t srcOffset,
+                                MemoryBuffer dstBuffer, size_t dstOffset, size_t size);
+
+/**
+ * @brief Validate a transfer and build its descriptor once for repeated launches
+ * @param channel Channel handle
+ * @param srcAddr Source address
+ * @param dstAddr Destination address
+ * @param size Transfer size in bytes
+ * @param prepared Output prepared transfer handle
+ * @return HAL_OK on success, HAL_ERROR on failure
+ */
+int HAL_DMA_PrepareTransfer(DmaChannel channel, const void* srcAddr, void* dstAddr, size_t size,
+                            DmaPreparedTransfer* prepared);
+
+/**
+ * @brief Start a prepared transfer (same semantics as HAL_DMA_StartTransfer)
+ * @param prepared Prepared transfer handle
+ * @return HAL_OK on success, HAL_BUSY if the channel is busy,
+ *         HAL_ERROR if the channel was released
+ */
+int HAL_DMA_Launch(DmaPreparedTransfer prepared);
+
+/**
+ * @brief Free a prepared transfer
+ * @param prepared Prepared transfer handle
+ * @return HAL_OK on success, HAL_ERROR on failure
+ */
+int HAL_DMA_ReleasePrepared(DmaPreparedTransfer prepared);
+
+/**
+ * @brief Start a prepared transfer in hardware whenever a channel completes a transfer
+ * @param channel Triggering channel
+ * @param prepared Transfer to start (copied, may be released afterwards), NULL to unlink
+ * @return HAL_OK on success, HAL_ERROR on failure
+ * @note A trigger that finds the target channel busy is lost
+ */
+int HAL_DMA_LinkChannel(DmaChannel channel, DmaPreparedTransfer prepared);
+
+/**
+ * @brief Start a prepared transfer in hardware on every expiry of a timer
+ * @param timer Triggering timer
+ * @param prepared Transfer to start (copied, may be released afterwards), NULL to unlink
+ * @return HAL_OK on success, HAL_ERROR on failure
+ * @note A trigger that finds the target channel busy is lost
+ */
+int HAL_DMA_LinkTimer(TimerHandle timer, DmaPreparedTransfer prepared);
+
+/**
+ * @brief Queue a transfer descriptor on the channel's submission ring (not started yet)
+ * @param channel Channel handle
+ * @param srcAddr Source address
+ * @param dstAddr Destination address
+ * @param size Transfer size in bytes
+ * @param tag Caller-defined tag reported by HAL_DMA_PopCompletion when the transfer completes
+ * @return HAL_OK on success, HAL_BUSY if the ring is full, HAL_ERROR on failure
+ */
+int HAL_DMA_QueueTransfer(DmaChannel channel, const void* srcAddr, void* dstAddr, size_t size,
+                          uint32_t tag);
+
+/**
+ * @brief Hand all queued descriptors to the engine, which runs them back-to-back
+ * @param channel Channel handle
+ * @return HAL_OK on success, HAL_ERROR on failure
+ */
+int HAL_DMA_SubmitQueued(DmaChannel channel);
+
+/**
+ * @brief Take the tag of the oldest completed queued transfer
+ * @param channel Channel handle
+ * @param tag Output: tag given to HAL_DMA_QueueTransfer
+ * @return HAL_OK if a tag was returned, HAL_BUSY if no queued transfer completed yet,
+ *         HAL_ERROR on failure
+ */
+int HAL_DMA_PopCompletion(DmaChannel channel, uint32_t* tag);
+
+/**
+ * @brief Stop DMA transfer (also drops all queued descriptors)
  * @param channel Channel handle
  * @return HAL_OK on success, HAL_ERROR on failure
  */
@@ -117,6 +213,19 @@ int HAL_DMA_WaitComplete(DmaChannel channel, uint32_t timeoutMs);
  */
 int HAL_DMA_RegisterCallback(DmaChannel channel, DmaCallback callback, void* userData);
 
+/**
+ * @brief Coalesce completion interrupts of a channel
+ * @param channel Channel handle
+ * @param maxTransfers Fire after this many completions (0 = no count limit)
+ * @param maxDelayUs Fire this long after the oldest unreported completion (0 = no time limit)
+ * @param callback Batch callback, NULL to disable coalescing (pending completions are reported)
+ * @param userData User data passed to callback
+ * @return HAL_OK on success, HAL_ERROR on failure
+ * @note While coalescing, completions are reported only through the batch callback
+ */
+int HAL_DMA_SetCoalescing(DmaChannel channel, uint32_t maxTransfers, uint32_t maxDelayUs,
+                          DmaBatchCallback callback, void* userData);
+
 /**
  * @brief Enable DMA events
  * @param channel Channel handle
@@ -0,0 +1,73 @@
+/**
+ * @file hal_event.h
+ * @brief Event Flag Group Hardware Abstraction Layer Interface
+ */
+
+#ifndef HAL_EVENT_H
+#define HAL_EVENT_H
+
+#include "hal_types.h"
+
+/* Event group handle */
+typedef void* EventGroupHandle;
+
+/* Which of the requested bits a wait needs */
+typedef enum {
+    EVENT_WAIT_ANY = 0, /* At least one of them */
+    EVENT_WAIT_ALL = 1  /* Every one of them */
+} EventWaitMode;
+
+/**
+ * @brief Create an event group of 32 flags, all clear
+ * @param group Output event group handle
+ * @return HAL_OK on success, HAL_ERROR on failure
+ */
+int HAL_EVENT_Create(EventGroupHandle* group);
+
+/**
+ * @brief Delete an event group
+ * @param group Event group handle
+ * @return HAL_OK on success, HAL_BUSY while tasks wait on it, HAL_ERROR on failure
+ */
+int HAL_EVENT_Delete(EventGroupHandle group);
+
+/**
+ * @brief Set flags and wake the tasks waiting on the group
+ * @param group Event group handle
+ * @param bits Flags to set
+ * @return HAL_OK on success, HAL_ERROR on error
+ * @note Safe from interrupt context
+ */
+int HAL_EVENT_Set(EventGroupHandle group, uint32_t bits);
+
+/**
+ * @brief Clear flags
+ * @param group Event group handle
+ * @param bits Flags to clear
+ * @return HAL_OK on success, HAL_ERROR on error
+ */
+int HAL_EVENT_Clear(EventGroupHandle group, uint32_t bits);
+
+/**
+ * @brief Wait until any or all of some flags are set
+ * @param group Event group handle
+ * @param bits Flags to wait for (non-zero)
+ * @param mode EVENT_WAIT_ANY or EVENT_WAIT_ALL
+ * @param clearOnExit Clear the requested flags on success, in the same step as the check
+ * @param timeoutMs Timeout in milliseconds (0 = no timeout)
+ * @param setBits Output flags as they were when the wait was satisfied (may be NULL)
+ * @return HAL_OK on success, HAL_TIMEOUT on timeout, HAL_ERROR on error
+ * @note A waiting task blocks and lets other tasks run. With clearOnExit, flags set once
+ *       satisfy only the first waiter that gets to run
+ */
+int HAL_EVENT_Wait(EventGroupHandle group, uint32_t bits, EventWaitMode mode, bool clearOnExit,
+                   uint32_t timeoutMs, uint32_t* setBits);
+
+/**
+ * @brief Get the flags of an event group
+ * @param group Event group handle
+ * @return Flags, 0 on invalid handle
+ */
+uint32_t HAL_EVENT_Get(EventGroupHandle group);
+
+#endif /* HAL_EVENT_H */
@@ -12,6 +12,9 @@
 /* Memory buffer handle */
 typedef void* MemoryBuffer;
 
+/* Asynchronous copy token */
+typedef void* MemoryCopyToken;
+
 /* Cache/Pool name (string identifier) */
 typedef const char* PoolName;
 
@@ -123,4 +126,31 @@ int HAL_MEMORY_InvalidateAll(void);
  */
 int HAL_MEMORY_CopyBuffer(MemoryBuffer dstBuffer, MemoryBuffer srcBuffer, size_t size);
 
+/**
+ * @brief Start copying data between buffers without waiting for it
+ * @param dstBuffer Destination buffer
+ * @param srcBuffer Source buffer
+ * @param size Size in bytes
+ * @param token Output token for HAL_MEMORY_PollCopy / HAL_MEMORY_WaitCopy
+ * @return HAL_OK on success, HAL_BUSY if too many copies are in flight, HAL_ERROR on failure
+ * @note Small copies are done by the CPU and are complete on return
+ */
+int HAL_MEMORY_CopyBufferAsync(MemoryBuffer dstBuffer, MemoryBuffer srcBuffer, size_t size,
+                               MemoryCopyToken* token);
+
+/**
+ * @brief Check whether an asynchronous copy has finished
+ * @param token Token from HAL_MEMORY_CopyBufferAsync
+ * @return HAL_OK if finished, HAL_BUSY if still in progress
+ */
+int HAL_MEMORY_PollCopy(MemoryCopyToken token);
+
+/**
+ * @brief Wait for an asynchronous copy to finish
+ * @param token Token from HAL_MEMORY_CopyBufferAsync
+ * @param timeoutMs Timeout in milliseconds (0 = wait forever)
+ * @return HAL_OK if finished, HAL_TIMEOUT on timeout, HAL_ERROR on failure
+ */
+int HAL_MEMORY_WaitCopy(MemoryCopyToken token, uint32_t timeoutMs);
+
 #endif /* HAL_MEMORY_H */
@@ -0,0 +1,60 @@
+/**
+ * @file hal_mutex.h
+ * @brief Mutex Hardware Abstraction Layer Interface
+ */
+
+#ifndef HAL_MUTEX_H
+#define HAL_MUTEX_H
+
+#include "hal_types.h"
+
+/* Mutex handle */
+typedef void* MutexHandle;
+
+/* What a contended mutex does to its owner */
+typedef enum {
+    MUTEX_PROTOCOL_NONE = 0,   /* Nothing: the owner keeps its priority */
+    MUTEX_PROTOCOL_INHERIT = 1 /* The owner runs at the priority of its highest waiter */
+} MutexProtocol;
+
+/**
+ * @brief Create a mutex
+ * @param protocol Priority protocol
+ * @param mutex Output mutex handle
+ * @return HAL_OK on success, HAL_ERROR on failure
+ */
+int HAL_MUTEX_Create(MutexProtocol protocol, MutexHandle* mutex);
+
+/**
+ * @brief Delete a mutex
+ * @param mutex Mutex handle
+ * @return HAL_OK on success, HAL_BUSY while it is locked, HAL_ERROR on failure
+ */
+int HAL_MUTEX_Delete(MutexHandle mutex);
+
+/**
+ * @brief Lock a mutex, waiting while another task holds it
+ * @param mutex Mutex handle
+ * @param timeoutMs Timeout in milliseconds (0 = no timeout)
+ * @return HAL_OK on success, HAL_TIMEOUT on timeout, HAL_ERROR on error or if the
+ *         caller holds it already (mutexes are not recursive)
+ * @note A waiting task blocks and lets other tasks run. Not for interrupt context
+ */
+int HAL_MUTEX_Lock(MutexHandle mutex, uint32_t timeoutMs);
+
+/**
+ * @brief Lock a mutex if it is free, without waiting
+ * @param mutex Mutex handle
+ * @return HAL_OK on success, HAL_BUSY if it is held, HAL_ERROR on error
+ */
+int HAL_MUTEX_TryLock(MutexHandle mutex);
+
+/**
+ * @brief Unlock a mutex, waking the highest-priority waiter
+ * @param mutex Mutex handle
+ * @return HAL_OK on success, HAL_ERROR if the caller does not hold it or on error
+ * @note An owner whose priority was raised drops back to what its other mutexes need
+ */
+int HAL_MUTEX_Unlock(MutexHandle mutex);
+
+#endif /* HAL_MUTEX_H */
@@ -0,0 +1,83 @@
+/**
+ * @file hal_queue.h
+ * @brief Inter-Task Message Queue Hardware Abstraction Layer Interface
+ */
+
+#ifndef HAL_QUEUE_H
+#define HAL_QUEUE_H
+
+#include "hal_types.h"
+
+/* Queue handle */
+typedef void* QueueHandle;
+
+/* Who may use a queue concurrently */
+typedef enum {
+    QUEUE_MODE_SPSC = 0, /* One sending and one receiving task or thread at a time */
+    QUEUE_MODE_MPSC = 1  /* Any number of senders, one receiver at a time */
+} QueueMode;
+
+/**
+ * @brief Create a message queue
+ * @param itemSize Bytes per message, copied in and out
+ * @param capacity Messages the queue holds (the port may round it up)
+ * @param mode Concurrency the queue has to support
+ * @param queue Output queue handle
+ * @return HAL_OK on success, HAL_ERROR on failure
+ */
+int HAL_QUEUE_Create(uint32_t itemSize, uint32_t capacity, QueueMode mode, QueueHandle* queue);
+
+/**
+ * @brief Delete a message queue
+ * @param queue Queue handle
+ * @return HAL_OK on success, HAL_BUSY while tasks wait on it, HAL_ERROR on failure
+ * @note Nobody may use the queue anymore
+ */
+int HAL_QUEUE_Delete(QueueHandle queue);
+
+/**
+ * @brief Send a message, waiting while the queue is full
+ * @param queue Queue handle
+ * @param item Message (itemSize bytes)
+ * @param timeoutMs Timeout in milliseconds (0 = no timeout)
+ * @return HAL_OK on success, HAL_TIMEOUT on timeout, HAL_ERROR on error
+ * @note A waiting task blocks and lets other tasks run
+ */
+int HAL_QUEUE_Send(QueueHandle queue, const void* item, uint32_t timeoutMs);
+
+/**
+ * @brief Receive the oldest message, waiting while the queue is empty
+ * @param queue Queue handle
+ * @param item Output message (itemSize bytes)
+ * @param timeoutMs Timeout in milliseconds (0 = no timeout)
+ * @return HAL_OK on success, HAL_TIMEOUT on timeout, HAL_ERROR on error
+ * @note A waiting task blocks and lets other tasks run
+ */
+int HAL_QUEUE_Receive(QueueHandle queue, void* item, uint32_t timeoutMs);
+
+/**
+ * @brief Send a message if there is room, without waiting
+ * @param queue Queue handle
+ * @param item Message (itemSize bytes)
+ * @return HAL_OK on success, HAL_BUSY if the queue is full, HAL_ERROR on error
+ * @note Lock-free; safe from interrupt context
+ */
+int HAL_QUEUE_TrySend(QueueHandle queue, const void* item);
+
+/**
+ * @brief Receive the oldest message if there is one, without waiting
+ * @param queue Queue handle
+ * @param item Output message (itemSize bytes)
+ * @return HAL_OK on success, HAL_BUSY if the queue is empty, HAL_ERROR on error
+ * @note Lock-free; safe from interrupt context
+ */
+int HAL_QUEUE_TryReceive(QueueHandle queue, void* item);
+
+/**
+ * @brief Get the number of messages in a queue
+ * @param queue Queue handle
+ * @return Messages queued (a snapshot while others send or receive), 0 on invalid handle
+ */
+uint32_t HAL_QUEUE_GetCount(QueueHandle queue);
+
+#endif /* HAL_QUEUE_H */
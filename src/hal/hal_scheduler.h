@@ -11,6 +11,9 @@
 /* Task handle */
 typedef void* TaskHandle;
 
+/* Frozen (precompiled) schedule handle */
+typedef void* ScheduleHandle;
+
 /* Task priority */
 typedef enum {
     TASK_PRIORITY_LOW = 0,
@@ -28,9 +31,63 @@ typedef enum {
     TASK_STATE_COMPLETED
 } TaskState;
 
+/*
+ * TaskStats.runHistogram: bucket 0 counts runs of up to 1 us execution time, each next
+ * doubles; TaskStats.responseHistogram buckets response times in us the same way
+ */
+#define TASK_STATS_RUN_BUCKETS 16
+
+/*
+ * Per-task run statistics. Timestamps and latencies in microseconds are system tick
+ * time (HAL_TIMER_GetSystemTickUs); the nanosecond fields are execution (CPU) time and
+ * stay zero on ports that do not measure it.
+ */
+typedef struct {
+    uint64_t createdUs;
+    uint64_t readyUs;       /* Last time the task became ready */
+    uint64_t startUs;       /* Start of the last run */
+    uint64_t endUs;         /* End of the last run (return, yield or suspend) */
+    uint64_t runs;          /* Times the task was dispatched */
+    uint64_t latencyUs;     /* Sum of ready-to-run delays */
+    uint64_t maxLatencyUs;
+    uint64_t latencyNs;     /* Sum of ready-to-run delays in execution time */
+    uint64_t maxLatencyNs;
+    uint64_t runNs;         /* Execution time summed over all runs */
+    uint64_t maxRunNs;
+    uint32_t runHistogram[TASK_STATS_RUN_BUCKETS];
+    uint64_t jobs;           /* Periodic task: jobs released */
+    uint64_t maxResponseUs;  /* Periodic task: longest release-to-completion time */
+    uint64_t deadlineMisses; /* Periodic task: jobs not completed by their deadline */
+    uint64_t overruns;       /* Periodic task: jobs that ran longer than their budget */
+    uint64_t delays;         /* Sleeps in HAL_SCHEDULER_Delay or HAL_SCHEDULER_DelayUntil */
+    uint64_t jitterUs;       /* Sum over those sleeps of the run start minus the wake time */
+    uint64_t maxJitterUs;
+    uint64_t lateWakes;      /* DelayUntil calls made when the wake time had already passed */
+    uint64_t preemptions;    /* Runs cut off by a higher-priority task or a time slice's end */
+    uint64_t responses;      /* Times the task was ready and then gave up the processor */
+    uint64_t responseUs;     /* Sum of those ready-to-done times, preemptions included */
+    uint32_t responseHistogram[TASK_STATS_RUN_BUCKETS];
+} TaskStats;
+
 /* Task function pointer */
 typedef void (*TaskFunction)(void* args);
 
+/* Timing of a periodic real-time task, in microseconds of system tick time */
+typedef struct {
+    uint32_t periodUs;   /* Release interval */
+    uint32_t deadlineUs; /* Relative deadline, at most the period; 0 for the period */
+    uint32_t budgetUs;   /* Worst-case execution time per job, 0 if not checked */
+} TaskTiming;
+
+/* Timing violation of a periodic task */
+typedef enum {
+    TASK_TIMING_DEADLINE_MISS = 0, /* A job had not completed by its absolute deadline */
+    TASK_TIMING_OVERRUN = 1        /* A job ran longer than its budget */
+} TaskTimingEvent;
+
+/* Timing violation callback */
+typedef void (*TaskTimingCallback)(TaskHandle taskHandle, TaskTimingEvent event, void* userData);
+
 /**
  * @brief Initialize scheduler
  * @return HAL_OK on success, HAL_ERROR on failure
@@ -48,6 +105,75 @@ int HAL_SCHEDULER_Init(void);
 int HAL_SCHEDULER_CreateTask(TaskFunction taskFunc, void* args, TaskPriority priority,
                              TaskHandle* taskHandle);
 
+/**
+ * @brief Create a periodic real-time task
+ * @param taskFunc Task function, called once per job; returning completes the job
+ * @param args Task arguments
+ * @param timing Period, relative deadline and budget
+ * @param taskHandle Output task handle
+ * @return HAL_OK on success, HAL_ERROR on failure
+ * @note The first job is released on creation. Periodic tasks run ahead of all TaskPriority
+ *       levels, ordered among themselves by the port's real-time policy; they cannot take
+ *       part in task graphs
+ */
+int HAL_SCHEDULER_CreatePeriodicTask(TaskFunction taskFunc, void* args, const TaskTiming* timing,
+                                     TaskHandle* taskHandle);
+
+/**
+ * @brief Register the callback for deadline misses and budget overruns of periodic tasks
+ * @param callback Callback function, NULL to remove it
+ * @param userData User data passed to the callback
+ * @return HAL_OK on success, HAL_ERROR on failure
+ * @note Violations are counted in TaskStats whether or not a callback is registered
+ */
+int HAL_SCHEDULER_RegisterTimingCallback(TaskTimingCallback callback, void* userData);
+
+/**
+ * @brief Make a task wait for another one (graph edge)
+ * @param producer Task that must complete first
+ * @param consumer Task that is blocked until all of its producers completed
+ * @return HAL_OK on success, HAL_ERROR on invalid handles or if the edge would close a cycle
+ * @note A producer that already completed only holds the consumer back from the next re-arm on
+ */
+int HAL_SCHEDULER_AddDependency(TaskHandle producer, TaskHandle consumer);
+
+/**
+ * @brief Re-arm a completed task graph for the next frame
+ * @param taskHandle Any task of the graph; every task connected to it by dependencies is re-armed
+ * @return HAL_OK on success, HAL_BUSY if part of the graph has not completed yet,
+ *         HAL_ERROR on failure
+ */
+int HAL_SCHEDULER_RearmGraph(TaskHandle taskHandle);
+
+/**
+ * @brief Precompile a task graph into a static execution order
+ * @param taskHandle Any task of the graph; every task connected to it by dependencies is frozen
+ * @param schedule Output schedule handle
+ * @return HAL_OK on success, HAL_BUSY if a frame of the graph is in flight or one of its tasks
+ *         is running or suspended, HAL_ERROR on failure
+ * @note The order is the one the dispatcher would pick for a freshly armed frame. Frozen tasks
+ *       leave dynamic scheduling: they only run through HAL_SCHEDULER_RunSchedule, must run to
+ *       completion, and cannot be suspended, resumed, deleted or re-armed until thawed
+ */
+int HAL_SCHEDULER_FreezeGraph(TaskHandle taskHandle, ScheduleHandle* schedule);
+
+/**
+ * @brief Run one frame of a frozen schedule on the calling thread
+ * @param schedule Schedule handle
+ * @return HAL_OK on success, HAL_BUSY during a multi-threaded frame, HAL_ERROR on failure
+ * @note Calls the task functions in their frozen order without ready queues or dependency
+ *       counts; runs are not counted in TaskStats
+ */
+int HAL_SCHEDULER_RunSchedule(ScheduleHandle schedule);
+
+/**
+ * @brief Return the tasks of a frozen schedule to dynamic scheduling
+ * @param schedule Schedule handle (invalid afterwards)
+ * @return HAL_OK on success, HAL_ERROR on failure
+ * @note The graph comes back as a completed frame; HAL_SCHEDULER_RearmGraph starts the next one
+ */
+int HAL_SCHEDULER_ThawSchedule(ScheduleHandle schedule);
+
 /**
  * @brief Delete a task
  * @param taskHandle Task handle
@@ -74,12 +200,40 @@ int HAL_SCHEDULER_Stop(void);
  */
 TaskState HAL_SCHEDULER_GetTaskState(TaskHandle taskHandle);
 
+/**
+ * @brief Get run statistics of a task
+ * @param taskHandle Task handle
+ * @param stats Output statistics
+ * @return HAL_OK on success, HAL_ERROR on failure
+ */
+int HAL_SCHEDULER_GetTaskStats(TaskHandle taskHandle, TaskStats* stats);
+
 /**
  * @brief Yield current task
  * @return HAL_OK on success, HAL_ERROR on failure
  */
 int HAL_SCHEDULER_Yield(void);
 
+/**
+ * @brief Put the calling task to sleep for a time
+ * @param delayUs Sleep time in microseconds of system tick time, 0 to only yield
+ * @return HAL_OK on success, HAL_ERROR on failure
+ * @note A task that cannot block mid-function is suspended instead and must return right
+ *       after the call; it runs again from the start once the time has passed
+ */
+int HAL_SCHEDULER_Delay(uint32_t delayUs);
+
+/**
+ * @brief Put the calling task to sleep until one period after its last wake time
+ * @param lastWakeUs In: the last wake time (the loop's start time before the first call),
+ *        out: the new wake time, always exactly one period later so wakeups never drift
+ * @param periodUs Period in microseconds of system tick time
+ * @return HAL_OK on success, HAL_TIMEOUT without sleeping if the wake time has already
+ *         passed, HAL_ERROR on failure
+ * @note Same restriction as HAL_SCHEDULER_Delay for tasks that cannot block mid-function
+ */
+int HAL_SCHEDULER_DelayUntil(uint64_t* lastWakeUs, uint32_t periodUs);
+
 /**
  * @brief Suspend a task
  * @param taskHandle Task handle
@@ -94,4 +248,15 @@ int HAL_SCHEDULER_SuspendTask(TaskHandle taskHandle);
  */
 int HAL_SCHEDULER_ResumeTask(TaskHandle taskHandle);
 
+/**
+ * @brief Restrict the cores a task may run on
+ * @param taskHandle Task handle
+ * @param coreMask Bit n set allows core n; tasks start out allowed on every core
+ * @return HAL_OK on success, HAL_BUSY while the task runs on another core or belongs to a
+ *         frozen schedule, HAL_ERROR on failure (including a mask without any existing core)
+ * @note A task queued on a core it may no longer use moves right away; a running one
+ *       moves when it is queued next
+ */
+int HAL_SCHEDULER_SetAffinity(TaskHandle taskHandle, uint32_t coreMask);
+
 #endif /* HAL_SCHEDULER_H */
@@ -0,0 +1,61 @@
+/**
+ * @file hal_semaphore.h
+ * @brief Counting Semaphore Hardware Abstraction Layer Interface
+ */
+
+#ifndef HAL_SEMAPHORE_H
+#define HAL_SEMAPHORE_H
+
+#include "hal_types.h"
+
+/* Semaphore handle */
+typedef void* SemaphoreHandle;
+
+/**
+ * @brief Create a counting semaphore
+ * @param initialCount Count to start with
+ * @param maxCount Highest count (1 for a binary semaphore)
+ * @param semaphore Output semaphore handle
+ * @return HAL_OK on success, HAL_ERROR on failure
+ */
+int HAL_SEMAPHORE_Create(uint32_t initialCount, uint32_t maxCount, SemaphoreHandle* semaphore);
+
+/**
+ * @brief Delete a semaphore
+ * @param semaphore Semaphore handle
+ * @return HAL_OK on success, HAL_BUSY while tasks wait on it, HAL_ERROR on failure
+ */
+int HAL_SEMAPHORE_Delete(SemaphoreHandle semaphore);
+
+/**
+ * @brief Take one count, waiting while the count is zero
+ * @param semaphore Semaphore handle
+ * @param timeoutMs Timeout in milliseconds (0 = no timeout)
+ * @return HAL_OK on success, HAL_TIMEOUT on timeout, HAL_ERROR on error
+ * @note A waiting task blocks and lets other tasks run
+ */
+int HAL_SEMAPHORE_Take(SemaphoreHandle semaphore, uint32_t timeoutMs);
+
+/**
+ * @brief Take one count if there is one, without waiting
+ * @param semaphore Semaphore handle
+ * @return HAL_OK on success, HAL_BUSY if the count is zero, HAL_ERROR on error
+ */
+int HAL_SEMAPHORE_TryTake(SemaphoreHandle semaphore);
+
+/**
+ * @brief Give one count back, waking the highest-priority waiter
+ * @param semaphore Semaphore handle
+ * @return HAL_OK on success, HAL_ERROR if the count is at its maximum or on error
+ * @note Safe from interrupt context
+ */
+int HAL_SEMAPHORE_Give(SemaphoreHandle semaphore);
+
+/**
+ * @brief Get the current count of a semaphore
+ * @param semaphore Semaphore handle
+ * @return Count, 0 on invalid handle
+ */
+uint32_t HAL_SEMAPHORE_GetCount(SemaphoreHandle semaphore);
+
+#endif /* HAL_SEMAPHORE_H */
@@ -0,0 +1,124 @@
+/**
+ * @file bench_sim_memory.cpp
+ * @brief Memory Simulator Microbenchmarks
+ *
+ * Usage: bench_sim_memory [--quick]
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+extern "C" {
+#include "hal_memory.h"
+#include "sim_dma.h"
+#include "sim_memory.h"
+#include "sim_timer.h"
+}
+
+typedef std::chrono::steady_clock BenchClock;
+
+static double BenchNsPerOp(BenchClock::duration elapsed, long ops)
+{
+    return std::chrono::duration<double, std::nano>(elapsed).count() / ops;
+}
+
+#define BENCH_MAX_COPY (64 * 1024)
+#define BENCH_BUS_BYTES_PER_US 1000
+
+/*
+ * CPU time HAL_MEMORY_CopyBufferAsync costs the caller per copy, issue plus
+ * completion poll. On the DMA path the bytes move while simulated time advances,
+ * which is left out of the measurement: that is the time the CPU gets back.
+ */
+static double BenchCopyNs(MemoryBuffer dst, MemoryBuffer src, size_t size, size_t threshold,
+                          long iterations)
+{
+    SimMemoryCopyConfig config = {0, 0, threshold};
+    SIM_MEMORY_ConfigureCopy(&config);
+
+    uint64_t transferUs = (size + BENCH_BUS_BYTES_PER_US - 1) / BENCH_BUS_BYTES_PER_US;
+    BenchClock::duration elapsed = BenchClock::duration::zero();
+
+    for (long i = 0; i < iterations; i++) {
+        MemoryCopyToken token;
+        BenchClock::time_point start = BenchClock::now();
+        if (HAL_MEMORY_CopyBufferAsync(dst, src, size, &token) != HAL_OK)
+            return -1.0;
+        int poll = HAL_MEMORY_PollCopy(token);
+        elapsed += BenchClock::now() - start;
+
+        if (poll == HAL_BUSY) {
+            SIM_TIMER_AdvanceTime(transferUs);
+            start = BenchClock::now();
+            poll = HAL_MEMORY_PollCopy(token);
+            elapsed += BenchClock::now() - start;
+        }
+        if (poll != HAL_OK)
+            return -1.0;
+    }
+    return BenchNsPerOp(elapsed, iterations);
+}
+
+/* memcpy vs DMA offload across copy sizes, and the size where offloading starts to pay */
+static int BenchCopyCrossover(long iterations)
+{
+    MemoryBuffer src, dst;
+    if (HAL_MEMORY_AllocBuffer(POOL_NAME_SRAM, BENCH_MAX_COPY, &src) != HAL_OK ||
+        HAL_MEMORY_AllocBuffer(POOL_NAME_SRAM, BENCH_MAX_COPY, &dst) != HAL_OK)
+        return 1;
+
+    void* srcAddr;
+    HAL_MEMORY_GetAddr(src, &srcAddr);
+    memset(srcAddr, 0x5A, BENCH_MAX_COPY);
+
+    size_t crossover = 0;
+    printf("%-10s %14s %14s\n", "size", "cpu ns/op", "dma ns/op");
+    for (size_t size = 16; size <= BENCH_MAX_COPY; size *= 2) {
+        double cpuNs = BenchCopyNs(dst, src, size, SIZE_MAX, iterations);
+        double dmaNs = BenchCopyNs(dst, src, size, 1, iterations);
+        if (cpuNs < 0 || dmaNs < 0)
+            return 1;
+
+        printf("%-10zu %14.1f %14.1f\n", size, cpuNs, dmaNs);
+        if (dmaNs < cpuNs && crossover == 0) {
+            crossover = size;
+        } else if (dmaNs >= cpuNs) {
+            crossover = 0;
+        }
+    }
+
+    if (crossover) {
+        printf("%-10s %14zu bytes\n", "crossover", crossover);
+    } else {
+        printf("%-10s %14s\n", "crossover", "none");
+    }
+    printf("%-10s %14d bytes\n", "default", SIM_MEMORY_DEFAULT_COPY_THRESHOLD);
+
+    HAL_MEMORY_FreeBuffer(dst);
+    HAL_MEMORY_FreeBuffer(src);
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    bool quick = argc > 1 && strcmp(argv[1], "--quick") == 0;
+    long iterations = quick ? 200 : 20000;
+
+    SIM_TIMER_Init();
+    SIM_DMA_Reset();
+    SIM_DMA_SetLogging(false);
+    SimDmaConfig dmaConfig = {BENCH_BUS_BYTES_PER_US, 0, 0, 0};
+    HAL_DMA_Init(0, &dmaConfig);
+    SIM_MEMORY_SimulatorInit();
+    SIM_MEMORY_ConfigurePool(POOL_NAME_SRAM, (void*) 0x20000000, 4 * BENCH_MAX_COPY);
+
+    printf("== Async copy, caller CPU time (%ld iterations, %d B/us bus) ==\n", iterations,
+           BENCH_BUS_BYTES_PER_US);
+    int ret = BenchCopyCrossover(iterations);
+
+    SIM_MEMORY_SimulatorReset();
+    SIM_DMA_Reset();
+    return ret;
+}
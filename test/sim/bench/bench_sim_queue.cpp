@@ -0,0 +1,236 @@
+/**
+ * @file bench_sim_queue.cpp
+ * @brief Message Queue Simulator Microbenchmarks
+ *
+ * Usage: bench_sim_queue [--quick]
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+extern "C" {
+#include "hal_queue.h"
+#include "hal_scheduler.h"
+#include "sim_queue.h"
+#include "sim_scheduler.h"
+}
+
+typedef std::chrono::steady_clock BenchClock;
+
+static double BenchNsPerOp(BenchClock::time_point start, BenchClock::time_point end, long ops)
+{
+    return std::chrono::duration<double, std::nano>(end - start).count() / ops;
+}
+
+#define BENCH_QUEUE_DEPTH 1024
+
+/* Send and receive on one thread: the cost of the ring operations alone */
+static int BenchUncontended(QueueMode mode, long messages)
+{
+    QueueHandle queue;
+    if (HAL_QUEUE_Create(sizeof(uint64_t), BENCH_QUEUE_DEPTH, mode, &queue) != HAL_OK)
+        return 1;
+
+    long batches = messages / 64;
+    uint64_t sum = 0;
+    BenchClock::time_point start = BenchClock::now();
+    for (long i = 0; i < batches; i++) {
+        for (uint64_t k = 0; k < 64; k++) {
+            HAL_QUEUE_TrySend(queue, &k);
+        }
+        for (int k = 0; k < 64; k++) {
+            uint64_t value;
+            HAL_QUEUE_TryReceive(queue, &value);
+            sum += value;
+        }
+    }
+    double ns = BenchNsPerOp(start, BenchClock::now(), batches * 64);
+
+    HAL_QUEUE_Delete(queue);
+    if (sum != (uint64_t) batches * (63 * 64 / 2))
+        return 1;
+    printf("%-6s %-10s %9s %12.1f %10.1f\n", mode == QUEUE_MODE_MPSC ? "MPSC" : "SPSC", "1 thread",
+           "-", ns, 1000.0 / ns);
+    return 0;
+}
+
+/* Host threads streaming messages, spinning on a full or empty ring */
+static int BenchStream(QueueMode mode, int producers, long messages)
+{
+    QueueHandle queue;
+    if (HAL_QUEUE_Create(sizeof(uint64_t), BENCH_QUEUE_DEPTH, mode, &queue) != HAL_OK)
+        return 1;
+
+    long perProducer = messages / producers;
+    BenchClock::time_point start = BenchClock::now();
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; p++) {
+        threads.emplace_back([queue, perProducer] {
+            for (uint64_t i = 0; i < (uint64_t) perProducer; i++) {
+                while (HAL_QUEUE_TrySend(queue, &i) != HAL_OK) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    uint64_t sum = 0;
+    for (long received = 0; received < perProducer * producers;) {
+        uint64_t value;
+        if (HAL_QUEUE_TryReceive(queue, &value) != HAL_OK) {
+            std::this_thread::yield();
+            continue;
+        }
+        sum += value;
+        received++;
+    }
+    double ns = BenchNsPerOp(start, BenchClock::now(), perProducer * producers);
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    HAL_QUEUE_Delete(queue);
+    if (sum != (uint64_t) producers * ((uint64_t) perProducer * (perProducer - 1) / 2))
+        return 1;
+
+    char senders[32];
+    snprintf(senders, sizeof(senders), "%d -> 1", producers);
+    printf("%-6s %-10s %9d %12.1f %10.1f\n", mode == QUEUE_MODE_MPSC ? "MPSC" : "SPSC", senders,
+           BENCH_QUEUE_DEPTH, ns, 1000.0 / ns);
+    return 0;
+}
+
+/* One message bounced between two host threads through a pair of SPSC rings */
+static int BenchPingPong(long rounds)
+{
+    QueueHandle ping, pong;
+    if (HAL_QUEUE_Create(sizeof(uint64_t), 1, QUEUE_MODE_SPSC, &ping) != HAL_OK ||
+        HAL_QUEUE_Create(sizeof(uint64_t), 1, QUEUE_MODE_SPSC, &pong) != HAL_OK)
+        return 1;
+
+    std::thread echo([ping, pong, rounds] {
+        for (long i = 0; i < rounds; i++) {
+            uint64_t value;
+            while (HAL_QUEUE_TryReceive(ping, &value) != HAL_OK) {
+                std::this_thread::yield();
+            }
+            while (HAL_QUEUE_TrySend(pong, &value) != HAL_OK) {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    BenchClock::time_point start = BenchClock::now();
+    for (uint64_t i = 0; i < (uint64_t) rounds; i++) {
+        uint64_t value = i;
+        while (HAL_QUEUE_TrySend(ping, &value) != HAL_OK) {
+            std::this_thread::yield();
+        }
+        while (HAL_QUEUE_TryReceive(pong, &value) != HAL_OK) {
+            std::this_thread::yield();
+        }
+        if (value != i)
+            return 1;
+    }
+    double ns = BenchNsPerOp(start, BenchClock::now(), rounds);
+    echo.join();
+
+    HAL_QUEUE_Delete(ping);
+    HAL_QUEUE_Delete(pong);
+    printf("%-28s %12.1f ns\n", "round trip", ns);
+    printf("%-28s %12.1f ns\n", "one-way latency", ns / 2);
+    return 0;
+}
+
+struct BenchPipe {
+    QueueHandle queue;
+    long messages;
+};
+
+static void BenchSenderTask(void* args)
+{
+    BenchPipe* pipe = (BenchPipe*) args;
+    for (uint64_t i = 0; i < (uint64_t) pipe->messages; i++) {
+        HAL_QUEUE_Send(pipe->queue, &i, 0);
+    }
+}
+
+static void BenchReceiverTask(void* args)
+{
+    BenchPipe* pipe = (BenchPipe*) args;
+    for (long i = 0; i < pipe->messages; i++) {
+        uint64_t value;
+        HAL_QUEUE_Receive(pipe->queue, &value, 0);
+    }
+}
+
+/* Stackful tasks that block on the queue, woken by the other side */
+static int BenchBlockingTasks(uint32_t depth, long messages)
+{
+    HAL_SCHEDULER_Init();
+    if (SIM_SCHEDULER_SetTaskStacks(SIM_SCHEDULER_DEFAULT_STACK_BYTES) != 0)
+        return 1;
+
+    BenchPipe pipe = {nullptr, messages};
+    TaskHandle sender, receiver;
+    if (HAL_QUEUE_Create(sizeof(uint64_t), depth, QUEUE_MODE_SPSC, &pipe.queue) != HAL_OK ||
+        HAL_SCHEDULER_CreateTask(BenchReceiverTask, &pipe, TASK_PRIORITY_HIGH, &receiver) !=
+            HAL_OK ||
+        HAL_SCHEDULER_CreateTask(BenchSenderTask, &pipe, TASK_PRIORITY_NORMAL, &sender) !=
+            HAL_OK)
+        return 1;
+
+    BenchClock::time_point start = BenchClock::now();
+    if (HAL_SCHEDULER_Start() != HAL_OK)
+        return 1;
+    double ns = BenchNsPerOp(start, BenchClock::now(), messages);
+
+    SimQueueStats stats;
+    SIM_QUEUE_GetStats(pipe.queue, &stats);
+    HAL_QUEUE_Delete(pipe.queue);
+    SIM_SCHEDULER_SetTaskStacks(0);
+    if (stats.received != (uint64_t) messages ||
+        HAL_SCHEDULER_GetTaskState(receiver) != TASK_STATE_COMPLETED)
+        return 1;
+
+    printf("%-8u %12.1f %14.3f\n", depth, ns, (double) (stats.sendWaits + stats.recvWaits) /
+                                                     messages);
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    bool quick = argc > 1 && strcmp(argv[1], "--quick") == 0;
+    long messages = quick ? 20000 : 20000000;
+    long rounds = quick ? 2000 : 200000;
+    long taskMessages = quick ? 2000 : 2000000;
+    uint32_t cores = std::thread::hardware_concurrency();
+
+    printf("== Host threads, lock-free rings (%ld messages of 8 bytes, %u cores) ==\n", messages,
+           cores);
+    printf("%-6s %-10s %9s %12s %10s\n", "ring", "threads", "depth", "ns/msg", "M msg/s");
+    if (BenchUncontended(QUEUE_MODE_SPSC, messages) != 0 ||
+        BenchUncontended(QUEUE_MODE_MPSC, messages) != 0 ||
+        BenchStream(QUEUE_MODE_SPSC, 1, messages) != 0)
+        return 1;
+    for (int producers = 1; producers <= 4; producers *= 2) {
+        if (BenchStream(QUEUE_MODE_MPSC, producers, messages) != 0)
+            return 1;
+    }
+
+    printf("\n== Host threads, ping-pong over two SPSC rings (%ld rounds) ==\n", rounds);
+    if (BenchPingPong(rounds) != 0)
+        return 1;
+
+    printf("\n== Stackful tasks, blocking Send/Receive (%ld messages) ==\n", taskMessages);
+    printf("%-8s %12s %14s\n", "depth", "ns/msg", "waits/msg");
+    const uint32_t depths[] = {1, 16, 256};
+    for (uint32_t depth : depths) {
+        if (BenchBlockingTasks(depth, taskMessages) != 0)
+            return 1;
+    }
+    return 0;
+}
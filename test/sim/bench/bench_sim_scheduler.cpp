@@ -0,0 +1,328 @@
+/**
+ * @file bench_sim_scheduler.cpp
+ * @brief Scheduler Simulator Microbenchmarks
+ *
+ * Usage: bench_sim_scheduler [--quick]
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+extern "C" {
+#include "hal_scheduler.h"
+#include "hal_timer.h"
+#include "sim_scheduler.h"
+#include "sim_timer.h"
+}
+
+typedef std::chrono::steady_clock BenchClock;
+
+static double BenchNsPerOp(BenchClock::time_point start, BenchClock::time_point end, long ops)
+{
+    return std::chrono::duration<double, std::nano>(end - start).count() / ops;
+}
+
+#define BENCH_TASKS 48
+
+/* Yields until its budget runs out, as a task that processes one item per turn */
+static void BenchYieldingTask(void* args)
+{
+    long* remaining = (long*) args;
+    if (--*remaining > 0) {
+        HAL_SCHEDULER_Yield();
+    }
+}
+
+/* Tasks spread over all priority levels, each dispatched turns times */
+static int BenchDispatch(long turns)
+{
+    static long remaining[BENCH_TASKS];
+
+    HAL_SCHEDULER_Init();
+    for (int i = 0; i < BENCH_TASKS; i++) {
+        TaskHandle handle;
+        remaining[i] = turns;
+        if (HAL_SCHEDULER_CreateTask(BenchYieldingTask, &remaining[i],
+                                     (TaskPriority) (i % (TASK_PRIORITY_REALTIME + 1)),
+                                     &handle) != HAL_OK)
+            return 1;
+    }
+
+    BenchClock::time_point start = BenchClock::now();
+    if (HAL_SCHEDULER_Start() != HAL_OK)
+        return 1;
+    BenchClock::time_point end = BenchClock::now();
+
+    SimSchedulerStats stats;
+    SIM_SCHEDULER_GetStats(&stats);
+    if (stats.completions != BENCH_TASKS)
+        return 1;
+
+    double ns = BenchNsPerOp(start, end, (long) stats.dispatches);
+    printf("%-28s %12llu\n", "dispatches", (unsigned long long) stats.dispatches);
+    printf("%-28s %12.1f ns/op\n", "dispatch + yield", ns);
+    printf("%-28s %12.2f M/s\n", "throughput", 1000.0 / ns);
+    return 0;
+}
+
+/* Loops like an RTOS task, switching out in the middle of the function */
+static void BenchCoroutineTask(void* args)
+{
+    long turns = *(long*) args;
+    for (long i = 0; i < turns; i++) {
+        HAL_SCHEDULER_Yield();
+    }
+}
+
+/* Two stackful tasks handing the CPU back and forth through HAL_SCHEDULER_Yield */
+static int BenchContextSwitch(long turns)
+{
+    HAL_SCHEDULER_Init();
+    if (SIM_SCHEDULER_SetTaskStacks(SIM_SCHEDULER_DEFAULT_STACK_BYTES) != 0)
+        return 1;
+
+    for (int i = 0; i < 2; i++) {
+        TaskHandle handle;
+        if (HAL_SCHEDULER_CreateTask(BenchCoroutineTask, &turns, TASK_PRIORITY_NORMAL,
+                                     &handle) != HAL_OK)
+            return 1;
+    }
+
+    BenchClock::time_point start = BenchClock::now();
+    if (HAL_SCHEDULER_Start() != HAL_OK)
+        return 1;
+    BenchClock::time_point end = BenchClock::now();
+
+    SimSchedulerStats stats;
+    SIM_SCHEDULER_GetStats(&stats);
+    SIM_SCHEDULER_SetTaskStacks(0);
+    if (stats.completions != 2)
+        return 1;
+
+    /* Each yield leaves one task and enters the other, through the dispatcher */
+    printf("%-28s %12llu\n", "yields", (unsigned long long) stats.yields);
+    double ns = BenchNsPerOp(start, end, (long) stats.yields);
+    printf("%-28s %12.1f ns/op\n", "task-to-task switch", ns);
+    return 0;
+}
+
+#define BENCH_GRAPH_STAGES 62
+#define BENCH_STEAL_STAGES 400 /* Hundreds of small tasks per frame */
+
+/* Stand-in for a small DSP kernel */
+static void BenchStageTask(void* args)
+{
+    volatile uint32_t* sink = (volatile uint32_t*) args;
+    uint32_t x = *sink;
+    for (int i = 0; i < 2000; i++) {
+        x = x * 1664525u + 1013904223u;
+    }
+    *sink = x;
+}
+
+static void BenchEdgeTask(void* args)
+{
+    (void) args;
+}
+
+/* Fork-join frame graph (source -> 400 stages -> sink) re-armed every frame */
+static int BenchGraphFrames(uint32_t workers, long frames, double* baselineUs)
+{
+    static uint32_t sinks[BENCH_STEAL_STAGES];
+
+    HAL_SCHEDULER_Init();
+    if (SIM_SCHEDULER_SetWorkers(workers) != 0)
+        return 1;
+
+    TaskHandle source, sink;
+    HAL_SCHEDULER_CreateTask(BenchEdgeTask, NULL, TASK_PRIORITY_HIGH, &source);
+    HAL_SCHEDULER_CreateTask(BenchEdgeTask, NULL, TASK_PRIORITY_HIGH, &sink);
+    for (int i = 0; i < BENCH_STEAL_STAGES; i++) {
+        TaskHandle stage;
+        if (HAL_SCHEDULER_CreateTask(BenchStageTask, &sinks[i], TASK_PRIORITY_NORMAL, &stage) !=
+                HAL_OK ||
+            HAL_SCHEDULER_AddDependency(source, stage) != HAL_OK ||
+            HAL_SCHEDULER_AddDependency(stage, sink) != HAL_OK)
+            return 1;
+    }
+
+    BenchClock::time_point start = BenchClock::now();
+    for (long frame = 0; frame < frames; frame++) {
+        if (HAL_SCHEDULER_Start() != HAL_OK || HAL_SCHEDULER_RearmGraph(source) != HAL_OK)
+            return 1;
+    }
+    BenchClock::time_point end = BenchClock::now();
+
+    uint64_t steals = 0, idleNs = 0;
+    for (uint32_t i = 0; i < workers; i++) {
+        SimSchedulerWorkerStats stats;
+        SIM_SCHEDULER_GetWorkerStats(i, &stats);
+        steals += stats.steals;
+        idleNs += stats.idleNs;
+    }
+
+    double frameUs = BenchNsPerOp(start, end, frames) / 1000.0;
+    double totalNs = std::chrono::duration<double, std::nano>(end - start).count() * workers;
+    if (*baselineUs == 0) {
+        *baselineUs = frameUs;
+    }
+    printf("%-8u %12.1f %10.2fx %12.1f %9.1f%%\n", workers, frameUs, *baselineUs / frameUs,
+           (double) steals / frames, 100.0 * idleNs / totalNs);
+
+    SIM_SCHEDULER_SetWorkers(0);
+    return 0;
+}
+
+/* Fork-join frame graph of empty tasks, so only scheduling is measured */
+static int BenchBuildEmptyGraph(TaskHandle* source)
+{
+    TaskHandle sink;
+    HAL_SCHEDULER_Init();
+    HAL_SCHEDULER_CreateTask(BenchEdgeTask, NULL, TASK_PRIORITY_HIGH, source);
+    HAL_SCHEDULER_CreateTask(BenchEdgeTask, NULL, TASK_PRIORITY_HIGH, &sink);
+    for (int i = 0; i < BENCH_GRAPH_STAGES; i++) {
+        TaskHandle stage;
+        if (HAL_SCHEDULER_CreateTask(BenchEdgeTask, NULL, TASK_PRIORITY_NORMAL, &stage) !=
+                HAL_OK ||
+            HAL_SCHEDULER_AddDependency(*source, stage) != HAL_OK ||
+            HAL_SCHEDULER_AddDependency(stage, sink) != HAL_OK)
+            return 1;
+    }
+    return 0;
+}
+
+/* The same graph dispatched dynamically (Start + RearmGraph) and replayed frozen */
+static int BenchFrozenFrames(long frames)
+{
+    const int tasks = BENCH_GRAPH_STAGES + 2;
+    TaskHandle source;
+
+    if (BenchBuildEmptyGraph(&source) != 0)
+        return 1;
+    BenchClock::time_point start = BenchClock::now();
+    for (long frame = 0; frame < frames; frame++) {
+        if (HAL_SCHEDULER_Start() != HAL_OK || HAL_SCHEDULER_RearmGraph(source) != HAL_OK)
+            return 1;
+    }
+    double dynamicNs = BenchNsPerOp(start, BenchClock::now(), frames);
+
+    ScheduleHandle schedule;
+    if (BenchBuildEmptyGraph(&source) != 0 ||
+        HAL_SCHEDULER_FreezeGraph(source, &schedule) != HAL_OK)
+        return 1;
+    start = BenchClock::now();
+    for (long frame = 0; frame < frames; frame++) {
+        if (HAL_SCHEDULER_RunSchedule(schedule) != HAL_OK)
+            return 1;
+    }
+    double frozenNs = BenchNsPerOp(start, BenchClock::now(), frames);
+
+    printf("%-8s %12s %12s %10s\n", "mode", "ns/frame", "ns/task", "speedup");
+    printf("%-8s %12.1f %12.1f %9.2fx\n", "dynamic", dynamicNs, dynamicNs / tasks, 1.0);
+    printf("%-8s %12.1f %12.1f %9.2fx\n", "frozen", frozenNs, frozenNs / tasks,
+           dynamicNs / frozenNs);
+    return 0;
+}
+
+/* Control loop: 50 us of work every 10 ms, sleeping in between */
+struct BenchSleeper {
+    TaskHandle self;
+    long wakeups;
+};
+
+#define BENCH_SLEEP_PERIOD_US 10000
+#define BENCH_SLEEP_WORK_US 50
+#define BENCH_SLEEP_STEP_US 100
+
+static void BenchSleepingTask(void* args)
+{
+    BenchSleeper* sleeper = (BenchSleeper*) args;
+    HAL_TIMER_DelayUs(BENCH_SLEEP_WORK_US);
+    if (--sleeper->wakeups > 0) {
+        SIM_SCHEDULER_ResumeAt(sleeper->self, SIM_TIMER_GetCurrentTime() -
+                                                  BENCH_SLEEP_WORK_US + BENCH_SLEEP_PERIOD_US);
+        HAL_SCHEDULER_SuspendTask(sleeper->self);
+    }
+}
+
+/* Idle-dominated soak, driven in fixed time steps or by the tickless dispatcher */
+static int BenchSoak(bool tickless, long wakeups, double* steppedNs)
+{
+    BenchSleeper sleeper = {nullptr, wakeups};
+
+    SIM_TIMER_Init();
+    HAL_SCHEDULER_Init();
+    if (HAL_SCHEDULER_CreateTask(BenchSleepingTask, &sleeper, TASK_PRIORITY_NORMAL,
+                                 &sleeper.self) != HAL_OK ||
+        SIM_SCHEDULER_SetTickless(tickless) != 0)
+        return 1;
+
+    BenchClock::time_point start = BenchClock::now();
+    if (HAL_SCHEDULER_Start() != HAL_OK)
+        return 1;
+    while (HAL_SCHEDULER_GetTaskState(sleeper.self) != TASK_STATE_COMPLETED) {
+        SIM_TIMER_AdvanceTime(BENCH_SLEEP_STEP_US);
+        if (HAL_SCHEDULER_Start() != HAL_OK)
+            return 1;
+    }
+    double ns = BenchNsPerOp(start, BenchClock::now(), wakeups);
+
+    SimSchedulerIdleStats idle;
+    SIM_SCHEDULER_GetIdleStats(&idle);
+    if (!tickless) {
+        *steppedNs = ns;
+    }
+    printf("%-10s %12.1f %14.3f %12llu %9.0fx\n", tickless ? "tickless" : "stepped", ns,
+           (double) SIM_TIMER_GetCurrentTime() / 1e6, (unsigned long long) idle.sleeps,
+           *steppedNs / ns);
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    bool quick = argc > 1 && strcmp(argv[1], "--quick") == 0;
+    long turns = quick ? 1000 : 200000;
+    long frames = quick ? 20 : 2000;
+
+    printf("== Dispatcher (%d tasks, %ld turns each) ==\n", BENCH_TASKS, turns);
+    if (BenchDispatch(turns) != 0)
+        return 1;
+
+    printf("\n== Context switch, stackful tasks (2 tasks, %ld yields each) ==\n", turns);
+    if (BenchContextSwitch(turns) != 0)
+        return 1;
+
+    uint32_t cores = std::thread::hardware_concurrency();
+    uint32_t maxWorkers = cores < SIM_SCHEDULER_MAX_WORKERS ? cores : SIM_SCHEDULER_MAX_WORKERS;
+    if (quick || maxWorkers < 2) {
+        maxWorkers = 2;
+    }
+    double baselineUs = 0;
+
+    printf("\n== Graph frames, work stealing (%d tasks per frame, %ld frames, %u cores) ==\n",
+           BENCH_STEAL_STAGES + 2, frames, cores);
+    printf("%-8s %12s %11s %12s %10s\n", "workers", "us/frame", "speedup", "steals/frame",
+           "idle");
+    for (uint32_t workers = 1; workers <= maxWorkers; workers *= 2) {
+        if (BenchGraphFrames(workers, frames, &baselineUs) != 0)
+            return 1;
+    }
+
+    long frozenFrames = quick ? 100 : 100000;
+    printf("\n== Graph frames, frozen vs dynamic (%d empty tasks per frame, %ld frames) ==\n",
+           BENCH_GRAPH_STAGES + 2, frozenFrames);
+    if (BenchFrozenFrames(frozenFrames) != 0)
+        return 1;
+
+    long wakeups = quick ? 100 : 10000;
+    double steppedNs = 0;
+    printf("\n== Idle soak, %d us of work every %d us (%ld wakeups, %d us steps) ==\n",
+           BENCH_SLEEP_WORK_US, BENCH_SLEEP_PERIOD_US, wakeups, BENCH_SLEEP_STEP_US);
+    printf("%-10s %12s %14s %12s %10s\n", "mode", "ns/wakeup", "simulated s", "idle jumps",
+           "speedup");
+    if (BenchSoak(false, wakeups, &steppedNs) != 0 || BenchSoak(true, wakeups, &steppedNs) != 0)
+        return 1;
+    return 0;
+}
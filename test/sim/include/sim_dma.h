@@ -0,0 +1,233 @@
+/**
+ * @file sim_dma.h
+ * @brief DMA Simulation - Implements HAL_DMA interface
+ */
+
+#ifndef SIM_DMA_H
+#define SIM_DMA_H
+
+#include "hal_dma.h"
+
+/* Upper bound for SimDmaConfig.channelCount */
+#define SIM_DMA_MAX_CHANNELS_PER_INSTANCE 4096
+
+/* Descriptors per channel submission ring (and tags per completion ring) */
+#define SIM_DMA_QUEUE_DEPTH 16
+
+/* Upper bound for SimDmaParallelConfig.workers */
+#define SIM_DMA_MAX_COPY_WORKERS 64
+
+/* Defaults for SimDmaParallelConfig fields left at 0 */
+#define SIM_DMA_DEFAULT_PARALLEL_THRESHOLD (8u * 1024 * 1024)
+#define SIM_DMA_DEFAULT_PARALLEL_CHUNK (1u * 1024 * 1024)
+
+/* Transfer trace ring capacity when SIM_DMA_StartTrace gets 0 */
+#define SIM_DMA_TRACE_DEFAULT_CAPACITY 4096
+
+/* Transfer size histogram: bucket 0 holds sizes up to 64 bytes, each further bucket doubles */
+#define SIM_DMA_TRACE_SIZE_BUCKETS 16
+
+/* Simulation-specific DMA instance configuration (pass as DmaConfig to HAL_DMA_Init) */
+typedef struct {
+    uint32_t busBytesPerUs; /* Shared bus bandwidth, 0 = unlimited (transfers complete on start) */
+    uint32_t burstBytes;    /* Bytes granted per arbitration slot, 0 = default (64) */
+    uint32_t cpuPriority;   /* Arbitration priority of CPU copies on the bus */
+    uint32_t channelCount;  /* Channels on this instance, 0 = keep current (default 32) */
+} SimDmaConfig;
+
+/* Host-side parallel copy of large transfers on instances without a bus model */
+typedef struct {
+    uint32_t workers;      /* Copy threads, 0 = off (every transfer is one memcpy) */
+    size_t thresholdBytes; /* Memory-to-memory transfers from this size go parallel, 0 = default */
+    size_t chunkBytes;     /* Progress update granularity per worker, 0 = default */
+    bool pinWorkers;       /* Pin worker i to CPU i (Linux only) */
+} SimDmaParallelConfig;
+
+/* Per-channel transfer statistics */
+typedef struct {
+    uint32_t transfers;       /* Completed transfers */
+    uint64_t bytes;           /* Completed bytes */
+    uint32_t grants;          /* Arbitration slots won */
+    uint64_t queueDelayNs;    /* Sum of submit-to-first-grant delays */
+    uint64_t maxQueueDelayNs; /* Worst submit-to-first-grant delay */
+    uint64_t serviceNs;       /* Sum of submit-to-completion times */
+    uint32_t queueDepth;      /* Descriptors currently queued or in flight */
+    uint32_t maxQueueDepth;   /* Deepest the submission ring has been */
+    uint64_t idleGapNs;       /* Sum of engine idle time between consecutive transfers */
+    uint32_t completionOverflows; /* Tags dropped because the completion ring was full */
+    uint32_t triggeredStarts;     /* Transfers started by a channel or timer trigger */
+    uint32_t missedTriggers;      /* Triggers lost because the channel was busy */
+    uint32_t batchCallbacks;      /* Coalesced completion callbacks fired */
+    uint32_t callbacksSaved;      /* Completions that did not get a callback of their own */
+    uint64_t coalesceDelayNs;     /* Sum over completions of completion-to-callback delay */
+    uint64_t maxCoalesceDelayNs;  /* Worst completion-to-callback delay */
+    uint32_t parallelTransfers;   /* Transfers copied by the parallel worker pool */
+} SimDmaChannelStats;
+
+/* Cache maintenance done by HAL_DMA_StartBufferTransfer, against whole-buffer flush/invalidate */
+typedef struct {
+    uint32_t performedOps;
+    uint64_t performedBytes;
+    uint32_t avoidedOps;
+    uint64_t avoidedBytes;
+} SimDmaCacheStats;
+
+/* Per-instance bus statistics */
+typedef struct {
+    uint64_t busyNs;   /* Time the bus spent moving data */
+    uint64_t dmaBytes; /* Bytes moved on behalf of DMA channels */
+    uint64_t cpuBytes; /* Bytes moved on behalf of CPU copies */
+} SimDmaBusStats;
+
+/* SimDmaTraceRecord.flags */
+#define SIM_DMA_TRACE_TAGGED 0x01u /* Queued transfer that reported a tag */
+#define SIM_DMA_TRACE_PERIPH 0x02u /* Source or destination was a virtual peripheral */
+
+/*
+ * One completed transfer. The layout is fixed (48 bytes, no padding) and is also the
+ * record format of the binary export: a 16-byte header ("SDMT", version 1, record
+ * size, record count as little-endian uint32) followed by the records, oldest first.
+ */
+typedef struct {
+    uint64_t submitNs; /* Engine took the descriptor */
+    uint64_t startNs;  /* First bus grant */
+    uint64_t endNs;    /* Completion */
+    uint64_t size;
+    uint32_t channel;  /* Channel handle (DmaChannel value) */
+    uint32_t priority;
+    uint8_t dmaId;
+    uint8_t direction; /* DmaDirection */
+    uint8_t flags;     /* SIM_DMA_TRACE_* */
+    uint8_t reserved[5];
+} SimDmaTraceRecord;
+
+/* Trace export formats */
+typedef enum {
+    SIM_DMA_TRACE_BINARY = 0, /* Compact record file, see SimDmaTraceRecord */
+    SIM_DMA_TRACE_CHROME = 1  /* Chrome / Perfetto trace event JSON */
+} SimDmaTraceFormat;
+
+/* Per-instance summary of the traced transfers */
+typedef struct {
+    uint32_t transfers;
+    uint64_t bytes;
+    uint64_t windowNs;        /* First submit to last completion */
+    uint64_t busyNs;          /* Time at least one channel had a transfer on the bus */
+    uint32_t utilizationPpm;  /* busyNs / windowNs in parts per million */
+    uint64_t queueDelayNs;    /* Sum of submit-to-start delays */
+    uint64_t maxQueueDelayNs;
+    uint32_t sizeHistogram[SIM_DMA_TRACE_SIZE_BUCKETS];
+} SimDmaTraceSummary;
+
+/**
+ * @brief Reset DMA simulator (deinitializes all instances and releases all channels)
+ * @return 0 on success, -1 on failure
+ */
+int SIM_DMA_Reset(void);
+
+/**
+ * @brief Change bus bandwidth of an initialized DMA instance
+ * @param dmaId DMA instance ID
+ * @param busBytesPerUs Bandwidth in bytes per microsecond, 0 = unlimited
+ * @return 0 on success, -1 on failure
+ */
+int SIM_DMA_SetBandwidth(DmaId dmaId, uint32_t busBytesPerUs);
+
+/**
+ * @brief Put CPU copy traffic on the bus of a DMA instance
+ * @param dmaId DMA instance ID
+ * @param bytes Bytes the CPU moves; they compete with DMA channels at cpuPriority
+ * @return 0 on success, -1 on failure
+ */
+int SIM_DMA_AddCpuTraffic(DmaId dmaId, size_t bytes);
+
+/**
+ * @brief Enable or disable per-transfer log lines (enabled after reset)
+ * @param enabled true to log every completed transfer
+ * @return 0 on success, -1 on failure
+ */
+int SIM_DMA_SetLogging(bool enabled);
+
+/**
+ * @brief Split large memory-to-memory transfers across a persistent worker pool (off after reset)
+ *
+ * Such a transfer no longer completes inside the start call: the channel stays busy,
+ * HAL_DMA_GetProgress reports the bytes copied so far, and completion (callback,
+ * completion ring, next queued descriptor) is delivered on the calling thread by the
+ * first DMA call or time advance after the last chunk finished. Simulated time does
+ * not advance meanwhile; HAL_DMA_WaitComplete blocks on the copy itself.
+ *
+ * @param config Parallel copy configuration, NULL = off
+ * @return 0 on success, -1 on failure
+ */
+int SIM_DMA_SetParallelCopy(const SimDmaParallelConfig* config);
+
+/**
+ * @brief Start recording every completed transfer into a ring (drops earlier records)
+ * @param capacity Records kept, rounded up to a power of two; the oldest are overwritten
+ *                 once it is full; 0 = default (4096)
+ * @return 0 on success, -1 on failure
+ */
+int SIM_DMA_StartTrace(uint32_t capacity);
+
+/**
+ * @brief Stop recording (records stay available until the next start or reset)
+ * @return 0 on success, -1 on failure
+ */
+int SIM_DMA_StopTrace(void);
+
+/**
+ * @brief Copy the recorded transfers out, oldest first
+ * @param records Output array
+ * @param maxRecords Array length
+ * @param count Output: records copied
+ * @return 0 on success, -1 on failure
+ */
+int SIM_DMA_ReadTrace(SimDmaTraceRecord* records, uint32_t maxRecords, uint32_t* count);
+
+/**
+ * @brief Write the recorded transfers to a file
+ * @param path Output file path
+ * @param format Export format
+ * @return 0 on success, -1 on failure
+ */
+int SIM_DMA_ExportTrace(const char* path, SimDmaTraceFormat format);
+
+/**
+ * @brief Summarize the recorded transfers of one DMA instance
+ * @param dmaId DMA instance ID
+ * @param summary Output summary
+ * @return 0 on success, -1 on failure
+ */
+int SIM_DMA_GetTraceSummary(DmaId dmaId, SimDmaTraceSummary* summary);
+
+/**
+ * @brief Print utilization, queueing delay and size histogram of every traced instance
+ * @return 0 on success, -1 on failure
+ */
+int SIM_DMA_PrintTraceReport(void);
+
+/**
+ * @brief Get channel statistics
+ * @param channel Channel handle
+ * @param stats Output statistics
+ * @return 0 on success, -1 on failure
+ */
+int SIM_DMA_GetChannelStats(DmaChannel channel, SimDmaChannelStats* stats);
+
+/**
+ * @brief Get bus statistics of a DMA instance
+ * @param dmaId DMA instance ID
+ * @param stats Output statistics
+ * @return 0 on success, -1 on failure
+ */
+int SIM_DMA_GetBusStats(DmaId dmaId, SimDmaBusStats* stats);
+
+/**
+ * @brief Get cache maintenance statistics of buffer transfers
+ * @param stats Output statistics
+ * @return 0 on success, -1 on failure
+ */
+int SIM_DMA_GetCacheStats(SimDmaCacheStats* stats);
+
+#endif /* SIM_DMA_H */
@@ -0,0 +1,44 @@
+/**
+ * @file sim_kernel.h
+ * @brief Discrete-Event Simulation Kernel
+ */
+
+#ifndef SIM_KERNEL_H
+#define SIM_KERNEL_H
+
+#include <stdint.h>
+
+/* Event queue statistics (cleared by SIM_TIMER_Init and SIM_TIMER_Reset) */
+typedef struct {
+    uint64_t posted;     /* Events scheduled */
+    uint64_t dispatched; /* Events that fired */
+    uint64_t cancelled;  /* Events withdrawn before firing */
+    uint32_t pending;    /* Events in the queue now */
+    uint32_t peakPending;
+} SimKernelStats;
+
+/**
+ * @brief Run the simulation up to an absolute time
+ * @param untilUs Simulated time to stop at, in microseconds
+ * @return 0 on success, -1 on failure
+ * @note Jumps from event to event (timer expiries, DMA completions, task wakeups) in
+ *       (time, posting order) and runs the scheduler's ready tasks once the events due at
+ *       the current time have fired. Jumps taken with no task ready are the scheduler's
+ *       idle time (SIM_SCHEDULER_GetIdleStats)
+ */
+int SIM_Run(uint64_t untilUs);
+
+/**
+ * @brief Get the time of the next pending event
+ * @return Time in microseconds, UINT64_MAX if the queue is empty
+ */
+uint64_t SIM_KERNEL_GetNextEventTime(void);
+
+/**
+ * @brief Get event queue statistics
+ * @param stats Output statistics
+ * @return 0 on success, -1 on failure
+ */
+int SIM_KERNEL_GetStats(SimKernelStats* stats);
+
+#endif /* SIM_KERNEL_H */
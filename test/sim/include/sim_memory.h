@@ -6,8 +6,38 @@
 #ifndef SIM_MEMORY_H
 #define SIM_MEMORY_H
 
+#include "hal_dma.h"
 #include "hal_memory.h"
 
+/* Simulated cache line size; cache maintenance is accounted in whole lines */
+#define SIM_MEMORY_CACHE_LINE 64
+
+/* Default size from which HAL_MEMORY_CopyBufferAsync uses DMA (see bench_sim_memory) */
+#define SIM_MEMORY_DEFAULT_COPY_THRESHOLD (32 * 1024)
+
+/* Asynchronous copy configuration */
+typedef struct {
+    DmaId dmaId;         /* DMA instance that hosts the copy channel (must be initialized) */
+    uint32_t priority;   /* Copy channel priority */
+    size_t cpuThreshold; /* Copies smaller than this stay on the CPU, 0 = default */
+} SimMemoryCopyConfig;
+
+/* Asynchronous copy statistics */
+typedef struct {
+    uint32_t cpuCopies;
+    uint64_t cpuBytes;
+    uint32_t dmaCopies;
+    uint64_t dmaBytes;
+} SimMemoryCopyStats;
+
+/* Cache maintenance statistics (only operations on cached pools are counted) */
+typedef struct {
+    uint32_t flushOps;
+    uint64_t flushBytes;
+    uint32_t invalidateOps;
+    uint64_t invalidateBytes;
+} SimMemoryCacheStats;
+
 /**
  * @brief Initialize memory simulator
  * @return 0 on success, -1 on failure
@@ -38,4 +68,34 @@ int SIM_MEMORY_ConfigurePool(PoolName poolName, void* baseAddr, size_t size);
  */
 int SIM_MEMORY_GetPoolStats(PoolName poolName, uint32_t* totalAllocs, size_t* currentUsage);
 
+/**
+ * @brief Mark a pool as cached (buffers report isCached and cache ops are accounted)
+ * @param poolName Pool name
+ * @param cached true if the pool is behind a data cache
+ * @return 0 on success, -1 on failure
+ */
+int SIM_MEMORY_SetPoolCached(PoolName poolName, bool cached);
+
+/**
+ * @brief Get cache maintenance statistics
+ * @param stats Output statistics
+ * @return 0 on success, -1 on failure
+ */
+int SIM_MEMORY_GetCacheStats(SimMemoryCacheStats* stats);
+
+/**
+ * @brief Configure HAL_MEMORY_CopyBufferAsync (DMA instance 0, priority 0 and default threshold
+ *        after init); releases the current copy channel, which is requested again on demand
+ * @param config Copy configuration
+ * @return 0 on success, -1 on failure
+ */
+int SIM_MEMORY_ConfigureCopy(const SimMemoryCopyConfig* config);
+
+/**
+ * @brief Get asynchronous copy statistics
+ * @param stats Output statistics
+ * @return 0 on success, -1 on failure
+ */
+int SIM_MEMORY_GetCopyStats(SimMemoryCopyStats* stats);
+
 #endif /* SIM_MEMORY_H */
@@ -0,0 +1,118 @@
+/**
+ * @file sim_periph.h
+ * @brief Virtual Peripheral Simulation - DMA sources and sinks
+ *
+ * A registered peripheral exposes a data register address. Passing that address
+ * as the source (ADC-like) or destination (driver-like) of a DMA transfer makes
+ * the DMA engine move data through the peripheral's hardware FIFO instead of
+ * memory, paced by the rate at which the device side fills or drains that FIFO.
+ */
+
+#ifndef SIM_PERIPH_H
+#define SIM_PERIPH_H
+
+#include "hal_types.h"
+
+/* Maximum number of registered peripherals */
+#define SIM_PERIPH_MAX 16
+
+/* Defaults for SimPeriphConfig fields left at 0 */
+#define SIM_PERIPH_DEFAULT_FIFO_DEPTH 64
+#define SIM_PERIPH_DEFAULT_STREAM_BYTES 4096
+
+/* Which way data flows */
+typedef enum {
+    SIM_PERIPH_SOURCE = 0, /* Device produces data, DMA reads the FIFO (PERIPH_TO_MEM) */
+    SIM_PERIPH_SINK = 1    /* DMA writes the FIFO, device consumes data (MEM_TO_PERIPH) */
+} SimPeriphRole;
+
+/* Where the device side gets its data from or puts it to */
+typedef enum {
+    SIM_PERIPH_BACKEND_FIFO = 0,    /* Software stream: SIM_PERIPH_Feed / SIM_PERIPH_Drain */
+    SIM_PERIPH_BACKEND_FILE = 1,    /* Raw sample file (read for sources, written for sinks) */
+    SIM_PERIPH_BACKEND_CALLBACK = 2 /* User callback produces or consumes the data */
+} SimPeriphBackend;
+
+/**
+ * @brief Callback backend
+ * @param data Sources fill this buffer, sinks consume it
+ * @param size Bytes requested (source) or offered (sink)
+ * @param userData User data
+ * @return Bytes actually produced or consumed
+ */
+typedef size_t (*SimPeriphCallback)(void* data, size_t size, void* userData);
+
+/* Peripheral configuration */
+typedef struct {
+    SimPeriphRole role;
+    SimPeriphBackend backend;
+    uint32_t bytesPerUs;        /* Device-side data rate, 0 = as fast as the DMA asks */
+    uint32_t fifoDepth;         /* Hardware FIFO bytes, 0 = default (64) */
+    uint32_t streamBytes;       /* BACKEND_FIFO stream capacity, 0 = default (4096) */
+    const char* path;           /* BACKEND_FILE: file path */
+    bool useMmap;               /* BACKEND_FILE source: map the file instead of reading it */
+    bool loop;                  /* BACKEND_FILE source: rewind at end of file */
+    SimPeriphCallback callback; /* BACKEND_CALLBACK: data callback */
+    void* userData;
+} SimPeriphConfig;
+
+/* Peripheral statistics */
+typedef struct {
+    uint64_t deviceBytes;   /* Bytes the device produced into / consumed from the FIFO */
+    uint64_t dmaBytes;      /* Bytes the DMA engine moved through the FIFO */
+    uint64_t overrunBytes;  /* Source: samples dropped because the FIFO was full */
+    uint64_t underrunBytes; /* Device-side demand the FIFO (sink) or backend (source) missed */
+    uint32_t fifoLevel;     /* Bytes currently in the FIFO */
+    uint32_t maxFifoLevel;  /* Highest FIFO level seen */
+} SimPeriphStats;
+
+/**
+ * @brief Remove all peripherals (closes files, frees FIFOs)
+ * @return 0 on success, -1 on failure
+ */
+int SIM_PERIPH_Reset(void);
+
+/**
+ * @brief Register a virtual peripheral
+ * @param name Peripheral name (for logs)
+ * @param config Peripheral configuration
+ * @param dataReg Output: data register address to use as DMA source or destination
+ * @return 0 on success, -1 on failure
+ */
+int SIM_PERIPH_Register(const char* name, const SimPeriphConfig* config, void** dataReg);
+
+/**
+ * @brief Unregister a peripheral
+ * @param dataReg Data register address returned by SIM_PERIPH_Register
+ * @return 0 on success, -1 on failure
+ */
+int SIM_PERIPH_Unregister(void* dataReg);
+
+/**
+ * @brief Append samples to the stream of a BACKEND_FIFO source
+ * @param dataReg Peripheral data register
+ * @param data Samples
+ * @param size Bytes (all or nothing)
+ * @return 0 on success, -1 if the stream has no room or the peripheral does not take feeds
+ */
+int SIM_PERIPH_Feed(void* dataReg, const void* data, size_t size);
+
+/**
+ * @brief Take consumed data out of the stream of a BACKEND_FIFO sink
+ * @param dataReg Peripheral data register
+ * @param data Output buffer
+ * @param size Buffer size
+ * @param received Output: bytes copied
+ * @return 0 on success, -1 on failure
+ */
+int SIM_PERIPH_Drain(void* dataReg, void* data, size_t size, size_t* received);
+
+/**
+ * @brief Get peripheral statistics (brought up to the current simulated time)
+ * @param dataReg Peripheral data register
+ * @param stats Output statistics
+ * @return 0 on success, -1 on failure
+ */
+int SIM_PERIPH_GetStats(void* dataReg, SimPeriphStats* stats);
+
+#endif /* SIM_PERIPH_H */
@@ -0,0 +1,38 @@
+/**
+ * @file sim_queue.h
+ * @brief Message Queue Simulation - Implements HAL_QUEUE interface
+ */
+
+#ifndef SIM_QUEUE_H
+#define SIM_QUEUE_H
+
+#include "hal_queue.h"
+
+/* Queues that can exist at the same time */
+#define SIM_QUEUE_MAX_QUEUES 32
+
+/* Per-queue statistics */
+typedef struct {
+    uint32_t capacity;   /* Slots after rounding up to a power of two */
+    uint64_t sent;       /* Messages sent so far */
+    uint64_t received;   /* Messages received so far */
+    uint64_t sendWaits;  /* HAL_QUEUE_Send calls that found the queue full */
+    uint64_t recvWaits;  /* HAL_QUEUE_Receive calls that found the queue empty */
+    uint64_t timeouts;   /* Send and receive calls that gave up */
+} SimQueueStats;
+
+/**
+ * @brief Get statistics of a queue
+ * @param queue Queue handle
+ * @param stats Output statistics
+ * @return 0 on success, -1 on failure
+ */
+int SIM_QUEUE_GetStats(QueueHandle queue, SimQueueStats* stats);
+
+/**
+ * @brief Delete all queues (handles from before stay invalid)
+ * @return 0 on success, -1 on failure
+ */
+int SIM_QUEUE_Reset(void);
+
+#endif /* SIM_QUEUE_H */
@@ -0,0 +1,292 @@
+/**
+ * @file sim_scheduler.h
+ * @brief Scheduler Simulation - Implements HAL_SCHEDULER interface
+ */
+
+#ifndef SIM_SCHEDULER_H
+#define SIM_SCHEDULER_H
+
+#include "hal_scheduler.h"
+
+/* Dispatcher statistics (cleared by HAL_SCHEDULER_Init) */
+typedef struct {
+    uint64_t dispatches;  /* Task function calls */
+    uint64_t yields;      /* Returns after HAL_SCHEDULER_Yield (task queued again) */
+    uint64_t completions; /* Tasks that reached TASK_STATE_COMPLETED */
+    uint64_t replays;     /* Frozen schedule frames run */
+    uint64_t preemptions; /* Runs cut off by preemptive dispatching (task queued again) */
+} SimSchedulerStats;
+
+/* Host threads HAL_SCHEDULER_Start can dispatch on */
+#define SIM_SCHEDULER_MAX_WORKERS 16
+
+/* Per-worker statistics (cleared by HAL_SCHEDULER_Init and SIM_SCHEDULER_SetWorkers) */
+typedef struct {
+    uint64_t tasksRun; /* Task function calls on this worker */
+    uint64_t steals;   /* Tasks taken from another worker's deque */
+    uint64_t idleNs;   /* Host time spent looking for work while the frame was still running */
+} SimSchedulerWorkerStats;
+
+/* Virtual cores, one bit each in an affinity mask */
+#define SIM_SCHEDULER_MAX_CORES SIM_SCHEDULER_MAX_WORKERS
+
+/* Per-core statistics (cleared by HAL_SCHEDULER_Init and SIM_SCHEDULER_SetCores) */
+typedef struct {
+    uint64_t tasksRun;   /* Task function calls on this core */
+    uint64_t busyUs;     /* Simulated time spent in those calls */
+    uint64_t busyNs;     /* Host time spent in those calls */
+    uint64_t ipis;       /* Wakeups other cores posted to this core's mailbox */
+    uint64_t migrations; /* Runs of tasks that ran on another core last time */
+    double utilization;  /* busyUs over the simulated time since the statistics were cleared */
+} SimSchedulerCoreStats;
+
+/*
+ * Idle accounting of the last SIM_Run or HAL_SCHEDULER_Start (cleared when the next one
+ * begins)
+ */
+typedef struct {
+    uint64_t elapsedUs;  /* Simulated time the run covered */
+    uint64_t idleUs;     /* Part of it with no task ready, skipped in clock jumps */
+    uint64_t sleeps;     /* Those jumps */
+    uint64_t maxSleepUs; /* Longest jump */
+} SimSchedulerIdleStats;
+
+/* Called before the clock jumps over an idle stretch, from nowUs to wakeUs */
+typedef void (*SimSchedulerIdleHook)(uint64_t nowUs, uint64_t wakeUs, void* userData);
+
+/* Run trace ring capacity when SIM_SCHEDULER_StartTrace gets 0 */
+#define SIM_SCHEDULER_TRACE_DEFAULT_CAPACITY 4096
+
+/* SimSchedulerTraceRecord.event */
+typedef enum {
+    SIM_SCHEDULER_TRACE_CREATED = 0,   /* Task created (all times are the creation time) */
+    SIM_SCHEDULER_TRACE_COMPLETED = 1, /* Run ended with the task function returning */
+    SIM_SCHEDULER_TRACE_YIELDED = 2,   /* Run ended in a yield (or a stackful task's wait) */
+    SIM_SCHEDULER_TRACE_SUSPENDED = 3, /* Run ended with the task suspending itself */
+    SIM_SCHEDULER_TRACE_DELETED = 4,   /* Run ended with the task deleting itself */
+    SIM_SCHEDULER_TRACE_PREEMPTED = 5  /* Run cut off, the task queued again */
+} SimSchedulerTraceEvent;
+
+/* One run of a task; simulated time in us, host time in ns since SIM_SCHEDULER_StartTrace */
+typedef struct {
+    uint64_t task;     /* TaskHandle value */
+    uint64_t readyUs;  /* Became ready */
+    uint64_t startUs;  /* Run started */
+    uint64_t endUs;    /* Run ended */
+    uint64_t readyNs;
+    uint64_t startNs;
+    uint64_t endNs;
+    uint16_t index;    /* Task slot */
+    uint8_t priority;
+    uint8_t worker;    /* Dispatching thread, 0 being the one in HAL_SCHEDULER_Start */
+    uint8_t event;     /* SimSchedulerTraceEvent */
+    uint8_t core;      /* Virtual core it ran on */
+    uint8_t reserved[2];
+} SimSchedulerTraceRecord;
+
+/**
+ * @brief Get dispatcher statistics
+ * @param stats Output statistics
+ * @return 0 on success, -1 on failure
+ */
+int SIM_SCHEDULER_GetStats(SimSchedulerStats* stats);
+
+/**
+ * @brief Set the number of host threads HAL_SCHEDULER_Start dispatches on
+ * @param workers Worker count including the calling thread; 0 or 1 dispatches on the caller only
+ * @return 0 on success, -1 on failure
+ * @note While several workers run, tasks may create tasks, resume tasks and suspend or
+ *       delete themselves; changing other tasks or the graph returns HAL_BUSY
+ */
+int SIM_SCHEDULER_SetWorkers(uint32_t workers);
+
+/**
+ * @brief Get statistics of one worker
+ * @param worker Worker index, 0 being the thread that calls HAL_SCHEDULER_Start
+ * @param stats Output statistics
+ * @return 0 on success, -1 on failure
+ */
+int SIM_SCHEDULER_GetWorkerStats(uint32_t worker, SimSchedulerWorkerStats* stats);
+
+/**
+ * @brief Set the number of virtual cores, each with its own ready queue
+ * @param cores Core count; 0 or 1 is the single core everything runs on by default
+ * @param hostThreads Run core n on worker thread n (starting cores workers), rather than
+ *        letting the cores take turns on the thread that calls HAL_SCHEDULER_Start
+ * @return 0 on success, -1 on failure
+ * @note Keeps its setting across HAL_SCHEDULER_Init; SIM_SCHEDULER_SetWorkers goes back
+ *       to one core. A task that becomes ready through another core (a wakeup, a
+ *       completing producer) is posted to its own core's mailbox, which that core drains
+ *       at its next dispatch. Cores taking turns share one simulated clock, so their
+ *       simulated busy times add up rather than overlap
+ */
+int SIM_SCHEDULER_SetCores(uint32_t cores, bool hostThreads);
+
+/**
+ * @brief Get statistics of one virtual core
+ * @param core Core index
+ * @param stats Output statistics
+ * @return 0 on success, -1 on failure
+ */
+int SIM_SCHEDULER_GetCoreStats(uint32_t core, SimSchedulerCoreStats* stats);
+
+/**
+ * @brief Resume a task at a simulated time
+ * @param taskHandle Task to resume (typically one that suspends itself right after)
+ * @param timeUs Absolute simulated time in microseconds
+ * @return 0 on success, -1 on failure
+ * @note The wakeup is an event of the simulation kernel: SIM_Run dispatches the task
+ *       once time reaches timeUs, in order with timer expiries due at the same time
+ */
+int SIM_SCHEDULER_ResumeAt(TaskHandle taskHandle, uint64_t timeUs);
+
+/**
+ * @brief Let HAL_SCHEDULER_Start sleep through idle stretches (cleared by HAL_SCHEDULER_Init)
+ * @param enable Once the ready lists drain while a task still waits for a point in
+ *        simulated time (a ResumeAt wakeup, a wait timeout, a periodic release), jump the
+ *        clock to the next kernel event and go on dispatching, instead of returning
+ * @return 0 on success, -1 on failure
+ * @note Start then returns once no task waits for time any more, or on HAL_SCHEDULER_Stop;
+ *       with periodic tasks only the latter ends it
+ */
+int SIM_SCHEDULER_SetTickless(bool enable);
+
+/**
+ * @brief Switch preemptive dispatching on or off (cleared by HAL_SCHEDULER_Init)
+ * @param enable Let a stackful task lose the processor while it works: to a task that
+ *        outranks it as soon as that one is ready, and at the end of its time slice to
+ *        the next ready task of its level
+ * @return 0 on success, -1 on failure
+ * @note Work is simulated time a task spends in HAL_TIMER_DelayUs, which is checked
+ *       event by event; a task made ready by the running one takes over when the latter
+ *       resumes or creates a task. Applies to the single-threaded dispatcher only
+ */
+int SIM_SCHEDULER_SetPreemptive(bool enable);
+
+/**
+ * @brief Set the time slice of a priority level (cleared by HAL_SCHEDULER_Init)
+ * @param priority Priority level
+ * @param quantumUs Work a task of that level may do before the next ready task of the
+ *        level gets its turn, 0 for no time slicing (the default)
+ * @return 0 on success, -1 on failure
+ */
+int SIM_SCHEDULER_SetQuantum(TaskPriority priority, uint32_t quantumUs);
+
+/**
+ * @brief Register a function called on every idle clock jump (cleared by HAL_SCHEDULER_Init)
+ * @param hook Hook, NULL to remove
+ * @param userData Passed to the hook
+ * @return 0 on success, -1 on failure
+ */
+int SIM_SCHEDULER_SetIdleHook(SimSchedulerIdleHook hook, void* userData);
+
+/**
+ * @brief Get the idle accounting of the last (or current) SIM_Run or HAL_SCHEDULER_Start
+ * @param stats Output statistics
+ * @return 0 on success, -1 on failure
+ */
+int SIM_SCHEDULER_GetIdleStats(SimSchedulerIdleStats* stats);
+
+/**
+ * @brief Get the static execution order of a frozen schedule
+ * @param schedule Schedule handle
+ * @param order Output array of task handles, in the order they run
+ * @param maxTasks Array length
+ * @param count Output: tasks in the schedule (may exceed maxTasks)
+ * @return 0 on success, -1 on failure
+ */
+int SIM_SCHEDULER_GetScheduleOrder(ScheduleHandle schedule, TaskHandle* order, uint32_t maxTasks,
+                                   uint32_t* count);
+
+/**
+ * @brief Start recording task runs, dropping earlier records
+ * @param capacity Records kept (rounded up to a power of two), 0 for the default; the oldest
+ *        are overwritten when full
+ * @return 0 on success, -1 on failure
+ * @note While recording, dispatches also measure host execution time and latency for
+ *       HAL_SCHEDULER_GetTaskStats (its nanosecond fields and run histogram)
+ */
+int SIM_SCHEDULER_StartTrace(uint32_t capacity);
+
+/**
+ * @brief Stop recording (records stay available until the next start)
+ * @return 0 on success, -1 on failure
+ */
+int SIM_SCHEDULER_StopTrace(void);
+
+/**
+ * @brief Copy the recorded runs out, oldest first
+ * @param records Output array
+ * @param maxRecords Array length
+ * @param count Output: records copied
+ * @return 0 on success, -1 on failure
+ */
+int SIM_SCHEDULER_ReadTrace(SimSchedulerTraceRecord* records, uint32_t maxRecords,
+                            uint32_t* count);
+
+/**
+ * @brief Write the recorded runs as Chrome / Perfetto trace event JSON
+ * @param path Output file path
+ * @return 0 on success, -1 on failure
+ * @note Host time runs one track per worker, simulated time one track per task
+ */
+int SIM_SCHEDULER_ExportTrace(const char* path);
+
+/**
+ * @brief Print a table of run count, execution time and wakeup latency per task, then one
+ *        line per virtual core when there are several
+ * @return 0 on success, -1 on failure
+ */
+int SIM_SCHEDULER_PrintTaskReport(void);
+
+/* Order of ready periodic tasks, which all run ahead of the TaskPriority levels */
+typedef enum {
+    SIM_SCHEDULER_POLICY_RM = 0, /* Rate-monotonic: shortest period first */
+    SIM_SCHEDULER_POLICY_EDF = 1 /* Earliest absolute deadline first */
+} SimSchedulerPolicy;
+
+/* Offline schedulability test of the periodic tasks under the current policy */
+typedef struct {
+    uint32_t tasks;          /* Periodic tasks */
+    uint32_t utilizationPpm; /* Sum of budget / period, in parts per million */
+    uint32_t boundPpm;       /* Utilization the policy guarantees: n(2^(1/n) - 1) for RM,
+                                100% for EDF (both ignoring non-preemption) */
+    bool schedulable;        /* The test passed: every job meets its deadline */
+    TaskHandle critical;     /* First task, by RM priority, whose test failed; NULL if none */
+} SimSchedulerAnalysis;
+
+/**
+ * @brief Select how ready periodic tasks are ordered
+ * @param policy Scheduling policy (RM until set; kept across HAL_SCHEDULER_Init)
+ * @return 0 on success, -1 on failure
+ * @note Unless SIM_SCHEDULER_SetPreemptive is on, the policy picks the next job whenever a
+ *       run ends
+ */
+int SIM_SCHEDULER_SetPolicy(SimSchedulerPolicy policy);
+
+/**
+ * @brief Test whether the periodic tasks meet all deadlines, using their budgets as WCET
+ * @param analysis Output result
+ * @return 0 on success, -1 on failure
+ * @note RM runs the non-preemptive response-time test, blocking each task for the longest
+ *       budget of a lower-priority one; EDF requires total density (budget / deadline) plus,
+ *       per task, the longest budget of a later-deadline task over its own deadline to stay
+ *       within 100%. Both are sufficient tests, and aperiodic tasks are not part of them
+ */
+int SIM_SCHEDULER_Analyze(SimSchedulerAnalysis* analysis);
+
+/* Smallest coroutine stack SIM_SCHEDULER_SetTaskStacks accepts */
+#define SIM_SCHEDULER_MIN_STACK_BYTES (16 * 1024)
+#define SIM_SCHEDULER_DEFAULT_STACK_BYTES (64 * 1024)
+
+/**
+ * @brief Give tasks created from now on their own stack
+ * @param stackBytes Stack size (rounded up to pages, plus a guard page), 0 for
+ *        run-to-completion tasks on the dispatcher's stack
+ * @return 0 on success, -1 on failure
+ * @note A stackful task switches out in HAL_SCHEDULER_Yield, when it suspends or deletes
+ *       itself and in blocking waits, and continues there when dispatched again
+ */
+int SIM_SCHEDULER_SetTaskStacks(size_t stackBytes);
+
+#endif /* SIM_SCHEDULER_H */
@@ -0,0 +1,41 @@
+/**
+ * @file sim_sync.h
+ * @brief Synchronization Simulation - Implements HAL_SEMAPHORE, HAL_EVENT and HAL_MUTEX interfaces
+ */
+
+#ifndef SIM_SYNC_H
+#define SIM_SYNC_H
+
+#include "hal_event.h"
+#include "hal_mutex.h"
+#include "hal_semaphore.h"
+
+/* Semaphores, event groups and mutexes that can exist at the same time, all kinds together */
+#define SIM_SYNC_MAX_OBJECTS 64
+
+/* Per-object statistics; wait times are simulated time */
+typedef struct {
+    uint64_t acquired;     /* Takes, satisfied event waits or locks */
+    uint64_t contended;    /* Calls that found the object unavailable and had to wait */
+    uint64_t timeouts;     /* Calls that gave up */
+    uint64_t waitUs;       /* Time spent waiting, all calls together */
+    uint64_t maxWaitUs;    /* Longest single wait */
+    uint64_t inheritances; /* Mutex: times a waiter raised the owner's priority */
+    uint32_t waiting;      /* Tasks blocked on the object right now */
+} SimSyncStats;
+
+/**
+ * @brief Get statistics of a semaphore, event group or mutex
+ * @param object Semaphore, event group or mutex handle
+ * @param stats Output statistics
+ * @return 0 on success, -1 on failure
+ */
+int SIM_SYNC_GetStats(void* object, SimSyncStats* stats);
+
+/**
+ * @brief Delete all semaphores, event groups and mutexes (handles from before stay invalid)
+ * @return 0 on success, -1 on failure
+ */
+int SIM_SYNC_Reset(void);
+
+#endif /* SIM_SYNC_H */
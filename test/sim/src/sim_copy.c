@@ -0,0 +1,265 @@
+/**
+ * @file sim_copy.c
+ * @brief Parallel Copy Engine for large simulated DMA transfers
+ *
+ * A persistent pool of worker threads copies memory on behalf of the DMA
+ * simulator. Each job is split into one contiguous stripe per worker, with stripe
+ * boundaries on destination page boundaries: every page is written by exactly one
+ * thread, so with first-touch placement (and pinned workers) a frame's pages land
+ * on the NUMA node of the worker that fills them, and stay there across frames.
+ *
+ * Workers publish progress after every chunk of a stripe. The job is done once
+ * its last stripe finishes; the simulator thread polls for that and runs the
+ * completion itself, so callbacks never fire on a worker thread.
+ */
+
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "sim_dma.h"
+#include "sim_internal.h"
+
+/* Copy job */
+struct SimCopyJob {
+    uint8_t* dst;
+    const uint8_t* src;
+    size_t size;
+    uint32_t stripes;
+    uint32_t nextStripe;     /* Next stripe to hand out (pool lock) */
+    uint32_t pendingStripes; /* Stripes not finished yet (pool lock) */
+    size_t doneBytes;        /* Bytes copied so far (atomic) */
+    bool cancel;             /* Skip the remaining chunks (atomic) */
+    bool done;               /* All stripes finished (atomic) */
+    SimCopyJob* next;        /* Pool queue link */
+};
+
+/* Global state */
+static struct {
+    pthread_t threads[SIM_DMA_MAX_COPY_WORKERS];
+    uint32_t workers;
+    size_t chunkBytes;
+    size_t pageBytes;
+    pthread_mutex_t lock;
+    pthread_cond_t workCond; /* Signalled when a job is queued or the pool stops */
+    pthread_cond_t doneCond; /* Broadcast when a job finishes */
+    SimCopyJob* head;        /* Jobs with stripes left to hand out */
+    SimCopyJob* tail;
+    bool stopping;
+} g_simCopy = {0};
+
+/* Private functions */
+
+/* Offset of the start of stripe k, rounded up to a destination page boundary */
+static size_t SimCopyStripeStart(const SimCopyJob* job, uint32_t k)
+{
+    if (k == 0)
+        return 0;
+    if (k >= job->stripes)
+        return job->size;
+
+    uintptr_t page = g_simCopy.pageBytes;
+    uintptr_t base = (uintptr_t) job->dst;
+    size_t share = job->size / job->stripes * k + job->size % job->stripes * k / job->stripes;
+    uintptr_t split = base + share;
+    uintptr_t aligned = (split + page - 1) & ~(page - 1);
+    size_t offset = aligned - base;
+
+    return offset < job->size ? offset : job->size;
+}
+
+static void SimCopyRunStripe(SimCopyJob* job, uint32_t k)
+{
+    size_t offset = SimCopyStripeStart(job, k);
+    size_t end = SimCopyStripeStart(job, k + 1);
+
+    while (offset < end && !__atomic_load_n(&job->cancel, __ATOMIC_RELAXED)) {
+        size_t n = end - offset < g_simCopy.chunkBytes ? end - offset : g_simCopy.chunkBytes;
+        memcpy(job->dst + offset, job->src + offset, n);
+        __atomic_fetch_add(&job->doneBytes, n, __ATOMIC_RELAXED);
+        offset += n;
+    }
+}
+
+static void SimCopyPin(uint32_t worker)
+{
+#ifdef __linux__
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus <= 0)
+        return;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(worker % (uint32_t) cpus, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+    (void) worker;
+#endif
+}
+
+typedef struct {
+    uint32_t index;
+    bool pin;
+} SimCopyWorkerArg;
+
+static void* SimCopyWorker(void* arg)
+{
+    SimCopyWorkerArg* workerArg = (SimCopyWorkerArg*) arg;
+    if (workerArg->pin) {
+        SimCopyPin(workerArg->index);
+    }
+    free(workerArg);
+
+    pthread_mutex_lock(&g_simCopy.lock);
+    for (;;) {
+        while (!g_simCopy.head && !g_simCopy.stopping) {
+            pthread_cond_wait(&g_simCopy.workCond, &g_simCopy.lock);
+        }
+        if (!g_simCopy.head)
+            break;
+
+        SimCopyJob* job = g_simCopy.head;
+        uint32_t stripe = job->nextStripe++;
+        if (job->nextStripe == job->stripes) {
+            g_simCopy.head = job->next;
+            if (!g_simCopy.head) {
+                g_simCopy.tail = NULL;
+            }
+        }
+
+        pthread_mutex_unlock(&g_simCopy.lock);
+        SimCopyRunStripe(job, stripe);
+        pthread_mutex_lock(&g_simCopy.lock);
+
+        if (--job->pendingStripes == 0) {
+            __atomic_store_n(&job->done, true, __ATOMIC_RELEASE);
+            pthread_cond_broadcast(&g_simCopy.doneCond);
+        }
+    }
+    pthread_mutex_unlock(&g_simCopy.lock);
+    return NULL;
+}
+
+static void SimCopyStop(void)
+{
+    if (g_simCopy.workers == 0)
+        return;
+
+    pthread_mutex_lock(&g_simCopy.lock);
+    g_simCopy.stopping = true;
+    pthread_cond_broadcast(&g_simCopy.workCond);
+    pthread_mutex_unlock(&g_simCopy.lock);
+
+    for (uint32_t i = 0; i < g_simCopy.workers; i++) {
+        pthread_join(g_simCopy.threads[i], NULL);
+    }
+
+    pthread_cond_destroy(&g_simCopy.doneCond);
+    pthread_cond_destroy(&g_simCopy.workCond);
+    pthread_mutex_destroy(&g_simCopy.lock);
+    memset(&g_simCopy, 0, sizeof(g_simCopy));
+}
+
+/* Internal interface */
+int SimCopyConfigure(uint32_t workers, size_t chunkBytes, bool pinWorkers)
+{
+    if (workers > SIM_DMA_MAX_COPY_WORKERS)
+        return -1;
+
+    SimCopyStop();
+    if (workers == 0)
+        return 0;
+
+    long page = sysconf(_SC_PAGESIZE);
+    g_simCopy.pageBytes = page > 0 ? (size_t) page : 4096;
+    g_simCopy.chunkBytes = (chunkBytes + g_simCopy.pageBytes - 1) & ~(g_simCopy.pageBytes - 1);
+    if (g_simCopy.chunkBytes == 0) {
+        g_simCopy.chunkBytes = g_simCopy.pageBytes;
+    }
+
+    pthread_mutex_init(&g_simCopy.lock, NULL);
+    pthread_cond_init(&g_simCopy.workCond, NULL);
+    pthread_cond_init(&g_simCopy.doneCond, NULL);
+
+    for (uint32_t i = 0; i < workers; i++) {
+        SimCopyWorkerArg* arg = (SimCopyWorkerArg*) malloc(sizeof(*arg));
+        if (arg) {
+            arg->index = i;
+            arg->pin = pinWorkers;
+        }
+        if (!arg || pthread_create(&g_simCopy.threads[i], NULL, SimCopyWorker, arg) != 0) {
+            free(arg);
+            g_simCopy.workers = i;
+            SimCopyStop();
+            printf("[SIM_DMA] ERROR: Failed to start copy worker %u\n", i);
+            return -1;
+        }
+        g_simCopy.workers = i + 1;
+    }
+
+    return 0;
+}
+
+SimCopyJob* SimCopySubmit(uint8_t* dst, const uint8_t* src, size_t size)
+{
+    if (g_simCopy.workers == 0)
+        return NULL;
+
+    SimCopyJob* job = (SimCopyJob*) calloc(1, sizeof(*job));
+    if (!job)
+        return NULL;
+
+    job->dst = dst;
+    job->src = src;
+    job->size = size;
+    job->stripes = g_simCopy.workers;
+    job->pendingStripes = job->stripes;
+
+    pthread_mutex_lock(&g_simCopy.lock);
+    if (g_simCopy.tail) {
+        g_simCopy.tail->next = job;
+    } else {
+        g_simCopy.head = job;
+    }
+    g_simCopy.tail = job;
+    pthread_cond_broadcast(&g_simCopy.workCond);
+    pthread_mutex_unlock(&g_simCopy.lock);
+
+    return job;
+}
+
+size_t SimCopyProgress(const SimCopyJob* job)
+{
+    return __atomic_load_n(&job->doneBytes, __ATOMIC_RELAXED);
+}
+
+bool SimCopyDone(const SimCopyJob* job)
+{
+    return __atomic_load_n(&job->done, __ATOMIC_ACQUIRE);
+}
+
+void SimCopyWait(const SimCopyJob* job)
+{
+    if (SimCopyDone(job))
+        return;
+
+    pthread_mutex_lock(&g_simCopy.lock);
+    while (!SimCopyDone(job)) {
+        pthread_cond_wait(&g_simCopy.doneCond, &g_simCopy.lock);
+    }
+    pthread_mutex_unlock(&g_simCopy.lock);
+}
+
+void SimCopyRelease(SimCopyJob* job, bool cancel)
+{
+    if (cancel) {
+        __atomic_store_n(&job->cancel, true, __ATOMIC_RELAXED);
+    }
+    SimCopyWait(job);
+    free(job);
+}
@@ -1,53 +1,1085 @@
 /**
  * @file sim_dma.c
  * @brief DMA Simulation Implementation
+ *
+ * Transfers complete inside the call that starts them unless the instance has a bus model
+ * (SimDmaConfig.busBytesPerUs), which makes them progress with simulated time.
  */
 
+#include "sim_dma.h"
+
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-#include "hal_dma.h"
+#include "sim_internal.h"
+#include "sim_timer.h"
+
+#define MAX_DMA_INSTANCES 8
+#define DEFAULT_DMA_CHANNELS 32
+#define MAX_DMA_TIMER_LINKS 16
+
+/* Zero-time trigger loops (A starts B starts A) are cut after this many starts */
+#define SIM_DMA_MAX_TRIGGERS_PER_INSTANT 256
+
+/*
+ * Channel handle layout: [generation:16][instance:4][index:12]
+ * Resolving a handle is a direct table lookup; the generation rejects stale handles.
+ */
+#define DMA_HANDLE_INDEX_BITS 12
+#define DMA_HANDLE_INSTANCE_BITS 4
+#define DMA_HANDLE_INDEX_MASK ((1u << DMA_HANDLE_INDEX_BITS) - 1)
+#define DMA_HANDLE_INSTANCE_MASK ((1u << DMA_HANDLE_INSTANCE_BITS) - 1)
+#define DMA_HANDLE_GEN_SHIFT (DMA_HANDLE_INDEX_BITS + DMA_HANDLE_INSTANCE_BITS)
+#define DMA_HANDLE_GEN_MASK 0xFFFFu
+
+#define SIM_DMA_DEFAULT_BURST_BYTES 64
+#define SIM_DMA_NS_PER_US 1000ULL
+
+/* Transfer descriptor */
+typedef struct {
+    const uint8_t* src;
+    uint8_t* dst;
+    SimPeriph* srcPeriph; /* Peripheral endpoints, NULL for memory */
+    SimPeriph* dstPeriph;
+    size_t size;
+    uint32_t tag;
+    bool tagged; /* Queued transfers report their tag, StartTransfer ones do not */
+} SimDmaDescriptor;
+
+/* Prepared transfer: a validated, ready-to-push descriptor bound to one channel */
+typedef struct {
+    DmaId dmaId;
+    uint32_t index;
+    uint16_t generation;
+    SimDmaDescriptor desc;
+} SimDmaPrepared;
+
+/* DMA channel state */
+typedef struct {
+    DmaChannel handle;
+    DmaId dmaId;
+    uint16_t generation;
+    bool allocated;
+    DmaDirection direction;
+    uint32_t priority;
+    DmaCallback callback;
+    void* userData;
+    bool busy;     /* Engine owns a descriptor (head != submitted) */
+    bool draining; /* Instant-mode drain loop is running */
+    size_t bytesTransferred;
+    /* Submission ring: [head, submitted) engine-owned, [submitted, tail) queued */
+    SimDmaDescriptor ring[SIM_DMA_QUEUE_DEPTH];
+    uint32_t head;
+    uint32_t submitted;
+    uint32_t tail;
+    /* Completion ring of tags */
+    uint32_t doneTags[SIM_DMA_QUEUE_DEPTH];
+    uint32_t doneHead;
+    uint32_t doneTail;
+    /* Active transfer (copy of ring[head]) */
+    const uint8_t* src;
+    uint8_t* dst;
+    SimPeriph* srcPeriph;
+    SimPeriph* dstPeriph;
+    size_t size;
+    uint64_t submitNs;
+    uint64_t startNs; /* First grant */
+    bool granted;
+    bool hasCompleted;
+    uint64_t lastCompleteNs;
+    /* Completion trigger route */
+    bool chained;
+    SimDmaPrepared chain;
+    /* Completion coalescing */
+    DmaBatchCallback batchCallback;
+    void* batchUserData;
+    uint32_t coalesceCount;
+    uint64_t coalesceNs;
+    uint32_t pendingCount;   /* Completions not reported yet */
+    uint64_t pendingFirstNs; /* Oldest unreported completion */
+    uint64_t pendingSumNs;   /* Sum of unreported completion times */
+    /* Parallel copy of the active transfer */
+    SimCopyJob* job;
+    SimDmaChannelStats stats;
+} SimDmaChannel;
+
+/* DMA instance state */
+typedef struct {
+    DmaId id;
+    bool initialized;
+    SimDmaChannel* channels; /* Per-instance channel table */
+    uint32_t channelCount;
+    uint32_t busBytesPerUs;
+    uint32_t burstBytes;
+    uint32_t cpuPriority;
+    uint64_t clockNs;   /* Arbiter time, trails simulated time until advanced */
+    bool advancing;     /* Arbiter is running (guards re-entry from callbacks) */
+    bool stalled;       /* Unpaced instance has a channel waiting on a peripheral */
+    int rrCursor;       /* Channel index that won the last slot */
+    size_t cpuPending;  /* CPU copy bytes waiting for the bus */
+    uint64_t triggerNs; /* Time of the last triggered start */
+    uint32_t triggerBurst; /* Triggered starts at triggerNs */
+    uint32_t parallelJobs; /* Channels with a parallel copy in flight */
+    SimEventId event;      /* Next kernel event, 0 when nothing is due */
+    SimDmaBusStats stats;
+} SimDmaInstance;
+
+/* Timer trigger route */
+typedef struct {
+    bool used;
+    TimerHandle timer;
+    SimDmaPrepared prepared;
+} SimDmaTimerLink;
+
+/* Global state */
+static struct {
+    SimDmaInstance instances[MAX_DMA_INSTANCES];
+    SimDmaTimerLink timerLinks[MAX_DMA_TIMER_LINKS];
+    bool quiet; /* Suppress per-transfer log lines */
+    size_t parallelThreshold; /* Parallel copy from this size, 0 = off */
+    SimDmaCacheStats cacheStats;
+} g_simDma = {0};
+
+/* Survives SIM_DMA_Reset so handles from before a reset stay invalid */
+static uint16_t g_simDmaGeneration = 0;
+
+/* Private functions */
+static SimDmaChannel* SimDmaFindChannel(DmaChannel channel)
+{
+    uintptr_t raw = (uintptr_t) channel;
+    uint32_t index = (uint32_t) (raw & DMA_HANDLE_INDEX_MASK);
+    uint32_t dmaId = (uint32_t) ((raw >> DMA_HANDLE_INDEX_BITS) & DMA_HANDLE_INSTANCE_MASK);
+    uint16_t generation = (uint16_t) ((raw >> DMA_HANDLE_GEN_SHIFT) & DMA_HANDLE_GEN_MASK);
+
+    if (dmaId >= MAX_DMA_INSTANCES)
+        return NULL;
+
+    SimDmaInstance* inst = &g_simDma.instances[dmaId];
+    if (index >= inst->channelCount)
+        return NULL;
+
+    SimDmaChannel* ch = &inst->channels[index];
+    if (!ch->allocated || ch->generation != generation)
+        return NULL;
+
+    return ch;
+}
+
+static DmaChannel SimDmaMakeHandle(DmaId dmaId, uint32_t index, uint16_t generation)
+{
+    return (DmaChannel) (((uintptr_t) generation << DMA_HANDLE_GEN_SHIFT) |
+                         ((uintptr_t) dmaId << DMA_HANDLE_INDEX_BITS) | index);
+}
+
+static bool SimDmaIsTimed(const SimDmaInstance* inst)
+{
+    return inst->busBytesPerUs != 0;
+}
+
+static uint64_t SimDmaNowNs(const SimDmaInstance* inst)
+{
+    /* Callbacks fired by the arbiter see the arbiter's notion of "now" */
+    if (inst->advancing) {
+        return inst->clockNs;
+    }
+    return SIM_TIMER_GetCurrentTime() * SIM_DMA_NS_PER_US;
+}
+
+static uint32_t SimDmaQueueDepth(const SimDmaChannel* ch)
+{
+    return ch->tail - ch->head;
+}
+
+/* Load the next engine-owned descriptor, as hardware does without software help */
+static void SimDmaLoadNext(SimDmaChannel* ch, uint64_t nowNs)
+{
+    ch->busy = ch->head != ch->submitted;
+    if (!ch->busy) {
+        return;
+    }
+
+    const SimDmaDescriptor* desc = &ch->ring[ch->head % SIM_DMA_QUEUE_DEPTH];
+    ch->src = desc->src;
+    ch->dst = desc->dst;
+    ch->srcPeriph = desc->srcPeriph;
+    ch->dstPeriph = desc->dstPeriph;
+    ch->size = desc->size;
+    ch->bytesTransferred = 0;
+    ch->submitNs = nowNs;
+    ch->granted = false;
+
+    if (ch->hasCompleted) {
+        ch->stats.idleGapNs += nowNs - ch->lastCompleteNs;
+    }
+}
+
+static void SimDmaTrigger(const SimDmaPrepared* prep, uint64_t nowNs);
+
+/* Report all pending completions in one batch callback fired at fireNs */
+static void SimDmaFlushBatch(SimDmaChannel* ch, uint64_t fireNs)
+{
+    uint32_t count = ch->pendingCount;
+    uint64_t oldestDelay = fireNs - ch->pendingFirstNs;
+
+    ch->stats.batchCallbacks++;
+    ch->stats.callbacksSaved += count - 1;
+    ch->stats.coalesceDelayNs += count * fireNs - ch->pendingSumNs;
+    if (oldestDelay > ch->stats.maxCoalesceDelayNs) {
+        ch->stats.maxCoalesceDelayNs = oldestDelay;
+    }
+
+    ch->pendingCount = 0;
+    ch->pendingSumNs = 0;
+
+    if (ch->batchCallback) {
+        ch->batchCallback(ch->handle, count, ch->batchUserData);
+    }
+}
+
+static bool SimDmaBatchDue(const SimDmaChannel* ch, uint64_t nowNs)
+{
+    return ch->pendingCount && ch->coalesceNs && nowNs >= ch->pendingFirstNs + ch->coalesceNs;
+}
+
+/*
+ * Hold a completion back until maxTransfers are pending or the oldest has waited
+ * maxDelayUs. Like a hardware timeout, the time limit fires at its deadline even if
+ * simulated time jumps past it.
+ */
+static void SimDmaCoalesce(SimDmaChannel* ch, uint64_t nowNs)
+{
+    /* The time limit expired before this completion */
+    if (SimDmaBatchDue(ch, nowNs)) {
+        SimDmaFlushBatch(ch, ch->pendingFirstNs + ch->coalesceNs);
+    }
+
+    if (ch->pendingCount == 0) {
+        ch->pendingFirstNs = nowNs;
+    }
+    ch->pendingCount++;
+    ch->pendingSumNs += nowNs;
+
+    if (ch->coalesceCount && ch->pendingCount >= ch->coalesceCount) {
+        SimDmaFlushBatch(ch, nowNs);
+    }
+}
+
+static void SimDmaTrace(const SimDmaChannel* ch, const SimDmaDescriptor* desc, uint64_t nowNs)
+{
+    SimDmaTraceRecord rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.submitNs = ch->submitNs;
+    rec.startNs = ch->granted ? ch->startNs : nowNs;
+    rec.endNs = nowNs;
+    rec.size = ch->size;
+    rec.channel = (uint32_t) (uintptr_t) ch->handle;
+    rec.priority = ch->priority;
+    rec.dmaId = (uint8_t) ch->dmaId;
+    rec.direction = (uint8_t) ch->direction;
+    rec.flags = (desc->tagged ? SIM_DMA_TRACE_TAGGED : 0) |
+                (ch->srcPeriph || ch->dstPeriph ? SIM_DMA_TRACE_PERIPH : 0);
+    SimDmaTraceAppend(&rec);
+}
+
+static void SimDmaComplete(SimDmaChannel* ch, uint64_t nowNs)
+{
+    const SimDmaDescriptor* desc = &ch->ring[ch->head % SIM_DMA_QUEUE_DEPTH];
+    size_t size = ch->size;
+
+    ch->bytesTransferred = size;
+    ch->stats.transfers++;
+    ch->stats.bytes += ch->size;
+    ch->stats.serviceNs += nowNs - ch->submitNs;
+    ch->hasCompleted = true;
+    ch->lastCompleteNs = nowNs;
+
+    if (SimDmaTraceEnabled()) {
+        SimDmaTrace(ch, desc, nowNs);
+    }
+
+    if (desc->tagged) {
+        if (ch->doneTail - ch->doneHead == SIM_DMA_QUEUE_DEPTH) {
+            /* Nobody drained the completion ring, drop the oldest tag */
+            ch->doneHead++;
+            ch->stats.completionOverflows++;
+        }
+        ch->doneTags[ch->doneTail++ % SIM_DMA_QUEUE_DEPTH] = desc->tag;
+    }
+
+    ch->head++;
+    SimDmaLoadNext(ch, nowNs);
+
+    /* Hardware route fires before software hears about the completion */
+    if (ch->chained) {
+        SimDmaTrigger(&ch->chain, nowNs);
+    }
+
+    if (!g_simDma.quiet) {
+        printf("[SIM_DMA] Transfer complete: %zu bytes\n", size);
+    }
+
+    if (ch->batchCallback) {
+        SimDmaCoalesce(ch, nowNs);
+    } else if (ch->callback) {
+        ch->callback(ch->handle, DMA_EVENT_TRANSFER_COMPLETE, ch->userData);
+    }
+}
+
+/* Move bytes of the active transfer; peripheral endpoints do not increment */
+static void SimDmaMove(SimDmaChannel* ch, size_t bytes, uint64_t nowNs)
+{
+    const uint8_t* src = ch->src + ch->bytesTransferred;
+    uint8_t* dst = ch->dst + ch->bytesTransferred;
+
+    if (!ch->srcPeriph && !ch->dstPeriph) {
+        memcpy(dst, src, bytes);
+    } else if (!ch->dstPeriph) {
+        SimPeriphRead(ch->srcPeriph, dst, bytes, nowNs);
+    } else if (!ch->srcPeriph) {
+        SimPeriphWrite(ch->dstPeriph, src, bytes, nowNs);
+    } else {
+        uint8_t scratch[SIM_DMA_DEFAULT_BURST_BYTES];
+        for (size_t done = 0; done < bytes;) {
+            size_t n = bytes - done < sizeof(scratch) ? bytes - done : sizeof(scratch);
+            SimPeriphRead(ch->srcPeriph, scratch, n, nowNs);
+            SimPeriphWrite(ch->dstPeriph, scratch, n, nowNs);
+            done += n;
+        }
+    }
+}
+
+/* Bytes the endpoints can take right now (memory never holds a transfer back) */
+static size_t SimDmaEndpointRoom(const SimDmaChannel* ch, uint64_t nowNs)
+{
+    size_t room = SIZE_MAX;
+
+    if (ch->srcPeriph) {
+        room = SimPeriphRoom(ch->srcPeriph, nowNs);
+    }
+    if (ch->dstPeriph) {
+        size_t dstRoom = SimPeriphRoom(ch->dstPeriph, nowNs);
+        room = dstRoom < room ? dstRoom : room;
+    }
+    return room;
+}
+
+/* Bytes a peripheral endpoint must be able to take before the channel requests the bus */
+static size_t SimDmaEndpointWant(const SimDmaInstance* inst, const SimDmaChannel* ch)
+{
+    size_t want = ch->size - ch->bytesTransferred;
+
+    if (want > inst->burstBytes) {
+        want = inst->burstBytes;
+    }
+    if (ch->srcPeriph && SimPeriphFifoDepth(ch->srcPeriph) &&
+        want > SimPeriphFifoDepth(ch->srcPeriph)) {
+        want = SimPeriphFifoDepth(ch->srcPeriph);
+    }
+    if (ch->dstPeriph && SimPeriphFifoDepth(ch->dstPeriph) &&
+        want > SimPeriphFifoDepth(ch->dstPeriph)) {
+        want = SimPeriphFifoDepth(ch->dstPeriph);
+    }
+    return want;
+}
+
+/* Earliest time the endpoints can take want bytes, UINT64_MAX if never without outside help */
+static uint64_t SimDmaEndpointReadyNs(const SimDmaChannel* ch, size_t want, uint64_t nowNs)
+{
+    uint64_t readyNs = nowNs;
+
+    if (ch->srcPeriph) {
+        readyNs = SimPeriphReadyNs(ch->srcPeriph, want, nowNs);
+    }
+    if (ch->dstPeriph) {
+        uint64_t dstReadyNs = SimPeriphReadyNs(ch->dstPeriph, want, nowNs);
+        readyNs = dstReadyNs > readyNs ? dstReadyNs : readyNs;
+    }
+    return readyNs;
+}
+
+static bool SimDmaEndpointReady(const SimDmaInstance* inst, const SimDmaChannel* ch)
+{
+    if (!ch->srcPeriph && !ch->dstPeriph) {
+        return true;
+    }
+    return SimDmaEndpointRoom(ch, inst->clockNs) >= SimDmaEndpointWant(inst, ch);
+}
+
+/* Earliest time a channel waiting on a peripheral can request the bus */
+static uint64_t SimDmaNextReadyNs(const SimDmaInstance* inst)
+{
+    uint64_t readyNs = UINT64_MAX;
+
+    for (uint32_t i = 0; i < inst->channelCount; i++) {
+        const SimDmaChannel* ch = &inst->channels[i];
+        if (!ch->allocated || !ch->busy || (!ch->srcPeriph && !ch->dstPeriph)) {
+            continue;
+        }
+        uint64_t chReadyNs = SimDmaEndpointReadyNs(ch, SimDmaEndpointWant(inst, ch), inst->clockNs);
+        if (chReadyNs < readyNs) {
+            readyNs = chReadyNs;
+        }
+    }
+    return readyNs;
+}
+
+static void SimDmaFirstGrant(SimDmaChannel* ch, uint64_t nowNs)
+{
+    if (!ch->granted) {
+        uint64_t delay = nowNs - ch->submitNs;
+        ch->granted = true;
+        ch->startNs = nowNs;
+        ch->stats.queueDelayNs += delay;
+        if (delay > ch->stats.maxQueueDelayNs) {
+            ch->stats.maxQueueDelayNs = delay;
+        }
+    }
+    ch->stats.grants++;
+}
+
+static void SimDmaGrant(SimDmaChannel* ch, size_t bytes, uint64_t nowNs)
+{
+    SimDmaFirstGrant(ch, nowNs);
+    SimDmaMove(ch, bytes, nowNs);
+    ch->bytesTransferred += bytes;
+}
+
+/* Pick the next bus master: highest priority wins, CPU wins ties, channels round-robin */
+static SimDmaChannel* SimDmaArbitrate(SimDmaInstance* inst, bool* cpuWins)
+{
+    SimDmaChannel* best = NULL;
+    int bestIndex = -1;
+    int count = (int) inst->channelCount;
+
+    for (int n = 1; n <= count; n++) {
+        int i = (inst->rrCursor + n) % count;
+        SimDmaChannel* ch = &inst->channels[i];
+
+        if (!ch->allocated || !ch->busy || !SimDmaEndpointReady(inst, ch)) {
+            continue;
+        }
+        /* Strictly greater keeps the first channel after the cursor within a level */
+        if (!best || ch->priority > best->priority) {
+            best = ch;
+            bestIndex = i;
+        }
+    }
+
+    *cpuWins = inst->cpuPending > 0 && (!best || inst->cpuPriority >= best->priority);
+    if (*cpuWins) {
+        return NULL;
+    }
+
+    if (best) {
+        inst->rrCursor = bestIndex;
+    }
+    return best;
+}
+
+static void SimDmaKick(SimDmaInstance* inst, SimDmaChannel* ch);
+
+/* Unpaced instance: restart channels waiting on peripherals whenever their FIFOs allow */
+static void SimDmaResume(SimDmaInstance* inst, uint64_t targetNs)
+{
+    inst->advancing = true;
+
+    while (inst->stalled) {
+        uint64_t readyNs = SimDmaNextReadyNs(inst);
+        if (readyNs > targetNs) {
+            break;
+        }
+
+        inst->clockNs = readyNs > inst->clockNs ? readyNs : inst->clockNs;
+        inst->stalled = false;
+        for (uint32_t i = 0; i < inst->channelCount; i++) {
+            if (inst->channels[i].allocated && inst->channels[i].busy) {
+                SimDmaKick(inst, &inst->channels[i]);
+            }
+        }
+    }
+
+    if (targetNs > inst->clockNs) {
+        inst->clockNs = targetNs;
+    }
+    inst->advancing = false;
+}
+
+/* Run the arbiter of one instance up to targetNs */
+static void SimDmaAdvance(SimDmaInstance* inst, uint64_t targetNs)
+{
+    if (inst->advancing) {
+        return;
+    }
+    if (!SimDmaIsTimed(inst)) {
+        SimDmaResume(inst, targetNs);
+        return;
+    }
+
+    inst->advancing = true;
+
+    while (inst->clockNs < targetNs) {
+        uint64_t budget = (targetNs - inst->clockNs) * inst->busBytesPerUs / SIM_DMA_NS_PER_US;
+        if (budget == 0) {
+            break;
+        }
+
+        bool cpuWins = false;
+        SimDmaChannel* ch = SimDmaArbitrate(inst, &cpuWins);
+        if (!ch && !cpuWins) {
+            /* Bus idles until a peripheral FIFO can take a burst */
+            uint64_t readyNs = SimDmaNextReadyNs(inst);
+            if (readyNs >= targetNs) {
+                break;
+            }
+            inst->clockNs = readyNs > inst->clockNs ? readyNs : inst->clockNs + 1;
+            continue;
+        }
+
+        size_t want = cpuWins ? inst->cpuPending : ch->size - ch->bytesTransferred;
+        if (want > inst->burstBytes) {
+            want = inst->burstBytes;
+        }
+        if (ch) {
+            size_t room = SimDmaEndpointRoom(ch, inst->clockNs);
+            want = room < want ? room : want;
+        }
+        size_t grant = want < budget ? want : (size_t) budget;
+        uint64_t costNs =
+            (grant * SIM_DMA_NS_PER_US + inst->busBytesPerUs - 1) / inst->busBytesPerUs;
+
+        if (cpuWins) {
+            inst->cpuPending -= grant;
+            inst->stats.cpuBytes += grant;
+        } else {
+            SimDmaGrant(ch, grant, inst->clockNs);
+            inst->stats.dmaBytes += grant;
+        }
+
+        inst->clockNs += costNs;
+        inst->stats.busyNs += costNs;
+
+        if (ch && ch->bytesTransferred == ch->size) {
+            SimDmaComplete(ch, inst->clockNs);
+        }
+    }
+
+    /* Idle bus: time passes without traffic */
+    if (inst->clockNs < targetNs) {
+        inst->clockNs = targetNs;
+    }
+
+    inst->advancing = false;
+}
+
+/* Hand the rest of a memory-to-memory transfer to the copy pool if it is large enough */
+static bool SimDmaOffload(SimDmaInstance* inst, SimDmaChannel* ch, size_t bytes, uint64_t nowNs)
+{
+    if (!g_simDma.parallelThreshold || bytes < g_simDma.parallelThreshold || ch->srcPeriph ||
+        ch->dstPeriph) {
+        return false;
+    }
+
+    ch->job = SimCopySubmit(ch->dst + ch->bytesTransferred, ch->src + ch->bytesTransferred, bytes);
+    if (!ch->job) {
+        return false;
+    }
+
+    SimDmaFirstGrant(ch, nowNs);
+    ch->stats.parallelTransfers++;
+    inst->parallelJobs++;
+    return true;
+}
+
+static void SimDmaDropJob(SimDmaInstance* inst, SimDmaChannel* ch, bool cancel)
+{
+    SimCopyRelease(ch->job, cancel);
+    ch->job = NULL;
+    inst->parallelJobs--;
+}
+
+/*
+ * Complete a channel whose parallel copy finished, then let it run what follows. The
+ * channel stays busy until the pool is done; completion always runs on the simulator thread.
+ */
+static void SimDmaReap(SimDmaInstance* inst, SimDmaChannel* ch)
+{
+    if (!ch->job || !SimCopyDone(ch->job) || inst->advancing) {
+        return;
+    }
+
+    SimDmaDropJob(inst, ch, false);
+    inst->stats.dmaBytes += ch->size - ch->bytesTransferred;
+    SimDmaComplete(ch, SimDmaNowNs(inst));
+    SimDmaKick(inst, ch);
+}
+
+static void SimDmaReapAll(SimDmaInstance* inst)
+{
+    for (uint32_t i = 0; i < inst->channelCount && inst->parallelJobs; i++) {
+        if (inst->channels[i].allocated) {
+            SimDmaReap(inst, &inst->channels[i]);
+        }
+    }
+}
+
+/* Abort (or finish) every parallel copy of an instance before its state is torn down */
+static void SimDmaDropJobs(SimDmaInstance* inst, bool cancel)
+{
+    for (uint32_t i = 0; i < inst->channelCount && inst->parallelJobs; i++) {
+        SimDmaChannel* ch = &inst->channels[i];
+        if (!ch->job) {
+            continue;
+        }
+        if (cancel) {
+            SimDmaDropJob(inst, ch, true);
+        } else {
+            SimCopyWait(ch->job);
+            SimDmaReap(inst, ch);
+        }
+    }
+}
+
+/* Earliest time an instance can complete a transfer or report a batch, UINT64_MAX if never */
+static uint64_t SimDmaNextEventNs(const SimDmaInstance* inst)
+{
+    uint64_t dueNs = UINT64_MAX;
+
+    for (uint32_t i = 0; i < inst->channelCount; i++) {
+        const SimDmaChannel* ch = &inst->channels[i];
+        if (!ch->allocated) {
+            continue;
+        }
+        if (ch->pendingCount && ch->coalesceNs && ch->pendingFirstNs + ch->coalesceNs < dueNs) {
+            dueNs = ch->pendingFirstNs + ch->coalesceNs;
+        }
+        /* Parallel copies land on host time, at the next DMA call or time advance */
+        if (!ch->busy || ch->job) {
+            continue;
+        }
+
+        uint64_t chNs = inst->clockNs;
+        if (ch->srcPeriph || ch->dstPeriph) {
+            chNs = SimDmaEndpointReadyNs(ch, SimDmaEndpointWant(inst, ch), inst->clockNs);
+            if (chNs == UINT64_MAX) {
+                continue; /* Only outside help (SimDmaPoll) moves it */
+            }
+        }
+        if (SimDmaIsTimed(inst)) {
+            /* No sooner than the rest of the transfer with the whole bus */
+            size_t remaining = ch->size - ch->bytesTransferred;
+            uint64_t busNs = inst->clockNs + (remaining * SIM_DMA_NS_PER_US + inst->busBytesPerUs -
+                                              1) / inst->busBytesPerUs;
+            chNs = busNs > chNs ? busNs : chNs;
+        }
+        if (chNs < dueNs) {
+            dueNs = chNs;
+        }
+    }
+    return dueNs;
+}
+
+static void SimDmaOnEvent(void* arg, uint64_t nowUs);
+
+/*
+ * (Re)post the kernel event of an instance; the arbiter reposts when it stops running.
+ * There is one event per instance, at the earliest time it can next complete a transfer
+ * or report a batch, so completions interleave with timer expiries in time order.
+ */
+static void SimDmaSchedule(SimDmaInstance* inst)
+{
+    if (inst->advancing) {
+        return;
+    }
+
+    SimKernelCancel(inst->event);
+    inst->event = 0;
+
+    uint64_t dueNs = SimDmaNextEventNs(inst);
+    if (dueNs == UINT64_MAX) {
+        return;
+    }
+
+    uint64_t dueUs = (dueNs + SIM_DMA_NS_PER_US - 1) / SIM_DMA_NS_PER_US;
+    uint64_t nowUs = SIM_TIMER_GetCurrentTime();
+    inst->event = SimKernelPost(dueUs > nowUs ? dueUs : nowUs + 1, SimDmaOnEvent, inst);
+}
+
+/* Run one instance up to nowNs: parallel copies, the arbiter, expired coalescing limits */
+static void SimDmaRun(SimDmaInstance* inst, uint64_t nowNs)
+{
+    if (inst->parallelJobs) {
+        SimDmaReapAll(inst);
+    }
+    SimDmaAdvance(inst, nowNs);
+
+    /* Coalescing timeouts that expired without a further completion */
+    for (uint32_t c = 0; c < inst->channelCount; c++) {
+        SimDmaChannel* ch = &inst->channels[c];
+        if (ch->allocated && SimDmaBatchDue(ch, nowNs)) {
+            SimDmaFlushBatch(ch, ch->pendingFirstNs + ch->coalesceNs);
+        }
+    }
+
+    SimDmaSchedule(inst);
+}
+
+static void SimDmaOnEvent(void* arg, uint64_t nowUs)
+{
+    SimDmaInstance* inst = (SimDmaInstance*) arg;
+
+    inst->event = 0;
+    if (inst->initialized) {
+        SimDmaRun(inst, nowUs * SIM_DMA_NS_PER_US);
+    }
+}
+
+static void SimDmaOnTimeAdvance(uint64_t nowUs)
+{
+    uint64_t nowNs = nowUs * SIM_DMA_NS_PER_US;
+
+    for (int i = 0; i < MAX_DMA_INSTANCES; i++) {
+        SimDmaInstance* inst = &g_simDma.instances[i];
+        if (inst->initialized) {
+            SimDmaRun(inst, nowNs);
+        }
+    }
+}
+
+/* Bring the arbiter up to the current simulated time before its state changes */
+static void SimDmaSync(SimDmaInstance* inst)
+{
+    if (inst->parallelJobs) {
+        SimDmaReapAll(inst);
+    }
+    if (inst->advancing || !SimDmaIsTimed(inst)) {
+        return;
+    }
+
+    uint64_t nowNs = SimDmaNowNs(inst);
+    if (nowNs < inst->clockNs) {
+        /* Simulated clock was reset underneath us, rebase */
+        inst->clockNs = nowNs;
+    }
+    SimDmaAdvance(inst, nowNs);
+}
+
+/* Let the engine run what it owns; without a bus model that means right now */
+static void SimDmaKick(SimDmaInstance* inst, SimDmaChannel* ch)
+{
+    if (ch->draining) {
+        /* Called from a completion callback, the outer loop picks the work up */
+        return;
+    }
+
+    ch->draining = true;
+    while (ch->busy && !ch->job && (!SimDmaIsTimed(inst) || ch->size == 0)) {
+        uint64_t nowNs = SimDmaNowNs(inst);
+        size_t remaining = ch->size - ch->bytesTransferred;
+        size_t room = SimDmaEndpointRoom(ch, nowNs);
+        size_t bytes = remaining < room ? remaining : room;
+
+        if (bytes == 0 && remaining > 0) {
+            /* Peripheral FIFO is full (or empty), resume once it can take data */
+            inst->clockNs = nowNs;
+            inst->stalled = true;
+            break;
+        }
+        if (SimDmaOffload(inst, ch, bytes, nowNs)) {
+            break;
+        }
+
+        SimDmaGrant(ch, bytes, nowNs);
+        inst->stats.dmaBytes += bytes;
+        if (ch->bytesTransferred == ch->size) {
+            SimDmaComplete(ch, nowNs);
+        }
+    }
+    ch->draining = false;
+
+    SimDmaSchedule(inst);
+}
+
+/* Channel a prepared transfer is bound to, NULL if it was released since */
+static SimDmaChannel* SimDmaPreparedChannel(const SimDmaPrepared* prep)
+{
+    SimDmaInstance* inst = &g_simDma.instances[prep->dmaId];
+    if (prep->index >= inst->channelCount)
+        return NULL;
+
+    SimDmaChannel* ch = &inst->channels[prep->index];
+    if (!ch->allocated || ch->generation != prep->generation)
+        return NULL;
+
+    return ch;
+}
+
+/* Start a prepared transfer from a hardware event that happened at nowNs, no callback involved */
+static void SimDmaTrigger(const SimDmaPrepared* prep, uint64_t nowNs)
+{
+    SimDmaChannel* ch = SimDmaPreparedChannel(prep);
+    if (!ch) {
+        return;
+    }
+
+    SimDmaInstance* inst = &g_simDma.instances[ch->dmaId];
+    bool nested = inst->advancing;
+    if (!nested) {
+        /* Run the instance up to the event, then act at the event's time */
+        SimDmaAdvance(inst, nowNs);
+        inst->advancing = true;
+    }
+
+    if (nowNs != inst->triggerNs) {
+        inst->triggerNs = nowNs;
+        inst->triggerBurst = 0;
+    }
+
+    if (ch->busy || ch->tail != ch->head ||
+        ++inst->triggerBurst > SIM_DMA_MAX_TRIGGERS_PER_INSTANT) {
+        ch->stats.missedTriggers++;
+    } else {
+        ch->stats.triggeredStarts++;
+        ch->ring[ch->tail++ % SIM_DMA_QUEUE_DEPTH] = prep->desc;
+        ch->submitted = ch->tail;
+        SimDmaLoadNext(ch, SimDmaNowNs(inst));
+        SimDmaKick(inst, ch);
+    }
+
+    if (!nested) {
+        inst->advancing = false;
+        SimDmaSchedule(inst);
+    }
+}
+
+static void SimDmaOnTimerTrigger(TimerHandle timer, void* arg, uint64_t expiryUs)
+{
+    const SimDmaTimerLink* link = (const SimDmaTimerLink*) arg;
+
+    /* Route may have been dropped by SIM_DMA_Reset */
+    if (link->used && link->timer == timer) {
+        SimDmaTrigger(&link->prepared, expiryUs * SIM_DMA_NS_PER_US);
+    }
+}
+
+static bool SimDmaValidate(const void* srcAddr, const void* dstAddr, size_t size)
+{
+    return size == 0 || (srcAddr && dstAddr);
+}
+
+/*
+ * Build a descriptor, binding peripheral data registers to their peripherals: such an
+ * address is a fixed endpoint whose FIFO the engine reads or writes instead of memory
+ */
+static bool SimDmaBuildDescriptor(SimDmaDescriptor* desc, const void* srcAddr, void* dstAddr,
+                                  size_t size, uint32_t tag, bool tagged)
+{
+    desc->src = (const uint8_t*) srcAddr;
+    desc->dst = (uint8_t*) dstAddr;
+    desc->srcPeriph = SimPeriphFind(srcAddr);
+    desc->dstPeriph = SimPeriphFind(dstAddr);
+    desc->size = size;
+    desc->tag = tag;
+    desc->tagged = tagged;
 
-#define MAX_DMA_INSTANCES 8
-#define MAX_DMA_CHANNELS 32
+    if (desc->srcPeriph && !SimPeriphHasRole(desc->srcPeriph, true))
+        return false;
+    if (desc->dstPeriph && !SimPeriphHasRole(desc->dstPeriph, false))
+        return false;
+    return true;
+}
 
-/* DMA instance state */
-typedef struct {
-    DmaId id;
-    bool initialized;
-} SimDmaInstance;
+/* Push one descriptor on an idle channel with an empty ring and start it */
+static int SimDmaSubmitSingle(SimDmaInstance* inst, SimDmaChannel* ch,
+                              const SimDmaDescriptor* desc)
+{
+    SimDmaSync(inst);
 
-/* DMA channel state */
-typedef struct {
-    DmaChannel handle;
-    DmaId dmaId;
-    bool allocated;
-    DmaDirection direction;
-    uint32_t priority;
-    DmaCallback callback;
-    void* userData;
-    bool busy;
-    size_t bytesTransferred;
-} SimDmaChannel;
+    if (ch->busy || ch->tail != ch->head)
+        return HAL_BUSY;
 
-/* Global state */
-static struct {
-    SimDmaInstance instances[MAX_DMA_INSTANCES];
-    SimDmaChannel channels[MAX_DMA_CHANNELS];
-    uint32_t nextHandle;
-} g_simDma = {0};
+    ch->ring[ch->tail++ % SIM_DMA_QUEUE_DEPTH] = *desc;
+    ch->submitted = ch->tail;
+    SimDmaLoadNext(ch, SimDmaNowNs(inst));
+    SimDmaKick(inst, ch);
+
+    return HAL_OK;
+}
+
+/* Simulator control functions */
+int SIM_DMA_Reset(void)
+{
+    for (int i = 0; i < MAX_DMA_INSTANCES; i++) {
+        SimDmaDropJobs(&g_simDma.instances[i], true);
+        SimKernelCancel(g_simDma.instances[i].event);
+        free(g_simDma.instances[i].channels);
+    }
+    SimCopyConfigure(0, 0, false);
+    SimDmaTraceReset();
+    memset(&g_simDma, 0, sizeof(g_simDma));
+    return 0;
+}
+
+int SIM_DMA_SetBandwidth(DmaId dmaId, uint32_t busBytesPerUs)
+{
+    if (dmaId >= MAX_DMA_INSTANCES || !g_simDma.instances[dmaId].initialized)
+        return -1;
+
+    SimDmaInstance* inst = &g_simDma.instances[dmaId];
+    SimDmaSync(inst);
+    if (!SimDmaIsTimed(inst)) {
+        /* Parallel copies belong to the unpaced engine, let them land first */
+        SimDmaDropJobs(inst, false);
+        inst->clockNs = SimDmaNowNs(inst);
+    }
+    inst->busBytesPerUs = busBytesPerUs;
+
+    if (!SimDmaIsTimed(inst)) {
+        /* Unlimited bus: in-flight transfers finish now */
+        for (uint32_t i = 0; i < inst->channelCount; i++) {
+            if (inst->channels[i].allocated) {
+                SimDmaKick(inst, &inst->channels[i]);
+            }
+        }
+        inst->cpuPending = 0;
+    }
+    SimDmaSchedule(inst);
+
+    return 0;
+}
+
+int SIM_DMA_AddCpuTraffic(DmaId dmaId, size_t bytes)
+{
+    if (dmaId >= MAX_DMA_INSTANCES || !g_simDma.instances[dmaId].initialized)
+        return -1;
+
+    SimDmaInstance* inst = &g_simDma.instances[dmaId];
+    if (!SimDmaIsTimed(inst)) {
+        /* Unlimited bus: CPU traffic never contends */
+        inst->stats.cpuBytes += bytes;
+        return 0;
+    }
+
+    SimDmaSync(inst);
+    inst->cpuPending += bytes;
+
+    return 0;
+}
+
+int SIM_DMA_SetLogging(bool enabled)
+{
+    g_simDma.quiet = !enabled;
+    return 0;
+}
+
+int SIM_DMA_SetParallelCopy(const SimDmaParallelConfig* config)
+{
+    if (config && config->workers > SIM_DMA_MAX_COPY_WORKERS)
+        return -1;
+
+    /* The pool is restarted, nothing may still be copying on it */
+    for (int i = 0; i < MAX_DMA_INSTANCES; i++) {
+        SimDmaDropJobs(&g_simDma.instances[i], false);
+    }
+
+    g_simDma.parallelThreshold = 0;
+    if (!config || config->workers == 0) {
+        return SimCopyConfigure(0, 0, false);
+    }
+
+    size_t chunkBytes = config->chunkBytes ? config->chunkBytes : SIM_DMA_DEFAULT_PARALLEL_CHUNK;
+    if (SimCopyConfigure(config->workers, chunkBytes, config->pinWorkers) != 0)
+        return -1;
+
+    g_simDma.parallelThreshold =
+        config->thresholdBytes ? config->thresholdBytes : SIM_DMA_DEFAULT_PARALLEL_THRESHOLD;
+
+    printf("[SIM_DMA] Parallel copy: %u workers from %zu bytes\n", config->workers,
+           g_simDma.parallelThreshold);
+    return 0;
+}
+
+int SIM_DMA_GetChannelStats(DmaChannel channel, SimDmaChannelStats* stats)
+{
+    SimDmaChannel* ch = SimDmaFindChannel(channel);
+    if (!ch || !stats)
+        return -1;
+
+    SimDmaSync(&g_simDma.instances[ch->dmaId]);
+    *stats = ch->stats;
+    stats->queueDepth = SimDmaQueueDepth(ch);
+    return 0;
+}
+
+int SIM_DMA_GetCacheStats(SimDmaCacheStats* stats)
+{
+    if (!stats)
+        return -1;
+
+    *stats = g_simDma.cacheStats;
+    return 0;
+}
+
+int SIM_DMA_GetBusStats(DmaId dmaId, SimDmaBusStats* stats)
+{
+    if (dmaId >= MAX_DMA_INSTANCES || !stats)
+        return -1;
+
+    *stats = g_simDma.instances[dmaId].stats;
+    return 0;
+}
 
 /* HAL interface implementation */
 int HAL_DMA_Init(DmaId dmaId, DmaConfig config)
 {
-    (void) config;
-
     if (dmaId >= MAX_DMA_INSTANCES)
         return HAL_ERROR;
 
-    g_simDma.instances[dmaId].id = dmaId;
-    g_simDma.instances[dmaId].initialized = true;
+    SimDmaInstance* inst = &g_simDma.instances[dmaId];
+    const SimDmaConfig* simConfig = (const SimDmaConfig*) config;
+
+    uint32_t channelCount = inst->channelCount ? inst->channelCount : DEFAULT_DMA_CHANNELS;
+    if (simConfig && simConfig->channelCount) {
+        channelCount = simConfig->channelCount;
+    }
+    if (channelCount > SIM_DMA_MAX_CHANNELS_PER_INSTANCE)
+        return HAL_ERROR;
+
+    if (channelCount != inst->channelCount) {
+        /* Resizing is only allowed while no channel is in use */
+        for (uint32_t i = 0; i < inst->channelCount; i++) {
+            if (inst->channels[i].allocated)
+                return HAL_ERROR;
+        }
+
+        SimDmaChannel* channels = (SimDmaChannel*) calloc(channelCount, sizeof(SimDmaChannel));
+        if (!channels)
+            return HAL_ERROR;
+
+        free(inst->channels);
+        inst->channels = channels;
+        inst->channelCount = channelCount;
+        inst->rrCursor = (int) channelCount - 1;
+    }
+
+    if (!inst->initialized) {
+        inst->clockNs = SIM_TIMER_GetCurrentTime() * SIM_DMA_NS_PER_US;
+        SimTimerAddAdvanceHook(SimDmaOnTimeAdvance);
+    }
+
+    if (simConfig) {
+        SimDmaSync(inst);
+        inst->busBytesPerUs = simConfig->busBytesPerUs;
+        inst->burstBytes = simConfig->burstBytes;
+        inst->cpuPriority = simConfig->cpuPriority;
+    }
+    if (inst->burstBytes == 0) {
+        inst->burstBytes = SIM_DMA_DEFAULT_BURST_BYTES;
+    }
+
+    inst->id = dmaId;
+    inst->initialized = true;
 
     printf("[SIM_DMA] Initialized DMA %u\n", dmaId);
     return HAL_OK;
@@ -58,6 +1090,9 @@ int HAL_DMA_Deinit(DmaId dmaId)
     if (dmaId >= MAX_DMA_INSTANCES)
         return HAL_ERROR;
 
+    SimDmaDropJobs(&g_simDma.instances[dmaId], true);
+    SimKernelCancel(g_simDma.instances[dmaId].event);
+    g_simDma.instances[dmaId].event = 0;
     g_simDma.instances[dmaId].initialized = false;
 
     printf("[SIM_DMA] Deinitialized DMA %u\n", dmaId);
@@ -69,21 +1104,27 @@ int HAL_DMA_RequestChannel(DmaId dmaId, DmaDirection direction, uint32_t priorit
 {
     if (!channel || dmaId >= MAX_DMA_INSTANCES)
         return HAL_ERROR;
-    if (!g_simDma.instances[dmaId].initialized)
+
+    SimDmaInstance* inst = &g_simDma.instances[dmaId];
+    if (!inst->initialized)
         return HAL_ERROR;
 
     /* Find free channel */
-    for (int i = 0; i < MAX_DMA_CHANNELS; i++) {
-        if (!g_simDma.channels[i].allocated) {
-            g_simDma.channels[i].handle = (DmaChannel) (uintptr_t) (++g_simDma.nextHandle);
-            g_simDma.channels[i].dmaId = dmaId;
-            g_simDma.channels[i].direction = direction;
-            g_simDma.channels[i].priority = priority;
-            g_simDma.channels[i].allocated = true;
-            g_simDma.channels[i].busy = false;
-            g_simDma.channels[i].bytesTransferred = 0;
-
-            *channel = g_simDma.channels[i].handle;
+    for (uint32_t i = 0; i < inst->channelCount; i++) {
+        if (!inst->channels[i].allocated) {
+            SimDmaChannel* ch = &inst->channels[i];
+            memset(ch, 0, sizeof(*ch));
+            if (++g_simDmaGeneration == 0) {
+                g_simDmaGeneration = 1;
+            }
+            ch->generation = g_simDmaGeneration;
+            ch->handle = SimDmaMakeHandle(dmaId, i, ch->generation);
+            ch->dmaId = dmaId;
+            ch->direction = direction;
+            ch->priority = priority;
+            ch->allocated = true;
+
+            *channel = ch->handle;
 
             printf("[SIM_DMA] Requested channel %p on DMA %u\n", *channel, dmaId);
             return HAL_OK;
@@ -95,16 +1136,21 @@ int HAL_DMA_RequestChannel(DmaId dmaId, DmaDirection direction, uint32_t priorit
 
 int HAL_DMA_ReleaseChannel(DmaChannel channel)
 {
-    for (int i = 0; i < MAX_DMA_CHANNELS; i++) {
-        if (g_simDma.channels[i].allocated && g_simDma.channels[i].handle == channel) {
-            g_simDma.channels[i].allocated = false;
+    SimDmaChannel* ch = SimDmaFindChannel(channel);
+    if (!ch)
+        return HAL_ERROR;
 
-            printf("[SIM_DMA] Released channel %p\n", channel);
-            return HAL_OK;
-        }
+    SimDmaInstance* inst = &g_simDma.instances[ch->dmaId];
+    SimDmaSync(inst);
+    if (ch->job) {
+        SimDmaDropJob(inst, ch, true);
     }
+    ch->busy = false;
+    ch->head = ch->submitted = ch->tail;
+    ch->allocated = false;
 
-    return HAL_ERROR;
+    printf("[SIM_DMA] Released channel %p\n", channel);
+    return HAL_OK;
 }
 
 int HAL_DMA_Configure(DmaChannel channel, DmaConfig config)
@@ -117,41 +1163,258 @@ int HAL_DMA_Configure(DmaChannel channel, DmaConfig config)
 
 int HAL_DMA_StartTransfer(DmaChannel channel, const void* srcAddr, void* dstAddr, size_t size)
 {
-    for (int i = 0; i < MAX_DMA_CHANNELS; i++) {
-        if (g_simDma.channels[i].allocated && g_simDma.channels[i].handle == channel) {
-            /* Simulate DMA transfer */
-            memcpy(dstAddr, srcAddr, size);
+    SimDmaChannel* ch = SimDmaFindChannel(channel);
+    if (!ch)
+        return HAL_ERROR;
 
-            g_simDma.channels[i].busy = false;
-            g_simDma.channels[i].bytesTransferred = size;
+    SimDmaDescriptor desc;
+    if (!SimDmaValidate(srcAddr, dstAddr, size) ||
+        !SimDmaBuildDescriptor(&desc, srcAddr, dstAddr, size, 0, false))
+        return HAL_ERROR;
 
-            printf("[SIM_DMA] Transfer complete: %zu bytes\n", size);
+    return SimDmaSubmitSingle(&g_simDma.instances[ch->dmaId], ch, &desc);
+}
 
-            /* Call callback if registered */
-            if (g_simDma.channels[i].callback) {
-                g_simDma.channels[i].callback(channel, DMA_EVENT_TRANSFER_COMPLETE,
-                                              g_simDma.channels[i].userData);
-            }
+/* Resolve a buffer range to a DMA (physical) address */
+static uint8_t* SimDmaResolveBuffer(MemoryBuffer buffer, size_t offset, size_t size,
+                                    MemoryBufferInfo* info)
+{
+    if (HAL_MEMORY_GetBufferInfo(buffer, info) != HAL_OK)
+        return NULL;
+    if (offset > info->size || size > info->size - offset)
+        return NULL;
 
-            return HAL_OK;
+    return (uint8_t*) info->physAddr + offset;
+}
+
+/* One cache operation, counted against what a whole-buffer operation would have cost */
+static void SimDmaMaintain(MemoryBuffer buffer, const MemoryBufferInfo* info, size_t offset,
+                           size_t size, bool flush)
+{
+    if (!info->isCached || size == 0) {
+        g_simDma.cacheStats.avoidedOps++;
+        g_simDma.cacheStats.avoidedBytes += info->size;
+        return;
+    }
+
+    if (flush) {
+        HAL_MEMORY_FlushBuffer(buffer, offset, size);
+    } else {
+        HAL_MEMORY_InvalidateBuffer(buffer, offset, size);
+    }
+
+    g_simDma.cacheStats.performedOps++;
+    g_simDma.cacheStats.performedBytes += size;
+    g_simDma.cacheStats.avoidedBytes += info->size - size;
+}
+
+int HAL_DMA_StartBufferTransfer(DmaChannel channel, MemoryBuffer srcBuffer, size_t srcOffset,
+                                MemoryBuffer dstBuffer, size_t dstOffset, size_t size)
+{
+    SimDmaChannel* ch = SimDmaFindChannel(channel);
+    if (!ch)
+        return HAL_ERROR;
+
+    MemoryBufferInfo srcInfo;
+    MemoryBufferInfo dstInfo;
+    const uint8_t* src = SimDmaResolveBuffer(srcBuffer, srcOffset, size, &srcInfo);
+    uint8_t* dst = SimDmaResolveBuffer(dstBuffer, dstOffset, size, &dstInfo);
+    if (!src || !dst)
+        return HAL_ERROR;
+
+    SimDmaInstance* inst = &g_simDma.instances[ch->dmaId];
+    SimDmaSync(inst);
+    if (ch->busy || ch->tail != ch->head)
+        return HAL_BUSY;
+
+    SimDmaDescriptor desc;
+    if (!SimDmaBuildDescriptor(&desc, src, dst, size, 0, false))
+        return HAL_ERROR;
+
+    /* Both ends are memory buffers whatever the channel direction */
+    SimDmaMaintain(srcBuffer, &srcInfo, srcOffset, size, true);
+    SimDmaMaintain(dstBuffer, &dstInfo, dstOffset, size, false);
+
+    return SimDmaSubmitSingle(inst, ch, &desc);
+}
+
+int HAL_DMA_PrepareTransfer(DmaChannel channel, const void* srcAddr, void* dstAddr, size_t size,
+                            DmaPreparedTransfer* prepared)
+{
+    if (!prepared)
+        return HAL_ERROR;
+
+    SimDmaChannel* ch = SimDmaFindChannel(channel);
+    if (!ch || !SimDmaValidate(srcAddr, dstAddr, size))
+        return HAL_ERROR;
+
+    SimDmaPrepared* prep = (SimDmaPrepared*) malloc(sizeof(SimDmaPrepared));
+    if (!prep)
+        return HAL_ERROR;
+
+    if (!SimDmaBuildDescriptor(&prep->desc, srcAddr, dstAddr, size, 0, false)) {
+        free(prep);
+        return HAL_ERROR;
+    }
+    prep->dmaId = ch->dmaId;
+    prep->index = (uint32_t) (ch - g_simDma.instances[ch->dmaId].channels);
+    prep->generation = ch->generation;
+
+    *prepared = prep;
+    return HAL_OK;
+}
+
+int HAL_DMA_Launch(DmaPreparedTransfer prepared)
+{
+    const SimDmaPrepared* prep = (const SimDmaPrepared*) prepared;
+    if (!prep)
+        return HAL_ERROR;
+
+    /* Only a liveness check: the channel may have been released since preparation */
+    SimDmaChannel* ch = SimDmaPreparedChannel(prep);
+    if (!ch)
+        return HAL_ERROR;
+
+    return SimDmaSubmitSingle(&g_simDma.instances[prep->dmaId], ch, &prep->desc);
+}
+
+int HAL_DMA_ReleasePrepared(DmaPreparedTransfer prepared)
+{
+    if (!prepared)
+        return HAL_ERROR;
+
+    free(prepared);
+    return HAL_OK;
+}
+
+int HAL_DMA_LinkChannel(DmaChannel channel, DmaPreparedTransfer prepared)
+{
+    SimDmaChannel* ch = SimDmaFindChannel(channel);
+    if (!ch)
+        return HAL_ERROR;
+
+    SimDmaSync(&g_simDma.instances[ch->dmaId]);
+    ch->chained = prepared != NULL;
+    if (prepared) {
+        ch->chain = *(const SimDmaPrepared*) prepared;
+    }
+
+    return HAL_OK;
+}
+
+int HAL_DMA_LinkTimer(TimerHandle timer, DmaPreparedTransfer prepared)
+{
+    if (!timer)
+        return HAL_ERROR;
+
+    SimDmaTimerLink* link = NULL;
+    for (int i = 0; i < MAX_DMA_TIMER_LINKS && !link; i++) {
+        if (g_simDma.timerLinks[i].used && g_simDma.timerLinks[i].timer == timer) {
+            link = &g_simDma.timerLinks[i];
         }
     }
 
-    return HAL_ERROR;
+    if (!prepared) {
+        if (link) {
+            link->used = false;
+        }
+        return SimTimerSetTrigger(timer, NULL, NULL) == 0 ? HAL_OK : HAL_ERROR;
+    }
+
+    for (int i = 0; i < MAX_DMA_TIMER_LINKS && !link; i++) {
+        if (!g_simDma.timerLinks[i].used) {
+            link = &g_simDma.timerLinks[i];
+        }
+    }
+    if (!link)
+        return HAL_ERROR;
+
+    if (SimTimerSetTrigger(timer, SimDmaOnTimerTrigger, link) != 0)
+        return HAL_ERROR;
+
+    link->used = true;
+    link->timer = timer;
+    link->prepared = *(const SimDmaPrepared*) prepared;
+    return HAL_OK;
+}
+
+int HAL_DMA_QueueTransfer(DmaChannel channel, const void* srcAddr, void* dstAddr, size_t size,
+                          uint32_t tag)
+{
+    SimDmaChannel* ch = SimDmaFindChannel(channel);
+    if (!ch || !SimDmaValidate(srcAddr, dstAddr, size))
+        return HAL_ERROR;
+
+    SimDmaSync(&g_simDma.instances[ch->dmaId]);
+
+    if (SimDmaQueueDepth(ch) == SIM_DMA_QUEUE_DEPTH)
+        return HAL_BUSY;
+
+    SimDmaDescriptor* desc = &ch->ring[ch->tail % SIM_DMA_QUEUE_DEPTH];
+    if (!SimDmaBuildDescriptor(desc, srcAddr, dstAddr, size, tag, true))
+        return HAL_ERROR;
+    ch->tail++;
+
+    if (SimDmaQueueDepth(ch) > ch->stats.maxQueueDepth) {
+        ch->stats.maxQueueDepth = SimDmaQueueDepth(ch);
+    }
+
+    return HAL_OK;
+}
+
+int HAL_DMA_SubmitQueued(DmaChannel channel)
+{
+    SimDmaChannel* ch = SimDmaFindChannel(channel);
+    if (!ch)
+        return HAL_ERROR;
+
+    SimDmaInstance* inst = &g_simDma.instances[ch->dmaId];
+    SimDmaSync(inst);
+
+    ch->submitted = ch->tail;
+    if (!ch->busy) {
+        SimDmaLoadNext(ch, SimDmaNowNs(inst));
+    }
+    SimDmaKick(inst, ch);
+
+    return HAL_OK;
+}
+
+int HAL_DMA_PopCompletion(DmaChannel channel, uint32_t* tag)
+{
+    if (!tag)
+        return HAL_ERROR;
+
+    SimDmaChannel* ch = SimDmaFindChannel(channel);
+    if (!ch)
+        return HAL_ERROR;
+
+    SimDmaSync(&g_simDma.instances[ch->dmaId]);
+
+    if (ch->doneHead == ch->doneTail)
+        return HAL_BUSY;
+
+    *tag = ch->doneTags[ch->doneHead++ % SIM_DMA_QUEUE_DEPTH];
+    return HAL_OK;
 }
 
 int HAL_DMA_StopTransfer(DmaChannel channel)
 {
-    for (int i = 0; i < MAX_DMA_CHANNELS; i++) {
-        if (g_simDma.channels[i].allocated && g_simDma.channels[i].handle == channel) {
-            g_simDma.channels[i].busy = false;
+    SimDmaChannel* ch = SimDmaFindChannel(channel);
+    if (!ch)
+        return HAL_ERROR;
 
-            printf("[SIM_DMA] Stopped transfer on channel %p\n", channel);
-            return HAL_OK;
-        }
+    SimDmaInstance* inst = &g_simDma.instances[ch->dmaId];
+    SimDmaSync(inst);
+    /* Abort the active descriptor and drop everything queued behind it */
+    if (ch->job) {
+        SimDmaDropJob(inst, ch, true);
     }
+    ch->busy = false;
+    ch->head = ch->submitted = ch->tail;
 
-    return HAL_ERROR;
+    printf("[SIM_DMA] Stopped transfer on channel %p\n", channel);
+    return HAL_OK;
 }
 
 int HAL_DMA_IsBusy(DmaChannel channel, bool* isBusy)
@@ -159,41 +1422,123 @@ int HAL_DMA_IsBusy(DmaChannel channel, bool* isBusy)
     if (!isBusy)
         return HAL_ERROR;
 
-    for (int i = 0; i < MAX_DMA_CHANNELS; i++) {
-        if (g_simDma.channels[i].allocated && g_simDma.channels[i].handle == channel) {
-            *isBusy = g_simDma.channels[i].busy;
-            return HAL_OK;
-        }
+    SimDmaChannel* ch = SimDmaFindChannel(channel);
+    if (!ch)
+        return HAL_ERROR;
+
+    if (ch->job) {
+        SimDmaReap(&g_simDma.instances[ch->dmaId], ch);
     }
+    *isBusy = ch->busy;
+    return HAL_OK;
+}
 
-    return HAL_ERROR;
+/* How far to advance simulated time before a busy channel can make progress, 0 = never */
+static uint64_t SimDmaWaitStepUs(const SimDmaInstance* inst, const SimDmaChannel* ch)
+{
+    uint64_t nowNs = SimDmaNowNs(inst);
+    uint64_t readyNs = SimDmaEndpointReadyNs(ch, SimDmaEndpointWant(inst, ch), nowNs);
+    if (readyNs == UINT64_MAX)
+        return 0;
+
+    uint64_t stepUs = (readyNs - nowNs + SIM_DMA_NS_PER_US - 1) / SIM_DMA_NS_PER_US;
+    if (SimDmaIsTimed(inst)) {
+        size_t remaining = ch->size - ch->bytesTransferred;
+        uint64_t busUs = (remaining + inst->busBytesPerUs - 1) / inst->busBytesPerUs;
+        stepUs = busUs > stepUs ? busUs : stepUs;
+    }
+    return stepUs ? stepUs : 1;
+}
+
+void SimDmaPoll(void)
+{
+    SimDmaOnTimeAdvance(SIM_TIMER_GetCurrentTime());
 }
 
 int HAL_DMA_WaitComplete(DmaChannel channel, uint32_t timeoutMs)
 {
-    (void) timeoutMs;
+    SimDmaChannel* ch = SimDmaFindChannel(channel);
+    if (!ch)
+        return HAL_ERROR;
+
+    SimDmaInstance* inst = &g_simDma.instances[ch->dmaId];
+    SimDmaSync(inst);
 
-    /* In simulation, transfers complete immediately */
-    bool isBusy = false;
-    if (HAL_DMA_IsBusy(channel, &isBusy) == HAL_OK) {
-        return isBusy ? HAL_BUSY : HAL_OK;
+    /* Timed transfers: let simulated time run until the channel drains */
+    uint64_t waitedUs = 0;
+    uint64_t timeoutUs = (uint64_t) timeoutMs * 1000;
+
+    while (ch->busy) {
+        if (inst->advancing || ch->draining)
+            return HAL_BUSY;
+
+        if (ch->job) {
+            /* Host-side copy, no simulated time involved: other tasks may run meanwhile */
+            if (!SimCopyDone(ch->job) && SimSchedulerWaitSwitch()) {
+                ch = SimDmaFindChannel(channel);
+                if (!ch)
+                    return HAL_ERROR;
+                continue;
+            }
+            SimCopyWait(ch->job);
+            SimDmaReap(inst, ch);
+            continue;
+        }
+
+        uint64_t stepUs = SimDmaWaitStepUs(inst, ch);
+        if (stepUs == 0 && !timeoutUs) {
+            /* Waiting on a peripheral nothing will ever feed or drain */
+            return HAL_TIMEOUT;
+        }
+        if (stepUs == 0 || (timeoutUs && waitedUs + stepUs > timeoutUs)) {
+            stepUs = timeoutUs - waitedUs;
+        }
+
+        if (stepUs == 0)
+            return HAL_TIMEOUT;
+        if (SIM_TIMER_AdvanceTime(stepUs) != 0)
+            return HAL_ERROR;
+        waitedUs += stepUs;
     }
 
-    return HAL_ERROR;
+    return HAL_OK;
 }
 
 int HAL_DMA_RegisterCallback(DmaChannel channel, DmaCallback callback, void* userData)
 {
-    for (int i = 0; i < MAX_DMA_CHANNELS; i++) {
-        if (g_simDma.channels[i].allocated && g_simDma.channels[i].handle == channel) {
-            g_simDma.channels[i].callback = callback;
-            g_simDma.channels[i].userData = userData;
+    SimDmaChannel* ch = SimDmaFindChannel(channel);
+    if (!ch)
+        return HAL_ERROR;
 
-            return HAL_OK;
-        }
+    ch->callback = callback;
+    ch->userData = userData;
+
+    return HAL_OK;
+}
+
+int HAL_DMA_SetCoalescing(DmaChannel channel, uint32_t maxTransfers, uint32_t maxDelayUs,
+                          DmaBatchCallback callback, void* userData)
+{
+    SimDmaChannel* ch = SimDmaFindChannel(channel);
+    if (!ch)
+        return HAL_ERROR;
+
+    SimDmaSync(&g_simDma.instances[ch->dmaId]);
+
+    /* Completions collected under the old setting are reported under it */
+    if (ch->pendingCount) {
+        SimDmaFlushBatch(ch, SimDmaNowNs(&g_simDma.instances[ch->dmaId]));
     }
 
-    return HAL_ERROR;
+    ch->batchCallback = callback;
+    ch->batchUserData = userData;
+    ch->coalesceCount = maxTransfers;
+    ch->coalesceNs = (uint64_t) maxDelayUs * SIM_DMA_NS_PER_US;
+    if (maxTransfers == 0 && maxDelayUs == 0) {
+        ch->coalesceCount = 1;
+    }
+
+    return HAL_OK;
 }
 
 int HAL_DMA_EnableEvents(DmaChannel channel, uint32_t events)
@@ -208,12 +1553,14 @@ int HAL_DMA_GetProgress(DmaChannel channel, size_t* bytesTransferred)
     if (!bytesTransferred)
         return HAL_ERROR;
 
-    for (int i = 0; i < MAX_DMA_CHANNELS; i++) {
-        if (g_simDma.channels[i].allocated && g_simDma.channels[i].handle == channel) {
-            *bytesTransferred = g_simDma.channels[i].bytesTransferred;
-            return HAL_OK;
-        }
-    }
+    SimDmaChannel* ch = SimDmaFindChannel(channel);
+    if (!ch)
+        return HAL_ERROR;
 
-    return HAL_ERROR;
+    SimDmaSync(&g_simDma.instances[ch->dmaId]);
+    *bytesTransferred = ch->bytesTransferred;
+    if (ch->job) {
+        *bytesTransferred += SimCopyProgress(ch->job);
+    }
+    return HAL_OK;
 }
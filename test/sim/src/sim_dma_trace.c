@@ -0,0 +1,363 @@
+/**
+ * @file sim_dma_trace.c
+ * @brief DMA Transfer Trace Recorder
+ *
+ * sim_dma.c appends one record per completed transfer. Records go into a
+ * power-of-two ring of sequence-stamped slots: a writer claims a slot with one
+ * atomic increment and publishes it by storing the slot's stamp, so appending
+ * never takes a lock and readers skip slots that are being overwritten. When the
+ * ring is full the oldest records are overwritten.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sim_dma.h"
+#include "sim_internal.h"
+
+#define SIM_DMA_TRACE_MAGIC "SDMT"
+#define SIM_DMA_TRACE_VERSION 1u
+#define SIM_DMA_TRACE_MIN_BUCKET_BYTES 64
+#define SIM_DMA_TRACE_MAX_INSTANCES 256
+
+/* Ring slot; stamp is the record's sequence number + 1 once it is complete, 0 while written */
+typedef struct {
+    uint64_t stamp;
+    SimDmaTraceRecord record;
+} SimDmaTraceSlot;
+
+/* Global state */
+static struct {
+    SimDmaTraceSlot* slots;
+    uint32_t capacity; /* Power of two */
+    uint64_t writeSeq; /* Next sequence number to hand out (atomic) */
+    bool recording;    /* Writers append (atomic) */
+} g_simDmaTrace = {0};
+
+static const char* const kSimDmaTraceDirection[] = {"M2M", "M2P", "P2M"};
+
+/* Private functions */
+static uint32_t SimDmaTraceRead(SimDmaTraceRecord* records, uint32_t maxRecords)
+{
+    if (!g_simDmaTrace.slots)
+        return 0;
+
+    uint64_t end = __atomic_load_n(&g_simDmaTrace.writeSeq, __ATOMIC_ACQUIRE);
+    uint64_t begin = end > g_simDmaTrace.capacity ? end - g_simDmaTrace.capacity : 0;
+    uint32_t count = 0;
+
+    for (uint64_t seq = begin; seq < end && count < maxRecords; seq++) {
+        const SimDmaTraceSlot* slot = &g_simDmaTrace.slots[seq & (g_simDmaTrace.capacity - 1)];
+        if (__atomic_load_n(&slot->stamp, __ATOMIC_ACQUIRE) != seq + 1) {
+            continue;
+        }
+        records[count] = slot->record;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        /* Overwritten while copying, the record is torn */
+        if (__atomic_load_n(&slot->stamp, __ATOMIC_RELAXED) == seq + 1) {
+            count++;
+        }
+    }
+    return count;
+}
+
+/* Snapshot of the ring; caller frees */
+static SimDmaTraceRecord* SimDmaTraceSnapshot(uint32_t* count)
+{
+    *count = 0;
+    if (!g_simDmaTrace.slots)
+        return NULL;
+
+    SimDmaTraceRecord* records =
+        (SimDmaTraceRecord*) malloc(g_simDmaTrace.capacity * sizeof(SimDmaTraceRecord));
+    if (records) {
+        *count = SimDmaTraceRead(records, g_simDmaTrace.capacity);
+    }
+    return records;
+}
+
+static int SimDmaTraceCompareStart(const void* a, const void* b)
+{
+    uint64_t x = ((const SimDmaTraceRecord*) a)->startNs;
+    uint64_t y = ((const SimDmaTraceRecord*) b)->startNs;
+    return x < y ? -1 : x > y;
+}
+
+static uint32_t SimDmaTraceBucket(uint64_t size)
+{
+    uint32_t bucket = 0;
+    uint64_t limit = SIM_DMA_TRACE_MIN_BUCKET_BYTES;
+
+    while (size > limit && bucket < SIM_DMA_TRACE_SIZE_BUCKETS - 1) {
+        limit <<= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+/* Summarize the records of one instance; sorts records in place */
+static void SimDmaTraceSummarize(SimDmaTraceRecord* records, uint32_t count, DmaId dmaId,
+                                 SimDmaTraceSummary* summary)
+{
+    memset(summary, 0, sizeof(*summary));
+
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (records[i].dmaId == dmaId) {
+            records[n++] = records[i];
+        }
+    }
+    if (n == 0)
+        return;
+
+    qsort(records, n, sizeof(*records), SimDmaTraceCompareStart);
+
+    uint64_t firstNs = UINT64_MAX;
+    uint64_t lastNs = 0;
+    uint64_t busyEndNs = 0;
+
+    for (uint32_t i = 0; i < n; i++) {
+        const SimDmaTraceRecord* rec = &records[i];
+        uint64_t delay = rec->startNs - rec->submitNs;
+
+        summary->transfers++;
+        summary->bytes += rec->size;
+        summary->queueDelayNs += delay;
+        if (delay > summary->maxQueueDelayNs) {
+            summary->maxQueueDelayNs = delay;
+        }
+        summary->sizeHistogram[SimDmaTraceBucket(rec->size)]++;
+
+        firstNs = rec->submitNs < firstNs ? rec->submitNs : firstNs;
+        lastNs = rec->endNs > lastNs ? rec->endNs : lastNs;
+
+        /* Union of [start, end) over channels sharing the bus */
+        uint64_t from = rec->startNs > busyEndNs ? rec->startNs : busyEndNs;
+        if (rec->endNs > from) {
+            summary->busyNs += rec->endNs - from;
+        }
+        busyEndNs = rec->endNs > busyEndNs ? rec->endNs : busyEndNs;
+    }
+
+    summary->windowNs = lastNs - firstNs;
+    if (summary->windowNs) {
+        summary->utilizationPpm = (uint32_t) (summary->busyNs * 1000000 / summary->windowNs);
+    }
+}
+
+static int SimDmaTraceWriteBinary(FILE* file, const SimDmaTraceRecord* records, uint32_t count)
+{
+    uint8_t header[16];
+    uint32_t fields[3] = {SIM_DMA_TRACE_VERSION, (uint32_t) sizeof(SimDmaTraceRecord), count};
+
+    memcpy(header, SIM_DMA_TRACE_MAGIC, 4);
+    for (int f = 0; f < 3; f++) {
+        for (int b = 0; b < 4; b++) {
+            header[4 + f * 4 + b] = (uint8_t) (fields[f] >> (8 * b));
+        }
+    }
+
+    if (fwrite(header, sizeof(header), 1, file) != 1)
+        return -1;
+    if (count && fwrite(records, sizeof(*records), count, file) != count)
+        return -1;
+    return 0;
+}
+
+static int SimDmaTraceWriteChrome(FILE* file, const SimDmaTraceRecord* records, uint32_t count)
+{
+    bool named[SIM_DMA_TRACE_MAX_INSTANCES] = {false};
+    const char* sep = "";
+
+    fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+
+    for (uint32_t i = 0; i < count; i++) {
+        const SimDmaTraceRecord* rec = &records[i];
+        const char* dir =
+            rec->direction < 3 ? kSimDmaTraceDirection[rec->direction] : "DMA";
+
+        if (!named[rec->dmaId]) {
+            named[rec->dmaId] = true;
+            fprintf(file,
+                    "%s\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%u,"
+                    "\"args\":{\"name\":\"DMA %u\"}}",
+                    sep, rec->dmaId, rec->dmaId);
+            sep = ",";
+        }
+
+        /* Timestamps are microseconds, kept to the nanosecond */
+        fprintf(file,
+                "%s\n{\"name\":\"%s %llu B\",\"cat\":\"dma\",\"ph\":\"X\",\"pid\":%u,"
+                "\"tid\":%u,\"ts\":%llu.%03llu,\"dur\":%llu.%03llu,\"args\":{\"size\":%llu,"
+                "\"priority\":%u,\"queueNs\":%llu,\"flags\":%u}}",
+                sep, dir, (unsigned long long) rec->size, rec->dmaId, rec->channel,
+                (unsigned long long) (rec->startNs / 1000),
+                (unsigned long long) (rec->startNs % 1000),
+                (unsigned long long) ((rec->endNs - rec->startNs) / 1000),
+                (unsigned long long) ((rec->endNs - rec->startNs) % 1000),
+                (unsigned long long) rec->size, rec->priority,
+                (unsigned long long) (rec->startNs - rec->submitNs), rec->flags);
+        sep = ",";
+    }
+
+    fprintf(file, "\n]}\n");
+    return ferror(file) ? -1 : 0;
+}
+
+/* Internal interface */
+bool SimDmaTraceEnabled(void)
+{
+    return __atomic_load_n(&g_simDmaTrace.recording, __ATOMIC_ACQUIRE);
+}
+
+void SimDmaTraceAppend(const SimDmaTraceRecord* record)
+{
+    if (!SimDmaTraceEnabled())
+        return;
+
+    uint64_t seq = __atomic_fetch_add(&g_simDmaTrace.writeSeq, 1, __ATOMIC_RELAXED);
+    SimDmaTraceSlot* slot = &g_simDmaTrace.slots[seq & (g_simDmaTrace.capacity - 1)];
+
+    __atomic_store_n(&slot->stamp, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    slot->record = *record;
+    __atomic_store_n(&slot->stamp, seq + 1, __ATOMIC_RELEASE);
+}
+
+void SimDmaTraceReset(void)
+{
+    __atomic_store_n(&g_simDmaTrace.recording, false, __ATOMIC_RELEASE);
+    free(g_simDmaTrace.slots);
+    memset(&g_simDmaTrace, 0, sizeof(g_simDmaTrace));
+}
+
+/* Simulator control functions */
+int SIM_DMA_StartTrace(uint32_t capacity)
+{
+    if (capacity == 0) {
+        capacity = SIM_DMA_TRACE_DEFAULT_CAPACITY;
+    }
+    if (capacity > (1u << 31))
+        return -1;
+
+    uint32_t rounded = 1;
+    while (rounded < capacity) {
+        rounded <<= 1;
+    }
+
+    SimDmaTraceSlot* slots = (SimDmaTraceSlot*) calloc(rounded, sizeof(SimDmaTraceSlot));
+    if (!slots)
+        return -1;
+
+    SimDmaTraceReset();
+    g_simDmaTrace.slots = slots;
+    g_simDmaTrace.capacity = rounded;
+    __atomic_store_n(&g_simDmaTrace.recording, true, __ATOMIC_RELEASE);
+
+    printf("[SIM_DMA] Tracing transfers (%u records)\n", rounded);
+    return 0;
+}
+
+int SIM_DMA_StopTrace(void)
+{
+    __atomic_store_n(&g_simDmaTrace.recording, false, __ATOMIC_RELEASE);
+    return 0;
+}
+
+int SIM_DMA_ReadTrace(SimDmaTraceRecord* records, uint32_t maxRecords, uint32_t* count)
+{
+    if (!count || (!records && maxRecords))
+        return -1;
+
+    *count = SimDmaTraceRead(records, maxRecords);
+    return 0;
+}
+
+int SIM_DMA_ExportTrace(const char* path, SimDmaTraceFormat format)
+{
+    if (!path || (format != SIM_DMA_TRACE_BINARY && format != SIM_DMA_TRACE_CHROME))
+        return -1;
+
+    FILE* file = fopen(path, format == SIM_DMA_TRACE_BINARY ? "wb" : "w");
+    if (!file) {
+        printf("[SIM_DMA] ERROR: Cannot open trace file %s\n", path);
+        return -1;
+    }
+
+    uint32_t count;
+    SimDmaTraceRecord* records = SimDmaTraceSnapshot(&count);
+    int ret = format == SIM_DMA_TRACE_BINARY ? SimDmaTraceWriteBinary(file, records, count)
+                                             : SimDmaTraceWriteChrome(file, records, count);
+    free(records);
+
+    if (fclose(file) != 0) {
+        ret = -1;
+    }
+    return ret;
+}
+
+int SIM_DMA_GetTraceSummary(DmaId dmaId, SimDmaTraceSummary* summary)
+{
+    if (!summary || dmaId >= SIM_DMA_TRACE_MAX_INSTANCES)
+        return -1;
+
+    uint32_t count;
+    SimDmaTraceRecord* records = SimDmaTraceSnapshot(&count);
+    SimDmaTraceSummarize(records, count, dmaId, summary);
+    free(records);
+    return 0;
+}
+
+int SIM_DMA_PrintTraceReport(void)
+{
+    uint32_t count;
+    SimDmaTraceRecord* records = SimDmaTraceSnapshot(&count);
+    if (!records && g_simDmaTrace.slots)
+        return -1;
+
+    /* Summarizing reorders the snapshot, work on a copy per instance */
+    SimDmaTraceRecord* scratch =
+        count ? (SimDmaTraceRecord*) malloc(count * sizeof(SimDmaTraceRecord)) : NULL;
+    bool seen[SIM_DMA_TRACE_MAX_INSTANCES] = {false};
+
+    printf("[SIM_DMA] Trace report: %u transfers\n", count);
+    for (uint32_t i = 0; i < count && scratch; i++) {
+        DmaId dmaId = records[i].dmaId;
+        if (seen[dmaId]) {
+            continue;
+        }
+        seen[dmaId] = true;
+
+        SimDmaTraceSummary summary;
+        memcpy(scratch, records, count * sizeof(*records));
+        SimDmaTraceSummarize(scratch, count, dmaId, &summary);
+
+        printf("[SIM_DMA] DMA %u: %u transfers, %llu bytes, utilization %u.%u%% "
+               "(busy %llu ns of %llu ns)\n",
+               dmaId, summary.transfers, (unsigned long long) summary.bytes,
+               summary.utilizationPpm / 10000, summary.utilizationPpm / 1000 % 10,
+               (unsigned long long) summary.busyNs, (unsigned long long) summary.windowNs);
+        printf("[SIM_DMA]   queue delay: avg %llu ns, max %llu ns\n",
+               (unsigned long long) (summary.queueDelayNs / summary.transfers),
+               (unsigned long long) summary.maxQueueDelayNs);
+
+        uint64_t limit = SIM_DMA_TRACE_MIN_BUCKET_BYTES;
+        for (uint32_t b = 0; b < SIM_DMA_TRACE_SIZE_BUCKETS; b++, limit <<= 1) {
+            if (!summary.sizeHistogram[b]) {
+                continue;
+            }
+            if (b == SIM_DMA_TRACE_SIZE_BUCKETS - 1) {
+                printf("[SIM_DMA]   size > %10llu B: %u\n", (unsigned long long) (limit >> 1),
+                       summary.sizeHistogram[b]);
+            } else {
+                printf("[SIM_DMA]   size <= %9llu B: %u\n", (unsigned long long) limit,
+                       summary.sizeHistogram[b]);
+            }
+        }
+    }
+
+    free(scratch);
+    free(records);
+    return 0;
+}
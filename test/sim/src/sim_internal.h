@@ -0,0 +1,310 @@
+/**
+ * @file sim_internal.h
+ * @brief Hooks shared between simulator sources (not part of the test-facing API)
+ */
+
+#ifndef SIM_INTERNAL_H
+#define SIM_INTERNAL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hal_timer.h"
+#include "sim_dma.h"
+#include "sim_scheduler.h"
+
+/* Called after simulated time moved forward */
+typedef void (*SimTimeHook)(uint64_t nowUs);
+
+/**
+ * @brief Register a hook run whenever simulated time advances
+ * @param hook Hook function (registering the same hook twice is a no-op)
+ * @return 0 on success, -1 on failure
+ */
+int SimTimerAddAdvanceHook(SimTimeHook hook);
+
+/* Hardware trigger fired on timer expiry, before the timer callback */
+typedef void (*SimTimerTrigger)(TimerHandle timer, void* arg, uint64_t expiryUs);
+
+/**
+ * @brief Route every expiry of a timer to a hardware trigger
+ * @param handle Timer handle
+ * @param trigger Trigger function, NULL to remove the route
+ * @param arg Trigger argument
+ * @return 0 on success, -1 on failure
+ */
+int SimTimerSetTrigger(TimerHandle handle, SimTimerTrigger trigger, void* arg);
+
+/**
+ * @brief Check whether SIM_TIMER_Init has run
+ */
+bool SimTimerInitialized(void);
+
+/**
+ * @brief Move simulated time forward without firing timers and run the advance hooks
+ * @param nowUs New time (no-op unless later than the current time)
+ * @note Only the simulation kernel calls this, between events
+ */
+void SimTimerAdvanceTo(uint64_t nowUs);
+
+/* Kernel event callback, run with simulated time at the event time (sim_kernel.c) */
+typedef void (*SimEventHandler)(void* arg, uint64_t nowUs);
+
+/* Pending event, 0 for none */
+typedef uint64_t SimEventId;
+
+/**
+ * @brief Schedule an event
+ * @param timeUs Simulated time to fire at (a past time fires at the next kernel step)
+ * @param handler Event callback
+ * @param arg Callback argument
+ * @return Event id, 0 on failure
+ * @note Events due at the same time fire in posting order
+ */
+SimEventId SimKernelPost(uint64_t timeUs, SimEventHandler handler, void* arg);
+
+/**
+ * @brief Withdraw a pending event
+ * @param id Event id (0 and ids of events that fired already are ignored)
+ * @return true if the event was pending
+ */
+bool SimKernelCancel(SimEventId id);
+
+/**
+ * @brief Fire all events due up to a time, then move simulated time there
+ * @param untilUs End time
+ * @param runTasks Run the scheduler's ready tasks whenever no event is due right now (SIM_Run)
+ * @return 0 on success, -1 on failure
+ */
+int SimKernelRunUntil(uint64_t untilUs, bool runTasks);
+
+/**
+ * @brief Whether an event handler is running right now
+ * @return true inside a handler
+ */
+bool SimKernelInHandler(void);
+
+/**
+ * @brief Drop all pending events and statistics (the owners reset their state too)
+ */
+void SimKernelReset(void);
+
+/* Virtual peripheral behind a data register address (sim_periph.c) */
+typedef struct SimPeriph SimPeriph;
+
+/**
+ * @brief Map a DMA address to the peripheral whose data register it is
+ * @param addr Address given to the DMA engine
+ * @return Peripheral slot (possibly unregistered), or NULL for ordinary memory
+ */
+SimPeriph* SimPeriphFind(const void* addr);
+
+/**
+ * @brief Check that a peripheral is registered and can be a DMA source (or sink)
+ */
+bool SimPeriphHasRole(const SimPeriph* periph, bool source);
+
+/**
+ * @brief Get the hardware FIFO depth of a peripheral in bytes (0 if unregistered)
+ */
+size_t SimPeriphFifoDepth(const SimPeriph* periph);
+
+/**
+ * @brief Bytes the DMA engine can move right now (FIFO level for sources, free space for sinks)
+ * @param periph Peripheral
+ * @param nowNs Simulated time in ns; the device side is run up to it first
+ */
+size_t SimPeriphRoom(SimPeriph* periph, uint64_t nowNs);
+
+/**
+ * @brief Earliest time at which SimPeriphRoom reaches size
+ * @return Time in ns, UINT64_MAX if that cannot happen without outside help
+ */
+uint64_t SimPeriphReadyNs(SimPeriph* periph, size_t size, uint64_t nowNs);
+
+/**
+ * @brief DMA side of a source: pop size bytes (at most SimPeriphRoom) from the FIFO
+ */
+void SimPeriphRead(SimPeriph* periph, uint8_t* data, size_t size, uint64_t nowNs);
+
+/**
+ * @brief DMA side of a sink: push size bytes (at most SimPeriphRoom) into the FIFO
+ */
+void SimPeriphWrite(SimPeriph* periph, const uint8_t* data, size_t size, uint64_t nowNs);
+
+/**
+ * @brief Let DMA channels waiting on a peripheral retry at the current simulated time
+ */
+void SimDmaPoll(void);
+
+/* Parallel copy job (sim_copy.c) */
+typedef struct SimCopyJob SimCopyJob;
+
+/**
+ * @brief (Re)start the copy worker pool; no job may be in flight
+ * @param workers Worker threads, 0 stops the pool
+ * @param chunkBytes Bytes copied between progress updates (rounded up to pages)
+ * @param pinWorkers Pin worker i to CPU i
+ * @return 0 on success, -1 on failure
+ */
+int SimCopyConfigure(uint32_t workers, size_t chunkBytes, bool pinWorkers);
+
+/**
+ * @brief Hand a copy to the worker pool
+ * @return Job, NULL if the pool is not running (the caller copies itself)
+ */
+SimCopyJob* SimCopySubmit(uint8_t* dst, const uint8_t* src, size_t size);
+
+/**
+ * @brief Bytes of a job copied so far
+ */
+size_t SimCopyProgress(const SimCopyJob* job);
+
+/**
+ * @brief Check whether all stripes of a job finished (their data is then visible)
+ */
+bool SimCopyDone(const SimCopyJob* job);
+
+/**
+ * @brief Block until a job is done
+ */
+void SimCopyWait(const SimCopyJob* job);
+
+/**
+ * @brief Wait for a job (optionally skipping the chunks not started yet) and free it
+ */
+void SimCopyRelease(SimCopyJob* job, bool cancel);
+
+/**
+ * @brief From a stackful task with other tasks ready, switch to them (sim_scheduler.c)
+ * @return true once the task runs again, false if the caller has to block the thread
+ */
+bool SimSchedulerWaitSwitch(void);
+
+/**
+ * @brief Dispatch the ready tasks once if the scheduler is idle (no-op otherwise)
+ * @param untilUs Stop dispatching once simulated time has passed it
+ */
+void SimSchedulerRunReady(uint64_t untilUs);
+
+/**
+ * @brief Start the idle accounting of a run (sim_scheduler.c)
+ */
+void SimSchedulerBeginRun(void);
+
+/**
+ * @brief Account a clock jump the kernel makes for lack of ready tasks and call the idle
+ *        hook (no-op while tasks are ready or running)
+ * @param nowUs Current simulated time
+ * @param wakeUs Time the clock jumps to: the next event or the end of the run
+ */
+void SimSchedulerIdle(uint64_t nowUs, uint64_t wakeUs);
+
+/**
+ * @brief Let the running task work for a while of simulated time, preemptibly
+ * @param us Work time in microseconds
+ * @return true if done here, false if the caller should just advance the clock (no
+ *         preemptive dispatching, or a caller that cannot be preempted)
+ */
+bool SimSchedulerSpend(uint64_t us);
+
+/* Set of scheduler task slots, one bit each */
+#define SIM_TASK_SET_WORDS 8
+typedef struct {
+    uint64_t words[SIM_TASK_SET_WORDS];
+} SimTaskSet;
+
+/* Tasks blocked on a simulator object such as a queue */
+typedef struct {
+    SimTaskSet waiters; /* Task slots (atomic words) */
+} SimWaitList;
+
+/**
+ * @brief Wait for a condition that whoever changes it announces on a wait list
+ * @param list Wait list
+ * @param ready Condition, re-checked once the caller is registered so no wakeup gets lost
+ * @param arg Condition argument
+ * @param deadlineUs Simulated time to give up at, UINT64_MAX for none
+ * @return HAL_OK when the caller should check again, HAL_TIMEOUT once the deadline passed
+ *         or nothing is left that could change the condition, HAL_ERROR on failure
+ * @note A stackful task blocks and other tasks run meanwhile. Elsewhere, a task of a
+ *       multi-threaded frame yields, and any other caller lets simulated time run to the
+ *       next kernel event
+ */
+int SimSchedulerWait(SimWaitList* list, bool (*ready)(void* arg), void* arg, uint64_t deadlineUs);
+
+/**
+ * @brief Wake the waiting task of highest priority (lowest index among equals)
+ * @return true if a task was woken
+ * @note Call after changing the condition; costs a few loads while nobody waits
+ */
+bool SimSchedulerWakeOne(SimWaitList* list);
+
+/**
+ * @brief Wake every task waiting on a list
+ */
+void SimSchedulerWakeAll(SimWaitList* list);
+
+/**
+ * @brief Count the tasks registered on a wait list
+ */
+uint32_t SimSchedulerCountWaiters(const SimWaitList* list);
+
+/**
+ * @brief Get the calling task
+ * @return Task handle, NULL outside tasks
+ */
+TaskHandle SimSchedulerSelf(void);
+
+/**
+ * @brief Get a task's priority
+ * @param inherited true for the level it is queued at now, false for the one it was created with
+ * @return Priority, -1 on invalid handle
+ */
+int SimSchedulerGetPriority(TaskHandle task, bool inherited);
+
+/**
+ * @brief Queue a task at another level than its own while it holds what others wait for
+ * @param priority Level to use from now on; the task's own priority ends the boost
+ * @note No-op for periodic tasks, which rank above all levels anyway
+ */
+void SimSchedulerSetInherited(TaskHandle task, int priority);
+
+/**
+ * @brief Highest current priority among the tasks waiting on a list, -1 if none
+ */
+int SimSchedulerWaitersPriority(const SimWaitList* list);
+
+/**
+ * @brief Check whether a task is blocked on a wait list
+ */
+bool SimSchedulerIsWaiting(const SimWaitList* list, TaskHandle task);
+
+/**
+ * @brief Check whether task runs are being traced (sim_scheduler_trace.c)
+ */
+bool SimSchedulerTraceEnabled(void);
+
+/**
+ * @brief Append a task creation or run to the trace ring (no-op unless tracing)
+ * @param record Record with absolute host times (CLOCK_MONOTONIC ns), readyNs 0 if unknown
+ */
+void SimSchedulerTraceAppend(const SimSchedulerTraceRecord* record);
+
+/**
+ * @brief Check whether DMA transfers are being traced (sim_dma_trace.c)
+ */
+bool SimDmaTraceEnabled(void);
+
+/**
+ * @brief Append a completed transfer to the trace ring (no-op unless tracing)
+ */
+void SimDmaTraceAppend(const SimDmaTraceRecord* record);
+
+/**
+ * @brief Stop tracing and free the trace ring
+ */
+void SimDmaTraceReset(void);
+
+#endif /* SIM_INTERNAL_H */
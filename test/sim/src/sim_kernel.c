@@ -0,0 +1,288 @@
+/**
+ * @file sim_kernel.c
+ * @brief Discrete-Event Simulation Kernel
+ *
+ * One event queue for all simulators, ordered by (time, posting order) so every run is
+ * reproducible.
+ */
+
+#include "sim_kernel.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "sim_internal.h"
+#include "sim_timer.h"
+
+#define SIM_KERNEL_INITIAL_SLOTS 64
+
+typedef struct {
+    uint64_t timeUs;
+    uint64_t seq;
+    SimEventHandler handler;
+    void* arg;
+    uint32_t heapIndex;
+    uint32_t generation;
+    uint32_t nextFree;
+    bool queued;
+} SimKernelSlot;
+
+/*
+ * Binary min-heap of slot indices. Each slot records its heap position, which makes
+ * cancelling O(log n); an event id carries the slot generation so a stale id cannot
+ * cancel the slot's next occupant.
+ */
+static struct {
+    SimKernelSlot* slots;
+    uint32_t* heap; /* Slot indices, earliest (time, seq) first */
+    uint32_t capacity;
+    uint32_t count;
+    uint32_t freeHead;
+    uint64_t nextSeq;
+    uint32_t handlerDepth; /* Handlers running, nested through time advances in them */
+    SimKernelStats stats;
+} g_simKernel = {0};
+
+#define SIM_KERNEL_NO_SLOT UINT32_MAX
+
+/* Survives SimKernelReset: slots start past every generation used so far, so old ids stay stale */
+static uint32_t g_simKernelGeneration = 0;
+
+/* Private functions */
+static bool SimKernelBefore(uint32_t a, uint32_t b)
+{
+    const SimKernelSlot* x = &g_simKernel.slots[a];
+    const SimKernelSlot* y = &g_simKernel.slots[b];
+    return x->timeUs < y->timeUs || (x->timeUs == y->timeUs && x->seq < y->seq);
+}
+
+static void SimKernelPlace(uint32_t index, uint32_t slot)
+{
+    g_simKernel.heap[index] = slot;
+    g_simKernel.slots[slot].heapIndex = index;
+}
+
+static void SimKernelSiftUp(uint32_t index)
+{
+    uint32_t slot = g_simKernel.heap[index];
+    while (index > 0) {
+        uint32_t parent = (index - 1) / 2;
+        if (!SimKernelBefore(slot, g_simKernel.heap[parent]))
+            break;
+        SimKernelPlace(index, g_simKernel.heap[parent]);
+        index = parent;
+    }
+    SimKernelPlace(index, slot);
+}
+
+static void SimKernelSiftDown(uint32_t index)
+{
+    uint32_t slot = g_simKernel.heap[index];
+    for (;;) {
+        uint32_t child = 2 * index + 1;
+        if (child >= g_simKernel.count)
+            break;
+        if (child + 1 < g_simKernel.count &&
+            SimKernelBefore(g_simKernel.heap[child + 1], g_simKernel.heap[child])) {
+            child++;
+        }
+        if (!SimKernelBefore(g_simKernel.heap[child], slot))
+            break;
+        SimKernelPlace(index, g_simKernel.heap[child]);
+        index = child;
+    }
+    SimKernelPlace(index, slot);
+}
+
+/* Take a slot out of the heap and put it on the free list */
+static void SimKernelRemove(uint32_t slot)
+{
+    SimKernelSlot* event = &g_simKernel.slots[slot];
+    uint32_t index = event->heapIndex;
+    uint32_t last = g_simKernel.heap[--g_simKernel.count];
+
+    if (index < g_simKernel.count) {
+        SimKernelPlace(index, last);
+        SimKernelSiftDown(index);
+        SimKernelSiftUp(g_simKernel.slots[last].heapIndex);
+    }
+
+    event->queued = false;
+    event->generation++;
+    event->nextFree = g_simKernel.freeHead;
+    g_simKernel.freeHead = slot;
+    g_simKernel.stats.pending = g_simKernel.count;
+}
+
+static bool SimKernelGrow(void)
+{
+    uint32_t capacity = g_simKernel.capacity ? g_simKernel.capacity * 2 : SIM_KERNEL_INITIAL_SLOTS;
+    SimKernelSlot* slots =
+        (SimKernelSlot*) realloc(g_simKernel.slots, capacity * sizeof(SimKernelSlot));
+    if (!slots)
+        return false;
+    g_simKernel.slots = slots;
+
+    uint32_t* heap = (uint32_t*) realloc(g_simKernel.heap, capacity * sizeof(uint32_t));
+    if (!heap)
+        return false;
+    g_simKernel.heap = heap;
+
+    if (!g_simKernel.capacity) {
+        g_simKernel.freeHead = SIM_KERNEL_NO_SLOT;
+    }
+    for (uint32_t i = capacity; i-- > g_simKernel.capacity;) {
+        memset(&slots[i], 0, sizeof(slots[i]));
+        slots[i].generation = g_simKernelGeneration;
+        slots[i].nextFree = g_simKernel.freeHead;
+        g_simKernel.freeHead = i;
+    }
+    g_simKernel.capacity = capacity;
+    return true;
+}
+
+/* Internal interface */
+SimEventId SimKernelPost(uint64_t timeUs, SimEventHandler handler, void* arg)
+{
+    if (!handler)
+        return 0;
+    if (!g_simKernel.capacity || g_simKernel.freeHead == SIM_KERNEL_NO_SLOT) {
+        if (!SimKernelGrow())
+            return 0;
+    }
+
+    uint32_t slot = g_simKernel.freeHead;
+    SimKernelSlot* event = &g_simKernel.slots[slot];
+    g_simKernel.freeHead = event->nextFree;
+
+    event->timeUs = timeUs;
+    event->seq = g_simKernel.nextSeq++;
+    event->handler = handler;
+    event->arg = arg;
+    event->queued = true;
+
+    g_simKernel.heap[g_simKernel.count] = slot;
+    SimKernelSiftUp(g_simKernel.count++);
+
+    g_simKernel.stats.posted++;
+    g_simKernel.stats.pending = g_simKernel.count;
+    if (g_simKernel.count > g_simKernel.stats.peakPending) {
+        g_simKernel.stats.peakPending = g_simKernel.count;
+    }
+
+    /* Generation in the high half keeps ids unique and non-zero */
+    return ((uint64_t) (event->generation + 1) << 32) | slot;
+}
+
+bool SimKernelCancel(SimEventId id)
+{
+    uint32_t slot = (uint32_t) id;
+    uint32_t generation = (uint32_t) (id >> 32) - 1;
+    if (!id || slot >= g_simKernel.capacity)
+        return false;
+
+    SimKernelSlot* event = &g_simKernel.slots[slot];
+    if (!event->queued || event->generation != generation)
+        return false;
+
+    SimKernelRemove(slot);
+    g_simKernel.stats.cancelled++;
+    return true;
+}
+
+/*
+ * Simulated time stays in sim_timer.c: the clock moves to each event's time, letting the
+ * other simulators catch up through the timer's advance hooks, before the handler runs.
+ * With no task ready such a jump is the scheduler's tickless idle.
+ */
+int SimKernelRunUntil(uint64_t untilUs, bool runTasks)
+{
+    for (;;) {
+        /* Everything due now fires first, so tasks released together compete for the CPU */
+        bool due = g_simKernel.count &&
+                   g_simKernel.slots[g_simKernel.heap[0]].timeUs <= SIM_TIMER_GetCurrentTime();
+        if (runTasks && !due) {
+            SimSchedulerRunReady(untilUs);
+        }
+        if (!g_simKernel.count)
+            break;
+
+        uint32_t slot = g_simKernel.heap[0];
+        SimKernelSlot* event = &g_simKernel.slots[slot];
+        if (event->timeUs > untilUs)
+            break;
+
+        uint64_t timeUs = event->timeUs;
+        SimEventHandler handler = event->handler;
+        void* arg = event->arg;
+        SimKernelRemove(slot);
+
+        /* Handlers posted for a time that has passed fire now */
+        if (timeUs > SIM_TIMER_GetCurrentTime()) {
+            if (runTasks) {
+                SimSchedulerIdle(SIM_TIMER_GetCurrentTime(), timeUs);
+            }
+            SimTimerAdvanceTo(timeUs);
+        }
+        g_simKernel.stats.dispatched++;
+        g_simKernel.handlerDepth++;
+        handler(arg, SIM_TIMER_GetCurrentTime());
+        g_simKernel.handlerDepth--;
+    }
+
+    if (untilUs > SIM_TIMER_GetCurrentTime()) {
+        if (runTasks) {
+            SimSchedulerIdle(SIM_TIMER_GetCurrentTime(), untilUs);
+        }
+        SimTimerAdvanceTo(untilUs);
+    }
+    if (runTasks) {
+        SimSchedulerRunReady(untilUs);
+    }
+    return 0;
+}
+
+bool SimKernelInHandler(void)
+{
+    return g_simKernel.handlerDepth != 0;
+}
+
+void SimKernelReset(void)
+{
+    for (uint32_t i = 0; i < g_simKernel.capacity; i++) {
+        if (g_simKernel.slots[i].generation >= g_simKernelGeneration) {
+            g_simKernelGeneration = g_simKernel.slots[i].generation + 1;
+        }
+    }
+    free(g_simKernel.slots);
+    free(g_simKernel.heap);
+    memset(&g_simKernel, 0, sizeof(g_simKernel));
+    g_simKernel.freeHead = SIM_KERNEL_NO_SLOT;
+}
+
+/* Simulator control functions */
+int SIM_Run(uint64_t untilUs)
+{
+    if (!SimTimerInitialized())
+        return -1;
+
+    SimSchedulerBeginRun();
+    return SimKernelRunUntil(untilUs, true);
+}
+
+uint64_t SIM_KERNEL_GetNextEventTime(void)
+{
+    if (!g_simKernel.count)
+        return UINT64_MAX;
+
+    return g_simKernel.slots[g_simKernel.heap[0]].timeUs;
+}
+
+int SIM_KERNEL_GetStats(SimKernelStats* stats)
+{
+    if (!stats)
+        return -1;
+
+    *stats = g_simKernel.stats;
+    return 0;
+}
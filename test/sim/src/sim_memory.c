@@ -1,6 +1,11 @@
 /**
  * @file sim_memory.c
  * @brief Memory Simulation Implementation
+ *
+ * HAL_MEMORY_CopyBufferAsync hands copies of cpuThreshold bytes or more to a
+ * MEM_TO_MEM channel it reserves on first use, queued with a sequence number as
+ * tag. Copies finish in order, so a token is done once the last reaped tag has
+ * reached its sequence number.
  */
 
 #include "sim_memory.h"
@@ -12,6 +17,9 @@
 #define MAX_POOLS 16
 #define MAX_BUFFERS 1024
 
+/* Copy tokens: odd = DMA copy (sequence << 1 | 1), SIM_MEMORY_COPY_DONE = finished CPU copy */
+#define SIM_MEMORY_COPY_DONE ((MemoryCopyToken) (uintptr_t) 2)
+
 /* Pool configuration */
 typedef struct {
     PoolName name;
@@ -20,6 +28,7 @@ typedef struct {
     size_t usedSize;
     uint32_t allocCount;
     bool configured;
+    bool cached;
 } SimMemoryPool;
 
 /* Buffer tracking */
@@ -37,6 +46,13 @@ static struct {
     SimMemoryPool pools[MAX_POOLS];
     SimMemoryBuffer buffers[MAX_BUFFERS];
     uint32_t nextHandle;
+    SimMemoryCacheStats cacheStats;
+    /* Asynchronous copies */
+    SimMemoryCopyConfig copyConfig;
+    DmaChannel copyChannel;
+    uint32_t copySeq;  /* Sequence number of the last queued DMA copy */
+    uint32_t copyDone; /* Sequence number of the last finished DMA copy */
+    SimMemoryCopyStats copyStats;
 } g_simMemory = {0};
 
 /* Private functions */
@@ -50,6 +66,102 @@ static SimMemoryPool* SimMemoryFindPool(PoolName poolName)
     return NULL;
 }
 
+static SimMemoryBuffer* SimMemoryFindBuffer(MemoryBuffer buffer)
+{
+    for (int i = 0; i < MAX_BUFFERS; i++) {
+        if (g_simMemory.buffers[i].allocated && g_simMemory.buffers[i].handle == buffer) {
+            return &g_simMemory.buffers[i];
+        }
+    }
+    return NULL;
+}
+
+static bool SimMemoryIsCached(const SimMemoryBuffer* buf)
+{
+    const SimMemoryPool* pool = SimMemoryFindPool(buf->poolName);
+    return pool && pool->cached;
+}
+
+/* Bytes covered by a cache operation on [offset, offset + size), whole lines, clipped */
+static size_t SimMemoryCacheRange(const SimMemoryBuffer* buf, size_t offset, size_t size)
+{
+    if (offset >= buf->size)
+        return 0;
+    if (size == 0 || size > buf->size - offset)
+        size = buf->size - offset;
+
+    size_t lineMask = (size_t) SIM_MEMORY_CACHE_LINE - 1;
+    size_t start = offset & ~lineMask;
+    size_t end = (offset + size + lineMask) & ~lineMask;
+    if (end > buf->size)
+        end = buf->size;
+
+    return end - start;
+}
+
+static void SimMemoryReleaseCopyChannel(void)
+{
+    if (g_simMemory.copyChannel) {
+        HAL_DMA_ReleaseChannel(g_simMemory.copyChannel);
+        g_simMemory.copyChannel = NULL;
+    }
+    /* Whatever was in flight is gone with the channel */
+    g_simMemory.copyDone = g_simMemory.copySeq;
+}
+
+/* Reap finished DMA copies */
+static void SimMemoryReapCopies(void)
+{
+    uint32_t tag;
+    while (g_simMemory.copyChannel &&
+           HAL_DMA_PopCompletion(g_simMemory.copyChannel, &tag) == HAL_OK) {
+        g_simMemory.copyDone = tag;
+    }
+}
+
+static bool SimMemoryCopyFinished(MemoryCopyToken token)
+{
+    uint32_t seq = (uint32_t) ((uintptr_t) token >> 1);
+
+    if (token == SIM_MEMORY_COPY_DONE)
+        return true;
+
+    SimMemoryReapCopies();
+    return (int32_t) (g_simMemory.copyDone - seq) >= 0;
+}
+
+/* Queue a copy on the copy channel, requesting the channel if needed */
+static int SimMemoryQueueDmaCopy(void* dst, const void* src, size_t size)
+{
+    uint32_t seq = g_simMemory.copySeq + 1;
+
+    for (int attempt = 0; attempt < 2; attempt++) {
+        if (!g_simMemory.copyChannel &&
+            HAL_DMA_RequestChannel(g_simMemory.copyConfig.dmaId, DMA_DIR_MEM_TO_MEM,
+                                   g_simMemory.copyConfig.priority,
+                                   &g_simMemory.copyChannel) != HAL_OK) {
+            g_simMemory.copyChannel = NULL;
+            return HAL_ERROR;
+        }
+
+        int ret = HAL_DMA_QueueTransfer(g_simMemory.copyChannel, src, dst, size, seq);
+        if (ret == HAL_OK)
+            break;
+        if (ret == HAL_BUSY)
+            return HAL_BUSY;
+
+        /* Stale handle (the DMA simulator was reset), request a new channel */
+        g_simMemory.copyChannel = NULL;
+        g_simMemory.copyDone = g_simMemory.copySeq;
+        if (attempt == 1)
+            return HAL_ERROR;
+    }
+
+    g_simMemory.copySeq = seq;
+    HAL_DMA_SubmitQueued(g_simMemory.copyChannel);
+    return HAL_OK;
+}
+
 static SimMemoryBuffer* SimMemoryFindFreeBuffer(void)
 {
     for (int i = 0; i < MAX_BUFFERS; i++) {
@@ -63,9 +175,11 @@ static SimMemoryBuffer* SimMemoryFindFreeBuffer(void)
 /* Simulator control functions */
 int SIM_MEMORY_SimulatorInit(void)
 {
+    SimMemoryReleaseCopyChannel();
     memset(&g_simMemory, 0, sizeof(g_simMemory));
     g_simMemory.initialized = true;
     g_simMemory.nextHandle = 1;
+    g_simMemory.copyConfig.cpuThreshold = SIM_MEMORY_DEFAULT_COPY_THRESHOLD;
 
     printf("[SIM_MEMORY] Simulator initialized\n");
     return 0;
@@ -100,6 +214,47 @@ int SIM_MEMORY_ConfigurePool(PoolName poolName, void* baseAddr, size_t size)
     return -1;
 }
 
+int SIM_MEMORY_SetPoolCached(PoolName poolName, bool cached)
+{
+    SimMemoryPool* pool = SimMemoryFindPool(poolName);
+    if (!pool)
+        return -1;
+
+    pool->cached = cached;
+    return 0;
+}
+
+int SIM_MEMORY_GetCacheStats(SimMemoryCacheStats* stats)
+{
+    if (!stats)
+        return -1;
+
+    *stats = g_simMemory.cacheStats;
+    return 0;
+}
+
+int SIM_MEMORY_ConfigureCopy(const SimMemoryCopyConfig* config)
+{
+    if (!config)
+        return -1;
+
+    SimMemoryReleaseCopyChannel();
+    g_simMemory.copyConfig = *config;
+    if (g_simMemory.copyConfig.cpuThreshold == 0) {
+        g_simMemory.copyConfig.cpuThreshold = SIM_MEMORY_DEFAULT_COPY_THRESHOLD;
+    }
+    return 0;
+}
+
+int SIM_MEMORY_GetCopyStats(SimMemoryCopyStats* stats)
+{
+    if (!stats)
+        return -1;
+
+    *stats = g_simMemory.copyStats;
+    return 0;
+}
+
 int SIM_MEMORY_GetPoolStats(PoolName poolName, uint32_t* totalAllocs, size_t* currentUsage)
 {
     const SimMemoryPool* pool = SimMemoryFindPool(poolName);
@@ -227,7 +382,7 @@ int HAL_MEMORY_GetBufferInfo(MemoryBuffer buffer, MemoryBufferInfo* info)
             info->size = g_simMemory.buffers[i].size;
             info->virtAddr = g_simMemory.buffers[i].addr;
             info->physAddr = g_simMemory.buffers[i].addr;
-            info->isCached = false;
+            info->isCached = SimMemoryIsCached(&g_simMemory.buffers[i]);
 
             return HAL_OK;
         }
@@ -238,20 +393,24 @@ int HAL_MEMORY_GetBufferInfo(MemoryBuffer buffer, MemoryBufferInfo* info)
 
 int HAL_MEMORY_FlushBuffer(MemoryBuffer buffer, size_t offset, size_t size)
 {
-    /* Simulation: no actual cache operation */
-    (void) buffer;
-    (void) offset;
-    (void) size;
+    /* Simulation: no actual cache operation, only accounting */
+    const SimMemoryBuffer* buf = SimMemoryFindBuffer(buffer);
+    if (buf && SimMemoryIsCached(buf)) {
+        g_simMemory.cacheStats.flushOps++;
+        g_simMemory.cacheStats.flushBytes += SimMemoryCacheRange(buf, offset, size);
+    }
     printf("[SIM_MEMORY] Flush buffer %p (simulated)\n", buffer);
     return HAL_OK;
 }
 
 int HAL_MEMORY_InvalidateBuffer(MemoryBuffer buffer, size_t offset, size_t size)
 {
-    /* Simulation: no actual cache operation */
-    (void) buffer;
-    (void) offset;
-    (void) size;
+    /* Simulation: no actual cache operation, only accounting */
+    const SimMemoryBuffer* buf = SimMemoryFindBuffer(buffer);
+    if (buf && SimMemoryIsCached(buf)) {
+        g_simMemory.cacheStats.invalidateOps++;
+        g_simMemory.cacheStats.invalidateBytes += SimMemoryCacheRange(buf, offset, size);
+    }
     printf("[SIM_MEMORY] Invalidate buffer %p (simulated)\n", buffer);
     return HAL_OK;
 }
@@ -283,3 +442,63 @@ int HAL_MEMORY_CopyBuffer(MemoryBuffer dstBuffer, MemoryBuffer srcBuffer, size_t
     printf("[SIM_MEMORY] Copied %zu bytes between buffers\n", size);
     return HAL_OK;
 }
+
+int HAL_MEMORY_CopyBufferAsync(MemoryBuffer dstBuffer, MemoryBuffer srcBuffer, size_t size,
+                               MemoryCopyToken* token)
+{
+    if (!token)
+        return HAL_ERROR;
+
+    SimMemoryBuffer* dst = SimMemoryFindBuffer(dstBuffer);
+    SimMemoryBuffer* src = SimMemoryFindBuffer(srcBuffer);
+    if (!dst || !src || size > dst->size || size > src->size)
+        return HAL_ERROR;
+
+    if (size >= g_simMemory.copyConfig.cpuThreshold) {
+        /* The engine reads memory and writes it behind the cache */
+        if (SimMemoryIsCached(src)) {
+            HAL_MEMORY_FlushBuffer(srcBuffer, 0, size);
+        }
+        if (SimMemoryIsCached(dst)) {
+            HAL_MEMORY_InvalidateBuffer(dstBuffer, 0, size);
+        }
+
+        int ret = SimMemoryQueueDmaCopy(dst->addr, src->addr, size);
+        if (ret == HAL_OK) {
+            g_simMemory.copyStats.dmaCopies++;
+            g_simMemory.copyStats.dmaBytes += size;
+            *token = (MemoryCopyToken) (((uintptr_t) g_simMemory.copySeq << 1) | 1);
+            return HAL_OK;
+        }
+        if (ret == HAL_BUSY)
+            return HAL_BUSY;
+        /* No DMA available, the CPU does it */
+    }
+
+    memcpy(dst->addr, src->addr, size);
+    g_simMemory.copyStats.cpuCopies++;
+    g_simMemory.copyStats.cpuBytes += size;
+    *token = SIM_MEMORY_COPY_DONE;
+    return HAL_OK;
+}
+
+int HAL_MEMORY_PollCopy(MemoryCopyToken token)
+{
+    return SimMemoryCopyFinished(token) ? HAL_OK : HAL_BUSY;
+}
+
+int HAL_MEMORY_WaitCopy(MemoryCopyToken token, uint32_t timeoutMs)
+{
+    if (!token)
+        return HAL_ERROR;
+
+    if (SimMemoryCopyFinished(token))
+        return HAL_OK;
+
+    /* Copies finish in order: once the channel drains, this one is done too */
+    int ret = HAL_DMA_WaitComplete(g_simMemory.copyChannel, timeoutMs);
+    if (SimMemoryCopyFinished(token))
+        return HAL_OK;
+
+    return ret == HAL_OK || ret == HAL_TIMEOUT ? HAL_TIMEOUT : HAL_ERROR;
+}
@@ -0,0 +1,546 @@
+/**
+ * @file sim_periph.c
+ * @brief Virtual Peripheral Simulation Implementation
+ *
+ * Each peripheral is a device with a hardware FIFO. The device side moves
+ * bytesPerUs between its backend and the FIFO as simulated time passes; the DMA
+ * engine (sim_dma.c) only sees how much the FIFO can give or take right now.
+ * The device side is run lazily, whenever the FIFO is looked at.
+ *
+ * Data register addresses are slots of one static array, so telling a peripheral
+ * address from memory is a range check.
+ */
+
+#include "sim_periph.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "sim_internal.h"
+#include "sim_timer.h"
+
+#define SIM_PERIPH_NAME_LEN 32
+#define SIM_PERIPH_SCRATCH_BYTES 256
+#define SIM_PERIPH_NS_PER_US 1000ULL
+
+/* Peripheral state */
+struct SimPeriph {
+    bool registered;
+    char name[SIM_PERIPH_NAME_LEN];
+    SimPeriphConfig config;
+    /* Hardware FIFO, level = fifoTail - fifoHead */
+    uint8_t* fifo;
+    uint32_t depth;
+    uint64_t fifoHead;
+    uint64_t fifoTail;
+    /* BACKEND_FIFO stream, level = streamTail - streamHead */
+    uint8_t* stream;
+    size_t streamBytes;
+    uint64_t streamHead;
+    uint64_t streamTail;
+    /* BACKEND_FILE */
+    FILE* file;
+    uint8_t* map;
+    size_t fileSize;
+    size_t filePos;
+    /* Device side */
+    uint64_t clockNs;
+    uint64_t carry; /* Partial byte owed by the rate, in byte*ns/us units */
+    bool primed;    /* Sink received data; starvation is counted from here on */
+    SimPeriphStats stats;
+};
+
+/* Global state */
+static struct {
+    SimPeriph periphs[SIM_PERIPH_MAX];
+    uint32_t dataRegs[SIM_PERIPH_MAX]; /* Handed out as data register addresses */
+} g_simPeriph = {0};
+
+/* Private functions */
+static uint64_t SimPeriphNowNs(void)
+{
+    return SIM_TIMER_GetCurrentTime() * SIM_PERIPH_NS_PER_US;
+}
+
+static size_t SimPeriphMin(size_t a, size_t b)
+{
+    return a < b ? a : b;
+}
+
+static uint32_t SimPeriphLevel(const SimPeriph* p)
+{
+    return (uint32_t) (p->fifoTail - p->fifoHead);
+}
+
+static void SimPeriphRingPut(uint8_t* ring, size_t cap, uint64_t pos, const uint8_t* data,
+                             size_t size)
+{
+    size_t index = (size_t) (pos % cap);
+    size_t first = SimPeriphMin(size, cap - index);
+
+    memcpy(ring + index, data, first);
+    memcpy(ring, data + first, size - first);
+}
+
+static void SimPeriphRingGet(const uint8_t* ring, size_t cap, uint64_t pos, uint8_t* data,
+                             size_t size)
+{
+    size_t index = (size_t) (pos % cap);
+    size_t first = SimPeriphMin(size, cap - index);
+
+    memcpy(data, ring + index, first);
+    memcpy(data + first, ring, size - first);
+}
+
+static size_t SimPeriphFileRead(SimPeriph* p, uint8_t* data, size_t size)
+{
+    size_t done = 0;
+
+    while (done < size && p->fileSize > 0) {
+        if (p->filePos == p->fileSize) {
+            if (!p->config.loop)
+                break;
+            p->filePos = 0;
+        }
+
+        size_t n = SimPeriphMin(size - done, p->fileSize - p->filePos);
+        if (p->map) {
+            memcpy(data + done, p->map + p->filePos, n);
+        } else if (fseek(p->file, (long) p->filePos, SEEK_SET) != 0 ||
+                   fread(data + done, 1, n, p->file) != n) {
+            break;
+        }
+        p->filePos += n;
+        done += n;
+    }
+
+    return done;
+}
+
+/* Backend -> device (sources) */
+static size_t SimPeriphPull(SimPeriph* p, uint8_t* data, size_t size)
+{
+    switch (p->config.backend) {
+        case SIM_PERIPH_BACKEND_FIFO: {
+            size_t n = SimPeriphMin(size, (size_t) (p->streamTail - p->streamHead));
+            SimPeriphRingGet(p->stream, p->streamBytes, p->streamHead, data, n);
+            p->streamHead += n;
+            return n;
+        }
+        case SIM_PERIPH_BACKEND_FILE:
+            return SimPeriphFileRead(p, data, size);
+        case SIM_PERIPH_BACKEND_CALLBACK:
+            return SimPeriphMin(p->config.callback(data, size, p->config.userData), size);
+    }
+    return 0;
+}
+
+/* Device -> backend (sinks) */
+static size_t SimPeriphPush(SimPeriph* p, uint8_t* data, size_t size)
+{
+    switch (p->config.backend) {
+        case SIM_PERIPH_BACKEND_FIFO: {
+            size_t space = p->streamBytes - (size_t) (p->streamTail - p->streamHead);
+            size_t n = SimPeriphMin(size, space);
+            SimPeriphRingPut(p->stream, p->streamBytes, p->streamTail, data, n);
+            p->streamTail += n;
+            return n;
+        }
+        case SIM_PERIPH_BACKEND_FILE:
+            return fwrite(data, 1, size, p->file);
+        case SIM_PERIPH_BACKEND_CALLBACK:
+            return SimPeriphMin(p->config.callback(data, size, p->config.userData), size);
+    }
+    return 0;
+}
+
+/* Bytes the backend can still supply (sources) or accept (sinks) */
+static size_t SimPeriphBackendRoom(const SimPeriph* p)
+{
+    switch (p->config.backend) {
+        case SIM_PERIPH_BACKEND_FIFO: {
+            size_t level = (size_t) (p->streamTail - p->streamHead);
+            return p->config.role == SIM_PERIPH_SOURCE ? level : p->streamBytes - level;
+        }
+        case SIM_PERIPH_BACKEND_FILE:
+            if (p->config.role == SIM_PERIPH_SOURCE && !(p->config.loop && p->fileSize > 0)) {
+                return p->fileSize - p->filePos;
+            }
+            return SIZE_MAX;
+        case SIM_PERIPH_BACKEND_CALLBACK:
+            return SIZE_MAX;
+    }
+    return 0;
+}
+
+/* Samples the device could not store are lost; the backend moves past them */
+static uint64_t SimPeriphSkip(SimPeriph* p, uint64_t size)
+{
+    uint8_t scratch[SIM_PERIPH_SCRATCH_BYTES];
+    uint64_t skipped = 0;
+
+    switch (p->config.backend) {
+        case SIM_PERIPH_BACKEND_FIFO:
+            skipped = SimPeriphMin(size, (size_t) (p->streamTail - p->streamHead));
+            p->streamHead += skipped;
+            break;
+        case SIM_PERIPH_BACKEND_FILE:
+            if (p->config.loop && p->fileSize > 0) {
+                p->filePos = (size_t) ((p->filePos + size % p->fileSize) % p->fileSize);
+                skipped = size;
+            } else {
+                skipped = SimPeriphMin(size, p->fileSize - p->filePos);
+                p->filePos += skipped;
+            }
+            break;
+        case SIM_PERIPH_BACKEND_CALLBACK:
+            while (skipped < size) {
+                size_t n = SimPeriphPull(p, scratch, SimPeriphMin(size - skipped, sizeof(scratch)));
+                if (n == 0)
+                    break;
+                skipped += n;
+            }
+            break;
+    }
+
+    return skipped;
+}
+
+/* Device side of a source: backend -> FIFO */
+static size_t SimPeriphFill(SimPeriph* p, size_t size)
+{
+    uint8_t scratch[SIM_PERIPH_SCRATCH_BYTES];
+    size_t done = 0;
+
+    while (done < size) {
+        size_t n = SimPeriphPull(p, scratch, SimPeriphMin(size - done, sizeof(scratch)));
+        SimPeriphRingPut(p->fifo, p->depth, p->fifoTail, scratch, n);
+        p->fifoTail += n;
+        done += n;
+        if (n == 0)
+            break;
+    }
+
+    p->stats.deviceBytes += done;
+    if (SimPeriphLevel(p) > p->stats.maxFifoLevel) {
+        p->stats.maxFifoLevel = SimPeriphLevel(p);
+    }
+    return done;
+}
+
+/* Device side of a sink: FIFO -> backend */
+static size_t SimPeriphEmpty(SimPeriph* p, size_t size)
+{
+    uint8_t scratch[SIM_PERIPH_SCRATCH_BYTES];
+    size_t done = 0;
+
+    while (done < size) {
+        size_t n = SimPeriphMin(size - done, sizeof(scratch));
+        SimPeriphRingGet(p->fifo, p->depth, p->fifoHead, scratch, n);
+        size_t accepted = SimPeriphPush(p, scratch, n);
+        p->fifoHead += accepted;
+        done += accepted;
+        if (accepted < n)
+            break;
+    }
+
+    p->stats.deviceBytes += done;
+    return done;
+}
+
+/* Run the device side up to nowNs */
+static void SimPeriphAdvance(SimPeriph* p, uint64_t nowNs)
+{
+    if (nowNs <= p->clockNs) {
+        return;
+    }
+
+    uint64_t elapsedNs = nowNs - p->clockNs;
+    p->clockNs = nowNs;
+    if (p->config.bytesPerUs == 0) {
+        return;
+    }
+
+    uint64_t work = elapsedNs * p->config.bytesPerUs + p->carry;
+    uint64_t bytes = work / SIM_PERIPH_NS_PER_US;
+    p->carry = work % SIM_PERIPH_NS_PER_US;
+
+    if (p->config.role == SIM_PERIPH_SOURCE) {
+        uint64_t space = p->depth - SimPeriphLevel(p);
+        uint64_t n = bytes < space ? bytes : space;
+        size_t got = SimPeriphFill(p, (size_t) n);
+        if (got < n) {
+            p->stats.underrunBytes += bytes - got;
+        } else if (bytes > n) {
+            uint64_t lost = SimPeriphSkip(p, bytes - n);
+            p->stats.overrunBytes += lost;
+            p->stats.underrunBytes += bytes - n - lost;
+        }
+    } else {
+        uint32_t level = SimPeriphLevel(p);
+        uint64_t n = bytes < level ? bytes : level;
+        size_t put = SimPeriphEmpty(p, (size_t) n);
+        if (p->primed && put == level) {
+            p->stats.underrunBytes += bytes - level;
+        }
+    }
+}
+
+static SimPeriph* SimPeriphFromReg(void* dataReg)
+{
+    SimPeriph* p = SimPeriphFind(dataReg);
+    return p && p->registered ? p : NULL;
+}
+
+static int SimPeriphOpenFile(SimPeriph* p, const char* path)
+{
+    bool source = p->config.role == SIM_PERIPH_SOURCE;
+
+    p->file = fopen(path, source ? "rb" : "wb");
+    if (!p->file)
+        return -1;
+    if (!source)
+        return 0;
+
+    if (fseek(p->file, 0, SEEK_END) != 0)
+        return -1;
+    long size = ftell(p->file);
+    if (size < 0)
+        return -1;
+    p->fileSize = (size_t) size;
+
+    if (p->config.useMmap && p->fileSize > 0) {
+        void* map = mmap(NULL, p->fileSize, PROT_READ, MAP_PRIVATE, fileno(p->file), 0);
+        if (map == MAP_FAILED)
+            return -1;
+        p->map = (uint8_t*) map;
+    }
+
+    return 0;
+}
+
+static void SimPeriphRelease(SimPeriph* p)
+{
+    if (p->map) {
+        munmap(p->map, p->fileSize);
+    }
+    if (p->file) {
+        fclose(p->file);
+    }
+    free(p->fifo);
+    free(p->stream);
+    memset(p, 0, sizeof(*p));
+}
+
+/* Internal interface (sim_internal.h) */
+SimPeriph* SimPeriphFind(const void* addr)
+{
+    uintptr_t offset = (uintptr_t) addr - (uintptr_t) g_simPeriph.dataRegs;
+    if (offset >= sizeof(g_simPeriph.dataRegs))
+        return NULL;
+
+    return &g_simPeriph.periphs[offset / sizeof(g_simPeriph.dataRegs[0])];
+}
+
+bool SimPeriphHasRole(const SimPeriph* periph, bool source)
+{
+    return periph->registered && (periph->config.role == SIM_PERIPH_SOURCE) == source;
+}
+
+size_t SimPeriphFifoDepth(const SimPeriph* periph)
+{
+    return periph->depth;
+}
+
+size_t SimPeriphRoom(SimPeriph* periph, uint64_t nowNs)
+{
+    if (!periph->registered)
+        return 0;
+
+    SimPeriphAdvance(periph, nowNs);
+
+    /* An unpaced device keeps up with whatever the DMA does */
+    if (periph->config.role == SIM_PERIPH_SOURCE) {
+        if (periph->config.bytesPerUs == 0) {
+            SimPeriphFill(periph, periph->depth - SimPeriphLevel(periph));
+        }
+        return SimPeriphLevel(periph);
+    }
+
+    if (periph->config.bytesPerUs == 0) {
+        SimPeriphEmpty(periph, SimPeriphLevel(periph));
+    }
+    return periph->depth - SimPeriphLevel(periph);
+}
+
+uint64_t SimPeriphReadyNs(SimPeriph* periph, size_t size, uint64_t nowNs)
+{
+    if (!periph->registered)
+        return UINT64_MAX;
+
+    if (size > periph->depth) {
+        size = periph->depth;
+    }
+
+    size_t room = SimPeriphRoom(periph, nowNs);
+    if (room >= size)
+        return nowNs;
+
+    /* Only a paced device with backend data (or space) left changes the FIFO over time */
+    size_t need = size - room;
+    uint32_t rate = periph->config.bytesPerUs;
+    if (rate == 0 || SimPeriphBackendRoom(periph) < need)
+        return UINT64_MAX;
+
+    uint64_t ns = (need * SIM_PERIPH_NS_PER_US - periph->carry + rate - 1) / rate;
+    return (periph->clockNs > nowNs ? periph->clockNs : nowNs) + ns;
+}
+
+void SimPeriphRead(SimPeriph* periph, uint8_t* data, size_t size, uint64_t nowNs)
+{
+    SimPeriphAdvance(periph, nowNs);
+
+    SimPeriphRingGet(periph->fifo, periph->depth, periph->fifoHead, data, size);
+    periph->fifoHead += size;
+    periph->stats.dmaBytes += size;
+}
+
+void SimPeriphWrite(SimPeriph* periph, const uint8_t* data, size_t size, uint64_t nowNs)
+{
+    SimPeriphAdvance(periph, nowNs);
+
+    SimPeriphRingPut(periph->fifo, periph->depth, periph->fifoTail, data, size);
+    periph->fifoTail += size;
+    periph->stats.dmaBytes += size;
+    periph->primed = true;
+    if (SimPeriphLevel(periph) > periph->stats.maxFifoLevel) {
+        periph->stats.maxFifoLevel = SimPeriphLevel(periph);
+    }
+
+    if (periph->config.bytesPerUs == 0) {
+        SimPeriphEmpty(periph, SimPeriphLevel(periph));
+    }
+}
+
+/* Simulator control functions */
+int SIM_PERIPH_Reset(void)
+{
+    for (int i = 0; i < SIM_PERIPH_MAX; i++) {
+        SimPeriphRelease(&g_simPeriph.periphs[i]);
+    }
+    return 0;
+}
+
+int SIM_PERIPH_Register(const char* name, const SimPeriphConfig* config, void** dataReg)
+{
+    if (!name || !config || !dataReg)
+        return -1;
+    if (config->backend == SIM_PERIPH_BACKEND_FILE && !config->path)
+        return -1;
+    if (config->backend == SIM_PERIPH_BACKEND_CALLBACK && !config->callback)
+        return -1;
+
+    for (int i = 0; i < SIM_PERIPH_MAX; i++) {
+        SimPeriph* p = &g_simPeriph.periphs[i];
+        if (p->registered) {
+            continue;
+        }
+
+        strncpy(p->name, name, SIM_PERIPH_NAME_LEN - 1);
+        p->config = *config;
+        p->config.path = NULL; /* Not retained */
+        p->depth = config->fifoDepth ? config->fifoDepth : SIM_PERIPH_DEFAULT_FIFO_DEPTH;
+        p->fifo = (uint8_t*) malloc(p->depth);
+
+        int ret = p->fifo ? 0 : -1;
+        if (ret == 0 && config->backend == SIM_PERIPH_BACKEND_FIFO) {
+            p->streamBytes =
+                config->streamBytes ? config->streamBytes : SIM_PERIPH_DEFAULT_STREAM_BYTES;
+            p->stream = (uint8_t*) malloc(p->streamBytes);
+            ret = p->stream ? 0 : -1;
+        }
+        if (ret == 0 && config->backend == SIM_PERIPH_BACKEND_FILE) {
+            ret = SimPeriphOpenFile(p, config->path);
+        }
+        if (ret != 0) {
+            SimPeriphRelease(p);
+            return -1;
+        }
+
+        p->clockNs = SimPeriphNowNs();
+        p->registered = true;
+        *dataReg = &g_simPeriph.dataRegs[i];
+
+        printf("[SIM_PERIPH] Registered %s '%s' at %p\n",
+               config->role == SIM_PERIPH_SOURCE ? "source" : "sink", p->name, *dataReg);
+        return 0;
+    }
+
+    return -1;
+}
+
+int SIM_PERIPH_Unregister(void* dataReg)
+{
+    SimPeriph* p = SimPeriphFromReg(dataReg);
+    if (!p)
+        return -1;
+
+    printf("[SIM_PERIPH] Unregistered '%s'\n", p->name);
+    SimPeriphRelease(p);
+    return 0;
+}
+
+int SIM_PERIPH_Feed(void* dataReg, const void* data, size_t size)
+{
+    SimPeriph* p = SimPeriphFromReg(dataReg);
+    if (!p || (!data && size > 0))
+        return -1;
+    if (p->config.role != SIM_PERIPH_SOURCE || p->config.backend != SIM_PERIPH_BACKEND_FIFO)
+        return -1;
+
+    /* Samples that arrived so far were produced before this feed */
+    SimPeriphAdvance(p, SimPeriphNowNs());
+
+    if (size > p->streamBytes - (size_t) (p->streamTail - p->streamHead))
+        return -1;
+
+    SimPeriphRingPut(p->stream, p->streamBytes, p->streamTail, (const uint8_t*) data, size);
+    p->streamTail += size;
+
+    SimDmaPoll();
+    return 0;
+}
+
+int SIM_PERIPH_Drain(void* dataReg, void* data, size_t size, size_t* received)
+{
+    SimPeriph* p = SimPeriphFromReg(dataReg);
+    if (!p || !received || (!data && size > 0))
+        return -1;
+    if (p->config.role != SIM_PERIPH_SINK || p->config.backend != SIM_PERIPH_BACKEND_FIFO)
+        return -1;
+
+    SimPeriphAdvance(p, SimPeriphNowNs());
+
+    size_t n = SimPeriphMin(size, (size_t) (p->streamTail - p->streamHead));
+    SimPeriphRingGet(p->stream, p->streamBytes, p->streamHead, (uint8_t*) data, n);
+    p->streamHead += n;
+    *received = n;
+
+    SimDmaPoll();
+    return 0;
+}
+
+int SIM_PERIPH_GetStats(void* dataReg, SimPeriphStats* stats)
+{
+    SimPeriph* p = SimPeriphFromReg(dataReg);
+    if (!p || !stats)
+        return -1;
+
+    SimPeriphAdvance(p, SimPeriphNowNs());
+
+    *stats = p->stats;
+    stats->fifoLevel = SimPeriphLevel(p);
+    return 0;
+}
@@ -0,0 +1,393 @@
+/**
+ * @file sim_queue.c
+ * @brief Message Queue Simulation Implementation
+ *
+ * Lock-free SPSC and MPSC rings; blocking calls wait through the scheduler's wait lists.
+ */
+
+#include "sim_queue.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sim_internal.h"
+#include "sim_timer.h"
+
+/* Handle layout: [generation:16][index:8], resolved like task handles */
+#define QUEUE_HANDLE_INDEX_BITS 8
+#define QUEUE_HANDLE_INDEX_MASK ((1u << QUEUE_HANDLE_INDEX_BITS) - 1)
+#define QUEUE_HANDLE_GEN_MASK 0xFFFFu
+
+#define SIM_QUEUE_CACHE_LINE 64
+#define SIM_QUEUE_MAX_CAPACITY (1u << 24)
+
+/*
+ * Power-of-two ring of fixed-size cells indexed by two free-running positions. Each
+ * position sits on its own cache line next to what only its side writes, so a sender
+ * and a receiver on different cores do not bounce a line on every message.
+ */
+typedef struct {
+    /* Sender side */
+    uint64_t tail __attribute__((aligned(SIM_QUEUE_CACHE_LINE))); /* Next position to fill */
+    uint64_t headCache; /* SPSC: head as the sender last saw it */
+
+    /* Receiver side */
+    uint64_t head __attribute__((aligned(SIM_QUEUE_CACHE_LINE))); /* Next position to take */
+    uint64_t tailCache; /* SPSC: tail as the receiver last saw it */
+
+    /* Only written when someone has to wait */
+    SimWaitList senders __attribute__((aligned(SIM_QUEUE_CACHE_LINE)));
+    SimWaitList receivers;
+    uint64_t sendWaits; /* Atomic */
+    uint64_t recvWaits; /* Atomic */
+    uint64_t timeouts;  /* Atomic */
+
+    /* Fixed while the queue exists */
+    uint8_t* cells __attribute__((aligned(SIM_QUEUE_CACHE_LINE)));
+    uint32_t cellBytes; /* Stride; MPSC cells start with their sequence number */
+    uint32_t mask;
+    uint32_t itemSize;
+    QueueMode mode;
+    bool allocated;
+    uint16_t generation;
+} SimQueue;
+
+static struct {
+    pthread_mutex_t lock; /* Create and delete */
+    uint16_t generation;  /* Survives SIM_QUEUE_Reset so old handles stay invalid */
+    SimQueue queues[SIM_QUEUE_MAX_QUEUES];
+} g_simQueue = {.lock = PTHREAD_MUTEX_INITIALIZER};
+
+/* Private functions */
+static SimQueue* SimQueueFind(QueueHandle handle)
+{
+    uintptr_t raw = (uintptr_t) handle;
+    uint32_t index = (uint32_t) (raw & QUEUE_HANDLE_INDEX_MASK);
+    uint16_t generation = (uint16_t) ((raw >> QUEUE_HANDLE_INDEX_BITS) & QUEUE_HANDLE_GEN_MASK);
+
+    if (index >= SIM_QUEUE_MAX_QUEUES)
+        return NULL;
+
+    SimQueue* queue = &g_simQueue.queues[index];
+    if (!__atomic_load_n(&queue->allocated, __ATOMIC_ACQUIRE) || queue->generation != generation)
+        return NULL;
+
+    return queue;
+}
+
+static uint8_t* SimQueueCell(const SimQueue* queue, uint64_t pos)
+{
+    return queue->cells + (size_t) (pos & queue->mask) * queue->cellBytes;
+}
+
+/*
+ * Each side reloads the other side's position only when the ring looks full (or empty),
+ * so in the steady state a batch of messages costs one shared-line transfer
+ */
+static bool SimQueuePushSpsc(SimQueue* queue, const void* item)
+{
+    uint64_t tail = __atomic_load_n(&queue->tail, __ATOMIC_RELAXED);
+    if (tail - queue->headCache > queue->mask) {
+        queue->headCache = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+        if (tail - queue->headCache > queue->mask)
+            return false;
+    }
+
+    memcpy(SimQueueCell(queue, tail), item, queue->itemSize);
+    __atomic_store_n(&queue->tail, tail + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+static bool SimQueuePopSpsc(SimQueue* queue, void* item)
+{
+    uint64_t head = __atomic_load_n(&queue->head, __ATOMIC_RELAXED);
+    if (head == queue->tailCache) {
+        queue->tailCache = __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);
+        if (head == queue->tailCache)
+            return false;
+    }
+
+    memcpy(item, SimQueueCell(queue, head), queue->itemSize);
+    __atomic_store_n(&queue->head, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+/*
+ * Vyukov's bounded queue: a cell's sequence number says whose turn it is. A sender that
+ * claimed position pos stores pos + 1 when its copy is in; the receiver hands the cell to
+ * the next lap with pos + capacity.
+ */
+static bool SimQueuePushMpsc(SimQueue* queue, const void* item)
+{
+    uint64_t pos = __atomic_load_n(&queue->tail, __ATOMIC_RELAXED);
+    uint8_t* cell;
+
+    for (;;) {
+        cell = SimQueueCell(queue, pos);
+        uint64_t seq = __atomic_load_n((uint64_t*) cell, __ATOMIC_ACQUIRE);
+        int64_t lap = (int64_t) (seq - pos);
+        if (lap == 0) {
+            /* Free in this lap: claim it (a failed CAS reloads pos) */
+            if (__atomic_compare_exchange_n(&queue->tail, &pos, pos + 1, true, __ATOMIC_RELAXED,
+                                            __ATOMIC_RELAXED))
+                break;
+        } else if (lap < 0) {
+            /* Still holds the message of the previous lap */
+            return false;
+        } else {
+            pos = __atomic_load_n(&queue->tail, __ATOMIC_RELAXED);
+        }
+    }
+
+    memcpy(cell + sizeof(uint64_t), item, queue->itemSize);
+    __atomic_store_n((uint64_t*) cell, pos + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+static bool SimQueuePopMpsc(SimQueue* queue, void* item)
+{
+    uint64_t head = __atomic_load_n(&queue->head, __ATOMIC_RELAXED);
+    uint8_t* cell = SimQueueCell(queue, head);
+
+    /* Empty, or the sender that claimed it is still copying */
+    if (__atomic_load_n((uint64_t*) cell, __ATOMIC_ACQUIRE) != head + 1)
+        return false;
+
+    /* head first, so tail - head never exceeds the capacity */
+    memcpy(item, cell + sizeof(uint64_t), queue->itemSize);
+    __atomic_store_n(&queue->head, head + 1, __ATOMIC_RELEASE);
+    __atomic_store_n((uint64_t*) cell, head + queue->mask + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+/* Checking for waiters is a few loads, so a queue nobody waits on never enters the scheduler */
+static bool SimQueuePush(SimQueue* queue, const void* item)
+{
+    bool pushed = queue->mode == QUEUE_MODE_MPSC ? SimQueuePushMpsc(queue, item)
+                                                 : SimQueuePushSpsc(queue, item);
+    if (pushed) {
+        SimSchedulerWakeOne(&queue->receivers);
+    }
+    return pushed;
+}
+
+static bool SimQueuePop(SimQueue* queue, void* item)
+{
+    bool popped = queue->mode == QUEUE_MODE_MPSC ? SimQueuePopMpsc(queue, item)
+                                                 : SimQueuePopSpsc(queue, item);
+    if (popped) {
+        SimSchedulerWakeOne(&queue->senders);
+    }
+    return popped;
+}
+
+/*
+ * Wait conditions, read without owning either side. The wakeup path is only serialized
+ * against the scheduler's workers, so other host threads stick to the Try calls.
+ */
+static bool SimQueueHasRoom(void* arg)
+{
+    SimQueue* queue = (SimQueue*) arg;
+    uint64_t head = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+    return __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE) - head <= queue->mask;
+}
+
+static bool SimQueueHasItem(void* arg)
+{
+    SimQueue* queue = (SimQueue*) arg;
+    uint64_t head = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+    if (queue->mode == QUEUE_MODE_MPSC)
+        return __atomic_load_n((uint64_t*) SimQueueCell(queue, head), __ATOMIC_ACQUIRE) == head + 1;
+    return __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE) != head;
+}
+
+static uint64_t SimQueueDeadline(uint32_t timeoutMs)
+{
+    return timeoutMs ? SIM_TIMER_GetCurrentTime() + (uint64_t) timeoutMs * 1000 : UINT64_MAX;
+}
+
+static int SimQueueWaitFailed(SimQueue* queue, int ret)
+{
+    if (ret == HAL_TIMEOUT) {
+        __atomic_fetch_add(&queue->timeouts, 1, __ATOMIC_RELAXED);
+    }
+    return ret;
+}
+
+static void SimQueueFree(SimQueue* queue)
+{
+    free(queue->cells);
+    memset(queue, 0, sizeof(*queue));
+}
+
+/* Simulator control functions */
+int SIM_QUEUE_GetStats(QueueHandle handle, SimQueueStats* stats)
+{
+    SimQueue* queue = SimQueueFind(handle);
+    if (!queue || !stats)
+        return -1;
+
+    stats->capacity = queue->mask + 1;
+    stats->received = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+    stats->sent = __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);
+    stats->sendWaits = __atomic_load_n(&queue->sendWaits, __ATOMIC_RELAXED);
+    stats->recvWaits = __atomic_load_n(&queue->recvWaits, __ATOMIC_RELAXED);
+    stats->timeouts = __atomic_load_n(&queue->timeouts, __ATOMIC_RELAXED);
+    return 0;
+}
+
+int SIM_QUEUE_Reset(void)
+{
+    pthread_mutex_lock(&g_simQueue.lock);
+    for (int i = 0; i < SIM_QUEUE_MAX_QUEUES; i++) {
+        if (g_simQueue.queues[i].allocated) {
+            SimQueueFree(&g_simQueue.queues[i]);
+        }
+    }
+    pthread_mutex_unlock(&g_simQueue.lock);
+    return 0;
+}
+
+/* HAL interface implementation */
+int HAL_QUEUE_Create(uint32_t itemSize, uint32_t capacity, QueueMode mode, QueueHandle* handle)
+{
+    if (!handle || itemSize == 0 || capacity == 0 || capacity > SIM_QUEUE_MAX_CAPACITY ||
+        (mode != QUEUE_MODE_SPSC && mode != QUEUE_MODE_MPSC))
+        return HAL_ERROR;
+
+    uint32_t slots = 1;
+    while (slots < capacity) {
+        slots <<= 1;
+    }
+    uint32_t cellBytes = itemSize;
+    if (mode == QUEUE_MODE_MPSC) {
+        cellBytes = (uint32_t) sizeof(uint64_t) + ((itemSize + 7u) & ~7u);
+    }
+
+    void* memory = NULL;
+    if (posix_memalign(&memory, SIM_QUEUE_CACHE_LINE, (size_t) slots * cellBytes) != 0)
+        return HAL_ERROR;
+    uint8_t* cells = (uint8_t*) memory;
+    if (mode == QUEUE_MODE_MPSC) {
+        for (uint32_t i = 0; i < slots; i++) {
+            *(uint64_t*) (cells + (size_t) i * cellBytes) = i;
+        }
+    }
+
+    pthread_mutex_lock(&g_simQueue.lock);
+    for (int i = 0; i < SIM_QUEUE_MAX_QUEUES; i++) {
+        SimQueue* queue = &g_simQueue.queues[i];
+        if (queue->allocated) {
+            continue;
+        }
+
+        memset(queue, 0, sizeof(*queue));
+        if (++g_simQueue.generation == 0) {
+            g_simQueue.generation = 1;
+        }
+        queue->generation = g_simQueue.generation;
+        queue->cells = cells;
+        queue->cellBytes = cellBytes;
+        queue->mask = slots - 1;
+        queue->itemSize = itemSize;
+        queue->mode = mode;
+        __atomic_store_n(&queue->allocated, true, __ATOMIC_RELEASE);
+        pthread_mutex_unlock(&g_simQueue.lock);
+
+        *handle = (QueueHandle) (((uintptr_t) queue->generation << QUEUE_HANDLE_INDEX_BITS) |
+                                 (uintptr_t) i);
+
+        printf("[SIM_QUEUE] Created %s queue %p (%u x %u bytes)\n",
+               mode == QUEUE_MODE_MPSC ? "MPSC" : "SPSC", *handle, slots, itemSize);
+        return HAL_OK;
+    }
+    pthread_mutex_unlock(&g_simQueue.lock);
+
+    free(cells);
+    printf("[SIM_QUEUE] ERROR: No free queue slot\n");
+    return HAL_ERROR;
+}
+
+int HAL_QUEUE_Delete(QueueHandle handle)
+{
+    pthread_mutex_lock(&g_simQueue.lock);
+    SimQueue* queue = SimQueueFind(handle);
+    if (!queue || SimSchedulerCountWaiters(&queue->senders) ||
+        SimSchedulerCountWaiters(&queue->receivers)) {
+        pthread_mutex_unlock(&g_simQueue.lock);
+        return queue ? HAL_BUSY : HAL_ERROR;
+    }
+
+    SimQueueFree(queue);
+    pthread_mutex_unlock(&g_simQueue.lock);
+
+    printf("[SIM_QUEUE] Deleted queue %p\n", handle);
+    return HAL_OK;
+}
+
+int HAL_QUEUE_Send(QueueHandle handle, const void* item, uint32_t timeoutMs)
+{
+    SimQueue* queue = SimQueueFind(handle);
+    if (!queue || !item)
+        return HAL_ERROR;
+    if (SimQueuePush(queue, item))
+        return HAL_OK;
+
+    __atomic_fetch_add(&queue->sendWaits, 1, __ATOMIC_RELAXED);
+    uint64_t deadlineUs = SimQueueDeadline(timeoutMs);
+    do {
+        int ret = SimSchedulerWait(&queue->senders, SimQueueHasRoom, queue, deadlineUs);
+        if (ret != HAL_OK)
+            return SimQueueWaitFailed(queue, ret);
+    } while (!SimQueuePush(queue, item));
+    return HAL_OK;
+}
+
+int HAL_QUEUE_Receive(QueueHandle handle, void* item, uint32_t timeoutMs)
+{
+    SimQueue* queue = SimQueueFind(handle);
+    if (!queue || !item)
+        return HAL_ERROR;
+    if (SimQueuePop(queue, item))
+        return HAL_OK;
+
+    __atomic_fetch_add(&queue->recvWaits, 1, __ATOMIC_RELAXED);
+    uint64_t deadlineUs = SimQueueDeadline(timeoutMs);
+    do {
+        int ret = SimSchedulerWait(&queue->receivers, SimQueueHasItem, queue, deadlineUs);
+        if (ret != HAL_OK)
+            return SimQueueWaitFailed(queue, ret);
+    } while (!SimQueuePop(queue, item));
+    return HAL_OK;
+}
+
+int HAL_QUEUE_TrySend(QueueHandle handle, const void* item)
+{
+    SimQueue* queue = SimQueueFind(handle);
+    if (!queue || !item)
+        return HAL_ERROR;
+
+    return SimQueuePush(queue, item) ? HAL_OK : HAL_BUSY;
+}
+
+int HAL_QUEUE_TryReceive(QueueHandle handle, void* item)
+{
+    SimQueue* queue = SimQueueFind(handle);
+    if (!queue || !item)
+        return HAL_ERROR;
+
+    return SimQueuePop(queue, item) ? HAL_OK : HAL_BUSY;
+}
+
+uint32_t HAL_QUEUE_GetCount(QueueHandle handle)
+{
+    SimQueue* queue = SimQueueFind(handle);
+    if (!queue)
+        return 0;
+
+    uint64_t head = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+    uint64_t tail = __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);
+    return tail > head ? (uint32_t) (tail - head) : 0;
+}
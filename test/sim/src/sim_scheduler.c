@@ -1,35 +1,2415 @@
 /**
  * @file sim_scheduler.c
- * @brief Scheduler Simulation Implementation (Simplified)
+ * @brief Scheduler Simulation Implementation
+ *
+ * HAL_SCHEDULER_Start runs a cooperative dispatcher on the calling thread until
+ * no task is ready or a task calls HAL_SCHEDULER_Stop.
  */
 
+#include "sim_scheduler.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "sim_internal.h"
+#include "sim_kernel.h"
+#include "sim_timer.h"
+
+#if defined(__x86_64__)
+#define SIM_SCHEDULER_STACK_SWITCH 1
+#else
+#include <ucontext.h>
+#endif
+
+#define MAX_TASKS (SIM_TASK_SET_WORDS * 64) /* Task sets have one bit per slot */
+#define MAX_SCHEDULES 8
+#define SIM_SCHEDULER_PRIORITY_LEVELS (TASK_PRIORITY_REALTIME + 1)
+#define SIM_SCHEDULER_NO_TASK (-1)
+#define SIM_SCHEDULER_NO_CORE (-1)
+
+/*
+ * Task handle layout: [generation:16][index:9]
+ * Resolving a handle is a direct table lookup; the generation rejects stale handles
+ * and keeps every handle non-NULL.
+ */
+#define TASK_HANDLE_INDEX_BITS 9
+#define TASK_HANDLE_INDEX_MASK ((1u << TASK_HANDLE_INDEX_BITS) - 1)
+#define TASK_HANDLE_GEN_MASK 0xFFFFu
+
+#ifdef SIM_SCHEDULER_STACK_SWITCH
+/* Saved stack pointer; everything else the task needs is on its stack */
+typedef struct {
+    void* sp;
+} SimContext;
+
+/* Push the callee-saved registers and FPU control words, swap stacks, pop the other side's */
+void SimSchedulerSwapStack(void** saveSp, void* loadSp) __attribute__((visibility("hidden")));
+__asm__(".text\n"
+        ".p2align 4\n"
+        ".globl SimSchedulerSwapStack\n"
+        ".type SimSchedulerSwapStack, @function\n"
+        "SimSchedulerSwapStack:\n"
+        "    pushq %rbp\n"
+        "    pushq %rbx\n"
+        "    pushq %r12\n"
+        "    pushq %r13\n"
+        "    pushq %r14\n"
+        "    pushq %r15\n"
+        "    subq $8, %rsp\n"
+        "    stmxcsr (%rsp)\n"
+        "    fnstcw 4(%rsp)\n"
+        "    movq %rsp, (%rdi)\n"
+        "    movq %rsi, %rsp\n"
+        "    ldmxcsr (%rsp)\n"
+        "    fldcw 4(%rsp)\n"
+        "    addq $8, %rsp\n"
+        "    popq %r15\n"
+        "    popq %r14\n"
+        "    popq %r13\n"
+        "    popq %r12\n"
+        "    popq %rbx\n"
+        "    popq %rbp\n"
+        "    ret\n"
+        ".size SimSchedulerSwapStack, .-SimSchedulerSwapStack\n");
+#else
+typedef ucontext_t SimContext;
+#endif
+
+/* Coroutine stack mapping, guard page at the low end */
+typedef struct SimStack {
+    uint8_t* base;
+    size_t bytes; /* Whole mapping, guard page included */
+    struct SimStack* next;
+} SimStack;
+
+typedef struct {
+    TaskHandle handle;
+    TaskFunction func;
+    void* args;
+    TaskPriority priority; /* Level it is queued at, raised while it holds a mutex waited for */
+    TaskPriority basePriority; /* Level it was created with */
+    TaskState state;
+    bool allocated;
+    uint16_t generation;
+    bool yielded;   /* Running task asked to run again */
+    bool deleted;   /* Running task was deleted, free its slot once it returns */
+    bool onStack;   /* Task function is being called (atomic) */
+    int prev;       /* Ready list links (task indices) */
+    int next;
+    SimTaskSet predecessors; /* Producers this task waits for */
+    SimTaskSet successors;   /* Consumers waiting for this task (atomic words) */
+    uint32_t pending;        /* Producers not completed in the current frame */
+    SimStack* stack;         /* Stackful task, NULL when it runs to completion */
+    SimContext context;      /* Where a stackful task continues */
+    bool started;            /* Stackful task entered its function in this run */
+    bool finished;           /* Stackful task returned from its function */
+    TaskStats stats;
+    uint64_t readyHostNs;    /* Host time it became ready, 0 unless tracing then */
+    bool periodic;           /* Created by HAL_SCHEDULER_CreatePeriodicTask */
+    bool jobActive;          /* Current job released and not completed */
+    bool overran;            /* Current job's overrun was reported */
+    TaskTiming timing;       /* Deadline filled in */
+    uint64_t releaseUs;      /* Release of the current job */
+    uint64_t jobUs;          /* Simulated execution time of the current job */
+    uint32_t backlog;        /* Releases that came while the current job was active */
+    SimEventId releaseEvent;
+    SimEventId deadlineEvent;
+    bool frozen;           /* Member of a frozen schedule */
+    uint32_t affinity;     /* Cores it may run on, 0 for any */
+    uint8_t core;          /* Core it is queued on, or ran on last */
+    int lastCore;          /* Core of its last run, SIM_SCHEDULER_NO_CORE before the first */
+    uint32_t sleeps;       /* SIM_SCHEDULER_ResumeAt wakeups still pending */
+    bool delayed;          /* Sleeping in HAL_SCHEDULER_Delay(Until), its jitter not taken yet */
+    uint64_t wakeUs;       /* Wake time of that sleep */
+    uint64_t responseFromUs; /* Readiness the current response time counts from */
+    uint64_t sliceEndUs;   /* End of the time slice of the current run */
+    bool preempted;        /* Running task lost the processor to a preemption */
+    bool sliceOver;        /* ... at the end of its slice, so it goes to the tail of its level */
+    SimWaitList* waitList; /* Wait list a stackful task is blocked on */
+    SimEventId waitEvent;  /* Its timeout */
+    bool timedOut;         /* The last wait ended at its deadline */
+} SimTask;
+
+/* One call of a frozen schedule */
+typedef struct {
+    TaskFunction func;
+    void* args;
+    int index;
+} SimScheduleEntry;
+
+/* Frozen graph; handles use the task handle layout */
+typedef struct {
+    bool allocated;
+    uint16_t generation;
+    uint32_t count;
+    SimTaskSet members;
+    SimScheduleEntry entries[MAX_TASKS];
+} SimSchedule;
+
+/*
+ * Virtual core: the ready lists the single-threaded dispatcher serves it from. One FIFO
+ * per TaskPriority and a bitmap of non-empty levels make picking, queueing and unqueueing
+ * O(1); ready periodic tasks form a band above all levels. Without host threads the cores
+ * take turns on the dispatcher thread, one run each, so they share the simulated clock.
+ */
+typedef struct {
+    uint32_t readyMask; /* Bit p set when ready list p is non-empty */
+    int readyHead[SIM_SCHEDULER_PRIORITY_LEVELS];
+    int readyTail[SIM_SCHEDULER_PRIORITY_LEVELS];
+    SimTaskSet periodicReady; /* Periodic tasks ready */
+    SimTaskSet mailbox;       /* Tasks other cores made ready, not taken in yet (atomic words) */
+    SimSchedulerCoreStats stats;
+} SimSchedulerCore;
+
+static struct {
+    bool initialized;
+    bool running; /* Dispatcher loop is active */
+    bool stopRequested;
+    SimTask tasks[MAX_TASKS];
+    int taskSlots;          /* One past the highest slot allocated since HAL_SCHEDULER_Init */
+    SimSchedulerCore cores[SIM_SCHEDULER_MAX_CORES];
+    int currentCore;        /* Core the single-threaded dispatcher serves right now */
+    uint32_t nextCore;      /* Core whose turn it is */
+    uint64_t coreSinceUs;   /* Simulated time the core statistics were cleared at */
+    TaskTimingCallback timingCallback;
+    void* timingUserData;
+    bool tickless;
+    SimSchedulerIdleHook idleHook;
+    void* idleUserData;
+    SimSchedulerIdleStats idle;
+    uint64_t runStartUs; /* Simulated time the current or last run began at */
+    bool preemptive;
+    uint32_t quantumUs[SIM_SCHEDULER_PRIORITY_LEVELS]; /* Time slice per level, 0 for none */
+    SimSchedule schedules[MAX_SCHEDULES];
+    SimSchedulerStats stats;
+} g_simScheduler = {.currentCore = SIM_SCHEDULER_NO_CORE};
+
+/* Virtual cores, keep their configuration across HAL_SCHEDULER_Init */
+static struct {
+    uint32_t count;
+    bool hostThreads; /* Core n runs on worker n */
+} g_simSchedulerCores = {.count = 1};
+
+/* Survives HAL_SCHEDULER_Init so handles from before a re-init stay invalid */
+static uint16_t g_simSchedulerGeneration = 0;
+
+/*
+ * Chase-Lev deque of task indices. A task sits in at most one deque at a time,
+ * so MAX_TASKS slots never overflow and the buffer never has to grow. Each worker
+ * owns one per priority level and works at the bottom; idle workers steal from the
+ * top. Tasks live in the deques only during a multi-threaded frame.
+ */
+typedef struct {
+    int64_t top __attribute__((aligned(64))); /* Thieves take from here */
+    int64_t bottom __attribute__((aligned(64))); /* Owner pushes and pops here */
+    int32_t slots[MAX_TASKS];
+} SimSchedulerDeque;
+
+typedef struct {
+    SimSchedulerDeque deques[SIM_SCHEDULER_PRIORITY_LEVELS];
+    uint32_t index;
+    SimSchedulerStats frame; /* Counts of the current frame, folded into g_simScheduler.stats */
+    SimSchedulerWorkerStats stats;
+} __attribute__((aligned(64))) SimSchedulerWorker;
+
+/* Worker pool, keeps its configuration across HAL_SCHEDULER_Init */
+static struct {
+    pthread_mutex_t lock; /* Pool hand-off; serializes control calls during a frame */
+    pthread_cond_t startCond;
+    pthread_cond_t doneCond;
+    pthread_t threads[SIM_SCHEDULER_MAX_WORKERS];
+    uint32_t workers; /* Dispatching threads, including the one in HAL_SCHEDULER_Start */
+    uint64_t frame;   /* Bumped to send the pool threads into a frame */
+    uint32_t busy;    /* Pool threads still in the current frame */
+    bool stopping;
+    bool dispatching;                                  /* A multi-threaded frame is running */
+    int32_t active;                                    /* Tasks queued or running (atomic) */
+    int32_t readyCount[SIM_SCHEDULER_PRIORITY_LEVELS]; /* Tasks queued per level (atomic) */
+    SimSchedulerWorker worker[SIM_SCHEDULER_MAX_WORKERS];
+} g_simSchedulerPool = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .startCond = PTHREAD_COND_INITIALIZER,
+    .doneCond = PTHREAD_COND_INITIALIZER,
+    .workers = 1,
+};
+
+/* Coroutine stack pool, keeps its configuration across HAL_SCHEDULER_Init */
+static struct {
+    size_t stackBytes; /* Usable bytes per stack, 0 = tasks run on the dispatcher's stack */
+    size_t pageBytes;
+    SimStack* free;
+} g_simSchedulerStacks = {0};
+
+/* Real-time policy, keeps its setting across HAL_SCHEDULER_Init */
+static SimSchedulerPolicy g_simSchedulerPolicy = SIM_SCHEDULER_POLICY_RM;
+
+/* Dispatch context of the calling thread */
+static __thread int g_simSchedulerCurrent = SIM_SCHEDULER_NO_TASK;
+static __thread SimSchedulerWorker* g_simSchedulerWorker = NULL;
+static __thread SimContext* g_simSchedulerHome = NULL; /* Dispatcher a coroutine returns to */
+
+/* Private functions */
+static SimTask* SimSchedulerFindTask(TaskHandle taskHandle)
+{
+    uintptr_t raw = (uintptr_t) taskHandle;
+    uint32_t index = (uint32_t) (raw & TASK_HANDLE_INDEX_MASK);
+    uint16_t generation = (uint16_t) ((raw >> TASK_HANDLE_INDEX_BITS) & TASK_HANDLE_GEN_MASK);
+
+    if (index >= MAX_TASKS)
+        return NULL;
+
+    SimTask* task = &g_simScheduler.tasks[index];
+    if (!task->allocated || task->generation != generation)
+        return NULL;
+
+    return task;
+}
+
+static SimSchedule* SimSchedulerFindSchedule(ScheduleHandle scheduleHandle)
+{
+    uintptr_t raw = (uintptr_t) scheduleHandle;
+    uint32_t index = (uint32_t) (raw & TASK_HANDLE_INDEX_MASK);
+    uint16_t generation = (uint16_t) ((raw >> TASK_HANDLE_INDEX_BITS) & TASK_HANDLE_GEN_MASK);
+
+    if (index >= MAX_SCHEDULES)
+        return NULL;
+
+    SimSchedule* schedule = &g_simScheduler.schedules[index];
+    if (!schedule->allocated || schedule->generation != generation)
+        return NULL;
+
+    return schedule;
+}
+
+static int SimSchedulerIndex(const SimTask* task)
+{
+    return (int) (task - g_simScheduler.tasks);
+}
+
+static TaskState SimSchedulerState(const SimTask* task)
+{
+    return __atomic_load_n(&task->state, __ATOMIC_ACQUIRE);
+}
+
+static void SimSchedulerSetState(SimTask* task, TaskState state)
+{
+    __atomic_store_n(&task->state, state, __ATOMIC_RELEASE);
+}
+
+/* Called from a task running on another worker thread */
+static bool SimSchedulerForeign(const SimTask* task)
+{
+    return g_simSchedulerPool.dispatching && SimSchedulerIndex(task) != g_simSchedulerCurrent;
+}
+
+static void SimSchedulerLock(void)
+{
+    if (g_simSchedulerPool.dispatching) {
+        pthread_mutex_lock(&g_simSchedulerPool.lock);
+    }
+}
+
+static void SimSchedulerUnlock(void)
+{
+    if (g_simSchedulerPool.dispatching) {
+        pthread_mutex_unlock(&g_simSchedulerPool.lock);
+    }
+}
+
+static uint64_t SimSchedulerHostNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
+
+/* Owner only */
+static void SimDequePush(SimSchedulerDeque* deque, int index)
+{
+    int64_t bottom = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED);
+    __atomic_store_n(&deque->slots[bottom & (MAX_TASKS - 1)], index, __ATOMIC_RELAXED);
+    __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELEASE);
+}
+
+/* Owner only: newest task first */
+static int SimDequePop(SimSchedulerDeque* deque)
+{
+    int64_t bottom = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED) - 1;
+    __atomic_store_n(&deque->bottom, bottom, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int64_t top = __atomic_load_n(&deque->top, __ATOMIC_RELAXED);
+
+    if (top > bottom) {
+        __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELAXED);
+        return SIM_SCHEDULER_NO_TASK;
+    }
+
+    int index = __atomic_load_n(&deque->slots[bottom & (MAX_TASKS - 1)], __ATOMIC_RELAXED);
+    if (top == bottom) {
+        /* Last entry: race the thieves for it */
+        if (!__atomic_compare_exchange_n(&deque->top, &top, top + 1, false, __ATOMIC_SEQ_CST,
+                                         __ATOMIC_RELAXED)) {
+            index = SIM_SCHEDULER_NO_TASK;
+        }
+        __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELAXED);
+    }
+    return index;
+}
+
+static uint32_t SimSchedulerAllowed(const SimTask* task);
+
+/* Any thread: oldest task first, gives up when it loses a race or the task may not run on
+   the thief's core */
+static int SimDequeSteal(SimSchedulerDeque* deque, uint32_t core)
+{
+    int64_t top = __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int64_t bottom = __atomic_load_n(&deque->bottom, __ATOMIC_ACQUIRE);
+
+    if (top >= bottom)
+        return SIM_SCHEDULER_NO_TASK;
+
+    int index = __atomic_load_n(&deque->slots[top & (MAX_TASKS - 1)], __ATOMIC_RELAXED);
+    if (!(SimSchedulerAllowed(&g_simScheduler.tasks[index]) & (1u << core)) ||
+        !__atomic_compare_exchange_n(&deque->top, &top, top + 1, false, __ATOMIC_SEQ_CST,
+                                     __ATOMIC_RELAXED))
+        return SIM_SCHEDULER_NO_TASK;
+
+    return index;
+}
+
+/* Task sets, plain */
+static void SimTaskSetAdd(SimTaskSet* set, const SimTask* task)
+{
+    int index = SimSchedulerIndex(task);
+    set->words[index / 64] |= 1ull << (index % 64);
+}
+
+static void SimTaskSetRemove(SimTaskSet* set, const SimTask* task)
+{
+    int index = SimSchedulerIndex(task);
+    set->words[index / 64] &= ~(1ull << (index % 64));
+}
+
+static bool SimTaskSetHas(const SimTaskSet* set, const SimTask* task)
+{
+    int index = SimSchedulerIndex(task);
+    return (set->words[index / 64] >> (index % 64)) & 1;
+}
+
+static bool SimTaskSetEmpty(const SimTaskSet* set)
+{
+    for (int w = 0; w < SIM_TASK_SET_WORDS; w++) {
+        if (set->words[w])
+            return false;
+    }
+    return true;
+}
+
+static uint32_t SimTaskSetCount(const SimTaskSet* set)
+{
+    uint32_t count = 0;
+    for (int w = 0; w < SIM_TASK_SET_WORDS; w++) {
+        count += (uint32_t) __builtin_popcountll(set->words[w]);
+    }
+    return count;
+}
+
+/* Add the members of other that are not in except */
+static void SimTaskSetMerge(SimTaskSet* set, const SimTaskSet* other, const SimTaskSet* except)
+{
+    for (int w = 0; w < SIM_TASK_SET_WORDS; w++) {
+        set->words[w] |= other->words[w] & (except ? ~except->words[w] : ~0ull);
+    }
+}
+
+/* Pop the task of the lowest index out of a set, NULL once it is empty */
+static SimTask* SimTaskSetPop(SimTaskSet* set)
+{
+    for (int w = 0; w < SIM_TASK_SET_WORDS; w++) {
+        uint64_t word = set->words[w];
+        if (word) {
+            set->words[w] = word & (word - 1);
+            return &g_simScheduler.tasks[w * 64 + __builtin_ctzll(word)];
+        }
+    }
+    return NULL;
+}
+
+/* Task sets shared between threads: each word is updated atomically on its own */
+static void SimTaskSetAtomicAdd(SimTaskSet* set, const SimTask* task)
+{
+    int index = SimSchedulerIndex(task);
+    __atomic_fetch_or(&set->words[index / 64], 1ull << (index % 64), __ATOMIC_SEQ_CST);
+}
+
+static void SimTaskSetAtomicRemove(SimTaskSet* set, const SimTask* task)
+{
+    int index = SimSchedulerIndex(task);
+    __atomic_fetch_and(&set->words[index / 64], ~(1ull << (index % 64)), __ATOMIC_SEQ_CST);
+}
+
+static bool SimTaskSetAtomicHas(const SimTaskSet* set, const SimTask* task)
+{
+    int index = SimSchedulerIndex(task);
+    return (__atomic_load_n(&set->words[index / 64], __ATOMIC_RELAXED) >> (index % 64)) & 1;
+}
+
+static bool SimTaskSetAtomicAny(const SimTaskSet* set)
+{
+    for (int w = 0; w < SIM_TASK_SET_WORDS; w++) {
+        if (__atomic_load_n(&set->words[w], __ATOMIC_RELAXED))
+            return true;
+    }
+    return false;
+}
+
+static SimTaskSet SimTaskSetAtomicLoad(const SimTaskSet* set)
+{
+    SimTaskSet copy;
+    for (int w = 0; w < SIM_TASK_SET_WORDS; w++) {
+        copy.words[w] = __atomic_load_n(&set->words[w], __ATOMIC_ACQUIRE);
+    }
+    return copy;
+}
+
+/* Cores a task may run on */
+static uint32_t SimSchedulerAllowed(const SimTask* task)
+{
+    uint32_t all = (uint32_t) ((1ull << g_simSchedulerCores.count) - 1);
+    uint32_t allowed = task->affinity & all;
+    return allowed ? allowed : all;
+}
+
+/* Allowed core with the fewest tasks on it, the lowest among equals */
+static uint8_t SimSchedulerLeastLoaded(uint32_t allowed)
+{
+    uint32_t load[SIM_SCHEDULER_MAX_CORES] = {0};
+    for (int i = 0; i < g_simScheduler.taskSlots; i++) {
+        const SimTask* task = &g_simScheduler.tasks[i];
+        if (task->allocated && !task->deleted && task->state != TASK_STATE_COMPLETED) {
+            load[task->core]++;
+        }
+    }
+
+    uint8_t best = (uint8_t) __builtin_ctz(allowed);
+    for (uint32_t core = best + 1u; core < g_simSchedulerCores.count; core++) {
+        if ((allowed & (1u << core)) && load[core] < load[best]) {
+            best = (uint8_t) core;
+        }
+    }
+    return best;
+}
+
+/* Keep a task on its core if it may stay there; workers just take the first allowed one */
+static void SimSchedulerPlace(SimTask* task)
+{
+    uint32_t allowed = SimSchedulerAllowed(task);
+    if (!(allowed & (1u << task->core))) {
+        task->core = g_simSchedulerPool.dispatching ? (uint8_t) __builtin_ctz(allowed)
+                                                    : SimSchedulerLeastLoaded(allowed);
+    }
+}
+
+static void SimSchedulerEnqueue(SimTask* task)
+{
+    SimSchedulerPlace(task);
+    SimSchedulerCore* core = &g_simScheduler.cores[task->core];
+    int index = SimSchedulerIndex(task);
+    int level = task->priority;
+
+    task->state = TASK_STATE_READY;
+    if (task->periodic) {
+        SimTaskSetAdd(&core->periodicReady, task);
+        return;
+    }
+    task->next = SIM_SCHEDULER_NO_TASK;
+    task->prev = core->readyTail[level];
+
+    if (task->prev == SIM_SCHEDULER_NO_TASK) {
+        core->readyHead[level] = index;
+        core->readyMask |= 1u << level;
+    } else {
+        g_simScheduler.tasks[task->prev].next = index;
+    }
+    core->readyTail[level] = index;
+}
+
+/* Queue a preempted task at the head of its level, it was first in line when it ran */
+static void SimSchedulerEnqueueFront(SimTask* task)
+{
+    SimSchedulerPlace(task);
+    SimSchedulerCore* core = &g_simScheduler.cores[task->core];
+    int index = SimSchedulerIndex(task);
+    int level = task->priority;
+
+    if (task->periodic || core->readyHead[level] == SIM_SCHEDULER_NO_TASK) {
+        SimSchedulerEnqueue(task);
+        return;
+    }
+    task->state = TASK_STATE_READY;
+    task->prev = SIM_SCHEDULER_NO_TASK;
+    task->next = core->readyHead[level];
+    g_simScheduler.tasks[task->next].prev = index;
+    core->readyHead[level] = index;
+}
+
+static void SimSchedulerUnqueue(SimTask* task)
+{
+    SimSchedulerCore* core = &g_simScheduler.cores[task->core];
+    int level = task->priority;
+
+    if (SimTaskSetAtomicHas(&core->mailbox, task)) {
+        /* Posted by another core and not taken in yet */
+        SimTaskSetAtomicRemove(&core->mailbox, task);
+        return;
+    }
+    if (task->periodic) {
+        SimTaskSetRemove(&core->periodicReady, task);
+        return;
+    }
+    if (task->prev == SIM_SCHEDULER_NO_TASK) {
+        core->readyHead[level] = task->next;
+    } else {
+        g_simScheduler.tasks[task->prev].next = task->next;
+    }
+    if (task->next == SIM_SCHEDULER_NO_TASK) {
+        core->readyTail[level] = task->prev;
+    } else {
+        g_simScheduler.tasks[task->next].prev = task->prev;
+    }
+
+    if (core->readyHead[level] == SIM_SCHEDULER_NO_TASK) {
+        core->readyMask &= ~(1u << level);
+    }
+    task->prev = task->next = SIM_SCHEDULER_NO_TASK;
+}
+
+/*
+ * Hand a ready task to its own core from another one: the inter-processor interrupt.
+ * The owning core drains its mailbox before it picks its next task.
+ */
+static void SimSchedulerPost(SimTask* task)
+{
+    SimSchedulerCore* core = &g_simScheduler.cores[task->core];
+    SimTaskSetAtomicAdd(&core->mailbox, task);
+    __atomic_fetch_add(&core->stats.ipis, 1, __ATOMIC_RELAXED);
+}
+
+/* Take the tasks other cores posted to a core */
+static SimTaskSet SimSchedulerTakeMail(SimSchedulerCore* core)
+{
+    SimTaskSet mail;
+    for (int w = 0; w < SIM_TASK_SET_WORDS; w++) {
+        mail.words[w] = __atomic_load_n(&core->mailbox.words[w], __ATOMIC_RELAXED)
+                            ? __atomic_exchange_n(&core->mailbox.words[w], 0, __ATOMIC_ACQUIRE)
+                            : 0;
+    }
+    return mail;
+}
+
+/* Single-threaded dispatcher: put a core's mail on its ready lists, lowest index first */
+static void SimSchedulerReceive(SimSchedulerCore* core)
+{
+    SimTaskSet mail = SimSchedulerTakeMail(core);
+    SimTask* task;
+    while ((task = SimTaskSetPop(&mail)) != NULL) {
+        SimSchedulerEnqueue(task);
+    }
+}
+
+static bool SimSchedulerRmBefore(const SimTask* a, const SimTask* b)
+{
+    return a->timing.periodUs < b->timing.periodUs;
+}
+
+static bool SimSchedulerEdfBefore(const SimTask* a, const SimTask* b)
+{
+    return a->releaseUs + a->timing.deadlineUs < b->releaseUs + b->timing.deadlineUs;
+}
+
+/* Real-time policies: true if a goes before b, ties go to the lower task index */
+static bool (*const kSimSchedulerPolicies[])(const SimTask* a, const SimTask* b) = {
+    [SIM_SCHEDULER_POLICY_RM] = SimSchedulerRmBefore,
+    [SIM_SCHEDULER_POLICY_EDF] = SimSchedulerEdfBefore,
+};
+
+/* Ready periodic task the policy runs first, else the highest-priority one, first in line */
+static SimTask* SimSchedulerPickNext(const SimSchedulerCore* core)
+{
+    SimTaskSet ready = core->periodicReady;
+    SimTask* first = SimTaskSetPop(&ready);
+    if (first) {
+        bool (*before)(const SimTask*, const SimTask*) =
+            kSimSchedulerPolicies[g_simSchedulerPolicy];
+        SimTask* task;
+        while ((task = SimTaskSetPop(&ready)) != NULL) {
+            if (before(task, first)) {
+                first = task;
+            }
+        }
+        return first;
+    }
+    if (!core->readyMask)
+        return NULL;
+
+    int level = 31 - __builtin_clz(core->readyMask);
+    return &g_simScheduler.tasks[core->readyHead[level]];
+}
+
+/* Whether a ready task takes the processor from a running one before its run ends */
+static bool SimSchedulerOutranks(const SimTask* task, const SimTask* running)
+{
+    if (task->periodic != running->periodic)
+        return task->periodic;
+    if (task->periodic)
+        return kSimSchedulerPolicies[g_simSchedulerPolicy](task, running);
+    return task->priority > running->priority;
+}
+
+/* Next core in turn with a task to run, which becomes the current core; NULL if none */
+static SimTask* SimSchedulerPickCore(void)
+{
+    for (uint32_t k = 0; k < g_simSchedulerCores.count; k++) {
+        uint32_t index = (g_simScheduler.nextCore + k) % g_simSchedulerCores.count;
+        SimSchedulerCore* core = &g_simScheduler.cores[index];
+        SimSchedulerReceive(core);
+        SimTask* task = SimSchedulerPickNext(core);
+        if (task) {
+            g_simScheduler.currentCore = (int) index;
+            g_simScheduler.nextCore = (index + 1) % g_simSchedulerCores.count;
+            return task;
+        }
+    }
+    return NULL;
+}
+
+/* Whether any core has a task queued or posted */
+static bool SimSchedulerAnyReady(void)
+{
+    for (uint32_t i = 0; i < g_simSchedulerCores.count; i++) {
+        const SimSchedulerCore* core = &g_simScheduler.cores[i];
+        if (core->readyMask || !SimTaskSetEmpty(&core->periodicReady) ||
+            SimTaskSetAtomicAny(&core->mailbox))
+            return true;
+    }
+    return false;
+}
+
+/* Core a worker serves: its own index when cores map to host threads, else the only one */
+static uint32_t SimSchedulerWorkerCore(const SimSchedulerWorker* worker)
+{
+    return g_simSchedulerCores.hostThreads ? worker->index : 0;
+}
+
+/* Push a task on a worker's own deque */
+static void SimSchedulerPush(SimSchedulerWorker* worker, SimTask* task)
+{
+    SimDequePush(&worker->deques[task->priority], SimSchedulerIndex(task));
+    __atomic_fetch_add(&g_simSchedulerPool.readyCount[task->priority], 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * Queue a task: on the ready lists, or on this thread's deque during a multi-threaded
+ * frame. A task that may not run on the calling core goes to its own core's mailbox.
+ */
+static void SimSchedulerMakeReady(SimTask* task)
+{
+    task->stats.readyUs = SIM_TIMER_GetCurrentTime();
+    task->responseFromUs = task->stats.readyUs;
+    task->readyHostNs = SimSchedulerTraceEnabled() ? SimSchedulerHostNs() : 0;
+
+    SimSchedulerWorker* worker = g_simSchedulerWorker;
+    if (!worker) {
+        int from = g_simScheduler.currentCore;
+        SimSchedulerPlace(task);
+        if (from != SIM_SCHEDULER_NO_CORE && from != task->core) {
+            SimSchedulerSetState(task, TASK_STATE_READY);
+            SimSchedulerPost(task);
+        } else {
+            SimSchedulerEnqueue(task);
+        }
+        return;
+    }
+
+    SimSchedulerSetState(task, TASK_STATE_READY);
+    __atomic_fetch_add(&g_simSchedulerPool.active, 1, __ATOMIC_SEQ_CST);
+    uint32_t core = SimSchedulerWorkerCore(worker);
+    if (SimSchedulerAllowed(task) & (1u << core)) {
+        task->core = (uint8_t) core;
+        SimSchedulerPush(worker, task);
+    } else {
+        SimSchedulerPlace(task);
+        SimSchedulerPost(task);
+    }
+}
+
+/* Count one producer as done, true if it was the last one */
+static bool SimSchedulerDropPending(SimTask* task)
+{
+    uint32_t pending = __atomic_load_n(&task->pending, __ATOMIC_SEQ_CST);
+    while (pending) {
+        if (__atomic_compare_exchange_n(&task->pending, &pending, pending - 1, true,
+                                        __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+            return pending == 1;
+    }
+    return false;
+}
+
+/* Queue a blocked task; whoever flips the state owns the hand-off */
+static void SimSchedulerUnblock(SimTask* task)
+{
+    TaskState expected = TASK_STATE_BLOCKED;
+    if (__atomic_compare_exchange_n(&task->state, &expected, TASK_STATE_READY, false,
+                                    __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+        SimSchedulerMakeReady(task);
+    }
+}
+
+/*
+ * A producer is done for this frame: unblock consumers it was the last one holding back.
+ * A consumer stays BLOCKED while its pending count of producers not yet done is non-zero.
+ */
+static void SimSchedulerRelease(const SimTask* task)
+{
+    SimTaskSet successors = SimTaskSetAtomicLoad(&task->successors);
+    SimTask* consumer;
+    while ((consumer = SimTaskSetPop(&successors)) != NULL) {
+        if (SimSchedulerDropPending(consumer)) {
+            SimSchedulerUnblock(consumer);
+        }
+    }
+}
+
+/* Check whether target can be reached from task along dependency edges */
+static bool SimSchedulerReaches(const SimTask* task, const SimTask* target)
+{
+    SimTaskSet seen = {{0}};
+    SimTaskSet frontier = task->successors;
+
+    while (!SimTaskSetEmpty(&frontier)) {
+        if (SimTaskSetHas(&frontier, target))
+            return true;
+
+        SimTaskSetMerge(&seen, &frontier, NULL);
+        SimTaskSet next = {{0}};
+        const SimTask* member;
+        while ((member = SimTaskSetPop(&frontier)) != NULL) {
+            SimTaskSetMerge(&next, &member->successors, &seen);
+        }
+        frontier = next;
+    }
+    return false;
+}
+
+/* Every task connected to task by dependencies, in either direction */
+static SimTaskSet SimSchedulerGraph(const SimTask* task)
+{
+    SimTaskSet graph = {{0}};
+    SimTaskSetAdd(&graph, task);
+    SimTaskSet frontier = graph;
+
+    while (!SimTaskSetEmpty(&frontier)) {
+        SimTaskSet next = {{0}};
+        const SimTask* member;
+        while ((member = SimTaskSetPop(&frontier)) != NULL) {
+            SimTaskSetMerge(&next, &member->predecessors, &graph);
+            SimTaskSetMerge(&next, &member->successors, &graph);
+        }
+        SimTaskSetMerge(&graph, &next, NULL);
+        frontier = next;
+    }
+    return graph;
+}
+
+/* Drop all edges of a task that goes away */
+static void SimSchedulerUnlink(SimTask* task)
+{
+    SimTaskSet edges = task->predecessors;
+    SimTask* other;
+    while ((other = SimTaskSetPop(&edges)) != NULL) {
+        SimTaskSetAtomicRemove(&other->successors, task);
+    }
+
+    /* It will never complete, so it stops holding its consumers back */
+    if (SimSchedulerState(task) != TASK_STATE_COMPLETED) {
+        SimSchedulerRelease(task);
+    }
+    edges = task->successors;
+    while ((other = SimTaskSetPop(&edges)) != NULL) {
+        SimTaskSetRemove(&other->predecessors, task);
+    }
+
+    memset(&task->predecessors, 0, sizeof(task->predecessors));
+    for (int w = 0; w < SIM_TASK_SET_WORDS; w++) {
+        __atomic_store_n(&task->successors.words[w], 0, __ATOMIC_RELEASE);
+    }
+}
+
+/* Append a task to its level's FIFO in SimSchedulerPlan */
+static void SimSchedulerPlanQueue(int* head, int* tail, int* link, const SimTask* task)
+{
+    int index = SimSchedulerIndex(task);
+    int level = task->priority;
+
+    link[index] = SIM_SCHEDULER_NO_TASK;
+    if (head[level] == SIM_SCHEDULER_NO_TASK) {
+        head[level] = index;
+    } else {
+        link[tail[level]] = index;
+    }
+    tail[level] = index;
+}
+
+/* Record the order the single-threaded dispatcher runs a freshly armed frame of a graph in */
+static void SimSchedulerPlan(const SimTaskSet* graph, SimSchedule* schedule)
+{
+    /* One FIFO per level, linked through link[] */
+    int head[SIM_SCHEDULER_PRIORITY_LEVELS];
+    int tail[SIM_SCHEDULER_PRIORITY_LEVELS];
+    int link[MAX_TASKS];
+    uint32_t pending[MAX_TASKS];
+    for (int level = 0; level < SIM_SCHEDULER_PRIORITY_LEVELS; level++) {
+        head[level] = tail[level] = SIM_SCHEDULER_NO_TASK;
+    }
+
+    /* Roots queue up in index order, as HAL_SCHEDULER_RearmGraph queues them */
+    SimTaskSet members = *graph;
+    const SimTask* task;
+    while ((task = SimTaskSetPop(&members)) != NULL) {
+        int index = SimSchedulerIndex(task);
+        pending[index] = SimTaskSetCount(&task->predecessors);
+        if (!pending[index]) {
+            SimSchedulerPlanQueue(head, tail, link, task);
+        }
+    }
+
+    schedule->count = 0;
+    for (;;) {
+        int level = SIM_SCHEDULER_PRIORITY_LEVELS - 1;
+        while (level >= 0 && head[level] == SIM_SCHEDULER_NO_TASK) {
+            level--;
+        }
+        if (level < 0)
+            break;
+
+        int index = head[level];
+        head[level] = link[index];
+        task = &g_simScheduler.tasks[index];
+        schedule->entries[schedule->count++] = (SimScheduleEntry){task->func, task->args, index};
+
+        SimTaskSet successors = task->successors;
+        const SimTask* consumer;
+        while ((consumer = SimTaskSetPop(&successors)) != NULL) {
+            if (--pending[SimSchedulerIndex(consumer)] == 0) {
+                SimSchedulerPlanQueue(head, tail, link, consumer);
+            }
+        }
+    }
+}
+
+static SimStack* SimStackAlloc(void)
+{
+    SimStack* stack = g_simSchedulerStacks.free;
+    if (stack) {
+        g_simSchedulerStacks.free = stack->next;
+        return stack;
+    }
+
+    stack = (SimStack*) malloc(sizeof(*stack));
+    if (!stack)
+        return NULL;
+
+    stack->bytes = g_simSchedulerStacks.stackBytes + g_simSchedulerStacks.pageBytes;
+    void* base = mmap(NULL, stack->bytes, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+    if (base == MAP_FAILED) {
+        free(stack);
+        return NULL;
+    }
+
+    /* Stacks grow down: an overflow faults on the guard instead of corrupting memory */
+    stack->base = (uint8_t*) base;
+    mprotect(stack->base, g_simSchedulerStacks.pageBytes, PROT_NONE);
+    return stack;
+}
+
+static void SimStackUnmap(SimStack* stack)
+{
+    munmap(stack->base, stack->bytes);
+    free(stack);
+}
+
+static void SimStackRelease(SimStack* stack)
+{
+    if (stack->bytes != g_simSchedulerStacks.stackBytes + g_simSchedulerStacks.pageBytes) {
+        SimStackUnmap(stack);
+        return;
+    }
+    stack->next = g_simSchedulerStacks.free;
+    g_simSchedulerStacks.free = stack;
+}
+
+/*
+ * Stackful tasks are coroutines on pooled stacks with a guard page below each. On
+ * x86-64 a switch saves the callee-saved registers and swaps stack pointers; elsewhere
+ * ucontext also saves the signal mask, a system call per switch.
+ *
+ * A coroutine can move to another thread while switched out, and the compiler may
+ * keep a thread-local address in a register across the switch; reading the
+ * dispatch context through these calls gets the one of the thread it runs on now.
+ */
+static __attribute__((noinline)) int SimSchedulerCurrent(void)
+{
+    return g_simSchedulerCurrent;
+}
+
+static __attribute__((noinline)) SimContext* SimSchedulerHome(void)
+{
+    return g_simSchedulerHome;
+}
+
+static void SimContextSwitch(SimContext* save, SimContext* load)
+{
+#ifdef SIM_SCHEDULER_STACK_SWITCH
+    SimSchedulerSwapStack(&save->sp, load->sp);
+#else
+    swapcontext(save, load);
+#endif
+}
+
+static void SimSchedulerEntry(void)
+{
+    SimTask* task = &g_simScheduler.tasks[SimSchedulerCurrent()];
+    task->func(task->args);
+    task->finished = true;
+    SimContextSwitch(&task->context, SimSchedulerHome());
+}
+
+/* Set a context up to enter SimSchedulerEntry on the task's stack */
+static void SimContextPrepare(SimTask* task)
+{
+    uint8_t* low = task->stack->base + g_simSchedulerStacks.pageBytes;
+    size_t bytes = task->stack->bytes - g_simSchedulerStacks.pageBytes;
+
+#ifdef SIM_SCHEDULER_STACK_SWITCH
+    /* Frame SimSchedulerSwapStack pops: control words, six registers, then the entry
+       point as return address above a null one, so the entry sees a call-aligned stack */
+    uint64_t* sp = (uint64_t*) (((uintptr_t) (low + bytes)) & ~(uintptr_t) 15);
+    *--sp = 0;
+    *--sp = (uint64_t) (uintptr_t) SimSchedulerEntry;
+    for (int i = 0; i < 6; i++) {
+        *--sp = 0;
+    }
+    *--sp = 0x1F80 | ((uint64_t) 0x037F << 32); /* Default MXCSR and x87 control word */
+    task->context.sp = sp;
+#else
+    getcontext(&task->context);
+    task->context.uc_stack.ss_sp = low;
+    task->context.uc_stack.ss_size = bytes;
+    task->context.uc_link = NULL;
+    makecontext(&task->context, SimSchedulerEntry, 0);
+#endif
+}
+
+/* Run a task until it returns, or for a stackful one until it switches out */
+static void SimSchedulerRun(SimTask* task)
+{
+    if (!task->stack) {
+        task->func(task->args);
+        return;
+    }
+
+    if (!task->started) {
+        SimContextPrepare(task);
+        task->started = true;
+        task->finished = false;
+    }
+
+    SimContext home;
+    g_simSchedulerHome = &home;
+    SimContextSwitch(&home, &task->context);
+}
+
+/* Give the thread back to the dispatcher; returns once the task is dispatched again */
+static void SimSchedulerSwitchOut(SimTask* task)
+{
+    SimContextSwitch(&task->context, SimSchedulerHome());
+}
+
+/* Take a task off the wait list it is registered on, if any */
+static void SimSchedulerLeaveWait(SimTask* task)
+{
+    if (task->waitList) {
+        SimTaskSetAtomicRemove(&task->waitList->waiters, task);
+        task->waitList = NULL;
+    }
+    SimKernelCancel(task->waitEvent);
+    task->waitEvent = 0;
+}
+
+static void SimSchedulerFree(SimTask* task)
+{
+    SimSchedulerUnlink(task);
+    SimSchedulerLeaveWait(task);
+    SimKernelCancel(task->releaseEvent);
+    SimKernelCancel(task->deadlineEvent);
+    if (task->stack) {
+        SimStackRelease(task->stack);
+        task->stack = NULL;
+    }
+    task->allocated = false;
+}
+
+static uint32_t SimSchedulerRunBucket(uint64_t runNs)
+{
+    uint32_t bucket = 0;
+    uint64_t limit = 1000;
+
+    while (runNs > limit && bucket < TASK_STATS_RUN_BUCKETS - 1) {
+        limit <<= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+/* Account a run in simulated time */
+static void SimSchedulerAccount(SimTask* task, uint64_t startUs, uint64_t endUs)
+{
+    TaskStats* stats = &task->stats;
+    uint64_t latencyUs = startUs > stats->readyUs ? startUs - stats->readyUs : 0;
+
+    stats->runs++;
+    stats->startUs = startUs;
+    stats->endUs = endUs;
+    stats->latencyUs += latencyUs;
+    if (latencyUs > stats->maxLatencyUs) {
+        stats->maxLatencyUs = latencyUs;
+    }
+}
+
+/* Account a response: from becoming ready to giving the processor up, preemptions included */
+static void SimSchedulerAccountResponse(SimTask* task, uint64_t endUs)
+{
+    TaskStats* stats = &task->stats;
+    uint64_t responseUs = endUs > task->responseFromUs ? endUs - task->responseFromUs : 0;
+
+    stats->responses++;
+    stats->responseUs += responseUs;
+    stats->responseHistogram[SimSchedulerRunBucket(responseUs * 1000)]++;
+}
+
+/* Account a traced run in host time */
+static void SimSchedulerAccountHost(SimTask* task, const SimSchedulerTraceRecord* run)
+{
+    TaskStats* stats = &task->stats;
+    uint64_t runNs = run->endNs - run->startNs;
+
+    stats->runNs += runNs;
+    if (runNs > stats->maxRunNs) {
+        stats->maxRunNs = runNs;
+    }
+    stats->runHistogram[SimSchedulerRunBucket(runNs)]++;
+
+    if (run->readyNs) {
+        uint64_t latencyNs = run->startNs - run->readyNs;
+        stats->latencyNs += latencyNs;
+        if (latencyNs > stats->maxLatencyNs) {
+            stats->maxLatencyNs = latencyNs;
+        }
+    }
+}
+
+static void SimSchedulerReportTiming(SimTask* task, TaskTimingEvent event)
+{
+    if (g_simScheduler.timingCallback) {
+        g_simScheduler.timingCallback(task->handle, event, g_simScheduler.timingUserData);
+    }
+}
+
+static void SimSchedulerOnDeadline(void* arg, uint64_t nowUs)
+{
+    (void) nowUs;
+    SimTask* task = SimSchedulerFindTask((TaskHandle) arg);
+    if (!task || task->deleted)
+        return;
+
+    /* Cancelled when the job completes, so firing means it is late */
+    task->deadlineEvent = 0;
+    task->stats.deadlineMisses++;
+    SimSchedulerReportTiming(task, TASK_TIMING_DEADLINE_MISS);
+}
+
+/*
+ * Each release and each deadline of a periodic task is a kernel event. Between jobs the
+ * task waits BLOCKED on one pending count its next release drops; a release while the
+ * previous job still runs is kept as backlog and starts when that job completes.
+ */
+static void SimSchedulerStartJob(SimTask* task, uint64_t releaseUs)
+{
+    task->jobActive = true;
+    task->overran = false;
+    task->jobUs = 0;
+    task->releaseUs = releaseUs;
+
+    /* A job completing exactly at its deadline is on time */
+    task->deadlineEvent = SimKernelPost(releaseUs + task->timing.deadlineUs + 1,
+                                        SimSchedulerOnDeadline, task->handle);
+}
+
+static void SimSchedulerOnRelease(void* arg, uint64_t nowUs)
+{
+    SimTask* task = SimSchedulerFindTask((TaskHandle) arg);
+    if (!task || task->deleted)
+        return;
+
+    task->releaseEvent = SimKernelPost(nowUs + task->timing.periodUs, SimSchedulerOnRelease, arg);
+    task->stats.jobs++;
+    if (task->jobActive) {
+        task->backlog++;
+        return;
+    }
+
+    SimSchedulerStartJob(task, nowUs);
+    if (SimSchedulerDropPending(task)) {
+        SimSchedulerUnblock(task);
+    }
+}
+
+/* Charge a run to the current job of a periodic task */
+static void SimSchedulerChargeJob(SimTask* task, uint64_t startUs)
+{
+    task->jobUs += task->stats.endUs - startUs;
+    if (task->timing.budgetUs && task->jobUs > task->timing.budgetUs && !task->overran) {
+        task->overran = true;
+        task->stats.overruns++;
+        SimSchedulerReportTiming(task, TASK_TIMING_OVERRUN);
+    }
+}
+
+/* The task function returned: start a backlogged job or wait for the next release */
+static void SimSchedulerFinishJob(SimTask* task)
+{
+    TaskStats* stats = &task->stats;
+    uint64_t responseUs = stats->endUs - task->releaseUs;
+    if (responseUs > stats->maxResponseUs) {
+        stats->maxResponseUs = responseUs;
+    }
+    SimKernelCancel(task->deadlineEvent);
+    task->deadlineEvent = 0;
+
+    if (task->backlog) {
+        task->backlog--;
+        SimSchedulerStartJob(task, task->releaseUs + task->timing.periodUs);
+        SimSchedulerMakeReady(task);
+    } else {
+        task->jobActive = false;
+        task->pending = 1;
+        SimSchedulerSetState(task, TASK_STATE_BLOCKED);
+    }
+}
+
+/* Run one task until it returns or switches out, then decide where it goes */
+static void SimSchedulerDispatch(SimTask* task)
+{
+    SimSchedulerWorker* worker = g_simSchedulerWorker;
+    SimSchedulerStats* counters = worker ? &worker->frame : &g_simScheduler.stats;
+    uint32_t coreIndex =
+        worker ? SimSchedulerWorkerCore(worker) : (uint32_t) g_simScheduler.currentCore;
+    SimSchedulerCore* core = &g_simScheduler.cores[coreIndex];
+
+    bool traced = SimSchedulerTraceEnabled();
+    bool timed = traced || g_simSchedulerCores.count > 1;
+    uint64_t startUs = SIM_TIMER_GetCurrentTime();
+    uint64_t startNs = timed ? SimSchedulerHostNs() : 0;
+
+    if (task->delayed && startUs >= task->wakeUs) {
+        uint64_t jitterUs = startUs - task->wakeUs;
+        task->delayed = false;
+        task->stats.jitterUs += jitterUs;
+        if (jitterUs > task->stats.maxJitterUs) {
+            task->stats.maxJitterUs = jitterUs;
+        }
+    }
+
+    SimSchedulerSetState(task, TASK_STATE_RUNNING);
+    task->yielded = false;
+    task->preempted = false;
+    task->sliceOver = false;
+    uint32_t quantumUs = worker ? 0 : g_simScheduler.quantumUs[task->priority];
+    task->sliceEndUs = quantumUs ? startUs + quantumUs : UINT64_MAX;
+    __atomic_store_n(&task->onStack, true, __ATOMIC_RELAXED);
+    g_simSchedulerCurrent = SimSchedulerIndex(task);
+    counters->dispatches++;
+    if (worker) {
+        worker->stats.tasksRun++;
+    }
+    task->core = (uint8_t) coreIndex;
+    if (task->lastCore != (int) coreIndex) {
+        if (task->lastCore != SIM_SCHEDULER_NO_CORE) {
+            __atomic_fetch_add(&core->stats.migrations, 1, __ATOMIC_RELAXED);
+        }
+        task->lastCore = (int) coreIndex;
+    }
+
+    SimSchedulerRun(task);
+
+    g_simSchedulerCurrent = SIM_SCHEDULER_NO_TASK;
+    uint64_t endUs = SIM_TIMER_GetCurrentTime();
+    SimSchedulerAccount(task, startUs, endUs);
+    uint64_t endNs = timed ? SimSchedulerHostNs() : 0;
+    __atomic_fetch_add(&core->stats.tasksRun, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&core->stats.busyUs, endUs - startUs, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&core->stats.busyNs, endNs - startNs, __ATOMIC_RELAXED);
+    if (task->periodic) {
+        SimSchedulerChargeJob(task, startUs);
+    }
+
+    /* Recorded before a task that deleted itself gives its slot up */
+    SimSchedulerTraceRecord run;
+    if (traced) {
+        run = (SimSchedulerTraceRecord){.task = (uint64_t) (uintptr_t) task->handle,
+                                        .readyUs = task->stats.readyUs,
+                                        .startUs = startUs,
+                                        .endUs = task->stats.endUs,
+                                        .readyNs = task->readyHostNs,
+                                        .startNs = startNs,
+                                        .endNs = endNs,
+                                        .index = (uint16_t) SimSchedulerIndex(task),
+                                        .priority = (uint8_t) task->priority,
+                                        .worker = (uint8_t) (worker ? worker->index : 0),
+                                        .core = (uint8_t) coreIndex};
+        SimSchedulerAccountHost(task, &run);
+    }
+    bool returned = !task->stack || task->finished;
+
+    /* Only the task itself can suspend, block or delete itself while it runs */
+    bool deleted = task->deleted;
+    bool preempted = task->preempted;
+    if (!deleted && !preempted) {
+        /* While it is on the stack no wakeup makes it ready and restarts the response */
+        SimSchedulerAccountResponse(task, endUs);
+    }
+    TaskState state = SimSchedulerState(task);
+    bool parked = state == TASK_STATE_SUSPENDED || state == TASK_STATE_BLOCKED;
+    if (deleted || parked) {
+        /* Must not interleave with a resume or wakeup from another worker */
+        SimSchedulerLock();
+        __atomic_store_n(&task->onStack, false, __ATOMIC_RELAXED);
+        state = SimSchedulerState(task);
+        parked = state == TASK_STATE_SUSPENDED || state == TASK_STATE_BLOCKED;
+        if (deleted) {
+            SimSchedulerFree(task);
+        }
+        SimSchedulerUnlock();
+    } else {
+        __atomic_store_n(&task->onStack, false, __ATOMIC_RELAXED);
+    }
+
+    if (deleted) {
+        run.event = SIM_SCHEDULER_TRACE_DELETED;
+    } else if (parked) {
+        /* Suspended itself or blocked in a wait, runs again once resumed or woken */
+        run.event = state == TASK_STATE_SUSPENDED ? SIM_SCHEDULER_TRACE_SUSPENDED
+                                                  : SIM_SCHEDULER_TRACE_YIELDED;
+    } else if (preempted) {
+        /* Switched out in the middle of its work, goes on from there when picked again */
+        run.event = SIM_SCHEDULER_TRACE_PREEMPTED;
+        counters->preemptions++;
+        task->stats.preemptions++;
+        task->stats.readyUs = endUs;
+        if (task->sliceOver) {
+            SimSchedulerEnqueue(task);
+        } else {
+            SimSchedulerEnqueueFront(task);
+        }
+    } else if (task->yielded || !returned) {
+        /* A coroutine resumed while switching out for a suspend just goes on */
+        run.event = SIM_SCHEDULER_TRACE_YIELDED;
+        counters->yields++;
+        SimSchedulerMakeReady(task);
+    } else {
+        run.event = SIM_SCHEDULER_TRACE_COMPLETED;
+        task->started = false;
+        if (task->periodic) {
+            SimSchedulerFinishJob(task);
+        } else {
+            SimSchedulerSetState(task, TASK_STATE_COMPLETED);
+            counters->completions++;
+            SimSchedulerRelease(task);
+        }
+    }
+
+    if (traced) {
+        SimSchedulerTraceAppend(&run);
+    }
+}
+
+/* Highest-priority task queued anywhere in the pool, preferring this worker's own */
+static SimTask* SimSchedulerTake(SimSchedulerWorker* self)
+{
+    uint32_t workers = g_simSchedulerPool.workers;
+    uint32_t core = SimSchedulerWorkerCore(self);
+
+    /* Tasks other cores made ready for this one join its deque */
+    SimTaskSet mail = SimSchedulerTakeMail(&g_simScheduler.cores[core]);
+    SimTask* posted;
+    while ((posted = SimTaskSetPop(&mail)) != NULL) {
+        SimSchedulerPush(self, posted);
+    }
+
+    for (int level = SIM_SCHEDULER_PRIORITY_LEVELS - 1; level >= 0; level--) {
+        if (__atomic_load_n(&g_simSchedulerPool.readyCount[level], __ATOMIC_ACQUIRE) <= 0) {
+            continue;
+        }
+
+        int index = SimDequePop(&self->deques[level]);
+        for (uint32_t k = 1; k < workers && index == SIM_SCHEDULER_NO_TASK; k++) {
+            SimSchedulerWorker* victim = &g_simSchedulerPool.worker[(self->index + k) % workers];
+            index = SimDequeSteal(&victim->deques[level], core);
+            if (index != SIM_SCHEDULER_NO_TASK) {
+                self->stats.steals++;
+            }
+        }
+
+        if (index != SIM_SCHEDULER_NO_TASK) {
+            __atomic_fetch_sub(&g_simSchedulerPool.readyCount[level], 1, __ATOMIC_RELAXED);
+            return &g_simScheduler.tasks[index];
+        }
+    }
+    return NULL;
+}
+
+/* One worker's share of a multi-threaded frame */
+static void SimSchedulerWork(SimSchedulerWorker* worker)
+{
+    uint64_t idleSince = 0;
+
+    g_simSchedulerWorker = worker;
+    while (!__atomic_load_n(&g_simScheduler.stopRequested, __ATOMIC_RELAXED)) {
+        SimTask* task = SimSchedulerTake(worker);
+        if (task) {
+            if (idleSince) {
+                worker->stats.idleNs += SimSchedulerHostNs() - idleSince;
+                idleSince = 0;
+            }
+            SimSchedulerDispatch(task);
+            __atomic_fetch_sub(&g_simSchedulerPool.active, 1, __ATOMIC_SEQ_CST);
+            continue;
+        }
+
+        /* Nothing queued and nothing running that could queue more: frame done */
+        if (__atomic_load_n(&g_simSchedulerPool.active, __ATOMIC_SEQ_CST) == 0)
+            break;
+
+        if (!idleSince) {
+            idleSince = SimSchedulerHostNs();
+        }
+        sched_yield();
+    }
+    if (idleSince) {
+        worker->stats.idleNs += SimSchedulerHostNs() - idleSince;
+    }
+    g_simSchedulerWorker = NULL;
+}
+
+static void* SimSchedulerWorkerMain(void* arg)
+{
+    SimSchedulerWorker* worker = (SimSchedulerWorker*) arg;
+    uint64_t frame = 0;
+
+    pthread_mutex_lock(&g_simSchedulerPool.lock);
+    for (;;) {
+        while (g_simSchedulerPool.frame == frame && !g_simSchedulerPool.stopping) {
+            pthread_cond_wait(&g_simSchedulerPool.startCond, &g_simSchedulerPool.lock);
+        }
+        if (g_simSchedulerPool.stopping)
+            break;
+
+        frame = g_simSchedulerPool.frame;
+        pthread_mutex_unlock(&g_simSchedulerPool.lock);
+        SimSchedulerWork(worker);
+        pthread_mutex_lock(&g_simSchedulerPool.lock);
+
+        if (--g_simSchedulerPool.busy == 0) {
+            pthread_cond_signal(&g_simSchedulerPool.doneCond);
+        }
+    }
+    pthread_mutex_unlock(&g_simSchedulerPool.lock);
+    return NULL;
+}
+
+static void SimSchedulerStopPool(void)
+{
+    pthread_mutex_lock(&g_simSchedulerPool.lock);
+    g_simSchedulerPool.stopping = true;
+    pthread_cond_broadcast(&g_simSchedulerPool.startCond);
+    pthread_mutex_unlock(&g_simSchedulerPool.lock);
+
+    for (uint32_t i = 1; i < g_simSchedulerPool.workers; i++) {
+        pthread_join(g_simSchedulerPool.threads[i], NULL);
+    }
+    g_simSchedulerPool.stopping = false;
+    g_simSchedulerPool.workers = 1;
+    g_simSchedulerPool.frame = 0; /* New threads start out waiting for frame 1 */
+}
+
+/* Run the ready lists to completion on the worker pool */
+static void SimSchedulerRunParallel(void)
+{
+    uint32_t workers = g_simSchedulerPool.workers;
+    uint32_t next = 0;
+
+    /*
+     * Deal the ready tasks round-robin over the workers, highest priority first; with
+     * cores on host threads each core's tasks go to its own worker
+     */
+    for (uint32_t c = 0; c < g_simSchedulerCores.count; c++) {
+        SimSchedulerCore* core = &g_simScheduler.cores[c];
+        SimSchedulerReceive(core);
+
+        SimTask* task;
+        while ((task = SimSchedulerPickNext(core)) != NULL) {
+            SimSchedulerUnqueue(task);
+            uint32_t worker = g_simSchedulerCores.hostThreads ? task->core : next;
+            SimDequePush(&g_simSchedulerPool.worker[worker].deques[task->priority],
+                         SimSchedulerIndex(task));
+            g_simSchedulerPool.readyCount[task->priority]++;
+            g_simSchedulerPool.active++;
+            next = (next + 1) % workers;
+        }
+    }
+
+    pthread_mutex_lock(&g_simSchedulerPool.lock);
+    g_simSchedulerPool.dispatching = true;
+    g_simSchedulerPool.busy = workers - 1;
+    g_simSchedulerPool.frame++;
+    pthread_cond_broadcast(&g_simSchedulerPool.startCond);
+    pthread_mutex_unlock(&g_simSchedulerPool.lock);
+
+    SimSchedulerWork(&g_simSchedulerPool.worker[0]);
+
+    pthread_mutex_lock(&g_simSchedulerPool.lock);
+    while (g_simSchedulerPool.busy) {
+        pthread_cond_wait(&g_simSchedulerPool.doneCond, &g_simSchedulerPool.lock);
+    }
+    g_simSchedulerPool.dispatching = false;
+    pthread_mutex_unlock(&g_simSchedulerPool.lock);
+
+    /* Whatever a stop left behind goes back on the ready lists */
+    for (uint32_t i = 0; i < workers; i++) {
+        SimSchedulerWorker* worker = &g_simSchedulerPool.worker[i];
+        for (int level = 0; level < SIM_SCHEDULER_PRIORITY_LEVELS; level++) {
+            SimSchedulerDeque* deque = &worker->deques[level];
+            for (int64_t slot = deque->top; slot < deque->bottom; slot++) {
+                SimSchedulerEnqueue(&g_simScheduler.tasks[deque->slots[slot & (MAX_TASKS - 1)]]);
+            }
+            deque->top = deque->bottom = 0;
+        }
+
+        g_simScheduler.stats.dispatches += worker->frame.dispatches;
+        g_simScheduler.stats.yields += worker->frame.yields;
+        g_simScheduler.stats.completions += worker->frame.completions;
+        memset(&worker->frame, 0, sizeof(worker->frame));
+    }
+    for (uint32_t c = 0; c < g_simSchedulerCores.count; c++) {
+        SimSchedulerReceive(&g_simScheduler.cores[c]);
+    }
+    memset(g_simSchedulerPool.readyCount, 0, sizeof(g_simSchedulerPool.readyCount));
+    g_simSchedulerPool.active = 0;
+}
+
+/*
+ * Dispatch until the ready lists drain, a task calls HAL_SCHEDULER_Stop or simulated
+ * time passes untilUs (an overloaded periodic task set never drains)
+ */
+static void SimSchedulerRunFrame(uint64_t untilUs)
+{
+    g_simScheduler.running = true;
+    g_simScheduler.stopRequested = false;
+
+    if (g_simSchedulerPool.workers > 1) {
+        SimSchedulerRunParallel();
+    } else {
+        /* Cores take turns, one dispatch each, on the shared simulated clock */
+        SimTask* task;
+        while (!g_simScheduler.stopRequested && SIM_TIMER_GetCurrentTime() <= untilUs &&
+               (task = SimSchedulerPickCore()) != NULL) {
+            SimSchedulerUnqueue(task);
+            SimSchedulerDispatch(task);
+        }
+        g_simScheduler.currentCore = SIM_SCHEDULER_NO_CORE;
+    }
+
+    g_simScheduler.running = false;
+}
+
+static bool SimSchedulerHasPeriodic(void)
+{
+    for (int i = 0; i < g_simScheduler.taskSlots; i++) {
+        const SimTask* task = &g_simScheduler.tasks[i];
+        if (task->allocated && !task->deleted && task->periodic)
+            return true;
+    }
+    return false;
+}
+
+/* Create a task; timing non-NULL for a periodic one, whose first job is released now */
+static int SimSchedulerCreate(TaskFunction taskFunc, void* args, TaskPriority priority,
+                              const TaskTiming* timing, TaskHandle* taskHandle)
+{
+    SimSchedulerLock();
+    for (int i = 0; i < MAX_TASKS; i++) {
+        SimTask* task = &g_simScheduler.tasks[i];
+        if (task->allocated) {
+            continue;
+        }
+
+        memset(task, 0, sizeof(*task));
+        if (g_simSchedulerStacks.stackBytes && !(task->stack = SimStackAlloc())) {
+            break;
+        }
+        /* A worker keeps new tasks to itself, otherwise they spread over the cores */
+        if (g_simSchedulerWorker) {
+            task->core = (uint8_t) SimSchedulerWorkerCore(g_simSchedulerWorker);
+        } else if (!g_simSchedulerPool.dispatching) {
+            task->core = SimSchedulerLeastLoaded(SimSchedulerAllowed(task));
+        }
+        task->lastCore = SIM_SCHEDULER_NO_CORE;
+        if (++g_simSchedulerGeneration == 0) {
+            g_simSchedulerGeneration = 1;
+        }
+        task->generation = g_simSchedulerGeneration;
+        task->handle =
+            (TaskHandle) (((uintptr_t) task->generation << TASK_HANDLE_INDEX_BITS) | (uintptr_t) i);
+        task->func = taskFunc;
+        task->args = args;
+        task->priority = priority;
+        task->basePriority = priority;
+        task->allocated = true;
+        if (i >= g_simScheduler.taskSlots) {
+            g_simScheduler.taskSlots = i + 1;
+        }
+        task->stats.createdUs = SIM_TIMER_GetCurrentTime();
+        if (timing) {
+            task->periodic = true;
+            task->timing = *timing;
+            task->stats.jobs = 1;
+            SimSchedulerStartJob(task, task->stats.createdUs);
+            task->releaseEvent = SimKernelPost(task->stats.createdUs + timing->periodUs,
+                                               SimSchedulerOnRelease, task->handle);
+            if (!task->deadlineEvent || !task->releaseEvent) {
+                SimSchedulerFree(task);
+                break;
+            }
+        }
+        SimSchedulerMakeReady(task);
+
+        if (task->readyHostNs) {
+            SimSchedulerTraceRecord created = {.task = (uint64_t) (uintptr_t) task->handle,
+                                               .readyUs = task->stats.createdUs,
+                                               .startUs = task->stats.createdUs,
+                                               .endUs = task->stats.createdUs,
+                                               .readyNs = task->readyHostNs,
+                                               .startNs = task->readyHostNs,
+                                               .endNs = task->readyHostNs,
+                                               .index = (uint16_t) i,
+                                               .priority = (uint8_t) priority,
+                                               .event = SIM_SCHEDULER_TRACE_CREATED};
+            SimSchedulerTraceAppend(&created);
+        }
+        SimSchedulerUnlock();
+
+        *taskHandle = task->handle;
+
+        printf("[SIM_SCHEDULER] Created task %p\n", *taskHandle);
+        return HAL_OK;
+    }
+    SimSchedulerUnlock();
+
+    return HAL_ERROR;
+}
+
+/* Non-preemptive response-time test of order[i], tasks sorted highest priority first */
+static bool SimSchedulerRmFits(const SimTask* const* order, uint32_t count, uint32_t i)
+{
+    uint64_t budget = order[i]->timing.budgetUs;
+    uint64_t deadline = order[i]->timing.deadlineUs;
+
+    /* A lower-priority job that just started runs to the end of its budget */
+    uint64_t blocking = 0;
+    for (uint32_t k = i + 1; k < count; k++) {
+        if (order[k]->timing.budgetUs > blocking) {
+            blocking = order[k]->timing.budgetUs;
+        }
+    }
+
+    /* Longest wait to start: blocking plus higher-priority jobs released until then */
+    uint64_t wait = blocking;
+    for (;;) {
+        uint64_t next = blocking;
+        for (uint32_t j = 0; j < i; j++) {
+            next += (wait / order[j]->timing.periodUs + 1) * order[j]->timing.budgetUs;
+        }
+        if (next + budget > deadline)
+            return false;
+        if (next == wait)
+            return true;
+        wait = next;
+    }
+}
+
+/* Simulator control functions */
+int SIM_SCHEDULER_GetStats(SimSchedulerStats* stats)
+{
+    if (!stats)
+        return -1;
+
+    *stats = g_simScheduler.stats;
+    return 0;
+}
+
+/* Restart the pool with a number of workers */
+static int SimSchedulerStartPool(uint32_t workers)
+{
+    SimSchedulerStopPool();
+    memset(g_simSchedulerPool.worker, 0, sizeof(g_simSchedulerPool.worker));
+
+    for (uint32_t i = 0; i < SIM_SCHEDULER_MAX_WORKERS; i++) {
+        g_simSchedulerPool.worker[i].index = i;
+    }
+    for (uint32_t i = 1; i < workers; i++) {
+        if (pthread_create(&g_simSchedulerPool.threads[i], NULL, SimSchedulerWorkerMain,
+                           &g_simSchedulerPool.worker[i]) != 0) {
+            SimSchedulerStopPool();
+            printf("[SIM_SCHEDULER] ERROR: Failed to start worker %u\n", i);
+            return -1;
+        }
+        g_simSchedulerPool.workers = i + 1;
+    }
+    return 0;
+}
+
+/* Change the core count, moving tasks queued on a core that goes away to one that stays */
+static void SimSchedulerSetCoreCount(uint32_t count, bool hostThreads)
+{
+    SimTask* queued[MAX_TASKS];
+    uint32_t tasks = 0;
+
+    for (uint32_t c = 0; c < g_simSchedulerCores.count; c++) {
+        SimSchedulerCore* core = &g_simScheduler.cores[c];
+        SimSchedulerReceive(core);
+
+        SimTask* task;
+        while ((task = SimSchedulerPickNext(core)) != NULL) {
+            SimSchedulerUnqueue(task);
+            queued[tasks++] = task;
+        }
+    }
+
+    g_simSchedulerCores.count = count;
+    g_simSchedulerCores.hostThreads = hostThreads;
+    for (uint32_t i = 0; i < tasks; i++) {
+        SimSchedulerEnqueue(queued[i]);
+    }
+}
+
+int SIM_SCHEDULER_SetWorkers(uint32_t workers)
+{
+    if (workers > SIM_SCHEDULER_MAX_WORKERS || g_simScheduler.running)
+        return -1;
+    if (workers > 1 && SimSchedulerHasPeriodic()) {
+        printf("[SIM_SCHEDULER] ERROR: Periodic tasks need the single-threaded dispatcher\n");
+        return -1;
+    }
+
+    SimSchedulerSetCoreCount(1, false);
+    return SimSchedulerStartPool(workers);
+}
+
+int SIM_SCHEDULER_SetCores(uint32_t cores, bool hostThreads)
+{
+    cores = cores ? cores : 1;
+    hostThreads = hostThreads && cores > 1;
+    if (cores > SIM_SCHEDULER_MAX_CORES || g_simScheduler.running)
+        return -1;
+    if (hostThreads && SimSchedulerHasPeriodic()) {
+        printf("[SIM_SCHEDULER] ERROR: Periodic tasks need the single-threaded dispatcher\n");
+        return -1;
+    }
+
+    int status = SimSchedulerStartPool(hostThreads ? cores : 1);
+    SimSchedulerSetCoreCount(status == 0 ? cores : 1, status == 0 && hostThreads);
+    for (uint32_t c = 0; c < SIM_SCHEDULER_MAX_CORES; c++) {
+        memset(&g_simScheduler.cores[c].stats, 0, sizeof(SimSchedulerCoreStats));
+    }
+    g_simScheduler.coreSinceUs = SIM_TIMER_GetCurrentTime();
+    g_simScheduler.nextCore = 0;
+    return status;
+}
+
+int SIM_SCHEDULER_GetCoreStats(uint32_t core, SimSchedulerCoreStats* stats)
+{
+    if (!stats || core >= g_simSchedulerCores.count)
+        return -1;
+
+    uint64_t elapsedUs = SIM_TIMER_GetCurrentTime() - g_simScheduler.coreSinceUs;
+    *stats = g_simScheduler.cores[core].stats;
+    stats->utilization = elapsedUs ? (double) stats->busyUs / (double) elapsedUs : 0.0;
+    return 0;
+}
+
+int SIM_SCHEDULER_GetWorkerStats(uint32_t worker, SimSchedulerWorkerStats* stats)
+{
+    if (!stats || worker >= g_simSchedulerPool.workers)
+        return -1;
+
+    *stats = g_simSchedulerPool.worker[worker].stats;
+    return 0;
+}
+
+int SIM_SCHEDULER_PrintTaskReport(void)
+{
+    if (!g_simScheduler.initialized || g_simScheduler.running)
+        return -1;
+
+    printf("[SIM_SCHEDULER] Task report (latency = ready to run; host ns measured while "
+           "tracing)\n");
+    printf("[SIM_SCHEDULER] %4s %4s %10s %12s %12s %12s %12s %12s %12s\n", "task", "prio", "runs",
+           "run avg ns", "run max ns", "lat avg us", "lat max us", "lat avg ns", "lat max ns");
+
+    for (int i = 0; i < g_simScheduler.taskSlots; i++) {
+        const SimTask* task = &g_simScheduler.tasks[i];
+        if (!task->allocated || task->deleted) {
+            continue;
+        }
+
+        const TaskStats* stats = &task->stats;
+        uint64_t runs = stats->runs ? stats->runs : 1;
+        printf("[SIM_SCHEDULER] %4d %4d %10llu %12llu %12llu %12llu %12llu %12llu %12llu\n", i,
+               task->priority, (unsigned long long) stats->runs,
+               (unsigned long long) (stats->runNs / runs), (unsigned long long) stats->maxRunNs,
+               (unsigned long long) (stats->latencyUs / runs),
+               (unsigned long long) stats->maxLatencyUs,
+               (unsigned long long) (stats->latencyNs / runs),
+               (unsigned long long) stats->maxLatencyNs);
+    }
+
+    for (int i = 0; i < g_simScheduler.taskSlots; i++) {
+        const SimTask* task = &g_simScheduler.tasks[i];
+        if (!task->allocated || task->deleted || !task->periodic) {
+            continue;
+        }
+        printf("[SIM_SCHEDULER] %4d period %u us, deadline %u us, budget %u us: %llu jobs, "
+               "response max %llu us, %llu deadline misses, %llu overruns\n",
+               i, task->timing.periodUs, task->timing.deadlineUs, task->timing.budgetUs,
+               (unsigned long long) task->stats.jobs,
+               (unsigned long long) task->stats.maxResponseUs,
+               (unsigned long long) task->stats.deadlineMisses,
+               (unsigned long long) task->stats.overruns);
+    }
+
+    for (int i = 0; i < g_simScheduler.taskSlots; i++) {
+        const SimTask* task = &g_simScheduler.tasks[i];
+        if (!task->allocated || task->deleted || !task->stats.delays) {
+            continue;
+        }
+        printf("[SIM_SCHEDULER] %4d %llu sleeps, wake jitter avg %llu us, max %llu us, "
+               "%llu late wakes\n",
+               i, (unsigned long long) task->stats.delays,
+               (unsigned long long) (task->stats.jitterUs / task->stats.delays),
+               (unsigned long long) task->stats.maxJitterUs,
+               (unsigned long long) task->stats.lateWakes);
+    }
+
+    for (int i = 0; i < g_simScheduler.taskSlots && g_simScheduler.preemptive; i++) {
+        const SimTask* task = &g_simScheduler.tasks[i];
+        if (!task->allocated || task->deleted || !task->stats.responses) {
+            continue;
+        }
+        printf("[SIM_SCHEDULER] %4d %llu preemptions, response avg %llu us over %llu responses\n",
+               i, (unsigned long long) task->stats.preemptions,
+               (unsigned long long) (task->stats.responseUs / task->stats.responses),
+               (unsigned long long) task->stats.responses);
+    }
+
+    for (uint32_t c = 0; c < g_simSchedulerCores.count && g_simSchedulerCores.count > 1; c++) {
+        SimSchedulerCoreStats stats;
+        SIM_SCHEDULER_GetCoreStats(c, &stats);
+        printf("[SIM_SCHEDULER] core %u: %llu runs, busy %llu us (%.1f%%), %llu ipis, "
+               "%llu migrations\n",
+               c, (unsigned long long) stats.tasksRun, (unsigned long long) stats.busyUs,
+               stats.utilization * 100.0, (unsigned long long) stats.ipis,
+               (unsigned long long) stats.migrations);
+    }
+    return 0;
+}
+
+int SIM_SCHEDULER_GetScheduleOrder(ScheduleHandle scheduleHandle, TaskHandle* order,
+                                   uint32_t maxTasks, uint32_t* count)
+{
+    const SimSchedule* schedule = SimSchedulerFindSchedule(scheduleHandle);
+    if (!schedule || !count || (!order && maxTasks))
+        return -1;
+
+    for (uint32_t i = 0; i < schedule->count && i < maxTasks; i++) {
+        order[i] = g_simScheduler.tasks[schedule->entries[i].index].handle;
+    }
+    *count = schedule->count;
+    return 0;
+}
+
+int SIM_SCHEDULER_SetPolicy(SimSchedulerPolicy policy)
+{
+    if ((unsigned) policy > SIM_SCHEDULER_POLICY_EDF || g_simScheduler.running)
+        return -1;
+
+    g_simSchedulerPolicy = policy;
+    return 0;
+}
+
+int SIM_SCHEDULER_Analyze(SimSchedulerAnalysis* analysis)
+{
+    if (!analysis)
+        return -1;
+
+    /* Highest RM priority first; EDF only needs the deadlines */
+    const SimTask* order[MAX_TASKS];
+    uint32_t count = 0;
+    uint64_t utilization = 0;
+    uint64_t density = 0;
+    for (int i = 0; i < g_simScheduler.taskSlots; i++) {
+        const SimTask* task = &g_simScheduler.tasks[i];
+        if (!task->allocated || task->deleted || !task->periodic) {
+            continue;
+        }
+        utilization += (uint64_t) task->timing.budgetUs * 1000000 / task->timing.periodUs;
+        density += (uint64_t) task->timing.budgetUs * 1000000 / task->timing.deadlineUs;
+
+        uint32_t k = count++;
+        while (k > 0 && SimSchedulerRmBefore(task, order[k - 1])) {
+            order[k] = order[k - 1];
+            k--;
+        }
+        order[k] = task;
+    }
+
+    memset(analysis, 0, sizeof(*analysis));
+    analysis->tasks = count;
+    analysis->utilizationPpm = (uint32_t) utilization;
+    analysis->boundPpm = 1000000;
+    analysis->schedulable = true;
+
+    for (uint32_t i = 0; i < count && analysis->schedulable; i++) {
+        const TaskTiming* timing = &order[i]->timing;
+        if (g_simSchedulerPolicy == SIM_SCHEDULER_POLICY_RM) {
+            analysis->schedulable = SimSchedulerRmFits(order, count, i);
+        } else {
+            /* Demand of all tasks plus a job with a later deadline that just started */
+            uint64_t blocking = 0;
+            for (uint32_t k = 0; k < count; k++) {
+                if (order[k]->timing.deadlineUs > timing->deadlineUs &&
+                    order[k]->timing.budgetUs > blocking) {
+                    blocking = order[k]->timing.budgetUs;
+                }
+            }
+            analysis->schedulable = density + blocking * 1000000 / timing->deadlineUs <= 1000000;
+        }
+        if (!analysis->schedulable) {
+            analysis->critical = order[i]->handle;
+        }
+    }
+
+    if (g_simSchedulerPolicy == SIM_SCHEDULER_POLICY_RM && count) {
+        analysis->boundPpm = (uint32_t) (count * (pow(2.0, 1.0 / count) - 1.0) * 1000000.0);
+    }
+    return 0;
+}
+
+static void SimSchedulerWake(void* arg, uint64_t nowUs)
+{
+    (void) nowUs;
+    SimTask* task = SimSchedulerFindTask((TaskHandle) arg);
+    if (task && task->sleeps) {
+        task->sleeps--;
+    }
+    HAL_SCHEDULER_ResumeTask((TaskHandle) arg);
+}
+
+int SIM_SCHEDULER_ResumeAt(TaskHandle taskHandle, uint64_t timeUs)
+{
+    SimTask* task = SimSchedulerFindTask(taskHandle);
+    if (!task || !SimKernelPost(timeUs, SimSchedulerWake, (void*) taskHandle))
+        return -1;
+
+    task->sleeps++;
+    return 0;
+}
+
+/* Whether a task waits for a point in simulated time that a kernel event will bring */
+static bool SimSchedulerSleeping(void)
+{
+    for (int i = 0; i < g_simScheduler.taskSlots; i++) {
+        const SimTask* task = &g_simScheduler.tasks[i];
+        if (task->allocated && !task->deleted && !task->frozen &&
+            (task->periodic || task->sleeps || task->waitEvent))
+            return true;
+    }
+    return false;
+}
+
+int SIM_SCHEDULER_SetTickless(bool enable)
+{
+    if (!g_simScheduler.initialized || g_simScheduler.running)
+        return -1;
+
+    g_simScheduler.tickless = enable;
+    return 0;
+}
+
+int SIM_SCHEDULER_SetIdleHook(SimSchedulerIdleHook hook, void* userData)
+{
+    if (!g_simScheduler.initialized)
+        return -1;
+
+    g_simScheduler.idleHook = hook;
+    g_simScheduler.idleUserData = userData;
+    return 0;
+}
+
+int SIM_SCHEDULER_GetIdleStats(SimSchedulerIdleStats* stats)
+{
+    if (!stats)
+        return -1;
+
+    uint64_t nowUs = SIM_TIMER_GetCurrentTime();
+    *stats = g_simScheduler.idle;
+    stats->elapsedUs = nowUs > g_simScheduler.runStartUs ? nowUs - g_simScheduler.runStartUs : 0;
+    return 0;
+}
+
+int SIM_SCHEDULER_SetPreemptive(bool enable)
+{
+    if (!g_simScheduler.initialized || g_simScheduler.running)
+        return -1;
+
+    g_simScheduler.preemptive = enable;
+    return 0;
+}
+
+int SIM_SCHEDULER_SetQuantum(TaskPriority priority, uint32_t quantumUs)
+{
+    if (!g_simScheduler.initialized || g_simScheduler.running ||
+        (unsigned) priority >= SIM_SCHEDULER_PRIORITY_LEVELS)
+        return -1;
+
+    g_simScheduler.quantumUs[priority] = quantumUs;
+    return 0;
+}
+
+/* Running stackful task preemptive dispatching may switch out here, NULL if none */
+static SimTask* SimSchedulerPreemptible(void)
+{
+    int current = g_simSchedulerCurrent;
+    if (!g_simScheduler.preemptive || current == SIM_SCHEDULER_NO_TASK || g_simSchedulerWorker ||
+        SimKernelInHandler())
+        return NULL;
+
+    SimTask* task = &g_simScheduler.tasks[current];
+    return task->stack && !task->frozen && SimSchedulerState(task) == TASK_STATE_RUNNING ? task
+                                                                                          : NULL;
+}
+
+/*
+ * Switch the running task out if a ready task outranks it, or if its slice is over and
+ * another task of its level is ready; returns once it is dispatched again. There are no
+ * host timer signals: a task's work is the simulated time it spends in HAL_TIMER_DelayUs,
+ * stepped event by event with a check after each step.
+ */
+static void SimSchedulerPreemptCheck(SimTask* task)
+{
+    SimSchedulerCore* core = &g_simScheduler.cores[task->core];
+    SimSchedulerReceive(core);
+    SimTask* next = SimSchedulerPickNext(core);
+    uint64_t nowUs = SIM_TIMER_GetCurrentTime();
+    bool sliceOver = nowUs >= task->sliceEndUs;
+
+    if (next && SimSchedulerOutranks(next, task)) {
+        task->preempted = true;
+    } else if (sliceOver && next && !next->periodic && !task->periodic &&
+               next->priority == task->priority) {
+        task->preempted = true;
+        task->sliceOver = true;
+    } else {
+        if (sliceOver) {
+            /* Nobody to take turns with: the next slice starts right away */
+            uint32_t quantumUs = g_simScheduler.quantumUs[task->priority];
+            task->sliceEndUs = quantumUs ? nowUs + quantumUs : UINT64_MAX;
+        }
+        return;
+    }
+    SimSchedulerSwitchOut(task);
+}
+
+/* The running task may have made a task ready that outranks it */
+static void SimSchedulerPreemptPoint(void)
+{
+    SimTask* task = SimSchedulerPreemptible();
+    if (task) {
+        SimSchedulerPreemptCheck(task);
+    }
+}
+
+int SIM_SCHEDULER_SetTaskStacks(size_t stackBytes)
+{
+    if (g_simScheduler.running ||
+        (stackBytes && stackBytes < SIM_SCHEDULER_MIN_STACK_BYTES))
+        return -1;
+
+    if (!g_simSchedulerStacks.pageBytes) {
+        long page = sysconf(_SC_PAGESIZE);
+        g_simSchedulerStacks.pageBytes = page > 0 ? (size_t) page : 4096;
+    }
+    size_t page = g_simSchedulerStacks.pageBytes;
+    g_simSchedulerStacks.stackBytes = (stackBytes + page - 1) & ~(page - 1);
+
+    /* Pooled stacks of the old size go; those in use return to the pool or go when freed */
+    while (g_simSchedulerStacks.free) {
+        SimStack* stack = g_simSchedulerStacks.free;
+        g_simSchedulerStacks.free = stack->next;
+        SimStackUnmap(stack);
+    }
+    return 0;
+}
+
+/* Internal interface */
+bool SimSchedulerWaitSwitch(void)
+{
+    int current = g_simSchedulerCurrent;
+    if (current == SIM_SCHEDULER_NO_TASK || !g_simScheduler.tasks[current].stack)
+        return false;
+
+    bool others = false;
+    SimSchedulerWorker* worker = g_simSchedulerWorker;
+    if (worker) {
+        const SimSchedulerCore* core = &g_simScheduler.cores[SimSchedulerWorkerCore(worker)];
+        others = SimTaskSetAtomicAny(&core->mailbox);
+        for (int level = 0; level < SIM_SCHEDULER_PRIORITY_LEVELS && !others; level++) {
+            others = __atomic_load_n(&g_simSchedulerPool.readyCount[level], __ATOMIC_RELAXED) > 0;
+        }
+    } else {
+        others = SimSchedulerAnyReady();
+    }
+    if (!others)
+        return false;
+
+    HAL_SCHEDULER_Yield();
+    return true;
+}
+
+void SimSchedulerRunReady(uint64_t untilUs)
+{
+    if (g_simScheduler.initialized && !g_simScheduler.running && SimSchedulerAnyReady()) {
+        SimSchedulerRunFrame(untilUs);
+    }
+}
 
-#include "hal_scheduler.h"
+void SimSchedulerBeginRun(void)
+{
+    memset(&g_simScheduler.idle, 0, sizeof(g_simScheduler.idle));
+    g_simScheduler.runStartUs = SIM_TIMER_GetCurrentTime();
+}
 
-#define MAX_TASKS 64
+/* The kernel jumped the clock with no task ready: book the jump as idle time of this run */
+void SimSchedulerIdle(uint64_t nowUs, uint64_t wakeUs)
+{
+    if (!g_simScheduler.initialized || g_simScheduler.running || SimSchedulerAnyReady())
+        return;
 
-typedef struct {
-    TaskHandle handle;
-    TaskFunction func;
-    void* args;
-    TaskPriority priority;
-    TaskState state;
-    bool allocated;
-} SimTask;
+    uint64_t sleepUs = wakeUs - nowUs;
+    g_simScheduler.idle.idleUs += sleepUs;
+    g_simScheduler.idle.sleeps++;
+    if (sleepUs > g_simScheduler.idle.maxSleepUs) {
+        g_simScheduler.idle.maxSleepUs = sleepUs;
+    }
+    if (g_simScheduler.idleHook) {
+        g_simScheduler.idleHook(nowUs, wakeUs, g_simScheduler.idleUserData);
+    }
+}
 
-static struct {
-    bool initialized;
-    SimTask tasks[MAX_TASKS];
-    uint32_t nextHandle;
-} g_simScheduler = {0};
+bool SimSchedulerSpend(uint64_t us)
+{
+    SimTask* task = SimSchedulerPreemptible();
+    if (!task || !SimTimerInitialized())
+        return false;
+
+    /*
+     * Work from event to event, since any of them may wake a task that outranks this
+     * one; time that passes while the task is switched out is not its work
+     */
+    uint64_t leftUs = us;
+    for (;;) {
+        SimSchedulerPreemptCheck(task);
+        if (!leftUs)
+            break;
+
+        uint64_t nowUs = SIM_TIMER_GetCurrentTime();
+        uint64_t untilUs = nowUs + leftUs;
+        uint64_t nextUs = SIM_KERNEL_GetNextEventTime();
+        if (nextUs < untilUs) {
+            untilUs = nextUs > nowUs ? nextUs : nowUs;
+        }
+        if (task->sliceEndUs > nowUs && task->sliceEndUs < untilUs) {
+            untilUs = task->sliceEndUs;
+        }
+        SimKernelRunUntil(untilUs, false);
+        leftUs -= untilUs - nowUs;
+    }
+    return true;
+}
+
+/* End a task's wait; called with the pool lock held */
+static void SimSchedulerEndWait(SimTask* task, bool timedOut)
+{
+    SimSchedulerLeaveWait(task);
+    task->timedOut = timedOut;
+
+    if (__atomic_load_n(&task->onStack, __ATOMIC_RELAXED)) {
+        /* Woken before it switched out: it simply keeps running */
+        if (SimSchedulerState(task) == TASK_STATE_BLOCKED) {
+            SimSchedulerSetState(task, TASK_STATE_RUNNING);
+        }
+    } else {
+        /* A waiter suspended meanwhile stays so until resumed */
+        SimSchedulerUnblock(task);
+    }
+}
+
+static void SimSchedulerWaitExpired(void* arg, uint64_t nowUs)
+{
+    (void) nowUs;
+    SimSchedulerLock();
+    SimTask* task = SimSchedulerFindTask((TaskHandle) arg);
+    if (task && !task->deleted && task->waitList) {
+        task->waitEvent = 0; /* Firing now */
+        SimSchedulerEndWait(task, true);
+    }
+    SimSchedulerUnlock();
+}
+
+/*
+ * Block a stackful task on a wait list until it is woken or its deadline passes. Queues
+ * and sync objects wake the highest-priority waiter; a kernel event ends the wait at the
+ * deadline otherwise.
+ */
+static int SimSchedulerBlock(SimTask* task, SimWaitList* list, bool (*ready)(void* arg),
+                             void* arg, uint64_t deadlineUs)
+{
+    SimSchedulerLock();
+    /* Registered before the re-check: a waker that changes the condition next sees the bit */
+    SimTaskSetAtomicAdd(&list->waiters, task);
+    if (ready(arg)) {
+        SimTaskSetAtomicRemove(&list->waiters, task);
+        SimSchedulerUnlock();
+        return HAL_OK;
+    }
+
+    task->waitList = list;
+    task->timedOut = false;
+    if (deadlineUs != UINT64_MAX) {
+        task->waitEvent = SimKernelPost(deadlineUs, SimSchedulerWaitExpired, task->handle);
+    }
+    SimSchedulerSetState(task, TASK_STATE_BLOCKED);
+    SimSchedulerUnlock();
+
+    SimSchedulerSwitchOut(task);
+
+    /* Resumed rather than woken, it still holds its place on the list */
+    SimSchedulerLock();
+    SimSchedulerLeaveWait(task);
+    SimSchedulerUnlock();
+    return task->timedOut ? HAL_TIMEOUT : HAL_OK;
+}
+
+int SimSchedulerWait(SimWaitList* list, bool (*ready)(void* arg), void* arg, uint64_t deadlineUs)
+{
+    uint64_t nowUs = SIM_TIMER_GetCurrentTime();
+    if (nowUs >= deadlineUs)
+        return HAL_TIMEOUT;
+
+    int current = g_simSchedulerCurrent;
+    SimTask* task = current != SIM_SCHEDULER_NO_TASK ? &g_simScheduler.tasks[current] : NULL;
+
+    /* Simulated time stands still during a multi-threaded frame, so only a wait without
+       deadline can block there */
+    if (task && task->stack && (!g_simSchedulerWorker || deadlineUs == UINT64_MAX))
+        return SimSchedulerBlock(task, list, ready, arg, deadlineUs);
+
+    if (g_simSchedulerWorker) {
+        /* Spin while other tasks are queued or running and could change the condition */
+        if (__atomic_load_n(&g_simSchedulerPool.active, __ATOMIC_SEQ_CST) <= 1)
+            return HAL_TIMEOUT;
+        if (!SimSchedulerWaitSwitch()) {
+            sched_yield();
+        }
+        return HAL_OK;
+    }
+
+    /* Nothing else runs meanwhile: let simulated time run to the next event */
+    uint64_t nextUs = SIM_KERNEL_GetNextEventTime();
+    if (nextUs > deadlineUs) {
+        nextUs = deadlineUs;
+    }
+    if (nextUs == UINT64_MAX || !SimTimerInitialized())
+        return HAL_TIMEOUT;
+    return SIM_TIMER_AdvanceTime(nextUs > nowUs ? nextUs - nowUs : 0) == 0 ? HAL_OK : HAL_ERROR;
+}
+
+/* Wake the highest-priority waiter of a list, true if there was one */
+static bool SimSchedulerWakeBest(SimWaitList* list)
+{
+    /* Pairs with the waiter's registration: the caller's change is visible before the read */
+    if (g_simSchedulerPool.dispatching) {
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    }
+    if (!SimTaskSetAtomicAny(&list->waiters))
+        return false;
+
+    SimSchedulerLock();
+    SimTaskSet waiters = SimTaskSetAtomicLoad(&list->waiters);
+    SimTask* best = NULL;
+    SimTask* task;
+    while ((task = SimTaskSetPop(&waiters)) != NULL) {
+        if (task->waitList != list) {
+            /* Left over from before a HAL_SCHEDULER_Init */
+            SimTaskSetAtomicRemove(&list->waiters, task);
+        } else if (SimSchedulerState(task) != TASK_STATE_SUSPENDED &&
+                   (!best || task->priority > best->priority)) {
+            best = task;
+        }
+    }
+    if (best) {
+        SimSchedulerEndWait(best, false);
+    }
+    SimSchedulerUnlock();
+    return best != NULL;
+}
+
+bool SimSchedulerWakeOne(SimWaitList* list)
+{
+    if (!SimSchedulerWakeBest(list))
+        return false;
+
+    SimSchedulerPreemptPoint();
+    return true;
+}
+
+void SimSchedulerWakeAll(SimWaitList* list)
+{
+    bool woken = false;
+    while (SimSchedulerWakeBest(list)) {
+        woken = true;
+    }
+    if (woken) {
+        SimSchedulerPreemptPoint();
+    }
+}
+
+uint32_t SimSchedulerCountWaiters(const SimWaitList* list)
+{
+    SimTaskSet waiters = SimTaskSetAtomicLoad(&list->waiters);
+    return SimTaskSetCount(&waiters);
+}
+
+TaskHandle SimSchedulerSelf(void)
+{
+    int current = SimSchedulerCurrent();
+    return current != SIM_SCHEDULER_NO_TASK ? g_simScheduler.tasks[current].handle : NULL;
+}
+
+int SimSchedulerGetPriority(TaskHandle taskHandle, bool inherited)
+{
+    const SimTask* task = SimSchedulerFindTask(taskHandle);
+    if (!task)
+        return -1;
+
+    return (int) (inherited ? task->priority : task->basePriority);
+}
+
+void SimSchedulerSetInherited(TaskHandle taskHandle, int priority)
+{
+    if (priority < 0 || priority >= SIM_SCHEDULER_PRIORITY_LEVELS)
+        return;
+
+    SimSchedulerLock();
+    SimTask* task = SimSchedulerFindTask(taskHandle);
+    if (task && !task->periodic && task->priority != (TaskPriority) priority) {
+        /* A task in a worker's deque keeps its place there until it is taken */
+        bool listed =
+            !g_simSchedulerPool.dispatching && SimSchedulerState(task) == TASK_STATE_READY;
+        if (listed) {
+            SimSchedulerUnqueue(task);
+        }
+        task->priority = (TaskPriority) priority;
+        if (listed) {
+            SimSchedulerEnqueue(task);
+        }
+    }
+    SimSchedulerUnlock();
+}
+
+int SimSchedulerWaitersPriority(const SimWaitList* list)
+{
+    int best = -1;
+    SimSchedulerLock();
+    SimTaskSet waiters = SimTaskSetAtomicLoad(&list->waiters);
+    const SimTask* task;
+    while ((task = SimTaskSetPop(&waiters)) != NULL) {
+        if (task->waitList == list && (int) task->priority > best) {
+            best = (int) task->priority;
+        }
+    }
+    SimSchedulerUnlock();
+    return best;
+}
+
+bool SimSchedulerIsWaiting(const SimWaitList* list, TaskHandle taskHandle)
+{
+    const SimTask* task = SimSchedulerFindTask(taskHandle);
+    return task && task->waitList == list && SimTaskSetAtomicHas(&list->waiters, task);
+}
 
 /* HAL interface implementation */
 int HAL_SCHEDULER_Init(void)
 {
+    if (g_simScheduler.running)
+        return HAL_ERROR;
+
+    for (int i = 0; i < MAX_TASKS; i++) {
+        if (g_simScheduler.tasks[i].stack) {
+            SimStackRelease(g_simScheduler.tasks[i].stack);
+        }
+    }
+    memset(&g_simScheduler, 0, sizeof(g_simScheduler));
+    for (uint32_t c = 0; c < SIM_SCHEDULER_MAX_CORES; c++) {
+        for (int level = 0; level < SIM_SCHEDULER_PRIORITY_LEVELS; level++) {
+            g_simScheduler.cores[c].readyHead[level] = SIM_SCHEDULER_NO_TASK;
+            g_simScheduler.cores[c].readyTail[level] = SIM_SCHEDULER_NO_TASK;
+        }
+    }
+    g_simScheduler.currentCore = SIM_SCHEDULER_NO_CORE;
+    g_simScheduler.coreSinceUs = SIM_TIMER_GetCurrentTime();
+    for (uint32_t i = 0; i < g_simSchedulerPool.workers; i++) {
+        memset(&g_simSchedulerPool.worker[i].stats, 0, sizeof(SimSchedulerWorkerStats));
+    }
     g_simScheduler.initialized = true;
-    g_simScheduler.nextHandle = 1;
 
     printf("[SIM_SCHEDULER] Initialized\n");
     return HAL_OK;
@@ -38,91 +2418,479 @@ int HAL_SCHEDULER_Init(void)
 int HAL_SCHEDULER_CreateTask(TaskFunction taskFunc, void* args, TaskPriority priority,
                              TaskHandle* taskHandle)
 {
-    if (!g_simScheduler.initialized || !taskFunc || !taskHandle) {
+    if (!g_simScheduler.initialized || !taskFunc || !taskHandle ||
+        (unsigned) priority >= SIM_SCHEDULER_PRIORITY_LEVELS) {
         return HAL_ERROR;
     }
 
-    for (int i = 0; i < MAX_TASKS; i++) {
-        if (!g_simScheduler.tasks[i].allocated) {
-            g_simScheduler.tasks[i].handle = (TaskHandle) (uintptr_t) (g_simScheduler.nextHandle++);
-            g_simScheduler.tasks[i].func = taskFunc;
-            g_simScheduler.tasks[i].args = args;
-            g_simScheduler.tasks[i].priority = priority;
-            g_simScheduler.tasks[i].state = TASK_STATE_READY;
-            g_simScheduler.tasks[i].allocated = true;
+    int status = SimSchedulerCreate(taskFunc, args, priority, NULL, taskHandle);
+    if (status == HAL_OK) {
+        SimSchedulerPreemptPoint();
+    }
+    return status;
+}
+
+int HAL_SCHEDULER_CreatePeriodicTask(TaskFunction taskFunc, void* args, const TaskTiming* timing,
+                                     TaskHandle* taskHandle)
+{
+    if (!g_simScheduler.initialized || !taskFunc || !taskHandle || !timing ||
+        !timing->periodUs || timing->deadlineUs > timing->periodUs) {
+        return HAL_ERROR;
+    }
+
+    TaskTiming checked = *timing;
+    if (!checked.deadlineUs) {
+        checked.deadlineUs = checked.periodUs;
+    }
+    if (checked.budgetUs > checked.deadlineUs)
+        return HAL_ERROR;
+
+    if (g_simSchedulerPool.workers > 1) {
+        printf("[SIM_SCHEDULER] ERROR: Periodic tasks need the single-threaded dispatcher\n");
+        return HAL_ERROR;
+    }
+
+    int status = SimSchedulerCreate(taskFunc, args, TASK_PRIORITY_REALTIME, &checked, taskHandle);
+    if (status == HAL_OK) {
+        SimSchedulerPreemptPoint();
+    }
+    return status;
+}
+
+int HAL_SCHEDULER_RegisterTimingCallback(TaskTimingCallback callback, void* userData)
+{
+    if (!g_simScheduler.initialized)
+        return HAL_ERROR;
+
+    g_simScheduler.timingCallback = callback;
+    g_simScheduler.timingUserData = userData;
+    return HAL_OK;
+}
+
+int HAL_SCHEDULER_AddDependency(TaskHandle producer, TaskHandle consumer)
+{
+    SimTask* from = SimSchedulerFindTask(producer);
+    SimTask* to = SimSchedulerFindTask(consumer);
+    if (g_simSchedulerPool.dispatching)
+        return HAL_BUSY;
+    if (!from || !to || from == to || from->deleted || to->deleted)
+        return HAL_ERROR;
+    if (from->periodic || to->periodic)
+        return HAL_ERROR;
+    if (from->frozen || to->frozen)
+        return HAL_BUSY;
+
+    if (SimTaskSetHas(&from->successors, to))
+        return HAL_OK;
+
+    if (SimSchedulerReaches(to, from)) {
+        printf("[SIM_SCHEDULER] ERROR: Dependency %p -> %p would close a cycle\n", producer,
+               consumer);
+        return HAL_ERROR;
+    }
 
-            *taskHandle = g_simScheduler.tasks[i].handle;
+    SimTaskSetAdd(&from->successors, to);
+    SimTaskSetAdd(&to->predecessors, from);
 
-            printf("[SIM_SCHEDULER] Created task %p\n", *taskHandle);
-            return HAL_OK;
+    /* Hold the consumer back only if it has yet to run in this frame */
+    bool waiting = to->state == TASK_STATE_READY || to->state == TASK_STATE_BLOCKED ||
+                   (to->state == TASK_STATE_SUSPENDED && !to->onStack);
+    if (from->state != TASK_STATE_COMPLETED && waiting) {
+        to->pending++;
+        if (to->state == TASK_STATE_READY) {
+            SimSchedulerUnqueue(to);
+            to->state = TASK_STATE_BLOCKED;
         }
     }
+    return HAL_OK;
+}
+
+int HAL_SCHEDULER_RearmGraph(TaskHandle taskHandle)
+{
+    if (g_simSchedulerPool.dispatching)
+        return HAL_BUSY;
+
+    SimTask* task = SimSchedulerFindTask(taskHandle);
+    if (!task || task->deleted)
+        return HAL_ERROR;
+    if (task->frozen)
+        return HAL_BUSY;
+
+    SimTaskSet graph = SimSchedulerGraph(task);
+
+    /* A frame still in flight cannot be re-armed */
+    SimTaskSet members = graph;
+    SimTask* member;
+    while ((member = SimTaskSetPop(&members)) != NULL) {
+        if (member->state != TASK_STATE_COMPLETED && member->state != TASK_STATE_SUSPENDED)
+            return HAL_BUSY;
+    }
 
-    return HAL_ERROR;
+    members = graph;
+    while ((member = SimTaskSetPop(&members)) != NULL) {
+        member->pending = SimTaskSetCount(&member->predecessors);
+        if (member->state != TASK_STATE_COMPLETED) {
+            continue;
+        }
+        if (member->pending) {
+            member->state = TASK_STATE_BLOCKED;
+        } else {
+            SimSchedulerEnqueue(member);
+        }
+    }
+    return HAL_OK;
 }
 
-int HAL_SCHEDULER_DeleteTask(TaskHandle taskHandle)
+/*
+ * Play the dispatcher over a freshly armed frame once and record the order; replaying is
+ * then a loop of calls with no queueing, counting or state changes
+ */
+int HAL_SCHEDULER_FreezeGraph(TaskHandle taskHandle, ScheduleHandle* scheduleHandle)
 {
-    for (int i = 0; i < MAX_TASKS; i++) {
-        if (g_simScheduler.tasks[i].allocated && g_simScheduler.tasks[i].handle == taskHandle) {
-            g_simScheduler.tasks[i].allocated = false;
+    if (!scheduleHandle)
+        return HAL_ERROR;
+    if (g_simSchedulerPool.dispatching)
+        return HAL_BUSY;
+
+    SimTask* task = SimSchedulerFindTask(taskHandle);
+    if (!task || task->deleted)
+        return HAL_ERROR;
+    if (task->frozen)
+        return HAL_BUSY;
+
+    SimTaskSet graph = SimSchedulerGraph(task);
+
+    /* Either a completed frame or one armed and not started yet */
+    uint32_t members = 0;
+    uint32_t completed = 0;
+    SimTaskSet mask = graph;
+    SimTask* member;
+    while ((member = SimTaskSetPop(&mask)) != NULL) {
+        if (member->stack || member->periodic)
+            return HAL_ERROR;
+        if (member->state == TASK_STATE_RUNNING || member->state == TASK_STATE_SUSPENDED ||
+            member->onStack)
+            return HAL_BUSY;
+        members++;
+        completed += member->state == TASK_STATE_COMPLETED;
+    }
+    if (completed && completed != members)
+        return HAL_BUSY;
+
+    int slot = 0;
+    while (slot < MAX_SCHEDULES && g_simScheduler.schedules[slot].allocated) {
+        slot++;
+    }
+    if (slot == MAX_SCHEDULES)
+        return HAL_ERROR;
 
-            printf("[SIM_SCHEDULER] Deleted task %p\n", taskHandle);
-            return HAL_OK;
+    SimSchedule* schedule = &g_simScheduler.schedules[slot];
+    SimSchedulerPlan(&graph, schedule);
+    schedule->members = graph;
+
+    mask = graph;
+    while ((member = SimTaskSetPop(&mask)) != NULL) {
+        if (member->state == TASK_STATE_READY) {
+            SimSchedulerUnqueue(member);
         }
+        member->state = TASK_STATE_COMPLETED;
+        member->pending = 0;
+        member->frozen = true;
     }
 
-    return HAL_ERROR;
+    if (++g_simSchedulerGeneration == 0) {
+        g_simSchedulerGeneration = 1;
+    }
+    schedule->generation = g_simSchedulerGeneration;
+    schedule->allocated = true;
+    uintptr_t raw = ((uintptr_t) schedule->generation << TASK_HANDLE_INDEX_BITS) | (uintptr_t) slot;
+    *scheduleHandle = (ScheduleHandle) raw;
+
+    printf("[SIM_SCHEDULER] Froze %u tasks into schedule %p\n", schedule->count, *scheduleHandle);
+    return HAL_OK;
+}
+
+int HAL_SCHEDULER_RunSchedule(ScheduleHandle scheduleHandle)
+{
+    const SimSchedule* schedule = SimSchedulerFindSchedule(scheduleHandle);
+    if (!schedule)
+        return HAL_ERROR;
+    if (g_simSchedulerPool.dispatching)
+        return HAL_BUSY;
+
+    /* May be called from a task: the frozen tasks run nested in it */
+    int outer = g_simSchedulerCurrent;
+    bool running = g_simScheduler.running;
+    g_simScheduler.running = true;
+
+    for (uint32_t i = 0; i < schedule->count; i++) {
+        const SimScheduleEntry* entry = &schedule->entries[i];
+        g_simSchedulerCurrent = entry->index;
+        entry->func(entry->args);
+    }
+
+    g_simSchedulerCurrent = outer;
+    g_simScheduler.running = running;
+    g_simScheduler.stats.replays++;
+    return HAL_OK;
+}
+
+int HAL_SCHEDULER_ThawSchedule(ScheduleHandle scheduleHandle)
+{
+    SimSchedule* schedule = SimSchedulerFindSchedule(scheduleHandle);
+    if (!schedule)
+        return HAL_ERROR;
+
+    SimTaskSet members = schedule->members;
+    SimTask* member;
+    while ((member = SimTaskSetPop(&members)) != NULL) {
+        member->frozen = false;
+    }
+    schedule->allocated = false;
+    return HAL_OK;
+}
+
+int HAL_SCHEDULER_DeleteTask(TaskHandle taskHandle)
+{
+    SimSchedulerLock();
+    SimTask* task = SimSchedulerFindTask(taskHandle);
+    if (!task || task->deleted || task->frozen || SimSchedulerForeign(task)) {
+        SimSchedulerUnlock();
+        return task && !task->deleted ? HAL_BUSY : HAL_ERROR;
+    }
+
+    if (task->state == TASK_STATE_READY) {
+        SimSchedulerUnqueue(task);
+    }
+    bool self = SimSchedulerIndex(task) == g_simSchedulerCurrent;
+    if (self) {
+        /* Still on the call stack, freed when it returns */
+        task->deleted = true;
+    } else {
+        SimSchedulerFree(task);
+    }
+    SimSchedulerUnlock();
+
+    printf("[SIM_SCHEDULER] Deleted task %p\n", taskHandle);
+    if (self && task->stack) {
+        SimSchedulerSwitchOut(task); /* Never dispatched again */
+    }
+    return HAL_OK;
 }
 
 int HAL_SCHEDULER_Start(void)
 {
+    if (!g_simScheduler.initialized || g_simScheduler.running)
+        return HAL_ERROR;
+
     printf("[SIM_SCHEDULER] Started\n");
+
+    SimSchedulerBeginRun();
+    SimSchedulerRunFrame(UINT64_MAX);
+
+    /* Tickless idle: sleep to the next event while some task waits for time */
+    while (g_simScheduler.tickless && !g_simScheduler.stopRequested && SimTimerInitialized() &&
+           SimSchedulerSleeping()) {
+        uint64_t nextUs = SIM_KERNEL_GetNextEventTime();
+        if (nextUs == UINT64_MAX)
+            break;
+        SimKernelRunUntil(nextUs, true);
+    }
     return HAL_OK;
 }
 
 int HAL_SCHEDULER_Stop(void)
 {
+    /* Takes effect when the running tasks return */
+    __atomic_store_n(&g_simScheduler.stopRequested, true, __ATOMIC_RELAXED);
+
     printf("[SIM_SCHEDULER] Stopped\n");
     return HAL_OK;
 }
 
 TaskState HAL_SCHEDULER_GetTaskState(TaskHandle taskHandle)
 {
-    for (int i = 0; i < MAX_TASKS; i++) {
-        if (g_simScheduler.tasks[i].allocated && g_simScheduler.tasks[i].handle == taskHandle) {
-            return g_simScheduler.tasks[i].state;
-        }
+    SimSchedulerLock();
+    const SimTask* task = SimSchedulerFindTask(taskHandle);
+    TaskState state = task && !task->deleted ? SimSchedulerState(task) : TASK_STATE_SUSPENDED;
+    SimSchedulerUnlock();
+
+    return state;
+}
+
+int HAL_SCHEDULER_GetTaskStats(TaskHandle taskHandle, TaskStats* stats)
+{
+    if (!stats)
+        return HAL_ERROR;
+
+    SimSchedulerLock();
+    const SimTask* task = SimSchedulerFindTask(taskHandle);
+    if (task && !task->deleted) {
+        *stats = task->stats;
     }
+    SimSchedulerUnlock();
 
-    return TASK_STATE_SUSPENDED;
+    return task && !task->deleted ? HAL_OK : HAL_ERROR;
 }
 
 int HAL_SCHEDULER_Yield(void)
 {
+    /* Outside a task there is nothing to give up */
+    int current = g_simSchedulerCurrent;
+    if (current != SIM_SCHEDULER_NO_TASK) {
+        SimTask* task = &g_simScheduler.tasks[current];
+        task->yielded = true;
+        if (task->stack) {
+            SimSchedulerSwitchOut(task);
+        }
+    }
     return HAL_OK;
 }
 
-int HAL_SCHEDULER_SuspendTask(TaskHandle taskHandle)
+/* Nobody wakes them: the wait's deadline event is the wakeup */
+static SimWaitList g_simSchedulerSleepers = {0};
+
+static bool SimSchedulerAwake(void* arg)
 {
-    for (int i = 0; i < MAX_TASKS; i++) {
-        if (g_simScheduler.tasks[i].allocated && g_simScheduler.tasks[i].handle == taskHandle) {
-            g_simScheduler.tasks[i].state = TASK_STATE_SUSPENDED;
-            return HAL_OK;
+    return SIM_TIMER_GetCurrentTime() >= *(const uint64_t*) arg;
+}
+
+/* Sleep until a simulated time, just yield if it has come */
+static int SimSchedulerSleepUntil(uint64_t wakeUs)
+{
+    /* Simulated time stands still during a multi-threaded frame */
+    if (g_simSchedulerWorker)
+        return HAL_ERROR;
+
+    int current = g_simSchedulerCurrent;
+    SimTask* task = current != SIM_SCHEDULER_NO_TASK ? &g_simScheduler.tasks[current] : NULL;
+    if (wakeUs <= SIM_TIMER_GetCurrentTime())
+        return HAL_SCHEDULER_Yield();
+
+    if (task) {
+        task->delayed = true;
+        task->wakeUs = wakeUs;
+        task->stats.delays++;
+        if (!task->stack) {
+            /* Suspended on return, dispatched again from the start at the wake time */
+            if (SIM_SCHEDULER_ResumeAt(task->handle, wakeUs) != 0) {
+                task->delayed = false;
+                return HAL_ERROR;
+            }
+            return HAL_SCHEDULER_SuspendTask(task->handle);
         }
     }
 
-    return HAL_ERROR;
+    /* A stackful task blocks until its timeout, anyone else lets time run up to it */
+    while (SIM_TIMER_GetCurrentTime() < wakeUs) {
+        int status = SimSchedulerWait(&g_simSchedulerSleepers, SimSchedulerAwake, &wakeUs, wakeUs);
+        if (status == HAL_ERROR)
+            return HAL_ERROR;
+        if (status == HAL_TIMEOUT)
+            break;
+    }
+    return SIM_TIMER_GetCurrentTime() >= wakeUs ? HAL_OK : HAL_ERROR;
+}
+
+int HAL_SCHEDULER_Delay(uint32_t delayUs)
+{
+    return SimSchedulerSleepUntil(SIM_TIMER_GetCurrentTime() + delayUs);
+}
+
+int HAL_SCHEDULER_DelayUntil(uint64_t* lastWakeUs, uint32_t periodUs)
+{
+    if (!lastWakeUs || !periodUs)
+        return HAL_ERROR;
+
+    /* The wake time moves by whole periods, however late the caller runs */
+    uint64_t wakeUs = *lastWakeUs + periodUs;
+    *lastWakeUs = wakeUs;
+
+    if (wakeUs < SIM_TIMER_GetCurrentTime()) {
+        int current = g_simSchedulerCurrent;
+        if (current != SIM_SCHEDULER_NO_TASK) {
+            g_simScheduler.tasks[current].stats.lateWakes++;
+        }
+        int status = SimSchedulerSleepUntil(wakeUs);
+        return status == HAL_OK ? HAL_TIMEOUT : status;
+    }
+    return SimSchedulerSleepUntil(wakeUs);
+}
+
+int HAL_SCHEDULER_SuspendTask(TaskHandle taskHandle)
+{
+    SimSchedulerLock();
+    SimTask* task = SimSchedulerFindTask(taskHandle);
+    if (!task || task->deleted || task->frozen || SimSchedulerForeign(task)) {
+        SimSchedulerUnlock();
+        return task && !task->deleted ? HAL_BUSY : HAL_ERROR;
+    }
+
+    if (task->state == TASK_STATE_READY) {
+        SimSchedulerUnqueue(task);
+    }
+    if (task->state != TASK_STATE_COMPLETED) {
+        SimSchedulerSetState(task, TASK_STATE_SUSPENDED);
+    }
+    bool self = SimSchedulerIndex(task) == g_simSchedulerCurrent;
+    SimSchedulerUnlock();
+
+    if (self && task->stack) {
+        SimSchedulerSwitchOut(task);
+    }
+    return HAL_OK;
 }
 
 int HAL_SCHEDULER_ResumeTask(TaskHandle taskHandle)
 {
-    for (int i = 0; i < MAX_TASKS; i++) {
-        if (g_simScheduler.tasks[i].allocated && g_simScheduler.tasks[i].handle == taskHandle) {
-            g_simScheduler.tasks[i].state = TASK_STATE_READY;
-            return HAL_OK;
+    SimSchedulerLock();
+    SimTask* task = SimSchedulerFindTask(taskHandle);
+    if (!task || task->deleted || task->frozen) {
+        SimSchedulerUnlock();
+        return task && !task->deleted ? HAL_BUSY : HAL_ERROR;
+    }
+
+    if (SimSchedulerState(task) == TASK_STATE_SUSPENDED) {
+        if (__atomic_load_n(&task->onStack, __ATOMIC_RELAXED)) {
+            /* Resumed before it returned: it simply keeps running */
+            SimSchedulerSetState(task, TASK_STATE_RUNNING);
+        } else {
+            /* Its last producer may complete on another worker meanwhile */
+            __atomic_store_n(&task->state, TASK_STATE_BLOCKED, __ATOMIC_SEQ_CST);
+            if (__atomic_load_n(&task->pending, __ATOMIC_SEQ_CST) == 0) {
+                SimSchedulerUnblock(task);
+            }
         }
     }
+    SimSchedulerUnlock();
 
-    return HAL_ERROR;
+    SimSchedulerPreemptPoint();
+    return HAL_OK;
+}
+
+int HAL_SCHEDULER_SetAffinity(TaskHandle taskHandle, uint32_t coreMask)
+{
+    uint32_t all = (uint32_t) ((1ull << g_simSchedulerCores.count) - 1);
+
+    SimSchedulerLock();
+    SimTask* task = SimSchedulerFindTask(taskHandle);
+    if (!task || task->deleted || !(coreMask & all)) {
+        SimSchedulerUnlock();
+        return HAL_ERROR;
+    }
+    if (task->frozen || SimSchedulerForeign(task)) {
+        SimSchedulerUnlock();
+        return HAL_BUSY;
+    }
+
+    task->affinity = coreMask;
+    if (!g_simSchedulerPool.dispatching && SimSchedulerState(task) == TASK_STATE_READY &&
+        !(coreMask & (1u << task->core))) {
+        /* Queued on a core it may no longer use: move it to the tail of an allowed one */
+        SimSchedulerUnqueue(task);
+        task->core = SimSchedulerLeastLoaded(coreMask & all);
+        SimSchedulerEnqueue(task);
+    }
+    SimSchedulerUnlock();
+    return HAL_OK;
 }
@@ -0,0 +1,256 @@
+/**
+ * @file sim_scheduler_trace.c
+ * @brief Task Run Trace Recorder
+ *
+ * sim_scheduler.c appends one record per task creation and per run. Workers of a
+ * multi-threaded frame append concurrently, so records go into the same kind of
+ * ring as the DMA trace: power-of-two, sequence-stamped slots claimed with one
+ * atomic increment, the oldest overwritten when full.
+ *
+ * The Chrome export has two processes: host time with one track per worker,
+ * showing where the host CPU went, and simulated time with one track per task.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "sim_internal.h"
+#include "sim_scheduler.h"
+
+#define SIM_SCHEDULER_TRACE_MAX_TASKS 512 /* Task slots in sim_scheduler.c */
+
+/* Ring slot; stamp is the record's sequence number + 1 once it is complete, 0 while written */
+typedef struct {
+    uint64_t stamp;
+    SimSchedulerTraceRecord record;
+} SimSchedulerTraceSlot;
+
+/* Global state */
+static struct {
+    SimSchedulerTraceSlot* slots;
+    uint32_t capacity; /* Power of two */
+    uint64_t writeSeq; /* Next sequence number to hand out (atomic) */
+    uint64_t originNs; /* Host time of SIM_SCHEDULER_StartTrace */
+    bool recording;    /* Writers append (atomic) */
+} g_simSchedulerTrace = {0};
+
+static const char* const kSimSchedulerTraceEvent[] = {"created",   "completed", "yielded",
+                                                      "suspended", "deleted",   "preempted"};
+#define SIM_SCHEDULER_TRACE_EVENT_NAMES \
+    (sizeof(kSimSchedulerTraceEvent) / sizeof(kSimSchedulerTraceEvent[0]))
+
+/* Private functions */
+static uint32_t SimSchedulerTraceRead(SimSchedulerTraceRecord* records, uint32_t maxRecords)
+{
+    if (!g_simSchedulerTrace.slots)
+        return 0;
+
+    uint32_t capacity = g_simSchedulerTrace.capacity;
+    uint64_t end = __atomic_load_n(&g_simSchedulerTrace.writeSeq, __ATOMIC_ACQUIRE);
+    uint64_t begin = end > capacity ? end - capacity : 0;
+    uint32_t count = 0;
+
+    for (uint64_t seq = begin; seq < end && count < maxRecords; seq++) {
+        const SimSchedulerTraceSlot* slot = &g_simSchedulerTrace.slots[seq & (capacity - 1)];
+        if (__atomic_load_n(&slot->stamp, __ATOMIC_ACQUIRE) != seq + 1) {
+            continue;
+        }
+        records[count] = slot->record;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        /* Overwritten while copying, the record is torn */
+        if (__atomic_load_n(&slot->stamp, __ATOMIC_RELAXED) == seq + 1) {
+            count++;
+        }
+    }
+    return count;
+}
+
+static uint64_t SimSchedulerTraceRelative(uint64_t hostNs)
+{
+    return hostNs > g_simSchedulerTrace.originNs ? hostNs - g_simSchedulerTrace.originNs : 0;
+}
+
+/* Chrome timestamps are microseconds; print ns values to the nanosecond */
+static void SimSchedulerTracePrintUs(FILE* file, const char* key, uint64_t ns)
+{
+    fprintf(file, "\"%s\":%llu.%03llu", key, (unsigned long long) (ns / 1000),
+            (unsigned long long) (ns % 1000));
+}
+
+static int SimSchedulerTraceWriteChrome(FILE* file, const SimSchedulerTraceRecord* records,
+                                        uint32_t count)
+{
+    bool workerNamed[SIM_SCHEDULER_MAX_WORKERS] = {false};
+    bool taskNamed[SIM_SCHEDULER_TRACE_MAX_TASKS] = {false};
+
+    fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n"
+                  "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,"
+                  "\"args\":{\"name\":\"Scheduler (host time)\"}},\n"
+                  "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,"
+                  "\"args\":{\"name\":\"Scheduler (simulated time)\"}}");
+
+    for (uint32_t i = 0; i < count; i++) {
+        const SimSchedulerTraceRecord* rec = &records[i];
+        const char* event =
+            rec->event < SIM_SCHEDULER_TRACE_EVENT_NAMES ? kSimSchedulerTraceEvent[rec->event]
+                                                         : "run";
+
+        if (rec->index < SIM_SCHEDULER_TRACE_MAX_TASKS && !taskNamed[rec->index]) {
+            taskNamed[rec->index] = true;
+            fprintf(file,
+                    ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,"
+                    "\"args\":{\"name\":\"Task %u\"}}",
+                    rec->index, rec->index);
+        }
+
+        if (rec->event == SIM_SCHEDULER_TRACE_CREATED) {
+            fprintf(file,
+                    ",\n{\"name\":\"Task %u created\",\"cat\":\"task\",\"ph\":\"i\",\"s\":\"t\","
+                    "\"pid\":1,\"tid\":%u,\"ts\":%llu,\"args\":{\"handle\":\"0x%llx\","
+                    "\"priority\":%u}}",
+                    rec->index, rec->index, (unsigned long long) rec->startUs,
+                    (unsigned long long) rec->task, rec->priority);
+            continue;
+        }
+
+        if (rec->worker < SIM_SCHEDULER_MAX_WORKERS && !workerNamed[rec->worker]) {
+            workerNamed[rec->worker] = true;
+            fprintf(file,
+                    ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,"
+                    "\"args\":{\"name\":\"Worker %u\"}}",
+                    rec->worker, rec->worker);
+        }
+
+        /* Host track: where the host CPU went */
+        fprintf(file,
+                ",\n{\"name\":\"Task %u\",\"cat\":\"task\",\"ph\":\"X\",\"pid\":0,\"tid\":%u,",
+                rec->index, rec->worker);
+        SimSchedulerTracePrintUs(file, "ts", rec->startNs);
+        fprintf(file, ",");
+        SimSchedulerTracePrintUs(file, "dur", rec->endNs - rec->startNs);
+        fprintf(file,
+                ",\"args\":{\"handle\":\"0x%llx\",\"priority\":%u,\"end\":\"%s\","
+                "\"latencyNs\":%llu,\"simStartUs\":%llu,\"simEndUs\":%llu}}",
+                (unsigned long long) rec->task, rec->priority, event,
+                (unsigned long long) (rec->readyNs ? rec->startNs - rec->readyNs : 0),
+                (unsigned long long) rec->startUs, (unsigned long long) rec->endUs);
+
+        /* Simulated track: what each task did on the target's timeline */
+        fprintf(file,
+                ",\n{\"name\":\"Task %u\",\"cat\":\"task\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,"
+                "\"ts\":%llu,\"dur\":%llu,\"args\":{\"end\":\"%s\",\"latencyUs\":%llu}}",
+                rec->index, rec->index, (unsigned long long) rec->startUs,
+                (unsigned long long) (rec->endUs - rec->startUs), event,
+                (unsigned long long) (rec->startUs - rec->readyUs));
+    }
+
+    fprintf(file, "\n]}\n");
+    return ferror(file) ? -1 : 0;
+}
+
+/* Internal interface */
+bool SimSchedulerTraceEnabled(void)
+{
+    return __atomic_load_n(&g_simSchedulerTrace.recording, __ATOMIC_ACQUIRE);
+}
+
+void SimSchedulerTraceAppend(const SimSchedulerTraceRecord* record)
+{
+    if (!SimSchedulerTraceEnabled())
+        return;
+
+    uint64_t seq = __atomic_fetch_add(&g_simSchedulerTrace.writeSeq, 1, __ATOMIC_RELAXED);
+    SimSchedulerTraceSlot* slot =
+        &g_simSchedulerTrace.slots[seq & (g_simSchedulerTrace.capacity - 1)];
+
+    __atomic_store_n(&slot->stamp, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    slot->record = *record;
+    slot->record.readyNs = record->readyNs ? SimSchedulerTraceRelative(record->readyNs) : 0;
+    slot->record.startNs = SimSchedulerTraceRelative(record->startNs);
+    slot->record.endNs = SimSchedulerTraceRelative(record->endNs);
+    __atomic_store_n(&slot->stamp, seq + 1, __ATOMIC_RELEASE);
+}
+
+/* Simulator control functions */
+int SIM_SCHEDULER_StartTrace(uint32_t capacity)
+{
+    if (capacity == 0) {
+        capacity = SIM_SCHEDULER_TRACE_DEFAULT_CAPACITY;
+    }
+    if (capacity > (1u << 31))
+        return -1;
+
+    uint32_t rounded = 1;
+    while (rounded < capacity) {
+        rounded <<= 1;
+    }
+
+    SimSchedulerTraceSlot* slots =
+        (SimSchedulerTraceSlot*) calloc(rounded, sizeof(SimSchedulerTraceSlot));
+    if (!slots)
+        return -1;
+
+    /* Not while a frame dispatches: the old ring may still be written */
+    __atomic_store_n(&g_simSchedulerTrace.recording, false, __ATOMIC_RELEASE);
+    free(g_simSchedulerTrace.slots);
+    memset(&g_simSchedulerTrace, 0, sizeof(g_simSchedulerTrace));
+
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    g_simSchedulerTrace.originNs = (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+    g_simSchedulerTrace.slots = slots;
+    g_simSchedulerTrace.capacity = rounded;
+    __atomic_store_n(&g_simSchedulerTrace.recording, true, __ATOMIC_RELEASE);
+
+    printf("[SIM_SCHEDULER] Tracing task runs (%u records)\n", rounded);
+    return 0;
+}
+
+int SIM_SCHEDULER_StopTrace(void)
+{
+    __atomic_store_n(&g_simSchedulerTrace.recording, false, __ATOMIC_RELEASE);
+    return 0;
+}
+
+int SIM_SCHEDULER_ReadTrace(SimSchedulerTraceRecord* records, uint32_t maxRecords,
+                            uint32_t* count)
+{
+    if (!count || (!records && maxRecords))
+        return -1;
+
+    *count = SimSchedulerTraceRead(records, maxRecords);
+    return 0;
+}
+
+int SIM_SCHEDULER_ExportTrace(const char* path)
+{
+    if (!path)
+        return -1;
+
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        printf("[SIM_SCHEDULER] ERROR: Cannot open trace file %s\n", path);
+        return -1;
+    }
+
+    uint32_t count = 0;
+    SimSchedulerTraceRecord* records = NULL;
+    if (g_simSchedulerTrace.slots) {
+        records = (SimSchedulerTraceRecord*) malloc(g_simSchedulerTrace.capacity *
+                                                    sizeof(SimSchedulerTraceRecord));
+        if (records) {
+            count = SimSchedulerTraceRead(records, g_simSchedulerTrace.capacity);
+        }
+    }
+
+    int ret = SimSchedulerTraceWriteChrome(file, records, count);
+    free(records);
+
+    if (fclose(file) != 0) {
+        ret = -1;
+    }
+    return ret;
+}
@@ -0,0 +1,537 @@
+/**
+ * @file sim_sync.c
+ * @brief Synchronization Simulation Implementation
+ *
+ * Semaphores, event groups and mutexes in one object table and one handle space.
+ */
+
+#include "sim_sync.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "sim_internal.h"
+#include "sim_timer.h"
+
+/* Handle layout: [generation:16][index:8], resolved like task handles */
+#define SYNC_HANDLE_INDEX_BITS 8
+#define SYNC_HANDLE_INDEX_MASK ((1u << SYNC_HANDLE_INDEX_BITS) - 1)
+#define SYNC_HANDLE_GEN_MASK 0xFFFFu
+
+/* Mutex owner recorded for callers outside tasks */
+#define SIM_SYNC_OUTSIDE UINTPTR_MAX
+
+typedef enum { SIM_SYNC_SEMAPHORE = 1, SIM_SYNC_EVENT, SIM_SYNC_MUTEX } SimSyncKind;
+
+/*
+ * One atomic word (count, flags or owner) plus a scheduler wait list. Acquiring is a
+ * compare-and-swap on the word; only a caller that finds the object unavailable waits.
+ * A handle of one kind passed to another kind's calls is invalid.
+ */
+typedef struct {
+    SimWaitList waiters;
+    uint32_t value;         /* Semaphore count or event flags (atomic) */
+    uintptr_t owner;        /* Mutex: task handle, SIM_SYNC_OUTSIDE, 0 when free (atomic) */
+    uint32_t maxCount;      /* Semaphore */
+    MutexProtocol protocol; /* Mutex */
+    SimSyncKind kind;
+    bool allocated;
+    uint16_t generation;
+    /* Statistics (atomic) */
+    uint64_t acquired;
+    uint64_t contended;
+    uint64_t timeouts;
+    uint64_t waitUs;
+    uint64_t maxWaitUs;
+    uint64_t inheritances;
+} SimSyncObject;
+
+/* One call's view of an object; the wait conditions get it as their argument */
+typedef struct {
+    SimSyncObject* object;
+    uintptr_t self;     /* Mutex lock */
+    uint32_t bits;      /* Event wait */
+    EventWaitMode mode;
+    bool clearOnExit;
+    uint32_t setBits;   /* Flags that satisfied an event wait */
+} SimSyncRequest;
+
+static struct {
+    pthread_mutex_t lock;      /* Create, delete and priority inheritance */
+    uint16_t generation;       /* Survives SIM_SYNC_Reset so old handles stay invalid */
+    SimSyncObject objects[SIM_SYNC_MAX_OBJECTS];
+} g_simSync = {.lock = PTHREAD_MUTEX_INITIALIZER};
+
+static const char* const kSimSyncNames[] = {
+    [SIM_SYNC_SEMAPHORE] = "semaphore",
+    [SIM_SYNC_EVENT] = "event group",
+    [SIM_SYNC_MUTEX] = "mutex",
+};
+
+/* Private functions */
+static SimSyncObject* SimSyncFind(void* handle, SimSyncKind kind)
+{
+    uintptr_t raw = (uintptr_t) handle;
+    uint32_t index = (uint32_t) (raw & SYNC_HANDLE_INDEX_MASK);
+    uint16_t generation = (uint16_t) ((raw >> SYNC_HANDLE_INDEX_BITS) & SYNC_HANDLE_GEN_MASK);
+
+    if (index >= SIM_SYNC_MAX_OBJECTS)
+        return NULL;
+
+    SimSyncObject* object = &g_simSync.objects[index];
+    if (!__atomic_load_n(&object->allocated, __ATOMIC_ACQUIRE) ||
+        object->generation != generation || (kind && object->kind != kind))
+        return NULL;
+
+    return object;
+}
+
+static int SimSyncCreate(SimSyncKind kind, uint32_t value, uint32_t maxCount,
+                         MutexProtocol protocol, void** handle)
+{
+    pthread_mutex_lock(&g_simSync.lock);
+    for (int i = 0; i < SIM_SYNC_MAX_OBJECTS; i++) {
+        SimSyncObject* object = &g_simSync.objects[i];
+        if (object->allocated) {
+            continue;
+        }
+
+        memset(object, 0, sizeof(*object));
+        if (++g_simSync.generation == 0) {
+            g_simSync.generation = 1;
+        }
+        object->generation = g_simSync.generation;
+        object->kind = kind;
+        object->value = value;
+        object->maxCount = maxCount;
+        object->protocol = protocol;
+        __atomic_store_n(&object->allocated, true, __ATOMIC_RELEASE);
+        pthread_mutex_unlock(&g_simSync.lock);
+
+        *handle = (void*) (((uintptr_t) object->generation << SYNC_HANDLE_INDEX_BITS) |
+                           (uintptr_t) i);
+
+        printf("[SIM_SYNC] Created %s %p\n", kSimSyncNames[kind], *handle);
+        return HAL_OK;
+    }
+    pthread_mutex_unlock(&g_simSync.lock);
+
+    printf("[SIM_SYNC] ERROR: No free object slot\n");
+    return HAL_ERROR;
+}
+
+static int SimSyncDelete(void* handle, SimSyncKind kind)
+{
+    pthread_mutex_lock(&g_simSync.lock);
+    SimSyncObject* object = SimSyncFind(handle, kind);
+    if (!object || SimSchedulerCountWaiters(&object->waiters) ||
+        __atomic_load_n(&object->owner, __ATOMIC_ACQUIRE)) {
+        pthread_mutex_unlock(&g_simSync.lock);
+        return object ? HAL_BUSY : HAL_ERROR;
+    }
+
+    memset(object, 0, sizeof(*object));
+    pthread_mutex_unlock(&g_simSync.lock);
+
+    printf("[SIM_SYNC] Deleted %s %p\n", kSimSyncNames[kind], handle);
+    return HAL_OK;
+}
+
+static uintptr_t SimSyncSelf(void)
+{
+    TaskHandle task = SimSchedulerSelf();
+    return task ? (uintptr_t) task : SIM_SYNC_OUTSIDE;
+}
+
+/* Inheriting mutex a task is blocked on, NULL if none; called with the lock held */
+static SimSyncObject* SimSyncBlockedOn(TaskHandle task)
+{
+    for (int i = 0; i < SIM_SYNC_MAX_OBJECTS; i++) {
+        SimSyncObject* object = &g_simSync.objects[i];
+        if (object->allocated && object->kind == SIM_SYNC_MUTEX &&
+            object->protocol == MUTEX_PROTOCOL_INHERIT &&
+            SimSchedulerIsWaiting(&object->waiters, task))
+            return object;
+    }
+    return NULL;
+}
+
+/* Task holding a mutex, NULL if it is free or held outside tasks */
+static TaskHandle SimSyncOwnerTask(const SimSyncObject* mutex)
+{
+    uintptr_t owner = __atomic_load_n(&mutex->owner, __ATOMIC_ACQUIRE);
+    return owner != SIM_SYNC_OUTSIDE ? (TaskHandle) owner : NULL;
+}
+
+/*
+ * Raise a mutex's owner, and the owners it waits for in turn, to at least a priority.
+ * Unless preemption is on, a raised owner gets ahead at the next dispatch rather than at
+ * once. Mutexes without a protocol never take the lock.
+ */
+static void SimSyncRaise(SimSyncObject* mutex, int priority)
+{
+    pthread_mutex_lock(&g_simSync.lock);
+    for (int depth = 0; mutex && depth < SIM_SYNC_MAX_OBJECTS; depth++) {
+        TaskHandle owner = SimSyncOwnerTask(mutex);
+        if (!owner || SimSchedulerGetPriority(owner, true) >= priority)
+            break;
+
+        SimSchedulerSetInherited(owner, priority);
+        __atomic_fetch_add(&mutex->inheritances, 1, __ATOMIC_RELAXED);
+        mutex = SimSyncBlockedOn(owner);
+    }
+    pthread_mutex_unlock(&g_simSync.lock);
+}
+
+/* Put a task at the level the inheriting mutexes it holds need, then redo the owners it
+   waits for; called with the lock held */
+static void SimSyncSettleLocked(TaskHandle task)
+{
+    for (int depth = 0; task && depth < SIM_SYNC_MAX_OBJECTS; depth++) {
+        int priority = SimSchedulerGetPriority(task, false);
+        if (priority < 0)
+            return;
+        for (int i = 0; i < SIM_SYNC_MAX_OBJECTS; i++) {
+            const SimSyncObject* object = &g_simSync.objects[i];
+            if (object->allocated && object->protocol == MUTEX_PROTOCOL_INHERIT &&
+                __atomic_load_n(&object->owner, __ATOMIC_ACQUIRE) == (uintptr_t) task) {
+                int waiter = SimSchedulerWaitersPriority(&object->waiters);
+                priority = waiter > priority ? waiter : priority;
+            }
+        }
+        if (priority == SimSchedulerGetPriority(task, true))
+            return;
+
+        SimSchedulerSetInherited(task, priority);
+        const SimSyncObject* next = SimSyncBlockedOn(task);
+        task = next ? SimSyncOwnerTask(next) : NULL;
+    }
+}
+
+static void SimSyncSettle(TaskHandle task)
+{
+    pthread_mutex_lock(&g_simSync.lock);
+    SimSyncSettleLocked(task);
+    pthread_mutex_unlock(&g_simSync.lock);
+}
+
+/* Attempts, each one step that takes what the caller asked for or changes nothing */
+static bool SimSyncTakeCount(SimSyncRequest* request)
+{
+    SimSyncObject* object = request->object;
+    uint32_t count = __atomic_load_n(&object->value, __ATOMIC_RELAXED);
+    while (count) {
+        if (__atomic_compare_exchange_n(&object->value, &count, count - 1, true,
+                                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+            return true;
+    }
+    return false;
+}
+
+static bool SimSyncMatch(const SimSyncRequest* request, uint32_t flags)
+{
+    uint32_t hit = flags & request->bits;
+    return request->mode == EVENT_WAIT_ALL ? hit == request->bits : hit != 0;
+}
+
+static bool SimSyncTakeFlags(SimSyncRequest* request)
+{
+    SimSyncObject* object = request->object;
+    uint32_t flags = __atomic_load_n(&object->value, __ATOMIC_ACQUIRE);
+    for (;;) {
+        if (!SimSyncMatch(request, flags))
+            return false;
+        if (!request->clearOnExit ||
+            __atomic_compare_exchange_n(&object->value, &flags, flags & ~request->bits, true,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            request->setBits = flags;
+            return true;
+        }
+    }
+}
+
+static bool SimSyncTakeOwner(SimSyncRequest* request)
+{
+    uintptr_t free = 0;
+    return __atomic_compare_exchange_n(&request->object->owner, &free, request->self, false,
+                                       __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+
+/* Wait conditions */
+static bool SimSyncHasCount(void* arg)
+{
+    const SimSyncRequest* request = (const SimSyncRequest*) arg;
+    return __atomic_load_n(&request->object->value, __ATOMIC_ACQUIRE) != 0;
+}
+
+static bool SimSyncHasFlags(void* arg)
+{
+    const SimSyncRequest* request = (const SimSyncRequest*) arg;
+    return SimSyncMatch(request, __atomic_load_n(&request->object->value, __ATOMIC_ACQUIRE));
+}
+
+static bool SimSyncIsFree(void* arg)
+{
+    const SimSyncRequest* request = (const SimSyncRequest*) arg;
+    return __atomic_load_n(&request->object->owner, __ATOMIC_ACQUIRE) == 0;
+}
+
+static void SimSyncCountWait(SimSyncObject* object, uint64_t waitedUs, int ret)
+{
+    __atomic_fetch_add(&object->waitUs, waitedUs, __ATOMIC_RELAXED);
+    uint64_t maxUs = __atomic_load_n(&object->maxWaitUs, __ATOMIC_RELAXED);
+    while (waitedUs > maxUs &&
+           !__atomic_compare_exchange_n(&object->maxWaitUs, &maxUs, waitedUs, true,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+    if (ret == HAL_OK) {
+        __atomic_fetch_add(&object->acquired, 1, __ATOMIC_RELAXED);
+    } else if (ret == HAL_TIMEOUT) {
+        __atomic_fetch_add(&object->timeouts, 1, __ATOMIC_RELAXED);
+    }
+}
+
+/*
+ * Attempt, and while that fails wait on the object and attempt again. A woken task only
+ * tries again, so a task that gets there first may take what it was woken for. Wait
+ * times count simulated time from the first failed attempt to the end of the call.
+ */
+static int SimSyncAcquire(SimSyncRequest* request, bool (*attempt)(SimSyncRequest* request),
+                          bool (*ready)(void* arg), uint32_t timeoutMs)
+{
+    SimSyncObject* object = request->object;
+    if (attempt(request)) {
+        __atomic_fetch_add(&object->acquired, 1, __ATOMIC_RELAXED);
+        return HAL_OK;
+    }
+
+    __atomic_fetch_add(&object->contended, 1, __ATOMIC_RELAXED);
+    bool inherit = object->protocol == MUTEX_PROTOCOL_INHERIT;
+    uint64_t startUs = SIM_TIMER_GetCurrentTime();
+    uint64_t deadlineUs = timeoutMs ? startUs + (uint64_t) timeoutMs * 1000 : UINT64_MAX;
+    int ret;
+    do {
+        if (inherit && request->self != SIM_SYNC_OUTSIDE) {
+            SimSyncRaise(object, SimSchedulerGetPriority((TaskHandle) request->self, true));
+        }
+        ret = SimSchedulerWait(&object->waiters, ready, request, deadlineUs);
+    } while (ret == HAL_OK && !attempt(request));
+
+    if (inherit) {
+        /* The new owner takes over the remaining waiters; after a timeout the owner may
+           have been raised for this caller alone */
+        TaskHandle owner = SimSyncOwnerTask(object);
+        if (owner) {
+            SimSyncSettle(owner);
+        }
+    }
+    SimSyncCountWait(object, SIM_TIMER_GetCurrentTime() - startUs, ret);
+    return ret;
+}
+
+/* Simulator control functions */
+int SIM_SYNC_GetStats(void* handle, SimSyncStats* stats)
+{
+    SimSyncObject* object = SimSyncFind(handle, 0);
+    if (!object || !stats)
+        return -1;
+
+    stats->acquired = __atomic_load_n(&object->acquired, __ATOMIC_RELAXED);
+    stats->contended = __atomic_load_n(&object->contended, __ATOMIC_RELAXED);
+    stats->timeouts = __atomic_load_n(&object->timeouts, __ATOMIC_RELAXED);
+    stats->waitUs = __atomic_load_n(&object->waitUs, __ATOMIC_RELAXED);
+    stats->maxWaitUs = __atomic_load_n(&object->maxWaitUs, __ATOMIC_RELAXED);
+    stats->inheritances = __atomic_load_n(&object->inheritances, __ATOMIC_RELAXED);
+    stats->waiting = SimSchedulerCountWaiters(&object->waiters);
+    return 0;
+}
+
+int SIM_SYNC_Reset(void)
+{
+    pthread_mutex_lock(&g_simSync.lock);
+    for (int i = 0; i < SIM_SYNC_MAX_OBJECTS; i++) {
+        memset(&g_simSync.objects[i], 0, sizeof(SimSyncObject));
+    }
+    pthread_mutex_unlock(&g_simSync.lock);
+    return 0;
+}
+
+/* HAL interface implementation */
+int HAL_SEMAPHORE_Create(uint32_t initialCount, uint32_t maxCount, SemaphoreHandle* semaphore)
+{
+    if (!semaphore || maxCount == 0 || initialCount > maxCount)
+        return HAL_ERROR;
+
+    return SimSyncCreate(SIM_SYNC_SEMAPHORE, initialCount, maxCount, MUTEX_PROTOCOL_NONE,
+                         semaphore);
+}
+
+int HAL_SEMAPHORE_Delete(SemaphoreHandle semaphore)
+{
+    return SimSyncDelete(semaphore, SIM_SYNC_SEMAPHORE);
+}
+
+int HAL_SEMAPHORE_Take(SemaphoreHandle semaphore, uint32_t timeoutMs)
+{
+    SimSyncRequest request = {.object = SimSyncFind(semaphore, SIM_SYNC_SEMAPHORE)};
+    if (!request.object)
+        return HAL_ERROR;
+
+    return SimSyncAcquire(&request, SimSyncTakeCount, SimSyncHasCount, timeoutMs);
+}
+
+int HAL_SEMAPHORE_TryTake(SemaphoreHandle semaphore)
+{
+    SimSyncRequest request = {.object = SimSyncFind(semaphore, SIM_SYNC_SEMAPHORE)};
+    if (!request.object)
+        return HAL_ERROR;
+    if (!SimSyncTakeCount(&request))
+        return HAL_BUSY;
+
+    __atomic_fetch_add(&request.object->acquired, 1, __ATOMIC_RELAXED);
+    return HAL_OK;
+}
+
+int HAL_SEMAPHORE_Give(SemaphoreHandle semaphore)
+{
+    SimSyncObject* object = SimSyncFind(semaphore, SIM_SYNC_SEMAPHORE);
+    if (!object)
+        return HAL_ERROR;
+
+    uint32_t count = __atomic_load_n(&object->value, __ATOMIC_RELAXED);
+    do {
+        if (count == object->maxCount)
+            return HAL_ERROR;
+    } while (!__atomic_compare_exchange_n(&object->value, &count, count + 1, true,
+                                          __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+    SimSchedulerWakeOne(&object->waiters);
+    return HAL_OK;
+}
+
+uint32_t HAL_SEMAPHORE_GetCount(SemaphoreHandle semaphore)
+{
+    SimSyncObject* object = SimSyncFind(semaphore, SIM_SYNC_SEMAPHORE);
+    return object ? __atomic_load_n(&object->value, __ATOMIC_ACQUIRE) : 0;
+}
+
+int HAL_EVENT_Create(EventGroupHandle* group)
+{
+    if (!group)
+        return HAL_ERROR;
+
+    return SimSyncCreate(SIM_SYNC_EVENT, 0, 0, MUTEX_PROTOCOL_NONE, group);
+}
+
+int HAL_EVENT_Delete(EventGroupHandle group)
+{
+    return SimSyncDelete(group, SIM_SYNC_EVENT);
+}
+
+int HAL_EVENT_Set(EventGroupHandle group, uint32_t bits)
+{
+    SimSyncObject* object = SimSyncFind(group, SIM_SYNC_EVENT);
+    if (!object)
+        return HAL_ERROR;
+
+    __atomic_fetch_or(&object->value, bits, __ATOMIC_RELEASE);
+    /* Waiters want different flags, so all of them look */
+    SimSchedulerWakeAll(&object->waiters);
+    return HAL_OK;
+}
+
+int HAL_EVENT_Clear(EventGroupHandle group, uint32_t bits)
+{
+    SimSyncObject* object = SimSyncFind(group, SIM_SYNC_EVENT);
+    if (!object)
+        return HAL_ERROR;
+
+    __atomic_fetch_and(&object->value, ~bits, __ATOMIC_RELEASE);
+    return HAL_OK;
+}
+
+int HAL_EVENT_Wait(EventGroupHandle group, uint32_t bits, EventWaitMode mode, bool clearOnExit,
+                   uint32_t timeoutMs, uint32_t* setBits)
+{
+    SimSyncRequest request = {.object = SimSyncFind(group, SIM_SYNC_EVENT),
+                              .bits = bits,
+                              .mode = mode,
+                              .clearOnExit = clearOnExit};
+    if (!request.object || bits == 0 || (mode != EVENT_WAIT_ANY && mode != EVENT_WAIT_ALL))
+        return HAL_ERROR;
+
+    int ret = SimSyncAcquire(&request, SimSyncTakeFlags, SimSyncHasFlags, timeoutMs);
+    if (setBits) {
+        *setBits = ret == HAL_OK ? request.setBits
+                                 : __atomic_load_n(&request.object->value, __ATOMIC_ACQUIRE);
+    }
+    return ret;
+}
+
+uint32_t HAL_EVENT_Get(EventGroupHandle group)
+{
+    SimSyncObject* object = SimSyncFind(group, SIM_SYNC_EVENT);
+    return object ? __atomic_load_n(&object->value, __ATOMIC_ACQUIRE) : 0;
+}
+
+int HAL_MUTEX_Create(MutexProtocol protocol, MutexHandle* mutex)
+{
+    if (!mutex || (protocol != MUTEX_PROTOCOL_NONE && protocol != MUTEX_PROTOCOL_INHERIT))
+        return HAL_ERROR;
+
+    return SimSyncCreate(SIM_SYNC_MUTEX, 0, 0, protocol, mutex);
+}
+
+int HAL_MUTEX_Delete(MutexHandle mutex)
+{
+    return SimSyncDelete(mutex, SIM_SYNC_MUTEX);
+}
+
+int HAL_MUTEX_Lock(MutexHandle mutex, uint32_t timeoutMs)
+{
+    SimSyncRequest request = {.object = SimSyncFind(mutex, SIM_SYNC_MUTEX),
+                              .self = SimSyncSelf()};
+    if (!request.object ||
+        __atomic_load_n(&request.object->owner, __ATOMIC_RELAXED) == request.self)
+        return HAL_ERROR;
+
+    return SimSyncAcquire(&request, SimSyncTakeOwner, SimSyncIsFree, timeoutMs);
+}
+
+int HAL_MUTEX_TryLock(MutexHandle mutex)
+{
+    SimSyncRequest request = {.object = SimSyncFind(mutex, SIM_SYNC_MUTEX),
+                              .self = SimSyncSelf()};
+    if (!request.object)
+        return HAL_ERROR;
+    if (!SimSyncTakeOwner(&request))
+        return HAL_BUSY;
+
+    __atomic_fetch_add(&request.object->acquired, 1, __ATOMIC_RELAXED);
+    return HAL_OK;
+}
+
+int HAL_MUTEX_Unlock(MutexHandle mutex)
+{
+    SimSyncObject* object = SimSyncFind(mutex, SIM_SYNC_MUTEX);
+    uintptr_t self = SimSyncSelf();
+    if (!object || __atomic_load_n(&object->owner, __ATOMIC_RELAXED) != self)
+        return HAL_ERROR;
+
+    if (object->protocol == MUTEX_PROTOCOL_INHERIT && self != SIM_SYNC_OUTSIDE) {
+        /* Under the lock, so no waiter raises this task after it let go */
+        pthread_mutex_lock(&g_simSync.lock);
+        __atomic_store_n(&object->owner, 0, __ATOMIC_RELEASE);
+        TaskHandle task = (TaskHandle) self;
+        if (SimSchedulerGetPriority(task, true) != SimSchedulerGetPriority(task, false)) {
+            SimSyncSettleLocked(task);
+        }
+        pthread_mutex_unlock(&g_simSync.lock);
+    } else {
+        __atomic_store_n(&object->owner, 0, __ATOMIC_RELEASE);
+    }
+
+    SimSchedulerWakeOne(&object->waiters);
+    return HAL_OK;
+}
@@ -1,6 +1,11 @@
 /**
  * @file sim_timer.c
  * @brief Timer Simulator Implementation
+ *
+ * Owns simulated time. Every running timer keeps one event in the simulation
+ * kernel (sim_kernel.c) for its next expiry, so advancing time visits each
+ * expiry in order with the clock set to the exact expiry time instead of
+ * scanning all timers at the end of the step.
  */
 
 #include "sim_timer.h"
@@ -10,8 +15,10 @@
 #include <string.h>
 
 #include "hal_timer.h"
+#include "sim_internal.h"
 
 #define MAX_TIMERS 32
+#define MAX_ADVANCE_HOOKS 8
 
 /* Timer state */
 typedef struct {
@@ -24,6 +31,9 @@ typedef struct {
     uint64_t lastTickUs;
     TimerCallback callback;
     void* userData;
+    SimTimerTrigger trigger; /* Hardware route, runs without a callback */
+    void* triggerArg;
+    SimEventId expiry; /* Pending kernel event while running */
 } SimTimerState;
 
 /* Simulator state */
@@ -35,8 +45,16 @@ static struct {
     uint32_t totalCallbacksFired;
 } g_simTimer = {0};
 
+/* Advance hooks survive SIM_TIMER_Reset (they belong to other simulators) */
+static struct {
+    SimTimeHook hooks[MAX_ADVANCE_HOOKS];
+    int count;
+} g_simTimerHooks = {0};
+
 /* Forward declarations */
-static void SimTimerProcessCallbacks(uint64_t oldTime, uint64_t newTime);
+static void SimTimerArm(SimTimerState* timer);
+static void SimTimerFold(SimTimerState* timer);
+static void SimTimerRunHooks(uint64_t oldTime, uint64_t newTime);
 
 /* ============================================
  * Simulator Control APIs (SIM_TIMER_*)
@@ -45,6 +63,7 @@ static void SimTimerProcessCallbacks(uint64_t oldTime, uint64_t newTime);
 int SIM_TIMER_Init(void)
 {
     printf("[SIM_TIMER] Simulator initialized\n");
+    SimKernelReset();
     memset(&g_simTimer, 0, sizeof(g_simTimer));
     g_simTimer.initialized = true;
     return 0;
@@ -53,6 +72,7 @@ int SIM_TIMER_Init(void)
 int SIM_TIMER_Reset(void)
 {
     printf("[SIM_TIMER] Simulator reset\n");
+    SimKernelReset();
     memset(&g_simTimer, 0, sizeof(g_simTimer));
     g_simTimer.initialized = true;
     return 0;
@@ -64,12 +84,7 @@ int SIM_TIMER_AdvanceTime(uint64_t microseconds)
         return -1;
     }
 
-    uint64_t oldTime = g_simTimer.currentTimeUs;
-    g_simTimer.currentTimeUs += microseconds;
-
-    SimTimerProcessCallbacks(oldTime, g_simTimer.currentTimeUs);
-
-    return 0;
+    return SimKernelRunUntil(g_simTimer.currentTimeUs + microseconds, false);
 }
 
 uint64_t SIM_TIMER_GetCurrentTime(void)
@@ -83,12 +98,13 @@ int SIM_TIMER_SetTime(uint64_t microseconds)
         return -1;
     }
 
-    uint64_t oldTime = g_simTimer.currentTimeUs;
-    g_simTimer.currentTimeUs = microseconds;
-
-    SimTimerProcessCallbacks(oldTime, microseconds);
+    /* Going back in time does not fire anything */
+    if (microseconds <= g_simTimer.currentTimeUs) {
+        g_simTimer.currentTimeUs = microseconds;
+        return 0;
+    }
 
-    return 0;
+    return SimKernelRunUntil(microseconds, false);
 }
 
 uint32_t SIM_TIMER_GetActiveTimerCount(void)
@@ -121,6 +137,58 @@ int SIM_TIMER_GetStats(uint32_t* totalTimers, uint32_t* activeTimers, uint32_t*
     return 0;
 }
 
+/* ============================================
+ * Simulator-internal Hooks
+ * ============================================ */
+
+int SimTimerAddAdvanceHook(SimTimeHook hook)
+{
+    if (!hook) {
+        return -1;
+    }
+
+    for (int i = 0; i < g_simTimerHooks.count; i++) {
+        if (g_simTimerHooks.hooks[i] == hook) {
+            return 0;
+        }
+    }
+
+    if (g_simTimerHooks.count >= MAX_ADVANCE_HOOKS) {
+        return -1;
+    }
+
+    g_simTimerHooks.hooks[g_simTimerHooks.count++] = hook;
+    return 0;
+}
+
+int SimTimerSetTrigger(TimerHandle handle, SimTimerTrigger trigger, void* arg)
+{
+    SimTimerState* timer = (SimTimerState*) handle;
+    if (!timer || !timer->allocated) {
+        return -1;
+    }
+
+    timer->trigger = trigger;
+    timer->triggerArg = arg;
+    return 0;
+}
+
+bool SimTimerInitialized(void)
+{
+    return g_simTimer.initialized;
+}
+
+void SimTimerAdvanceTo(uint64_t nowUs)
+{
+    uint64_t oldTime = g_simTimer.currentTimeUs;
+    if (nowUs <= oldTime) {
+        return;
+    }
+
+    g_simTimer.currentTimeUs = nowUs;
+    SimTimerRunHooks(oldTime, nowUs);
+}
+
 /* ============================================
  * HAL Timer Implementation (HAL_TIMER_*)
  * ============================================ */
@@ -191,6 +259,7 @@ int HAL_TIMER_Destroy(TimerHandle handle)
     }
 
     printf("[SIM_TIMER] Destroyed timer 0x%lx\n", (unsigned long) handle);
+    SimKernelCancel(timer->expiry);
     memset(timer, 0, sizeof(SimTimerState));
 
     return HAL_OK;
@@ -210,6 +279,7 @@ int HAL_TIMER_Start(TimerHandle handle)
     timer->running = true;
     timer->counterUs = 0;
     timer->lastTickUs = g_simTimer.currentTimeUs;
+    SimTimerArm(timer);
 
     printf("[SIM_TIMER] Started timer 0x%lx\n", (unsigned long) handle);
 
@@ -227,7 +297,9 @@ int HAL_TIMER_Stop(TimerHandle handle)
         return HAL_ERROR;
     }
 
+    SimTimerFold(timer);
     timer->running = false;
+    SimTimerArm(timer);
 
     printf("[SIM_TIMER] Stopped timer 0x%lx\n", (unsigned long) handle);
 
@@ -247,6 +319,7 @@ int HAL_TIMER_Reset(TimerHandle handle)
 
     timer->counterUs = 0;
     timer->lastTickUs = g_simTimer.currentTimeUs;
+    SimTimerArm(timer);
 
     return HAL_OK;
 }
@@ -283,7 +356,9 @@ int HAL_TIMER_SetPeriod(TimerHandle handle, uint32_t periodUs)
         return HAL_ERROR;
     }
 
+    SimTimerFold(timer);
     timer->periodUs = periodUs;
+    SimTimerArm(timer);
 
     return HAL_OK;
 }
@@ -316,8 +391,10 @@ uint64_t HAL_TIMER_GetSystemTickMs(void)
 
 int HAL_TIMER_DelayUs(uint32_t delayUs)
 {
-    /* In simulation, delays are instant */
-    SIM_TIMER_AdvanceTime(delayUs);
+    /* In simulation, delays are instant; a preemptive scheduler may switch tasks meanwhile */
+    if (!SimSchedulerSpend(delayUs)) {
+        SIM_TIMER_AdvanceTime(delayUs);
+    }
     return HAL_OK;
 }
 
@@ -330,41 +407,66 @@ int HAL_TIMER_DelayMs(uint32_t delayMs)
  * Internal Helper Functions
  * ============================================ */
 
-static void SimTimerProcessCallbacks(uint64_t oldTime, uint64_t newTime)
+static void SimTimerExpire(void* arg, uint64_t nowUs)
 {
-    if (newTime <= oldTime) {
+    SimTimerState* timer = (SimTimerState*) arg;
+
+    timer->expiry = 0;
+    timer->counterUs = 0;
+    timer->lastTickUs = nowUs;
+
+    /* Settle the next expiry first so the callback may stop or restart the timer */
+    if (timer->mode == TIMER_MODE_ONESHOT) {
+        timer->running = false;
+    } else {
+        SimTimerArm(timer);
+    }
+
+    /* Hardware trigger sees the exact expiry time */
+    if (timer->trigger) {
+        timer->trigger(timer, timer->triggerArg, nowUs);
+    }
+
+    if (timer->callback) {
+        timer->callback(timer, timer->userData);
+        g_simTimer.totalCallbacksFired++;
+    }
+}
+
+/* (Re)post the expiry event of a timer from its counter and period */
+static void SimTimerArm(SimTimerState* timer)
+{
+    SimKernelCancel(timer->expiry);
+    timer->expiry = 0;
+
+    /* A zero-period periodic timer would expire forever without time passing */
+    if (!timer->running || (timer->periodUs == 0 && timer->mode != TIMER_MODE_ONESHOT)) {
         return;
     }
 
-    /* Process all running timers */
-    for (int i = 0; i < MAX_TIMERS; i++) {
-        SimTimerState* timer = &g_simTimer.timers[i];
+    uint64_t dueUs = timer->lastTickUs;
+    if (timer->periodUs > timer->counterUs) {
+        dueUs += timer->periodUs - timer->counterUs;
+    }
+    timer->expiry = SimKernelPost(dueUs, SimTimerExpire, timer);
+}
 
-        if (!timer->allocated || !timer->running) {
-            continue;
-        }
+/* Move elapsed time into the counter */
+static void SimTimerFold(SimTimerState* timer)
+{
+    if (timer->running && g_simTimer.currentTimeUs > timer->lastTickUs) {
+        timer->counterUs += (uint32_t) (g_simTimer.currentTimeUs - timer->lastTickUs);
+        timer->lastTickUs = g_simTimer.currentTimeUs;
+    }
+}
 
-        uint64_t elapsed = newTime - timer->lastTickUs;
-        timer->counterUs += elapsed;
-
-        /* Check if timer period has elapsed */
-        while (timer->counterUs >= timer->periodUs) {
-            /* Fire callback */
-            if (timer->callback) {
-                timer->callback(timer, timer->userData);
-                g_simTimer.totalCallbacksFired++;
-            }
-
-            timer->counterUs -= timer->periodUs;
-
-            /* Handle one-shot timers */
-            if (timer->mode == TIMER_MODE_ONESHOT) {
-                timer->running = false;
-                timer->counterUs = 0;
-                break;
-            }
-        }
+static void SimTimerRunHooks(uint64_t oldTime, uint64_t newTime)
+{
+    if (newTime <= oldTime) {
+        return;
+    }
 
-        timer->lastTickUs = newTime;
+    for (int i = 0; i < g_simTimerHooks.count; i++) {
+        g_simTimerHooks.hooks[i](newTime);
     }
 }
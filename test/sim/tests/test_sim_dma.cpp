@@ -5,10 +5,19 @@
 
 #include <gtest/gtest.h>
 
+#include <cstdio>
 #include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
 
 extern "C" {
 #include "hal_dma.h"
+#include "sim_dma.h"
+#include "sim_memory.h"
+#include "sim_scheduler.h"
+#include "sim_timer.h"
 }
 
 class SimDmaTest : public ::testing::Test
@@ -234,6 +243,937 @@ TEST_F(SimDmaTest, EnableEvents)
     EXPECT_EQ(HAL_OK, ret);
 }
 
+TEST_F(SimDmaTest, QueuedTransfersReportTags)
+{
+    HAL_DMA_Init(0, nullptr);
+
+    DmaChannel channel;
+    HAL_DMA_RequestChannel(0, DMA_DIR_MEM_TO_MEM, 1, &channel);
+
+    uint8_t src[3][32];
+    uint8_t dst[3][32];
+    memset(dst, 0, sizeof(dst));
+    for (int i = 0; i < 3; i++) {
+        memset(src[i], i + 1, sizeof(src[i]));
+        EXPECT_EQ(HAL_OK, HAL_DMA_QueueTransfer(channel, src[i], dst[i], sizeof(src[i]), 10 + i));
+    }
+
+    // Nothing moves before submission
+    uint32_t tag;
+    EXPECT_EQ(HAL_BUSY, HAL_DMA_PopCompletion(channel, &tag));
+    EXPECT_EQ(0, dst[0][0]);
+
+    EXPECT_EQ(HAL_OK, HAL_DMA_SubmitQueued(channel));
+    EXPECT_EQ(0, memcmp(src, dst, sizeof(src)));
+
+    for (uint32_t i = 0; i < 3; i++) {
+        ASSERT_EQ(HAL_OK, HAL_DMA_PopCompletion(channel, &tag));
+        EXPECT_EQ(10 + i, tag);
+    }
+    EXPECT_EQ(HAL_BUSY, HAL_DMA_PopCompletion(channel, &tag));
+
+    HAL_DMA_ReleaseChannel(channel);
+}
+
+TEST_F(SimDmaTest, QueueFull)
+{
+    HAL_DMA_Init(0, nullptr);
+
+    DmaChannel channel;
+    HAL_DMA_RequestChannel(0, DMA_DIR_MEM_TO_MEM, 1, &channel);
+
+    uint8_t buf[8];
+    EXPECT_EQ(HAL_ERROR, HAL_DMA_QueueTransfer(channel, nullptr, buf, sizeof(buf), 7));
+    EXPECT_EQ(HAL_ERROR, HAL_DMA_QueueTransfer(channel, buf, nullptr, sizeof(buf), 7));
+    for (uint32_t i = 0; i < SIM_DMA_QUEUE_DEPTH; i++) {
+        EXPECT_EQ(HAL_OK, HAL_DMA_QueueTransfer(channel, buf, buf, sizeof(buf), i));
+    }
+    EXPECT_EQ(HAL_BUSY, HAL_DMA_QueueTransfer(channel, buf, buf, sizeof(buf), 99));
+
+    // Ring is not empty, a single transfer must wait
+    EXPECT_EQ(HAL_BUSY, HAL_DMA_StartTransfer(channel, buf, buf, sizeof(buf)));
+
+    HAL_DMA_ReleaseChannel(channel);
+}
+
+TEST_F(SimDmaTest, PreparedTransferLaunch)
+{
+    HAL_DMA_Init(0, nullptr);
+
+    DmaChannel channel;
+    HAL_DMA_RequestChannel(0, DMA_DIR_MEM_TO_MEM, 2, &channel);
+
+    uint8_t src[128];
+    uint8_t dst[128];
+    DmaPreparedTransfer prepared;
+    ASSERT_EQ(HAL_OK, HAL_DMA_PrepareTransfer(channel, src, dst, sizeof(src), &prepared));
+
+    for (int i = 0; i < 5; i++) {
+        memset(src, i, sizeof(src));
+        EXPECT_EQ(HAL_OK, HAL_DMA_Launch(prepared));
+        EXPECT_EQ(0, memcmp(src, dst, sizeof(src)));
+    }
+
+    // Releasing the channel invalidates the prepared transfer
+    HAL_DMA_ReleaseChannel(channel);
+    EXPECT_EQ(HAL_ERROR, HAL_DMA_Launch(prepared));
+    EXPECT_EQ(HAL_OK, HAL_DMA_ReleasePrepared(prepared));
+}
+
+TEST_F(SimDmaTest, PrepareRejectsInvalidTransfer)
+{
+    HAL_DMA_Init(0, nullptr);
+
+    DmaChannel channel;
+    HAL_DMA_RequestChannel(0, DMA_DIR_MEM_TO_MEM, 2, &channel);
+
+    uint8_t buf[16];
+    DmaPreparedTransfer prepared;
+    EXPECT_EQ(HAL_ERROR, HAL_DMA_PrepareTransfer(channel, nullptr, buf, sizeof(buf), &prepared));
+    EXPECT_EQ(HAL_ERROR, HAL_DMA_PrepareTransfer(channel, buf, buf, sizeof(buf), nullptr));
+    EXPECT_EQ(HAL_ERROR, HAL_DMA_StartTransfer(channel, buf, nullptr, sizeof(buf)));
+
+    HAL_DMA_ReleaseChannel(channel);
+}
+
+TEST_F(SimDmaTest, ChannelCompletionStartsLinkedChannel)
+{
+    SIM_DMA_Reset();
+    HAL_DMA_Init(0, nullptr);
+
+    uint8_t src[64];
+    uint8_t stage[64] = {0};
+    uint8_t dst[64] = {0};
+    memset(src, 0x3C, sizeof(src));
+
+    DmaChannel first, second;
+    HAL_DMA_RequestChannel(0, DMA_DIR_MEM_TO_MEM, 1, &first);
+    HAL_DMA_RequestChannel(0, DMA_DIR_MEM_TO_MEM, 1, &second);
+
+    // The route keeps its own copy of the prepared transfer
+    DmaPreparedTransfer prepared;
+    HAL_DMA_PrepareTransfer(second, stage, dst, sizeof(dst), &prepared);
+    EXPECT_EQ(HAL_OK, HAL_DMA_LinkChannel(first, prepared));
+    HAL_DMA_ReleasePrepared(prepared);
+
+    EXPECT_EQ(HAL_OK, HAL_DMA_StartTransfer(first, src, stage, sizeof(src)));
+    EXPECT_EQ(0, memcmp(src, dst, sizeof(dst)));
+
+    SimDmaChannelStats stats;
+    SIM_DMA_GetChannelStats(second, &stats);
+    EXPECT_EQ(1u, stats.transfers);
+    EXPECT_EQ(1u, stats.triggeredStarts);
+
+    // Unlinked: the second channel no longer follows
+    HAL_DMA_LinkChannel(first, nullptr);
+    HAL_DMA_StartTransfer(first, src, stage, sizeof(src));
+    SIM_DMA_GetChannelStats(second, &stats);
+    EXPECT_EQ(1u, stats.transfers);
+}
+
+TEST_F(SimDmaTest, ZeroTimeTriggerLoopIsCut)
+{
+    SIM_DMA_Reset();
+    HAL_DMA_Init(0, nullptr);
+
+    uint8_t buffer[16] = {0};
+    DmaChannel channel;
+    HAL_DMA_RequestChannel(0, DMA_DIR_MEM_TO_MEM, 1, &channel);
+
+    DmaPreparedTransfer prepared;
+    HAL_DMA_PrepareTransfer(channel, buffer, buffer + 8, 8, &prepared);
+    HAL_DMA_LinkChannel(channel, prepared);
+    EXPECT_EQ(HAL_OK, HAL_DMA_Launch(prepared));
+
+    SimDmaChannelStats stats;
+    SIM_DMA_GetChannelStats(channel, &stats);
+    EXPECT_EQ(256u, stats.triggeredStarts);
+    EXPECT_EQ(1u, stats.missedTriggers);
+    EXPECT_EQ(257u, stats.transfers);
+
+    HAL_DMA_ReleasePrepared(prepared);
+}
+
+static void CountBatch(DmaChannel channel, uint32_t completed, void* userData)
+{
+    (void) channel;
+    std::vector<uint32_t>* batches = (std::vector<uint32_t>*) userData;
+    batches->push_back(completed);
+}
+
+TEST_F(SimDmaTest, CoalescedCompletionsReportCount)
+{
+    SIM_TIMER_Init();
+    SIM_DMA_Reset();
+    HAL_DMA_Init(0, nullptr);
+
+    uint8_t src[32];
+    uint8_t dst[32];
+    DmaChannel channel;
+    HAL_DMA_RequestChannel(0, DMA_DIR_MEM_TO_MEM, 1, &channel);
+
+    std::vector<uint32_t> batches;
+    EXPECT_EQ(HAL_OK, HAL_DMA_SetCoalescing(channel, 4, 1000, CountBatch, &batches));
+
+    for (int i = 0; i < 10; i++) {
+        HAL_DMA_StartTransfer(channel, src, dst, sizeof(src));
+    }
+    EXPECT_EQ((std::vector<uint32_t>{4, 4}), batches);
+
+    // The last two are reported by the timeout
+    SIM_TIMER_AdvanceTime(999);
+    EXPECT_EQ(2u, batches.size());
+    SIM_TIMER_AdvanceTime(1);
+    EXPECT_EQ((std::vector<uint32_t>{4, 4, 2}), batches);
+
+    SimDmaChannelStats stats;
+    SIM_DMA_GetChannelStats(channel, &stats);
+    EXPECT_EQ(3u, stats.batchCallbacks);
+    EXPECT_EQ(7u, stats.callbacksSaved);
+    EXPECT_EQ(2000000u, stats.coalesceDelayNs);
+    EXPECT_EQ(1000000u, stats.maxCoalesceDelayNs);
+
+    // Disabling reports what is still pending
+    HAL_DMA_StartTransfer(channel, src, dst, sizeof(src));
+    HAL_DMA_SetCoalescing(channel, 0, 0, nullptr, nullptr);
+    EXPECT_EQ(1u, batches.back());
+    EXPECT_EQ(4u, batches.size());
+}
+
+class SimDmaArbiterTest : public ::testing::Test
+{
+   protected:
+    void SetUp() override
+    {
+        SIM_TIMER_Init();
+        SIM_DMA_Reset();
+
+        // 100 bytes/us bus, 100-byte bursts: one slot per microsecond
+        SimDmaConfig config = {.busBytesPerUs = 100, .burstBytes = 100, .cpuPriority = 3,
+                               .channelCount = 0};
+        HAL_DMA_Init(0, &config);
+    }
+
+    void TearDown() override
+    {
+        SIM_DMA_Reset();
+        SIM_TIMER_Reset();
+    }
+};
+
+TEST_F(SimDmaArbiterTest, TransferTakesBusTime)
+{
+    DmaChannel channel;
+    HAL_DMA_RequestChannel(0, DMA_DIR_MEM_TO_MEM, 1, &channel);
+
+    uint8_t src[1000];
+    uint8_t dst[1000];
+    memset(src, 0x5A, sizeof(src));
+    memset(dst, 0x00, sizeof(dst));
+
+    EXPECT_EQ(HAL_OK, HAL_DMA_StartTransfer(channel, src, dst, sizeof(src)));
+
+    bool isBusy = false;
+    HAL_DMA_IsBusy(channel, &isBusy);
+    EXPECT_TRUE(isBusy);
+    EXPECT_EQ(HAL_BUSY, HAL_DMA_StartTransfer(channel, src, dst, sizeof(src)));
+
+    SIM_TIMER_AdvanceTime(4);
+    size_t progress = 0;
+    HAL_DMA_GetProgress(channel, &progress);
+    EXPECT_EQ(400u, progress);
+
+    SIM_TIMER_AdvanceTime(6);
+    HAL_DMA_IsBusy(channel, &isBusy);
+    EXPECT_FALSE(isBusy);
+    EXPECT_EQ(0, memcmp(src, dst, sizeof(src)));
+}
+
+TEST_F(SimDmaArbiterTest, HigherPriorityStarvesLower)
+{
+    DmaChannel bulk, motor;
+    HAL_DMA_RequestChannel(0, DMA_DIR_MEM_TO_MEM, 3, &bulk);
+    HAL_DMA_RequestChannel(0, DMA_DIR_MEM_TO_MEM, 2, &motor);
+
+    static uint8_t bulkSrc[2000], bulkDst[2000];
+    uint8_t motorSrc[100], motorDst[100];
+
+    HAL_DMA_StartTransfer(bulk, bulkSrc, bulkDst, sizeof(bulkSrc));
+    HAL_DMA_StartTransfer(motor, motorSrc, motorDst, sizeof(motorSrc));
+
+    SIM_TIMER_AdvanceTime(20);
+
+    bool bulkBusy, motorBusy;
+    HAL_DMA_IsBusy(bulk, &bulkBusy);
+    HAL_DMA_IsBusy(motor, &motorBusy);
+    EXPECT_FALSE(bulkBusy);
+    EXPECT_TRUE(motorBusy);
+
+    SIM_TIMER_AdvanceTime(1);
+
+    SimDmaChannelStats stats;
+    ASSERT_EQ(0, SIM_DMA_GetChannelStats(motor, &stats));
+    EXPECT_EQ(1u, stats.transfers);
+    EXPECT_EQ(20000u, stats.queueDelayNs);
+    EXPECT_EQ(21000u, stats.serviceNs);
+}
+
+TEST_F(SimDmaArbiterTest, EqualPriorityRoundRobin)
+{
+    DmaChannel a, b;
+    HAL_DMA_RequestChannel(0, DMA_DIR_MEM_TO_MEM, 1, &a);
+    HAL_DMA_RequestChannel(0, DMA_DIR_MEM_TO_MEM, 1, &b);
+
+    static uint8_t src[1000], dstA[1000], dstB[1000];
+    HAL_DMA_StartTransfer(a, src, dstA, sizeof(src));
+    HAL_DMA_StartTransfer(b, src, dstB, sizeof(src));
+
+    SIM_TIMER_AdvanceTime(10);
+
+    size_t progressA = 0, progressB = 0;
+    HAL_DMA_GetProgress(a, &progressA);
+    HAL_DMA_GetProgress(b, &progressB);
+    EXPECT_EQ(500u, progressA);
+    EXPECT_EQ(500u, progressB);
+
+    SimDmaChannelStats stats;
+    SIM_DMA_GetChannelStats(b, &stats);
+    EXPECT_EQ(1000u, stats.maxQueueDelayNs);
+}
+
+TEST_F(SimDmaArbiterTest, CpuTrafficSharesBus)
+{
+    DmaChannel channel;
+    HAL_DMA_RequestChannel(0, DMA_DIR_MEM_TO_MEM, 1, &channel);
+
+    uint8_t src[500], dst[500];
+    EXPECT_EQ(0, SIM_DMA_AddCpuTraffic(0, 300));
+    HAL_DMA_StartTransfer(channel, src, dst, sizeof(src));
+
+    SIM_TIMER_AdvanceTime(5);
+    bool isBusy;
+    HAL_DMA_IsBusy(channel, &isBusy);
+    EXPECT_TRUE(isBusy);
+
+    SIM_TIMER_AdvanceTime(3);
+    HAL_DMA_IsBusy(channel, &isBusy);
+    EXPECT_FALSE(isBusy);
+
+    SimDmaBusStats busStats;
+    SIM_DMA_GetBusStats(0, &busStats);
+    EXPECT_EQ(300u, busStats.cpuBytes);
+    EXPECT_EQ(500u, busStats.dmaBytes);
+    EXPECT_EQ(8000u, busStats.busyNs);
+}
+
+TEST_F(SimDmaArbiterTest, WaitCompleteAdvancesTime)
+{
+    DmaChannel channel;
+    HAL_DMA_RequestChannel(0, DMA_DIR_MEM_TO_MEM, 1, &channel);
+
+    static uint8_t src[4096], dst[4096];
+    HAL_DMA_StartTransfer(channel, src, dst, sizeof(src));
+
+    EXPECT_EQ(HAL_OK, HAL_DMA_WaitComplete(channel, 0));
+    EXPECT_EQ(41u, SIM_TIMER_GetCurrentTime());
+
+    // 1 byte/us: 4096us transfer cannot finish within a 1ms timeout
+    SIM_DMA_SetBandwidth(0, 1);
+    HAL_DMA_StartTransfer(channel, src, dst, sizeof(src));
+    EXPECT_EQ(HAL_TIMEOUT, HAL_DMA_WaitComplete(channel, 1));
+    EXPECT_EQ(1041u, SIM_TIMER_GetCurrentTime());
+}
+
+TEST_F(SimDmaArbiterTest, StaleHandleRejected)
+{
+    DmaChannel first, second;
+    HAL_DMA_RequestChannel(0, DMA_DIR_MEM_TO_MEM, 1, &first);
+    HAL_DMA_ReleaseChannel(first);
+
+    // Same slot is reused, but with a new generation
+    HAL_DMA_RequestChannel(0, DMA_DIR_MEM_TO_MEM, 1, &second);
+    EXPECT_NE(first, second);
+
+    bool isBusy;
+    EXPECT_EQ(HAL_ERROR, HAL_DMA_IsBusy(first, &isBusy));
+    EXPECT_EQ(HAL_ERROR, HAL_DMA_ReleaseChannel(first));
+    EXPECT_EQ(HAL_OK, HAL_DMA_IsBusy(second, &isBusy));
+}
+
+TEST_F(SimDmaArbiterTest, PerInstanceChannelCount)
+{
+    SimDmaConfig config = {.busBytesPerUs = 0, .burstBytes = 0, .cpuPriority = 0,
+                           .channelCount = 100};
+    ASSERT_EQ(HAL_OK, HAL_DMA_Init(1, &config));
+
+    DmaChannel channel;
+    for (int i = 0; i < 100; i++) {
+        ASSERT_EQ(HAL_OK, HAL_DMA_RequestChannel(1, DMA_DIR_MEM_TO_MEM, 0, &channel));
+    }
+    EXPECT_EQ(HAL_ERROR, HAL_DMA_RequestChannel(1, DMA_DIR_MEM_TO_MEM, 0, &channel));
+
+    // Instance 0 keeps its own (default sized) table
+    EXPECT_EQ(HAL_OK, HAL_DMA_RequestChannel(0, DMA_DIR_MEM_TO_MEM, 0, &channel));
+
+    // Cannot resize while channels are in use
+    config.channelCount = 8;
+    EXPECT_EQ(HAL_ERROR, HAL_DMA_Init(1, &config));
+
+    config.channelCount = SIM_DMA_MAX_CHANNELS_PER_INSTANCE + 1;
+    EXPECT_EQ(HAL_ERROR, HAL_DMA_Init(2, &config));
+}
+
+TEST_F(SimDmaArbiterTest, QueuedTransfersRunBackToBack)
+{
+    DmaChannel channel;
+    HAL_DMA_RequestChannel(0, DMA_DIR_MEM_TO_MEM, 1, &channel);
+
+    static uint8_t src[4][100], dst[4][100];
+    for (uint32_t i = 0; i < 4; i++) {
+        HAL_DMA_QueueTransfer(channel, src[i], dst[i], sizeof(src[i]), i);
+    }
+    HAL_DMA_SubmitQueued(channel);
+
+    SIM_TIMER_AdvanceTime(2);
+    uint32_t tag;
+    ASSERT_EQ(HAL_OK, HAL_DMA_PopCompletion(channel, &tag));
+    EXPECT_EQ(0u, tag);
+    ASSERT_EQ(HAL_OK, HAL_DMA_PopCompletion(channel, &tag));
+    EXPECT_EQ(1u, tag);
+    EXPECT_EQ(HAL_BUSY, HAL_DMA_PopCompletion(channel, &tag));
+
+    SIM_TIMER_AdvanceTime(2);
+
+    SimDmaChannelStats stats;
+    SIM_DMA_GetChannelStats(channel, &stats);
+    EXPECT_EQ(4u, stats.transfers);
+    EXPECT_EQ(4u, stats.maxQueueDepth);
+    EXPECT_EQ(0u, stats.queueDepth);
+    EXPECT_EQ(0u, stats.idleGapNs);
+
+    // Software restart after a pause shows up as an idle gap
+    SIM_TIMER_AdvanceTime(10);
+    HAL_DMA_StartTransfer(channel, src[0], dst[0], sizeof(src[0]));
+    SIM_DMA_GetChannelStats(channel, &stats);
+    EXPECT_EQ(10000u, stats.idleGapNs);
+}
+
+TEST_F(SimDmaArbiterTest, PreparedLaunchWaitsForIdleChannel)
+{
+    DmaChannel channel;
+    HAL_DMA_RequestChannel(0, DMA_DIR_MEM_TO_MEM, 1, &channel);
+
+    uint8_t src[200], dst[200];
+    DmaPreparedTransfer prepared;
+    HAL_DMA_PrepareTransfer(channel, src, dst, sizeof(src), &prepared);
+
+    EXPECT_EQ(HAL_OK, HAL_DMA_Launch(prepared));
+    EXPECT_EQ(HAL_BUSY, HAL_DMA_Launch(prepared));
+
+    SIM_TIMER_AdvanceTime(2);
+    EXPECT_EQ(HAL_OK, HAL_DMA_Launch(prepared));
+
+    HAL_DMA_ReleasePrepared(prepared);
+}
+
+TEST_F(SimDmaArbiterTest, TimerTriggerStartsAtExpiry)
+{
+    uint8_t src[200];
+    uint8_t dst[200];
+    memset(src, 0x11, sizeof(src));
+
+    DmaChannel channel;
+    HAL_DMA_RequestChannel(0, DMA_DIR_MEM_TO_MEM, 1, &channel);
+    DmaPreparedTransfer prepared;
+    HAL_DMA_PrepareTransfer(channel, src, dst, sizeof(src), &prepared);
+
+    TimerConfig timerConfig = {TIMER_MODE_PERIODIC, 100, nullptr, nullptr, 0};
+    TimerHandle timer;
+    HAL_TIMER_Create(0, &timerConfig, &timer);
+    EXPECT_EQ(HAL_OK, HAL_DMA_LinkTimer(timer, prepared));
+    HAL_TIMER_Start(timer);
+
+    // One big step still starts each transfer at its expiry (100us, 200us)
+    SIM_TIMER_AdvanceTime(250);
+
+    SimDmaChannelStats stats;
+    SIM_DMA_GetChannelStats(channel, &stats);
+    EXPECT_EQ(2u, stats.triggeredStarts);
+    EXPECT_EQ(2u, stats.transfers);
+    EXPECT_EQ(4000u, stats.serviceNs);
+    EXPECT_EQ(0u, stats.queueDelayNs);
+    EXPECT_EQ(0, memcmp(src, dst, sizeof(src)));
+
+    HAL_DMA_LinkTimer(timer, nullptr);
+    SIM_TIMER_AdvanceTime(100);
+    SIM_DMA_GetChannelStats(channel, &stats);
+    EXPECT_EQ(2u, stats.triggeredStarts);
+
+    HAL_DMA_ReleasePrepared(prepared);
+    HAL_TIMER_Destroy(timer);
+}
+
+TEST_F(SimDmaArbiterTest, TimerTriggerOnBusyChannelIsMissed)
+{
+    uint8_t src[250];
+    uint8_t dst[250];
+
+    DmaChannel channel;
+    HAL_DMA_RequestChannel(0, DMA_DIR_MEM_TO_MEM, 1, &channel);
+    DmaPreparedTransfer prepared;
+    HAL_DMA_PrepareTransfer(channel, src, dst, sizeof(src), &prepared);
+
+    // 2.5us transfers triggered every microsecond
+    TimerConfig timerConfig = {TIMER_MODE_PERIODIC, 1, nullptr, nullptr, 0};
+    TimerHandle timer;
+    HAL_TIMER_Create(0, &timerConfig, &timer);
+    HAL_DMA_LinkTimer(timer, prepared);
+    HAL_TIMER_Start(timer);
+
+    SIM_TIMER_AdvanceTime(10);
+
+    SimDmaChannelStats stats;
+    SIM_DMA_GetChannelStats(channel, &stats);
+    EXPECT_EQ(4u, stats.triggeredStarts);
+    EXPECT_EQ(6u, stats.missedTriggers);
+
+    HAL_DMA_LinkTimer(timer, nullptr);
+    HAL_DMA_ReleasePrepared(prepared);
+    HAL_TIMER_Destroy(timer);
+}
+
+TEST_F(SimDmaArbiterTest, CoalescingTimeoutFiresAtDeadline)
+{
+    uint8_t src[300];
+    uint8_t dst[300];
+    DmaChannel channel;
+    HAL_DMA_RequestChannel(0, DMA_DIR_MEM_TO_MEM, 1, &channel);
+
+    std::vector<uint32_t> batches;
+    HAL_DMA_SetCoalescing(channel, 0, 5, CountBatch, &batches);
+
+    // Completions at 1, 2 and 3us; the batch is due at 6us
+    for (int i = 0; i < 3; i++) {
+        HAL_DMA_QueueTransfer(channel, src + i * 100, dst + i * 100, 100, i);
+    }
+    HAL_DMA_SubmitQueued(channel);
+    SIM_TIMER_AdvanceTime(20);
+    EXPECT_EQ((std::vector<uint32_t>{3}), batches);
+
+    SimDmaChannelStats stats;
+    SIM_DMA_GetChannelStats(channel, &stats);
+    EXPECT_EQ(12000u, stats.coalesceDelayNs);
+    EXPECT_EQ(5000u, stats.maxCoalesceDelayNs);
+}
+
+class SimDmaBufferTest : public ::testing::Test
+{
+   protected:
+    void SetUp() override
+    {
+        SIM_MEMORY_SimulatorInit();
+        SIM_MEMORY_ConfigurePool(POOL_NAME_DDR, (void*) 0x80000000, 1024 * 1024);
+        SIM_MEMORY_ConfigurePool(POOL_NAME_SRAM, (void*) 0x20000000, 1024 * 1024);
+        SIM_MEMORY_SetPoolCached(POOL_NAME_DDR, true);
+
+        SIM_DMA_Reset();
+        HAL_DMA_Init(0, nullptr);
+    }
+
+    void TearDown() override
+    {
+        SIM_DMA_Reset();
+        HAL_MEMORY_FreeBuffer(src);
+        HAL_MEMORY_FreeBuffer(dst);
+        SIM_MEMORY_SimulatorReset();
+    }
+
+    MemoryBuffer src = nullptr;
+    MemoryBuffer dst = nullptr;
+};
+
+TEST_F(SimDmaBufferTest, CopiesRangeAndMaintainsOnlyCachedSide)
+{
+    HAL_MEMORY_AllocBuffer(POOL_NAME_DDR, 4096, &src);
+    HAL_MEMORY_AllocBuffer(POOL_NAME_SRAM, 4096, &dst);
+
+    uint8_t* srcAddr;
+    uint8_t* dstAddr;
+    HAL_MEMORY_GetAddr(src, (void**) &srcAddr);
+    HAL_MEMORY_GetAddr(dst, (void**) &dstAddr);
+    memset(srcAddr, 0x11, 4096);
+    memset(srcAddr + 512, 0x77, 256);
+    memset(dstAddr, 0x00, 4096);
+
+    DmaChannel channel;
+    HAL_DMA_RequestChannel(0, DMA_DIR_MEM_TO_MEM, 1, &channel);
+    EXPECT_EQ(HAL_OK, HAL_DMA_StartBufferTransfer(channel, src, 512, dst, 1024, 256));
+
+    EXPECT_EQ(0, memcmp(srcAddr + 512, dstAddr + 1024, 256));
+    EXPECT_EQ(0x00, dstAddr[1023]);
+    EXPECT_EQ(0x00, dstAddr[1280]);
+
+    // Source flushed over the transferred range only, uncached destination skipped
+    SimDmaCacheStats stats;
+    SIM_DMA_GetCacheStats(&stats);
+    EXPECT_EQ(1u, stats.performedOps);
+    EXPECT_EQ(256u, stats.performedBytes);
+    EXPECT_EQ(1u, stats.avoidedOps);
+    EXPECT_EQ((4096u - 256u) + 4096u, stats.avoidedBytes);
+
+    SimMemoryCacheStats memStats;
+    SIM_MEMORY_GetCacheStats(&memStats);
+    EXPECT_EQ(1u, memStats.flushOps);
+    EXPECT_EQ(0u, memStats.invalidateOps);
+}
+
+TEST_F(SimDmaBufferTest, MaintainsBothRangesOnAnyDirection)
+{
+    HAL_MEMORY_AllocBuffer(POOL_NAME_DDR, 1024, &src);
+    HAL_MEMORY_AllocBuffer(POOL_NAME_DDR, 1024, &dst);
+
+    DmaChannel toPeriph, fromPeriph;
+    HAL_DMA_RequestChannel(0, DMA_DIR_MEM_TO_PERIPH, 1, &toPeriph);
+    HAL_DMA_RequestChannel(0, DMA_DIR_PERIPH_TO_MEM, 1, &fromPeriph);
+
+    EXPECT_EQ(HAL_OK, HAL_DMA_StartBufferTransfer(toPeriph, src, 0, dst, 0, 128));
+    EXPECT_EQ(HAL_OK, HAL_DMA_StartBufferTransfer(fromPeriph, src, 0, dst, 0, 128));
+
+    // Both buffers are memory the engine reads or writes, the direction notwithstanding
+    SimMemoryCacheStats memStats;
+    SIM_MEMORY_GetCacheStats(&memStats);
+    EXPECT_EQ(2u, memStats.flushOps);
+    EXPECT_EQ(2u, memStats.invalidateOps);
+    EXPECT_EQ(256u, memStats.flushBytes);
+    EXPECT_EQ(256u, memStats.invalidateBytes);
+}
+
+TEST_F(SimDmaBufferTest, RejectsOutOfBounds)
+{
+    HAL_MEMORY_AllocBuffer(POOL_NAME_DDR, 1024, &src);
+    HAL_MEMORY_AllocBuffer(POOL_NAME_SRAM, 512, &dst);
+
+    DmaChannel channel;
+    HAL_DMA_RequestChannel(0, DMA_DIR_MEM_TO_MEM, 1, &channel);
+
+    EXPECT_EQ(HAL_ERROR, HAL_DMA_StartBufferTransfer(channel, src, 0, dst, 256, 512));
+    EXPECT_EQ(HAL_ERROR, HAL_DMA_StartBufferTransfer(channel, src, 1000, dst, 0, 100));
+    EXPECT_EQ(HAL_ERROR, HAL_DMA_StartBufferTransfer(channel, src, 0, (MemoryBuffer) 0x7777, 0, 8));
+    EXPECT_EQ(HAL_OK, HAL_DMA_StartBufferTransfer(channel, src, 512, dst, 0, 512));
+
+    // Rejected transfers do no cache maintenance
+    SimDmaCacheStats stats;
+    SIM_DMA_GetCacheStats(&stats);
+    EXPECT_EQ(1u, stats.performedOps);
+}
+
+class SimDmaParallelTest : public ::testing::Test
+{
+   protected:
+    void SetUp() override
+    {
+        SIM_TIMER_Init();
+        SIM_DMA_Reset();
+        SIM_DMA_SetLogging(false);
+        HAL_DMA_Init(0, nullptr);
+
+        SimDmaParallelConfig config = {4, 1024 * 1024, 64 * 1024, false};
+        ASSERT_EQ(0, SIM_DMA_SetParallelCopy(&config));
+
+        // Odd size so the last stripe ends off a page boundary
+        src.resize(8 * 1024 * 1024 + 123);
+        dst.assign(src.size(), 0);
+        for (size_t i = 0; i < src.size(); i++) {
+            src[i] = (uint8_t) (i * 31 + (i >> 12));
+        }
+    }
+
+    void TearDown() override
+    {
+        SIM_DMA_Reset();
+    }
+
+    std::vector<uint8_t> src;
+    std::vector<uint8_t> dst;
+};
+
+TEST_F(SimDmaParallelTest, LargeTransferCompletesAfterAllChunks)
+{
+    int completions = 0;
+    auto callback = [](DmaChannel, DmaEvent, void* userData) { (*(int*) userData)++; };
+
+    DmaChannel channel;
+    HAL_DMA_RequestChannel(0, DMA_DIR_MEM_TO_MEM, 1, &channel);
+    HAL_DMA_RegisterCallback(channel, callback, &completions);
+    EXPECT_EQ(HAL_OK, HAL_DMA_StartTransfer(channel, src.data(), dst.data(), src.size()));
+
+    // Progress only ever grows until the pool is done
+    size_t last = 0;
+    bool busy = true;
+    while (busy) {
+        size_t progress;
+        HAL_DMA_GetProgress(channel, &progress);
+        EXPECT_GE(progress, last);
+        EXPECT_LE(progress, src.size());
+        last = progress;
+        HAL_DMA_IsBusy(channel, &busy);
+    }
+
+    size_t progress;
+    HAL_DMA_GetProgress(channel, &progress);
+    EXPECT_EQ(src.size(), progress);
+    EXPECT_EQ(1, completions);
+    EXPECT_TRUE(src == dst);
+
+    SimDmaChannelStats stats;
+    SIM_DMA_GetChannelStats(channel, &stats);
+    EXPECT_EQ(1u, stats.parallelTransfers);
+    EXPECT_EQ(1u, stats.transfers);
+}
+
+TEST_F(SimDmaParallelTest, SmallTransferStaysInline)
+{
+    DmaChannel channel;
+    HAL_DMA_RequestChannel(0, DMA_DIR_MEM_TO_MEM, 1, &channel);
+    EXPECT_EQ(HAL_OK, HAL_DMA_StartTransfer(channel, src.data(), dst.data(), 4096));
+
+    bool busy = true;
+    HAL_DMA_IsBusy(channel, &busy);
+    EXPECT_FALSE(busy);
+    EXPECT_EQ(0, memcmp(src.data(), dst.data(), 4096));
+
+    SimDmaChannelStats stats;
+    SIM_DMA_GetChannelStats(channel, &stats);
+    EXPECT_EQ(0u, stats.parallelTransfers);
+}
+
+TEST_F(SimDmaParallelTest, QueuedTransfersCompleteInOrder)
+{
+    size_t half = src.size() / 2;
+
+    DmaChannel channel;
+    HAL_DMA_RequestChannel(0, DMA_DIR_MEM_TO_MEM, 1, &channel);
+    HAL_DMA_QueueTransfer(channel, src.data(), dst.data(), half, 1);
+    HAL_DMA_QueueTransfer(channel, src.data() + half, dst.data() + half, src.size() - half, 2);
+    HAL_DMA_SubmitQueued(channel);
+
+    EXPECT_EQ(HAL_OK, HAL_DMA_WaitComplete(channel, 0));
+    EXPECT_TRUE(src == dst);
+
+    uint32_t tag;
+    EXPECT_EQ(HAL_OK, HAL_DMA_PopCompletion(channel, &tag));
+    EXPECT_EQ(1u, tag);
+    EXPECT_EQ(HAL_OK, HAL_DMA_PopCompletion(channel, &tag));
+    EXPECT_EQ(2u, tag);
+
+    SimDmaChannelStats stats;
+    SIM_DMA_GetChannelStats(channel, &stats);
+    EXPECT_EQ(2u, stats.parallelTransfers);
+}
+
+TEST_F(SimDmaParallelTest, StopAbortsCopy)
+{
+    DmaChannel channel;
+    HAL_DMA_RequestChannel(0, DMA_DIR_MEM_TO_MEM, 1, &channel);
+    EXPECT_EQ(HAL_OK, HAL_DMA_StartTransfer(channel, src.data(), dst.data(), src.size()));
+    EXPECT_EQ(HAL_OK, HAL_DMA_StopTransfer(channel));
+
+    bool busy = true;
+    HAL_DMA_IsBusy(channel, &busy);
+    EXPECT_FALSE(busy);
+
+    // The channel is usable again, and turning the pool off makes copies inline
+    EXPECT_EQ(0, SIM_DMA_SetParallelCopy(nullptr));
+    EXPECT_EQ(HAL_OK, HAL_DMA_StartTransfer(channel, src.data(), dst.data(), src.size()));
+    HAL_DMA_IsBusy(channel, &busy);
+    EXPECT_FALSE(busy);
+    EXPECT_TRUE(src == dst);
+}
+
+// RTOS-style task: start a copy and block on it
+struct DmaWaitTask {
+    DmaChannel channel;
+    const std::vector<uint8_t>* src;
+    std::vector<uint8_t>* dst;
+    std::string* trace;
+    int result;
+};
+
+static void DmaWaitTaskFunc(void* args)
+{
+    DmaWaitTask* task = (DmaWaitTask*) args;
+    *task->trace += 'S';
+    HAL_DMA_StartTransfer(task->channel, (void*) task->src->data(), task->dst->data(),
+                          task->src->size());
+    task->result = HAL_DMA_WaitComplete(task->channel, 0);
+    *task->trace += 'W';
+}
+
+static void DmaOtherTaskFunc(void* args)
+{
+    *(std::string*) args += 'o';
+}
+
+TEST_F(SimDmaParallelTest, WaitSwitchesToOtherTasks)
+{
+    HAL_SCHEDULER_Init();
+    ASSERT_EQ(0, SIM_SCHEDULER_SetTaskStacks(SIM_SCHEDULER_DEFAULT_STACK_BYTES));
+
+    std::string trace;
+    DmaWaitTask waiter = {0, &src, &dst, &trace, HAL_ERROR};
+    HAL_DMA_RequestChannel(0, DMA_DIR_MEM_TO_MEM, 1, &waiter.channel);
+
+    TaskHandle handle;
+    HAL_SCHEDULER_CreateTask(DmaWaitTaskFunc, &waiter, TASK_PRIORITY_HIGH, &handle);
+    HAL_SCHEDULER_CreateTask(DmaOtherTaskFunc, &trace, TASK_PRIORITY_LOW, &handle);
+    EXPECT_EQ(HAL_OK, HAL_SCHEDULER_Start());
+    SIM_SCHEDULER_SetTaskStacks(0);
+
+    // The low-priority task runs during the wait unless the workers finished first
+    EXPECT_TRUE(trace == "SoW" || trace == "SWo") << trace;
+    EXPECT_EQ(HAL_OK, waiter.result);
+    EXPECT_TRUE(src == dst);
+}
+
+class SimDmaTraceTest : public SimDmaArbiterTest
+{
+   protected:
+    void SetUp() override
+    {
+        SimDmaArbiterTest::SetUp();
+        SIM_DMA_SetLogging(false);
+        ASSERT_EQ(0, SIM_DMA_StartTrace(0));
+    }
+
+    // Two 500-byte transfers contending for the bus from t=0
+    void RunContention()
+    {
+        HAL_DMA_RequestChannel(0, DMA_DIR_MEM_TO_MEM, 2, &high);
+        HAL_DMA_RequestChannel(0, DMA_DIR_MEM_TO_PERIPH, 1, &low);
+        HAL_DMA_StartTransfer(high, src, dst, 500);
+        HAL_DMA_StartTransfer(low, src, dst + 500, 500);
+        SIM_TIMER_AdvanceTime(10);
+    }
+
+    static std::string ReadFile(const std::string& path)
+    {
+        std::ifstream file(path, std::ios::binary);
+        std::stringstream contents;
+        contents << file.rdbuf();
+        return contents.str();
+    }
+
+    DmaChannel high;
+    DmaChannel low;
+    uint8_t src[1000] = {0};
+    uint8_t dst[1000] = {0};
+};
+
+TEST_F(SimDmaTraceTest, RecordsTimestamps)
+{
+    RunContention();
+
+    SimDmaTraceRecord records[4];
+    uint32_t count = 0;
+    ASSERT_EQ(0, SIM_DMA_ReadTrace(records, 4, &count));
+    ASSERT_EQ(2u, count);
+
+    EXPECT_EQ((uint32_t) (uintptr_t) high, records[0].channel);
+    EXPECT_EQ(0u, records[0].submitNs);
+    EXPECT_EQ(0u, records[0].startNs);
+    EXPECT_EQ(5000u, records[0].endNs);
+    EXPECT_EQ(2u, records[0].priority);
+    EXPECT_EQ(DMA_DIR_MEM_TO_MEM, records[0].direction);
+
+    // The low-priority channel queued behind the high one
+    EXPECT_EQ((uint32_t) (uintptr_t) low, records[1].channel);
+    EXPECT_EQ(0u, records[1].submitNs);
+    EXPECT_EQ(5000u, records[1].startNs);
+    EXPECT_EQ(10000u, records[1].endNs);
+    EXPECT_EQ(500u, records[1].size);
+    EXPECT_EQ(DMA_DIR_MEM_TO_PERIPH, records[1].direction);
+}
+
+TEST_F(SimDmaTraceTest, SummaryReportsUtilization)
+{
+    RunContention();
+
+    // Bus idles 10us, then carries one more microsecond of traffic
+    SIM_TIMER_AdvanceTime(10);
+    HAL_DMA_StartTransfer(high, src, dst, 100);
+    SIM_TIMER_AdvanceTime(1);
+
+    SimDmaTraceSummary summary;
+    ASSERT_EQ(0, SIM_DMA_GetTraceSummary(0, &summary));
+    EXPECT_EQ(3u, summary.transfers);
+    EXPECT_EQ(1100u, summary.bytes);
+    EXPECT_EQ(21000u, summary.windowNs);
+    EXPECT_EQ(11000u, summary.busyNs);
+    EXPECT_EQ(523809u, summary.utilizationPpm);
+    EXPECT_EQ(5000u, summary.queueDelayNs);
+    EXPECT_EQ(5000u, summary.maxQueueDelayNs);
+    EXPECT_EQ(1u, summary.sizeHistogram[1]); // 65..128 bytes
+    EXPECT_EQ(2u, summary.sizeHistogram[3]); // 257..512 bytes
+
+    EXPECT_EQ(0, SIM_DMA_PrintTraceReport());
+}
+
+TEST_F(SimDmaTraceTest, RingKeepsNewestRecords)
+{
+    HAL_DMA_Init(1, nullptr);
+    ASSERT_EQ(0, SIM_DMA_StartTrace(3));
+
+    DmaChannel channel;
+    HAL_DMA_RequestChannel(1, DMA_DIR_MEM_TO_MEM, 1, &channel);
+    for (size_t size = 1; size <= 6; size++) {
+        HAL_DMA_StartTransfer(channel, src, dst, size);
+    }
+
+    SimDmaTraceRecord records[8];
+    uint32_t count = 0;
+    SIM_DMA_ReadTrace(records, 8, &count);
+    ASSERT_EQ(4u, count);
+    for (uint32_t i = 0; i < count; i++) {
+        EXPECT_EQ(3u + i, records[i].size);
+        EXPECT_EQ(1u, records[i].dmaId);
+    }
+
+    // Nothing is recorded once stopped
+    SIM_DMA_StopTrace();
+    HAL_DMA_StartTransfer(channel, src, dst, 7);
+    SIM_DMA_ReadTrace(records, 8, &count);
+    EXPECT_EQ(6u, records[count - 1].size);
+}
+
+TEST_F(SimDmaTraceTest, ExportsBinaryAndChrome)
+{
+    RunContention();
+
+    std::string binPath = ::testing::TempDir() + "sim_dma_trace.bin";
+    std::string jsonPath = ::testing::TempDir() + "sim_dma_trace.json";
+    ASSERT_EQ(0, SIM_DMA_ExportTrace(binPath.c_str(), SIM_DMA_TRACE_BINARY));
+    ASSERT_EQ(0, SIM_DMA_ExportTrace(jsonPath.c_str(), SIM_DMA_TRACE_CHROME));
+
+    std::string bin = ReadFile(binPath);
+    EXPECT_EQ(48u, sizeof(SimDmaTraceRecord));
+    ASSERT_EQ(16u + 2 * sizeof(SimDmaTraceRecord), bin.size());
+    EXPECT_EQ("SDMT", bin.substr(0, 4));
+    EXPECT_EQ(2, bin[12]);
+
+    std::string json = ReadFile(jsonPath);
+    EXPECT_NE(std::string::npos, json.find("\"traceEvents\""));
+    EXPECT_NE(std::string::npos, json.find("\"ts\":5.000,\"dur\":5.000"));
+    size_t slices = 0;
+    for (size_t pos = json.find("\"ph\":\"X\""); pos != std::string::npos;
+         pos = json.find("\"ph\":\"X\"", pos + 1)) {
+        slices++;
+    }
+    EXPECT_EQ(2u, slices);
+
+    remove(binPath.c_str());
+    remove(jsonPath.c_str());
+}
+
 int main(int argc, char** argv)
 {
     ::testing::InitGoogleTest(&argc, argv);
@@ -0,0 +1,201 @@
+/**
+ * @file test_sim_kernel.cpp
+ * @brief Discrete-Event Simulation Kernel Unit Tests
+ */
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+extern "C" {
+#include "hal_dma.h"
+#include "hal_scheduler.h"
+#include "hal_timer.h"
+#include "sim_dma.h"
+#include "sim_kernel.h"
+#include "sim_scheduler.h"
+#include "sim_timer.h"
+}
+
+// (label, simulated time) of everything that happened, in order
+static std::vector<std::pair<std::string, uint64_t>> g_events;
+
+static void RecordTimer(TimerHandle timer, void* userData)
+{
+    (void) timer;
+    g_events.push_back({static_cast<const char*>(userData), SIM_TIMER_GetCurrentTime()});
+}
+
+static void RecordDma(DmaChannel channel, DmaEvent event, void* userData)
+{
+    (void) channel;
+    (void) event;
+    g_events.push_back({static_cast<const char*>(userData), SIM_TIMER_GetCurrentTime()});
+}
+
+class SimKernelTest : public ::testing::Test
+{
+   protected:
+    void SetUp() override
+    {
+        g_events.clear();
+        SIM_TIMER_Init();
+        SIM_DMA_Reset();
+        HAL_SCHEDULER_Init();
+    }
+
+    void TearDown() override
+    {
+        SIM_SCHEDULER_SetTaskStacks(0);
+        SIM_DMA_Reset();
+        SIM_TIMER_Reset();
+    }
+
+    TimerHandle StartTimer(TimerMode mode, uint32_t periodUs, const char* label)
+    {
+        TimerConfig config = {.mode = mode,
+                              .periodUs = periodUs,
+                              .callback = RecordTimer,
+                              .userData = const_cast<char*>(label),
+                              .priority = 0};
+        TimerHandle handle = nullptr;
+        EXPECT_EQ(HAL_OK, HAL_TIMER_Create(0, &config, &handle));
+        EXPECT_EQ(HAL_OK, HAL_TIMER_Start(handle));
+        return handle;
+    }
+};
+
+TEST_F(SimKernelTest, CallbacksSeeTheirExpiryTime)
+{
+    StartTimer(TIMER_MODE_PERIODIC, 300, "T");
+
+    EXPECT_EQ(0, SIM_TIMER_AdvanceTime(1000));
+
+    ASSERT_EQ(3u, g_events.size());
+    EXPECT_EQ(300u, g_events[0].second);
+    EXPECT_EQ(600u, g_events[1].second);
+    EXPECT_EQ(900u, g_events[2].second);
+    EXPECT_EQ(1000u, SIM_TIMER_GetCurrentTime());
+}
+
+TEST_F(SimKernelTest, SameTimeEventsFireInPostingOrder)
+{
+    StartTimer(TIMER_MODE_PERIODIC, 100, "A");
+    StartTimer(TIMER_MODE_PERIODIC, 50, "B");
+    StartTimer(TIMER_MODE_ONESHOT, 100, "C");
+
+    EXPECT_EQ(0, SIM_Run(100));
+
+    std::vector<std::pair<std::string, uint64_t>> expected = {
+        {"B", 50}, {"A", 100}, {"C", 100}, {"B", 100}};
+    EXPECT_EQ(expected, g_events);
+}
+
+TEST_F(SimKernelTest, TimersOrderedAcrossOneLargeStep)
+{
+    StartTimer(TIMER_MODE_PERIODIC, 40, "fast");
+    StartTimer(TIMER_MODE_ONESHOT, 90, "once");
+
+    SIM_TIMER_AdvanceTime(130);
+
+    std::vector<std::pair<std::string, uint64_t>> expected = {
+        {"fast", 40}, {"fast", 80}, {"once", 90}, {"fast", 120}};
+    EXPECT_EQ(expected, g_events);
+}
+
+TEST_F(SimKernelTest, DmaCompletionInterleavesWithTimers)
+{
+    // 10 bytes/us: 1000 bytes complete at t=100
+    SimDmaConfig config = {.busBytesPerUs = 10, .burstBytes = 100, .cpuPriority = 0,
+                           .channelCount = 0};
+    ASSERT_EQ(HAL_OK, HAL_DMA_Init(0, &config));
+
+    DmaChannel channel;
+    ASSERT_EQ(HAL_OK, HAL_DMA_RequestChannel(0, DMA_DIR_MEM_TO_MEM, 1, &channel));
+    HAL_DMA_RegisterCallback(channel, RecordDma, const_cast<char*>("dma"));
+
+    static uint8_t src[1000], dst[1000];
+    StartTimer(TIMER_MODE_PERIODIC, 60, "tick");
+    ASSERT_EQ(HAL_OK, HAL_DMA_StartTransfer(channel, src, dst, sizeof(src)));
+
+    EXPECT_EQ(0, SIM_Run(200));
+
+    std::vector<std::pair<std::string, uint64_t>> expected = {
+        {"tick", 60}, {"dma", 100}, {"tick", 120}, {"tick", 180}};
+    EXPECT_EQ(expected, g_events);
+}
+
+TEST_F(SimKernelTest, IdsFromBeforeResetCancelNothing)
+{
+    SimDmaConfig config = {.busBytesPerUs = 10, .burstBytes = 100, .cpuPriority = 0,
+                           .channelCount = 0};
+    ASSERT_EQ(HAL_OK, HAL_DMA_Init(0, &config));
+    DmaChannel channel;
+    ASSERT_EQ(HAL_OK, HAL_DMA_RequestChannel(0, DMA_DIR_MEM_TO_MEM, 1, &channel));
+    static uint8_t src[1000], dst[1000];
+    ASSERT_EQ(HAL_OK, HAL_DMA_StartTransfer(channel, src, dst, sizeof(src)));
+
+    // The instance keeps its completion's id across the reset; rescheduling cancels that id
+    SIM_TIMER_Reset();
+    StartTimer(TIMER_MODE_PERIODIC, 100, "T");
+    ASSERT_EQ(HAL_OK, HAL_DMA_StopTransfer(channel));
+    ASSERT_EQ(HAL_OK, HAL_DMA_StartTransfer(channel, src, dst, sizeof(src)));
+    SIM_TIMER_AdvanceTime(1000);
+
+    EXPECT_EQ(10u, g_events.size());
+}
+
+static TaskHandle g_sleeper;
+
+static void SleeperTask(void* args)
+{
+    (void) args;
+    for (int i = 0; i < 3; i++) {
+        g_events.push_back({"wake", SIM_TIMER_GetCurrentTime()});
+        SIM_SCHEDULER_ResumeAt(g_sleeper, SIM_TIMER_GetCurrentTime() + 250);
+        HAL_SCHEDULER_SuspendTask(g_sleeper);
+    }
+    g_events.push_back({"done", SIM_TIMER_GetCurrentTime()});
+}
+
+TEST_F(SimKernelTest, TasksSleepUntilTheirWakeupEvent)
+{
+    ASSERT_EQ(0, SIM_SCHEDULER_SetTaskStacks(SIM_SCHEDULER_MIN_STACK_BYTES));
+    ASSERT_EQ(HAL_OK, HAL_SCHEDULER_CreateTask(SleeperTask, nullptr, TASK_PRIORITY_NORMAL, &g_sleeper));
+    StartTimer(TIMER_MODE_ONESHOT, 400, "timer");
+
+    EXPECT_EQ(0, SIM_Run(1000));
+
+    std::vector<std::pair<std::string, uint64_t>> expected = {
+        {"wake", 0}, {"wake", 250}, {"timer", 400}, {"wake", 500}, {"done", 750}};
+    EXPECT_EQ(expected, g_events);
+    EXPECT_EQ(TASK_STATE_COMPLETED, HAL_SCHEDULER_GetTaskState(g_sleeper));
+    EXPECT_EQ(1000u, SIM_TIMER_GetCurrentTime());
+}
+
+TEST_F(SimKernelTest, StoppedTimersCancelTheirEvent)
+{
+    TimerHandle timer = StartTimer(TIMER_MODE_PERIODIC, 100, "T");
+    EXPECT_EQ(100u, SIM_KERNEL_GetNextEventTime());
+
+    SIM_TIMER_AdvanceTime(50);
+    HAL_TIMER_Stop(timer);
+    EXPECT_EQ(UINT64_MAX, SIM_KERNEL_GetNextEventTime());
+
+    // Restarting counts a full period from now
+    HAL_TIMER_Start(timer);
+    EXPECT_EQ(150u, SIM_KERNEL_GetNextEventTime());
+    SIM_TIMER_AdvanceTime(100);
+
+    SimKernelStats stats;
+    EXPECT_EQ(-1, SIM_KERNEL_GetStats(nullptr));
+    ASSERT_EQ(0, SIM_KERNEL_GetStats(&stats));
+    EXPECT_EQ(3u, stats.posted); // 100, 150, 250
+    EXPECT_EQ(1u, stats.cancelled);
+    EXPECT_EQ(1u, stats.dispatched);
+    EXPECT_EQ(1u, stats.pending);
+    ASSERT_EQ(1u, g_events.size());
+    EXPECT_EQ(150u, g_events[0].second);
+}
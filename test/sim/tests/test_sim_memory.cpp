@@ -5,9 +5,13 @@
 
 #include <gtest/gtest.h>
 
+#include <cstring>
+
 extern "C" {
 #include "hal_memory.h"
+#include "sim_dma.h"
 #include "sim_memory.h"
+#include "sim_timer.h"
 }
 
 class SimMemoryTest : public ::testing::Test
@@ -223,6 +227,146 @@ TEST_F(SimMemoryTest, MultipleAllocationsAndFrees)
     EXPECT_EQ(0u, usage);    // but usage should be 0
 }
 
+TEST_F(SimMemoryTest, CachedPoolMaintenanceAccounting)
+{
+    SIM_MEMORY_ConfigurePool(POOL_NAME_DDR, (void*) 0x80000000, 1024 * 1024);
+    SIM_MEMORY_ConfigurePool(POOL_NAME_SRAM, (void*) 0x20000000, 1024 * 1024);
+    EXPECT_EQ(0, SIM_MEMORY_SetPoolCached(POOL_NAME_DDR, true));
+    EXPECT_EQ(-1, SIM_MEMORY_SetPoolCached(POOL_NAME_L3, true));
+
+    MemoryBuffer cached, uncached;
+    HAL_MEMORY_AllocBuffer(POOL_NAME_DDR, 1024, &cached);
+    HAL_MEMORY_AllocBuffer(POOL_NAME_SRAM, 1024, &uncached);
+
+    MemoryBufferInfo info;
+    HAL_MEMORY_GetBufferInfo(cached, &info);
+    EXPECT_TRUE(info.isCached);
+    HAL_MEMORY_GetBufferInfo(uncached, &info);
+    EXPECT_FALSE(info.isCached);
+
+    // Range is widened to whole cache lines: [10, 110) -> [0, 128)
+    HAL_MEMORY_FlushBuffer(cached, 10, 100);
+    HAL_MEMORY_InvalidateBuffer(cached, 0, 0);
+    HAL_MEMORY_FlushBuffer(uncached, 0, 0);
+
+    SimMemoryCacheStats stats;
+    SIM_MEMORY_GetCacheStats(&stats);
+    EXPECT_EQ(1u, stats.flushOps);
+    EXPECT_EQ(2u * SIM_MEMORY_CACHE_LINE, stats.flushBytes);
+    EXPECT_EQ(1u, stats.invalidateOps);
+    EXPECT_EQ(1024u, stats.invalidateBytes);
+}
+
+class SimMemoryCopyTest : public ::testing::Test
+{
+   protected:
+    void SetUp() override
+    {
+        SIM_TIMER_Init();
+        SIM_DMA_Reset();
+        SIM_MEMORY_SimulatorInit();
+        SIM_MEMORY_ConfigurePool(POOL_NAME_DDR, (void*) 0x80000000, 1024 * 1024);
+
+        HAL_MEMORY_AllocBuffer(POOL_NAME_DDR, 8192, &src);
+        HAL_MEMORY_AllocBuffer(POOL_NAME_DDR, 8192, &dst);
+        HAL_MEMORY_GetAddr(src, (void**) &srcAddr);
+        HAL_MEMORY_GetAddr(dst, (void**) &dstAddr);
+        for (int i = 0; i < 8192; i++) {
+            srcAddr[i] = (uint8_t) (i * 13);
+        }
+        memset(dstAddr, 0, 8192);
+    }
+
+    void TearDown() override
+    {
+        HAL_MEMORY_FreeBuffer(src);
+        HAL_MEMORY_FreeBuffer(dst);
+        SIM_MEMORY_SimulatorReset();
+        SIM_DMA_Reset();
+    }
+
+    MemoryBuffer src;
+    MemoryBuffer dst;
+    uint8_t* srcAddr;
+    uint8_t* dstAddr;
+};
+
+TEST_F(SimMemoryCopyTest, FallsBackToCpu)
+{
+    MemoryCopyToken token;
+
+    // Below the threshold
+    HAL_DMA_Init(0, nullptr);
+    EXPECT_EQ(HAL_OK, HAL_MEMORY_CopyBufferAsync(dst, src, 64, &token));
+    EXPECT_EQ(HAL_OK, HAL_MEMORY_PollCopy(token));
+
+    // No DMA instance to offload to
+    SimMemoryCopyConfig config = {0, 0, 1024};
+    SIM_MEMORY_ConfigureCopy(&config);
+    SIM_DMA_Reset();
+    EXPECT_EQ(HAL_OK, HAL_MEMORY_CopyBufferAsync(dst, src, 8192, &token));
+    EXPECT_EQ(HAL_OK, HAL_MEMORY_PollCopy(token));
+    EXPECT_EQ(0, memcmp(srcAddr, dstAddr, 8192));
+
+    EXPECT_EQ(HAL_ERROR, HAL_MEMORY_CopyBufferAsync(dst, src, 8193, &token));
+
+    SimMemoryCopyStats stats;
+    SIM_MEMORY_GetCopyStats(&stats);
+    EXPECT_EQ(2u, stats.cpuCopies);
+    EXPECT_EQ(0u, stats.dmaCopies);
+}
+
+TEST_F(SimMemoryCopyTest, LargeCopyRunsOnDma)
+{
+    SimDmaConfig dmaConfig = {100, 64, 0, 0};
+    HAL_DMA_Init(0, &dmaConfig);
+    SimMemoryCopyConfig config = {0, 0, 1024};
+    SIM_MEMORY_ConfigureCopy(&config);
+
+    MemoryCopyToken first, second;
+    EXPECT_EQ(HAL_OK, HAL_MEMORY_CopyBufferAsync(dst, src, 4000, &first));
+    EXPECT_EQ(HAL_OK, HAL_MEMORY_CopyBufferAsync(dst, src, 3000, &second));
+    EXPECT_EQ(HAL_BUSY, HAL_MEMORY_PollCopy(first));
+
+    // 4000 bytes at 100 B/us
+    SIM_TIMER_AdvanceTime(40);
+    EXPECT_EQ(HAL_OK, HAL_MEMORY_PollCopy(first));
+    EXPECT_EQ(HAL_BUSY, HAL_MEMORY_PollCopy(second));
+
+    EXPECT_EQ(HAL_OK, HAL_MEMORY_WaitCopy(second, 0));
+    EXPECT_EQ(70u, SIM_TIMER_GetCurrentTime());
+    EXPECT_EQ(0, memcmp(srcAddr, dstAddr, 4000));
+
+    SimMemoryCopyStats stats;
+    SIM_MEMORY_GetCopyStats(&stats);
+    EXPECT_EQ(2u, stats.dmaCopies);
+    EXPECT_EQ(7000u, stats.dmaBytes);
+}
+
+TEST_F(SimMemoryCopyTest, ThresholdAndChannelAreReconfigurable)
+{
+    HAL_DMA_Init(0, nullptr);
+
+    SimMemoryCopyConfig config = {0, 1, 16};
+    EXPECT_EQ(0, SIM_MEMORY_ConfigureCopy(&config));
+
+    MemoryCopyToken token;
+    EXPECT_EQ(HAL_OK, HAL_MEMORY_CopyBufferAsync(dst, src, 16, &token));
+    EXPECT_EQ(HAL_OK, HAL_MEMORY_WaitCopy(token, 0));
+
+    // The copy channel is requested again after a DMA simulator reset
+    SIM_DMA_Reset();
+    HAL_DMA_Init(0, nullptr);
+    EXPECT_EQ(HAL_OK, HAL_MEMORY_CopyBufferAsync(dst, src, 32, &token));
+    EXPECT_EQ(HAL_OK, HAL_MEMORY_WaitCopy(token, 0));
+    EXPECT_EQ(0, memcmp(srcAddr, dstAddr, 32));
+
+    SimMemoryCopyStats stats;
+    SIM_MEMORY_GetCopyStats(&stats);
+    EXPECT_EQ(2u, stats.dmaCopies);
+    EXPECT_EQ(0u, stats.cpuCopies);
+}
+
 int main(int argc, char** argv)
 {
     ::testing::InitGoogleTest(&argc, argv);
@@ -0,0 +1,246 @@
+/**
+ * @file test_sim_periph.cpp
+ * @brief Virtual Peripheral Simulator Unit Tests
+ */
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+extern "C" {
+#include "hal_dma.h"
+#include "sim_dma.h"
+#include "sim_periph.h"
+#include "sim_timer.h"
+}
+
+class SimPeriphTest : public ::testing::Test
+{
+   protected:
+    void SetUp() override
+    {
+        SIM_TIMER_Init();
+        SIM_DMA_Reset();
+        SIM_PERIPH_Reset();
+        HAL_DMA_Init(0, nullptr);
+    }
+
+    void TearDown() override
+    {
+        SIM_DMA_Reset();
+        SIM_PERIPH_Reset();
+    }
+
+    static SimPeriphConfig MakeConfig(SimPeriphRole role, SimPeriphBackend backend,
+                                      uint32_t bytesPerUs, uint32_t fifoDepth)
+    {
+        SimPeriphConfig config;
+        memset(&config, 0, sizeof(config));
+        config.role = role;
+        config.backend = backend;
+        config.bytesPerUs = bytesPerUs;
+        config.fifoDepth = fifoDepth;
+        return config;
+    }
+};
+
+TEST_F(SimPeriphTest, SinkPacesUnlimitedBus)
+{
+    SimPeriphConfig config = MakeConfig(SIM_PERIPH_SINK, SIM_PERIPH_BACKEND_FIFO, 1, 16);
+    void* driver;
+    ASSERT_EQ(0, SIM_PERIPH_Register("driver", &config, &driver));
+
+    uint8_t frame[64];
+    for (int i = 0; i < 64; i++) {
+        frame[i] = (uint8_t) i;
+    }
+
+    DmaChannel channel;
+    HAL_DMA_RequestChannel(0, DMA_DIR_MEM_TO_PERIPH, 1, &channel);
+    EXPECT_EQ(HAL_OK, HAL_DMA_StartTransfer(channel, frame, driver, sizeof(frame)));
+
+    // Only the FIFO's worth went out, the rest waits for the device
+    size_t progress;
+    HAL_DMA_GetProgress(channel, &progress);
+    EXPECT_EQ(16u, progress);
+
+    EXPECT_EQ(HAL_OK, HAL_DMA_WaitComplete(channel, 0));
+    EXPECT_EQ(48u, SIM_TIMER_GetCurrentTime());
+
+    SIM_TIMER_AdvanceTime(16);
+    uint8_t received[64];
+    size_t count;
+    EXPECT_EQ(0, SIM_PERIPH_Drain(driver, received, sizeof(received), &count));
+    EXPECT_EQ(64u, count);
+    EXPECT_EQ(0, memcmp(frame, received, sizeof(frame)));
+
+    SimPeriphStats stats;
+    SIM_PERIPH_GetStats(driver, &stats);
+    EXPECT_EQ(64u, stats.dmaBytes);
+    EXPECT_EQ(16u, stats.maxFifoLevel);
+    EXPECT_EQ(0u, stats.underrunBytes);
+}
+
+TEST_F(SimPeriphTest, SourceFeedsTimedBus)
+{
+    SimDmaConfig dmaConfig = {100, 16, 0, 0};
+    HAL_DMA_Init(0, &dmaConfig);
+
+    SimPeriphConfig config = MakeConfig(SIM_PERIPH_SOURCE, SIM_PERIPH_BACKEND_FIFO, 10, 32);
+    void* adc;
+    ASSERT_EQ(0, SIM_PERIPH_Register("adc", &config, &adc));
+
+    uint8_t samples[256];
+    for (int i = 0; i < 256; i++) {
+        samples[i] = (uint8_t) (i * 7);
+    }
+    ASSERT_EQ(0, SIM_PERIPH_Feed(adc, samples, sizeof(samples)));
+
+    uint8_t data[128] = {0};
+    DmaChannel channel;
+    HAL_DMA_RequestChannel(0, DMA_DIR_PERIPH_TO_MEM, 1, &channel);
+    EXPECT_EQ(HAL_OK, HAL_DMA_StartTransfer(channel, adc, data, sizeof(data)));
+    EXPECT_EQ(HAL_OK, HAL_DMA_WaitComplete(channel, 0));
+
+    // Paced by the ADC (12.8us for 128 bytes), not by the 100 B/us bus
+    EXPECT_EQ(13u, SIM_TIMER_GetCurrentTime());
+    EXPECT_EQ(0, memcmp(samples, data, sizeof(data)));
+
+    SimDmaBusStats bus;
+    SIM_DMA_GetBusStats(0, &bus);
+    EXPECT_EQ(1280u, bus.busyNs);
+}
+
+TEST_F(SimPeriphTest, SourceOverrunDropsSamples)
+{
+    SimPeriphConfig config = MakeConfig(SIM_PERIPH_SOURCE, SIM_PERIPH_BACKEND_FIFO, 10, 32);
+    void* adc;
+    SIM_PERIPH_Register("adc", &config, &adc);
+
+    uint8_t samples[200] = {0};
+    SIM_PERIPH_Feed(adc, samples, sizeof(samples));
+    SIM_TIMER_AdvanceTime(10);
+
+    SimPeriphStats stats;
+    SIM_PERIPH_GetStats(adc, &stats);
+    EXPECT_EQ(32u, stats.fifoLevel);
+    EXPECT_EQ(32u, stats.deviceBytes);
+    EXPECT_EQ(68u, stats.overrunBytes);
+
+    // Stream runs dry after the remaining 100 samples
+    SIM_TIMER_AdvanceTime(20);
+    SIM_PERIPH_GetStats(adc, &stats);
+    EXPECT_EQ(168u, stats.overrunBytes);
+    EXPECT_EQ(100u, stats.underrunBytes);
+}
+
+TEST_F(SimPeriphTest, FileSourceLoops)
+{
+    std::string path = ::testing::TempDir() + "sim_periph_samples.bin";
+    FILE* file = fopen(path.c_str(), "wb");
+    ASSERT_NE(nullptr, file);
+    for (uint8_t i = 0; i < 10; i++) {
+        fputc(i, file);
+    }
+    fclose(file);
+
+    for (bool useMmap : {false, true}) {
+        SimPeriphConfig config = MakeConfig(SIM_PERIPH_SOURCE, SIM_PERIPH_BACKEND_FILE, 0, 8);
+        config.path = path.c_str();
+        config.useMmap = useMmap;
+        config.loop = true;
+        void* stream;
+        ASSERT_EQ(0, SIM_PERIPH_Register("file", &config, &stream));
+
+        uint8_t data[25] = {0};
+        DmaChannel channel;
+        HAL_DMA_RequestChannel(0, DMA_DIR_PERIPH_TO_MEM, 1, &channel);
+        EXPECT_EQ(HAL_OK, HAL_DMA_StartTransfer(channel, stream, data, sizeof(data)));
+
+        bool busy = true;
+        HAL_DMA_IsBusy(channel, &busy);
+        EXPECT_FALSE(busy);
+        for (int i = 0; i < 25; i++) {
+            EXPECT_EQ(i % 10, data[i]) << "mmap=" << useMmap << " i=" << i;
+        }
+
+        HAL_DMA_ReleaseChannel(channel);
+        SIM_PERIPH_Unregister(stream);
+    }
+
+    remove(path.c_str());
+}
+
+static size_t CountingSink(void* data, size_t size, void* userData)
+{
+    size_t* total = (size_t*) userData;
+    for (size_t i = 0; i < size; i++) {
+        *total += ((uint8_t*) data)[i];
+    }
+    return size;
+}
+
+TEST_F(SimPeriphTest, CallbackSink)
+{
+    size_t total = 0;
+    SimPeriphConfig config = MakeConfig(SIM_PERIPH_SINK, SIM_PERIPH_BACKEND_CALLBACK, 0, 0);
+    config.callback = CountingSink;
+    config.userData = &total;
+    void* sink;
+    ASSERT_EQ(0, SIM_PERIPH_Register("sink", &config, &sink));
+
+    uint8_t data[300];
+    memset(data, 2, sizeof(data));
+    DmaChannel channel;
+    HAL_DMA_RequestChannel(0, DMA_DIR_MEM_TO_PERIPH, 1, &channel);
+    EXPECT_EQ(HAL_OK, HAL_DMA_StartTransfer(channel, data, sink, sizeof(data)));
+    EXPECT_EQ(600u, total);
+}
+
+TEST_F(SimPeriphTest, StarvedSourceResumesOnFeed)
+{
+    SimPeriphConfig config = MakeConfig(SIM_PERIPH_SOURCE, SIM_PERIPH_BACKEND_FIFO, 0, 0);
+    void* adc;
+    SIM_PERIPH_Register("adc", &config, &adc);
+
+    uint8_t data[8] = {0};
+    DmaChannel channel;
+    HAL_DMA_RequestChannel(0, DMA_DIR_PERIPH_TO_MEM, 1, &channel);
+    EXPECT_EQ(HAL_OK, HAL_DMA_StartTransfer(channel, adc, data, sizeof(data)));
+    EXPECT_EQ(HAL_TIMEOUT, HAL_DMA_WaitComplete(channel, 0));
+    EXPECT_EQ(HAL_TIMEOUT, HAL_DMA_WaitComplete(channel, 1));
+    EXPECT_EQ(1000u, SIM_TIMER_GetCurrentTime());
+
+    uint8_t samples[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+    SIM_PERIPH_Feed(adc, samples, sizeof(samples));
+
+    bool busy = true;
+    HAL_DMA_IsBusy(channel, &busy);
+    EXPECT_FALSE(busy);
+    EXPECT_EQ(0, memcmp(samples, data, sizeof(data)));
+}
+
+TEST_F(SimPeriphTest, RejectsWrongDirection)
+{
+    SimPeriphConfig config = MakeConfig(SIM_PERIPH_SOURCE, SIM_PERIPH_BACKEND_FIFO, 0, 0);
+    void* adc;
+    SIM_PERIPH_Register("adc", &config, &adc);
+
+    uint8_t data[8] = {0};
+    DmaChannel channel;
+    HAL_DMA_RequestChannel(0, DMA_DIR_MEM_TO_PERIPH, 1, &channel);
+    EXPECT_EQ(HAL_ERROR, HAL_DMA_StartTransfer(channel, data, adc, sizeof(data)));
+
+    // Stale data register of an unregistered peripheral
+    SIM_PERIPH_Unregister(adc);
+    EXPECT_EQ(HAL_ERROR, HAL_DMA_StartTransfer(channel, adc, data, sizeof(data)));
+    EXPECT_EQ(-1, SIM_PERIPH_Feed(adc, data, sizeof(data)));
+}
+
+int main(int argc, char** argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,368 @@
+/**
+ * @file test_sim_queue.cpp
+ * @brief Message Queue Simulator Unit Tests
+ */
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+extern "C" {
+#include "hal_queue.h"
+#include "hal_scheduler.h"
+#include "hal_timer.h"
+#include "sim_kernel.h"
+#include "sim_queue.h"
+#include "sim_scheduler.h"
+#include "sim_timer.h"
+}
+
+class SimQueueTest : public ::testing::Test
+{
+   protected:
+    void SetUp() override
+    {
+        SIM_TIMER_Init();
+        SIM_QUEUE_Reset();
+        HAL_SCHEDULER_Init();
+    }
+
+    void TearDown() override
+    {
+        SIM_SCHEDULER_SetTaskStacks(0);
+        SIM_SCHEDULER_SetWorkers(0);
+        SIM_QUEUE_Reset();
+        SIM_TIMER_Reset();
+    }
+
+    std::string trace;
+};
+
+TEST_F(SimQueueTest, CreateRejectsInvalidArguments)
+{
+    QueueHandle queue;
+    EXPECT_EQ(HAL_ERROR, HAL_QUEUE_Create(0, 4, QUEUE_MODE_SPSC, &queue));
+    EXPECT_EQ(HAL_ERROR, HAL_QUEUE_Create(4, 0, QUEUE_MODE_SPSC, &queue));
+    EXPECT_EQ(HAL_ERROR, HAL_QUEUE_Create(4, 4, (QueueMode) 7, &queue));
+    EXPECT_EQ(HAL_ERROR, HAL_QUEUE_Create(4, 4, QUEUE_MODE_SPSC, nullptr));
+
+    ASSERT_EQ(HAL_OK, HAL_QUEUE_Create(4, 5, QUEUE_MODE_SPSC, &queue));
+    SimQueueStats stats;
+    ASSERT_EQ(0, SIM_QUEUE_GetStats(queue, &stats));
+    EXPECT_EQ(8u, stats.capacity);
+
+    // Deleted handles stay invalid even when the slot is reused
+    EXPECT_EQ(HAL_OK, HAL_QUEUE_Delete(queue));
+    EXPECT_EQ(HAL_ERROR, HAL_QUEUE_Delete(queue));
+    QueueHandle next;
+    ASSERT_EQ(HAL_OK, HAL_QUEUE_Create(4, 4, QUEUE_MODE_SPSC, &next));
+    EXPECT_NE(queue, next);
+    uint32_t value = 1;
+    EXPECT_EQ(HAL_ERROR, HAL_QUEUE_TrySend(queue, &value));
+}
+
+TEST_F(SimQueueTest, RingsKeepOrderAndReportFull)
+{
+    const QueueMode modes[] = {QUEUE_MODE_SPSC, QUEUE_MODE_MPSC};
+    for (QueueMode mode : modes) {
+        QueueHandle queue;
+        ASSERT_EQ(HAL_OK, HAL_QUEUE_Create(sizeof(uint32_t), 4, mode, &queue));
+
+        // Several laps around the ring
+        uint32_t next = 0;
+        uint32_t expected = 0;
+        for (int lap = 0; lap < 3; lap++) {
+            while (HAL_QUEUE_TrySend(queue, &next) == HAL_OK) {
+                next++;
+            }
+            EXPECT_EQ(4u, HAL_QUEUE_GetCount(queue));
+
+            uint32_t value;
+            while (HAL_QUEUE_TryReceive(queue, &value) == HAL_OK) {
+                EXPECT_EQ(expected++, value);
+            }
+            EXPECT_EQ(0u, HAL_QUEUE_GetCount(queue));
+        }
+        EXPECT_EQ(12u, next);
+        EXPECT_EQ(12u, expected);
+
+        SimQueueStats stats;
+        SIM_QUEUE_GetStats(queue, &stats);
+        EXPECT_EQ(12u, stats.sent);
+        EXPECT_EQ(12u, stats.received);
+        EXPECT_EQ(HAL_OK, HAL_QUEUE_Delete(queue));
+    }
+}
+
+TEST_F(SimQueueTest, TimeoutRunsSimulatedTime)
+{
+    QueueHandle queue;
+    ASSERT_EQ(HAL_OK, HAL_QUEUE_Create(sizeof(uint32_t), 1, QUEUE_MODE_SPSC, &queue));
+
+    uint32_t value = 7;
+    EXPECT_EQ(HAL_TIMEOUT, HAL_QUEUE_Receive(queue, &value, 5));
+    EXPECT_EQ(5000u, SIM_TIMER_GetCurrentTime());
+
+    EXPECT_EQ(HAL_OK, HAL_QUEUE_Send(queue, &value, 5));
+    EXPECT_EQ(HAL_TIMEOUT, HAL_QUEUE_Send(queue, &value, 2));
+    EXPECT_EQ(7000u, SIM_TIMER_GetCurrentTime());
+
+    // Waiting for good on a queue nothing will ever feed gives up right away
+    EXPECT_EQ(HAL_OK, HAL_QUEUE_Receive(queue, &value, 0));
+    EXPECT_EQ(HAL_TIMEOUT, HAL_QUEUE_Receive(queue, &value, 0));
+    EXPECT_EQ(7000u, SIM_TIMER_GetCurrentTime());
+
+    SimQueueStats stats;
+    SIM_QUEUE_GetStats(queue, &stats);
+    EXPECT_EQ(1u, stats.sendWaits);
+    EXPECT_EQ(2u, stats.recvWaits);
+    EXPECT_EQ(3u, stats.timeouts);
+}
+
+static void SendFromInterrupt(TimerHandle timer, void* userData)
+{
+    (void) timer;
+    uint32_t value = (uint32_t) SIM_TIMER_GetCurrentTime();
+    HAL_QUEUE_TrySend((QueueHandle) userData, &value);
+}
+
+TEST_F(SimQueueTest, ReceiveWaitsForTimerCallback)
+{
+    QueueHandle queue;
+    ASSERT_EQ(HAL_OK, HAL_QUEUE_Create(sizeof(uint32_t), 4, QUEUE_MODE_MPSC, &queue));
+
+    TimerConfig config = {.mode = TIMER_MODE_ONESHOT,
+                          .periodUs = 3000,
+                          .callback = SendFromInterrupt,
+                          .userData = queue,
+                          .priority = 0};
+    TimerHandle timer;
+    ASSERT_EQ(HAL_OK, HAL_TIMER_Create(0, &config, &timer));
+    ASSERT_EQ(HAL_OK, HAL_TIMER_Start(timer));
+
+    uint32_t value = 0;
+    EXPECT_EQ(HAL_OK, HAL_QUEUE_Receive(queue, &value, 0));
+    EXPECT_EQ(3000u, value);
+    EXPECT_EQ(3000u, SIM_TIMER_GetCurrentTime());
+}
+
+struct PipeEnd {
+    QueueHandle queue;
+    std::string* trace;
+    int items;
+    uint32_t timeoutMs;
+    int result;
+    uint64_t doneUs;
+};
+
+static void PipeSenderFunc(void* args)
+{
+    PipeEnd* end = (PipeEnd*) args;
+    for (int i = 0; i < end->items; i++) {
+        uint32_t value = (uint32_t) i;
+        end->result = HAL_QUEUE_Send(end->queue, &value, end->timeoutMs);
+        *end->trace += 's';
+    }
+}
+
+static void PipeReceiverFunc(void* args)
+{
+    PipeEnd* end = (PipeEnd*) args;
+    for (int i = 0; i < end->items; i++) {
+        uint32_t value = 0;
+        end->result = HAL_QUEUE_Receive(end->queue, &value, end->timeoutMs);
+        if (end->result != HAL_OK || value != (uint32_t) i)
+            break;
+        *end->trace += 'r';
+    }
+    end->doneUs = SIM_TIMER_GetCurrentTime();
+}
+
+TEST_F(SimQueueTest, StackfulTasksBlockOnFullAndEmpty)
+{
+    ASSERT_EQ(0, SIM_SCHEDULER_SetTaskStacks(SIM_SCHEDULER_MIN_STACK_BYTES));
+    QueueHandle queue;
+    ASSERT_EQ(HAL_OK, HAL_QUEUE_Create(sizeof(uint32_t), 2, QUEUE_MODE_SPSC, &queue));
+
+    PipeEnd sender = {queue, &trace, 6, 0, HAL_ERROR, 0};
+    PipeEnd receiver = {queue, &trace, 6, 0, HAL_ERROR, 0};
+    TaskHandle hs, hr;
+    HAL_SCHEDULER_CreateTask(PipeReceiverFunc, &receiver, TASK_PRIORITY_HIGH, &hr);
+    HAL_SCHEDULER_CreateTask(PipeSenderFunc, &sender, TASK_PRIORITY_LOW, &hs);
+
+    // Dispatching is non-preemptive: whoever runs fills (or drains) the ring, then blocks
+    EXPECT_EQ(HAL_OK, HAL_SCHEDULER_Start());
+    EXPECT_EQ(HAL_OK, receiver.result);
+    EXPECT_EQ(HAL_OK, sender.result);
+    EXPECT_EQ("ssrrssrrssrr", trace);
+    EXPECT_EQ(TASK_STATE_COMPLETED, HAL_SCHEDULER_GetTaskState(hr));
+    EXPECT_EQ(TASK_STATE_COMPLETED, HAL_SCHEDULER_GetTaskState(hs));
+
+    SimQueueStats stats;
+    SIM_QUEUE_GetStats(queue, &stats);
+    EXPECT_EQ(6u, stats.received);
+    EXPECT_EQ(3u, stats.recvWaits);
+    EXPECT_EQ(2u, stats.sendWaits);
+    EXPECT_EQ(0u, stats.timeouts);
+}
+
+struct TimedReceiver {
+    QueueHandle queue;
+    uint32_t timeoutMs;
+    std::vector<uint32_t> values;
+    int result;
+    uint64_t doneUs;
+};
+
+static void TimedReceiverFunc(void* args)
+{
+    TimedReceiver* receiver = (TimedReceiver*) args;
+    uint32_t value;
+    while ((receiver->result = HAL_QUEUE_Receive(receiver->queue, &value,
+                                                 receiver->timeoutMs)) == HAL_OK) {
+        receiver->values.push_back(value);
+    }
+    receiver->doneUs = SIM_TIMER_GetCurrentTime();
+}
+
+TEST_F(SimQueueTest, BlockedTaskTimesOutInSimulatedTime)
+{
+    ASSERT_EQ(0, SIM_SCHEDULER_SetTaskStacks(SIM_SCHEDULER_MIN_STACK_BYTES));
+    QueueHandle queue;
+    ASSERT_EQ(HAL_OK, HAL_QUEUE_Create(sizeof(uint32_t), 2, QUEUE_MODE_MPSC, &queue));
+
+    TimedReceiver receiver = {queue, 4, {}, HAL_ERROR, 0};
+    TaskHandle hr;
+    HAL_SCHEDULER_CreateTask(TimedReceiverFunc, &receiver, TASK_PRIORITY_NORMAL, &hr);
+
+    // One message arrives in time, the next never does
+    TimerConfig config = {.mode = TIMER_MODE_ONESHOT,
+                          .periodUs = 1500,
+                          .callback = SendFromInterrupt,
+                          .userData = queue,
+                          .priority = 0};
+    TimerHandle timer;
+    ASSERT_EQ(HAL_OK, HAL_TIMER_Create(0, &config, &timer));
+    ASSERT_EQ(HAL_OK, HAL_TIMER_Start(timer));
+
+    EXPECT_EQ(0, SIM_Run(10000));
+    ASSERT_EQ(1u, receiver.values.size());
+    EXPECT_EQ(1500u, receiver.values[0]);
+    EXPECT_EQ(HAL_TIMEOUT, receiver.result);
+    EXPECT_EQ(1500u + 4000u, receiver.doneUs);
+    EXPECT_EQ(TASK_STATE_COMPLETED, HAL_SCHEDULER_GetTaskState(hr));
+}
+
+struct Waiter {
+    QueueHandle queue;
+    std::string* trace;
+    char name;
+};
+
+static void WaiterFunc(void* args)
+{
+    Waiter* waiter = (Waiter*) args;
+    uint32_t value;
+    if (HAL_QUEUE_Receive(waiter->queue, &value, 0) == HAL_OK) {
+        *waiter->trace += waiter->name;
+    }
+}
+
+TEST_F(SimQueueTest, HighestPriorityWaiterWakesFirst)
+{
+    ASSERT_EQ(0, SIM_SCHEDULER_SetTaskStacks(SIM_SCHEDULER_MIN_STACK_BYTES));
+    QueueHandle queue;
+    ASSERT_EQ(HAL_OK, HAL_QUEUE_Create(sizeof(uint32_t), 4, QUEUE_MODE_SPSC, &queue));
+
+    Waiter low = {queue, &trace, 'L'};
+    Waiter high = {queue, &trace, 'H'};
+    TaskHandle hl, hh;
+    HAL_SCHEDULER_CreateTask(WaiterFunc, &low, TASK_PRIORITY_LOW, &hl);
+    HAL_SCHEDULER_CreateTask(WaiterFunc, &high, TASK_PRIORITY_HIGH, &hh);
+
+    EXPECT_EQ(HAL_OK, HAL_SCHEDULER_Start());
+    EXPECT_EQ(TASK_STATE_BLOCKED, HAL_SCHEDULER_GetTaskState(hl));
+    EXPECT_EQ(TASK_STATE_BLOCKED, HAL_SCHEDULER_GetTaskState(hh));
+    EXPECT_EQ(HAL_BUSY, HAL_QUEUE_Delete(queue));
+
+    uint32_t value = 1;
+    EXPECT_EQ(HAL_OK, HAL_QUEUE_TrySend(queue, &value));
+    EXPECT_EQ(TASK_STATE_READY, HAL_SCHEDULER_GetTaskState(hh));
+    EXPECT_EQ(TASK_STATE_BLOCKED, HAL_SCHEDULER_GetTaskState(hl));
+    EXPECT_EQ(HAL_OK, HAL_SCHEDULER_Start());
+    EXPECT_EQ("H", trace);
+
+    // A suspended waiter is passed over until resumed
+    EXPECT_EQ(HAL_OK, HAL_SCHEDULER_SuspendTask(hl));
+    EXPECT_EQ(HAL_OK, HAL_QUEUE_TrySend(queue, &value));
+    EXPECT_EQ(TASK_STATE_SUSPENDED, HAL_SCHEDULER_GetTaskState(hl));
+    EXPECT_EQ(HAL_OK, HAL_SCHEDULER_ResumeTask(hl));
+    EXPECT_EQ(HAL_OK, HAL_SCHEDULER_Start());
+    EXPECT_EQ("HL", trace);
+    EXPECT_EQ(HAL_OK, HAL_QUEUE_Delete(queue));
+}
+
+TEST_F(SimQueueTest, WorkerThreadsShareBlockingQueue)
+{
+    ASSERT_EQ(0, SIM_SCHEDULER_SetTaskStacks(SIM_SCHEDULER_MIN_STACK_BYTES));
+    ASSERT_EQ(0, SIM_SCHEDULER_SetWorkers(4));
+    QueueHandle queue;
+    ASSERT_EQ(HAL_OK, HAL_QUEUE_Create(sizeof(uint32_t), 4, QUEUE_MODE_SPSC, &queue));
+
+    std::string senderTrace, receiverTrace;
+    PipeEnd sender = {queue, &senderTrace, 2000, 0, HAL_ERROR, 0};
+    PipeEnd receiver = {queue, &receiverTrace, 2000, 0, HAL_ERROR, 0};
+    TaskHandle hs, hr;
+    HAL_SCHEDULER_CreateTask(PipeReceiverFunc, &receiver, TASK_PRIORITY_NORMAL, &hr);
+    HAL_SCHEDULER_CreateTask(PipeSenderFunc, &sender, TASK_PRIORITY_NORMAL, &hs);
+
+    EXPECT_EQ(HAL_OK, HAL_SCHEDULER_Start());
+    EXPECT_EQ(HAL_OK, receiver.result);
+    EXPECT_EQ(2000u, receiverTrace.size());
+    EXPECT_EQ(TASK_STATE_COMPLETED, HAL_SCHEDULER_GetTaskState(hr));
+    EXPECT_EQ(TASK_STATE_COMPLETED, HAL_SCHEDULER_GetTaskState(hs));
+}
+
+TEST_F(SimQueueTest, MpscRingAcrossHostThreads)
+{
+    const int producers = 4;
+    const uint32_t perProducer = 50000;
+    QueueHandle queue;
+    ASSERT_EQ(HAL_OK, HAL_QUEUE_Create(sizeof(uint64_t), 64, QUEUE_MODE_MPSC, &queue));
+
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; p++) {
+        threads.emplace_back([queue, p, perProducer] {
+            for (uint32_t i = 0; i < perProducer; i++) {
+                uint64_t value = ((uint64_t) p << 32) | i;
+                while (HAL_QUEUE_TrySend(queue, &value) != HAL_OK) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    // Messages of one producer arrive in the order it sent them
+    std::vector<uint32_t> next(producers, 0);
+    bool ordered = true;
+    for (uint32_t received = 0; received < producers * perProducer;) {
+        uint64_t value;
+        if (HAL_QUEUE_TryReceive(queue, &value) != HAL_OK) {
+            std::this_thread::yield();
+            continue;
+        }
+        uint32_t p = (uint32_t) (value >> 32);
+        ordered = ordered && p < (uint32_t) producers && (uint32_t) value == next[p];
+        next[p]++;
+        received++;
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    EXPECT_TRUE(ordered);
+    EXPECT_EQ(0u, HAL_QUEUE_GetCount(queue));
+}
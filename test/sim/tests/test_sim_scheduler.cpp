@@ -5,8 +5,20 @@
 
 #include <gtest/gtest.h>
 
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
 extern "C" {
 #include "hal_scheduler.h"
+#include "hal_timer.h"
+#include "sim_kernel.h"
+#include "sim_scheduler.h"
+#include "sim_timer.h"
 }
 
 class SimSchedulerTest : public ::testing::Test
@@ -160,6 +172,1753 @@ TEST_F(SimSchedulerTest, CreateAndDeleteMultipleTasks)
     }
 }
 
+// Task that appends its name to a trace and yields until its budget runs out
+struct TraceTask {
+    std::string* trace;
+    char name;
+    int yields;
+};
+
+static void TraceTaskFunc(void* args)
+{
+    TraceTask* task = (TraceTask*) args;
+    *task->trace += task->name;
+    if (task->yields > 0) {
+        task->yields--;
+        HAL_SCHEDULER_Yield();
+    }
+}
+
+TEST_F(SimSchedulerTest, RunsHighestPriorityFirst)
+{
+    std::string trace;
+    TraceTask low = {&trace, 'L', 0};
+    TraceTask normal1 = {&trace, 'N', 0};
+    TraceTask normal2 = {&trace, 'n', 0};
+    TraceTask realtime = {&trace, 'R', 0};
+    TaskHandle handles[4];
+
+    HAL_SCHEDULER_CreateTask(TraceTaskFunc, &low, TASK_PRIORITY_LOW, &handles[0]);
+    HAL_SCHEDULER_CreateTask(TraceTaskFunc, &normal1, TASK_PRIORITY_NORMAL, &handles[1]);
+    HAL_SCHEDULER_CreateTask(TraceTaskFunc, &normal2, TASK_PRIORITY_NORMAL, &handles[2]);
+    HAL_SCHEDULER_CreateTask(TraceTaskFunc, &realtime, TASK_PRIORITY_REALTIME, &handles[3]);
+
+    EXPECT_EQ(HAL_OK, HAL_SCHEDULER_Start());
+    EXPECT_EQ("RNnL", trace);
+    for (TaskHandle handle : handles) {
+        EXPECT_EQ(TASK_STATE_COMPLETED, HAL_SCHEDULER_GetTaskState(handle));
+    }
+}
+
+TEST_F(SimSchedulerTest, YieldRequeuesAtTailOfLevel)
+{
+    std::string trace;
+    TraceTask a = {&trace, 'A', 2};
+    TraceTask b = {&trace, 'B', 1};
+    TraceTask low = {&trace, 'L', 0};
+    TaskHandle handle;
+
+    HAL_SCHEDULER_CreateTask(TraceTaskFunc, &a, TASK_PRIORITY_HIGH, &handle);
+    HAL_SCHEDULER_CreateTask(TraceTaskFunc, &b, TASK_PRIORITY_HIGH, &handle);
+    HAL_SCHEDULER_CreateTask(TraceTaskFunc, &low, TASK_PRIORITY_LOW, &handle);
+
+    HAL_SCHEDULER_Start();
+    EXPECT_EQ("ABABAL", trace);
+
+    SimSchedulerStats stats;
+    SIM_SCHEDULER_GetStats(&stats);
+    EXPECT_EQ(6u, stats.dispatches);
+    EXPECT_EQ(3u, stats.yields);
+    EXPECT_EQ(3u, stats.completions);
+}
+
+TEST_F(SimSchedulerTest, SuspendedTaskWaitsForResume)
+{
+    std::string trace;
+    TraceTask a = {&trace, 'A', 0};
+    TraceTask b = {&trace, 'B', 0};
+    TaskHandle handleA, handleB;
+
+    HAL_SCHEDULER_CreateTask(TraceTaskFunc, &a, TASK_PRIORITY_NORMAL, &handleA);
+    HAL_SCHEDULER_CreateTask(TraceTaskFunc, &b, TASK_PRIORITY_NORMAL, &handleB);
+    HAL_SCHEDULER_SuspendTask(handleA);
+
+    HAL_SCHEDULER_Start();
+    EXPECT_EQ("B", trace);
+    EXPECT_EQ(TASK_STATE_SUSPENDED, HAL_SCHEDULER_GetTaskState(handleA));
+
+    HAL_SCHEDULER_ResumeTask(handleA);
+    HAL_SCHEDULER_Start();
+    EXPECT_EQ("BA", trace);
+    EXPECT_EQ(TASK_STATE_COMPLETED, HAL_SCHEDULER_GetTaskState(handleA));
+}
+
+struct ControlTask {
+    std::string* trace;
+    TaskHandle target;
+};
+
+static void StateProbeTask(void* args)
+{
+    ControlTask* task = (ControlTask*) args;
+    *task->trace += HAL_SCHEDULER_GetTaskState(task->target) == TASK_STATE_RUNNING ? 'r' : '?';
+}
+
+static void StoppingTask(void* args)
+{
+    ControlTask* task = (ControlTask*) args;
+    *task->trace += 'S';
+    HAL_SCHEDULER_Stop();
+}
+
+static void SelfDeletingTask(void* args)
+{
+    ControlTask* task = (ControlTask*) args;
+    *task->trace += 'D';
+    HAL_SCHEDULER_DeleteTask(task->target);
+}
+
+TEST_F(SimSchedulerTest, TaskSeesItselfRunning)
+{
+    std::string trace;
+    ControlTask probe = {&trace, nullptr};
+    HAL_SCHEDULER_CreateTask(StateProbeTask, &probe, TASK_PRIORITY_NORMAL, &probe.target);
+
+    HAL_SCHEDULER_Start();
+    EXPECT_EQ("r", trace);
+}
+
+TEST_F(SimSchedulerTest, StopLeavesRemainingTasksReady)
+{
+    std::string trace;
+    ControlTask stopper = {&trace, nullptr};
+    TraceTask later = {&trace, 'L', 0};
+    TaskHandle stopHandle, laterHandle;
+
+    HAL_SCHEDULER_CreateTask(StoppingTask, &stopper, TASK_PRIORITY_HIGH, &stopHandle);
+    HAL_SCHEDULER_CreateTask(TraceTaskFunc, &later, TASK_PRIORITY_LOW, &laterHandle);
+
+    HAL_SCHEDULER_Start();
+    EXPECT_EQ("S", trace);
+    EXPECT_EQ(TASK_STATE_READY, HAL_SCHEDULER_GetTaskState(laterHandle));
+
+    HAL_SCHEDULER_Start();
+    EXPECT_EQ("SL", trace);
+}
+
+TEST_F(SimSchedulerTest, TaskCanDeleteItself)
+{
+    std::string trace;
+    ControlTask task = {&trace, nullptr};
+    HAL_SCHEDULER_CreateTask(SelfDeletingTask, &task, TASK_PRIORITY_NORMAL, &task.target);
+
+    HAL_SCHEDULER_Start();
+    EXPECT_EQ("D", trace);
+
+    // Stale handle: the slot is free and the handle no longer resolves
+    EXPECT_EQ(HAL_ERROR, HAL_SCHEDULER_DeleteTask(task.target));
+    EXPECT_EQ(HAL_ERROR, HAL_SCHEDULER_ResumeTask(task.target));
+
+    TaskHandle reused;
+    HAL_SCHEDULER_CreateTask(SelfDeletingTask, &task, TASK_PRIORITY_NORMAL, &reused);
+    EXPECT_NE(task.target, reused);
+}
+
+class SimSchedulerGraphTest : public SimSchedulerTest
+{
+   protected:
+    TaskHandle Stage(TraceTask* task, TaskPriority priority = TASK_PRIORITY_NORMAL)
+    {
+        TaskHandle handle = nullptr;
+        HAL_SCHEDULER_CreateTask(TraceTaskFunc, task, priority, &handle);
+        return handle;
+    }
+
+    std::string trace;
+};
+
+TEST_F(SimSchedulerGraphTest, FramePipelineRunsInDependencyOrder)
+{
+    // filter -> {fft, stats} -> detect -> control; control is created first and has the
+    // highest priority, so only the edges keep it last
+    TraceTask control = {&trace, 'C', 0};
+    TraceTask detect = {&trace, 'D', 0};
+    TraceTask stats = {&trace, 'S', 0};
+    TraceTask fft = {&trace, 'F', 0};
+    TraceTask filter = {&trace, 'f', 0};
+    TaskHandle c = Stage(&control, TASK_PRIORITY_REALTIME);
+    TaskHandle d = Stage(&detect, TASK_PRIORITY_HIGH);
+    TaskHandle s = Stage(&stats, TASK_PRIORITY_LOW);
+    TaskHandle f = Stage(&fft);
+    TaskHandle in = Stage(&filter);
+
+    EXPECT_EQ(HAL_OK, HAL_SCHEDULER_AddDependency(in, f));
+    EXPECT_EQ(HAL_OK, HAL_SCHEDULER_AddDependency(in, s));
+    EXPECT_EQ(HAL_OK, HAL_SCHEDULER_AddDependency(f, d));
+    EXPECT_EQ(HAL_OK, HAL_SCHEDULER_AddDependency(s, d));
+    EXPECT_EQ(HAL_OK, HAL_SCHEDULER_AddDependency(d, c));
+    EXPECT_EQ(TASK_STATE_BLOCKED, HAL_SCHEDULER_GetTaskState(d));
+
+    HAL_SCHEDULER_Start();
+    EXPECT_EQ("fFSDC", trace);
+
+    // Periodic frames: re-arm through any member of the graph
+    for (int frame = 0; frame < 2; frame++) {
+        EXPECT_EQ(HAL_OK, HAL_SCHEDULER_RearmGraph(d));
+        EXPECT_EQ(TASK_STATE_READY, HAL_SCHEDULER_GetTaskState(in));
+        EXPECT_EQ(TASK_STATE_BLOCKED, HAL_SCHEDULER_GetTaskState(c));
+        HAL_SCHEDULER_Start();
+    }
+    EXPECT_EQ("fFSDCfFSDCfFSDC", trace);
+}
+
+TEST_F(SimSchedulerGraphTest, RejectsCycles)
+{
+    TraceTask a = {&trace, 'A', 0};
+    TraceTask b = {&trace, 'B', 0};
+    TraceTask c = {&trace, 'C', 0};
+    TaskHandle ha = Stage(&a);
+    TaskHandle hb = Stage(&b);
+    TaskHandle hc = Stage(&c);
+
+    EXPECT_EQ(HAL_OK, HAL_SCHEDULER_AddDependency(ha, hb));
+    EXPECT_EQ(HAL_OK, HAL_SCHEDULER_AddDependency(hb, hc));
+    EXPECT_EQ(HAL_ERROR, HAL_SCHEDULER_AddDependency(hc, ha));
+    EXPECT_EQ(HAL_ERROR, HAL_SCHEDULER_AddDependency(ha, ha));
+    EXPECT_EQ(HAL_OK, HAL_SCHEDULER_AddDependency(ha, hb)); // Duplicate edge
+
+    HAL_SCHEDULER_Start();
+    EXPECT_EQ("ABC", trace);
+}
+
+TEST_F(SimSchedulerGraphTest, YieldingProducerReleasesOnCompletion)
+{
+    TraceTask producer = {&trace, 'P', 2};
+    TraceTask consumer = {&trace, 'C', 0};
+    TraceTask other = {&trace, 'o', 0};
+    TaskHandle p = Stage(&producer);
+    TaskHandle c = Stage(&consumer, TASK_PRIORITY_HIGH);
+    Stage(&other);
+    HAL_SCHEDULER_AddDependency(p, c);
+
+    HAL_SCHEDULER_Start();
+    EXPECT_EQ("PoPPC", trace);
+}
+
+TEST_F(SimSchedulerGraphTest, RearmWaitsForFrameToFinish)
+{
+    TraceTask producer = {&trace, 'P', 0};
+    TraceTask consumer = {&trace, 'C', 0};
+    TaskHandle p = Stage(&producer);
+    TaskHandle c = Stage(&consumer);
+    HAL_SCHEDULER_AddDependency(p, c);
+
+    EXPECT_EQ(HAL_BUSY, HAL_SCHEDULER_RearmGraph(p));
+
+    // A suspended consumer keeps the graph from running it, even once released
+    HAL_SCHEDULER_SuspendTask(c);
+    HAL_SCHEDULER_Start();
+    EXPECT_EQ("P", trace);
+    HAL_SCHEDULER_ResumeTask(c);
+    HAL_SCHEDULER_Start();
+    EXPECT_EQ("PC", trace);
+}
+
+TEST_F(SimSchedulerGraphTest, DeletedProducerNoLongerBlocks)
+{
+    TraceTask producer = {&trace, 'P', 0};
+    TraceTask consumer = {&trace, 'C', 0};
+    TaskHandle p = Stage(&producer);
+    TaskHandle c = Stage(&consumer);
+    HAL_SCHEDULER_AddDependency(p, c);
+
+    HAL_SCHEDULER_DeleteTask(p);
+    EXPECT_EQ(TASK_STATE_READY, HAL_SCHEDULER_GetTaskState(c));
+    HAL_SCHEDULER_Start();
+    EXPECT_EQ("C", trace);
+
+    // Edge from a producer that already completed only counts from the next frame on
+    TraceTask late = {&trace, 'L', 0};
+    TaskHandle l = Stage(&late);
+    HAL_SCHEDULER_AddDependency(c, l);
+    HAL_SCHEDULER_Start();
+    EXPECT_EQ("CL", trace);
+    EXPECT_EQ(HAL_OK, HAL_SCHEDULER_RearmGraph(l));
+    EXPECT_EQ(TASK_STATE_BLOCKED, HAL_SCHEDULER_GetTaskState(l));
+}
+
+struct ChainLink {
+    std::vector<int>* order;
+    int index;
+};
+
+static void ChainLinkFunc(void* args)
+{
+    ChainLink* link = (ChainLink*) args;
+    link->order->push_back(link->index);
+}
+
+TEST_F(SimSchedulerGraphTest, ChainSpansManyTaskSetWords)
+{
+    // Each link waits for the one created after it, so only the edges reverse the order
+    const int links = 300;
+    std::vector<int> order;
+    std::vector<ChainLink> chain(links);
+    std::vector<TaskHandle> handles(links);
+    for (int i = 0; i < links; i++) {
+        chain[i] = {&order, i};
+        ASSERT_EQ(HAL_OK, HAL_SCHEDULER_CreateTask(ChainLinkFunc, &chain[i], TASK_PRIORITY_NORMAL,
+                                                   &handles[i]));
+    }
+    for (int i = 1; i < links; i++) {
+        ASSERT_EQ(HAL_OK, HAL_SCHEDULER_AddDependency(handles[i], handles[i - 1]));
+    }
+    EXPECT_EQ(HAL_ERROR, HAL_SCHEDULER_AddDependency(handles[0], handles[links - 1]));
+
+    std::vector<int> expected;
+    for (int frame = 0; frame < 2; frame++) {
+        HAL_SCHEDULER_Start();
+        for (int i = links - 1; i >= 0; i--) {
+            expected.push_back(i);
+        }
+        EXPECT_EQ(expected, order);
+        EXPECT_EQ(HAL_OK, HAL_SCHEDULER_RearmGraph(handles[0]));
+        EXPECT_EQ(TASK_STATE_READY, HAL_SCHEDULER_GetTaskState(handles[links - 1]));
+        EXPECT_EQ(TASK_STATE_BLOCKED, HAL_SCHEDULER_GetTaskState(handles[0]));
+    }
+}
+
+TEST_F(SimSchedulerGraphTest, FrozenScheduleReplaysDispatcherOrder)
+{
+    TraceTask control = {&trace, 'C', 0};
+    TraceTask detect = {&trace, 'D', 0};
+    TraceTask stats = {&trace, 'S', 0};
+    TraceTask fft = {&trace, 'F', 0};
+    TraceTask filter = {&trace, 'f', 0};
+    TaskHandle c = Stage(&control, TASK_PRIORITY_REALTIME);
+    TaskHandle d = Stage(&detect, TASK_PRIORITY_HIGH);
+    TaskHandle s = Stage(&stats, TASK_PRIORITY_LOW);
+    TaskHandle f = Stage(&fft);
+    TaskHandle in = Stage(&filter);
+    HAL_SCHEDULER_AddDependency(in, f);
+    HAL_SCHEDULER_AddDependency(in, s);
+    HAL_SCHEDULER_AddDependency(f, d);
+    HAL_SCHEDULER_AddDependency(s, d);
+    HAL_SCHEDULER_AddDependency(d, c);
+
+    ScheduleHandle schedule;
+    ASSERT_EQ(HAL_OK, HAL_SCHEDULER_FreezeGraph(d, &schedule));
+
+    TaskHandle order[8];
+    uint32_t count = 0;
+    ASSERT_EQ(0, SIM_SCHEDULER_GetScheduleOrder(schedule, order, 8, &count));
+    ASSERT_EQ(5u, count);
+    std::vector<TaskHandle> expected = {in, f, s, d, c};
+    EXPECT_EQ(expected, std::vector<TaskHandle>(order, order + count));
+
+    // Frozen tasks are off the ready lists; only the replay runs them
+    HAL_SCHEDULER_Start();
+    EXPECT_EQ("", trace);
+    for (int frame = 0; frame < 3; frame++) {
+        EXPECT_EQ(HAL_OK, HAL_SCHEDULER_RunSchedule(schedule));
+    }
+    EXPECT_EQ("fFSDCfFSDCfFSDC", trace);
+    EXPECT_EQ(TASK_STATE_COMPLETED, HAL_SCHEDULER_GetTaskState(in));
+
+    SimSchedulerStats schedulerStats;
+    SIM_SCHEDULER_GetStats(&schedulerStats);
+    EXPECT_EQ(3u, schedulerStats.replays);
+    EXPECT_EQ(0u, schedulerStats.dispatches);
+}
+
+TEST_F(SimSchedulerGraphTest, FrozenTasksLeaveDynamicScheduling)
+{
+    TraceTask producer = {&trace, 'P', 0};
+    TraceTask consumer = {&trace, 'C', 0};
+    TaskHandle p = Stage(&producer);
+    TaskHandle c = Stage(&consumer);
+    HAL_SCHEDULER_AddDependency(p, c);
+    HAL_SCHEDULER_Start();
+
+    ScheduleHandle schedule;
+    ASSERT_EQ(HAL_OK, HAL_SCHEDULER_FreezeGraph(p, &schedule));
+    EXPECT_EQ(HAL_BUSY, HAL_SCHEDULER_FreezeGraph(c, &schedule));
+    EXPECT_EQ(HAL_BUSY, HAL_SCHEDULER_RearmGraph(c));
+    EXPECT_EQ(HAL_BUSY, HAL_SCHEDULER_SuspendTask(c));
+    EXPECT_EQ(HAL_BUSY, HAL_SCHEDULER_ResumeTask(c));
+    EXPECT_EQ(HAL_BUSY, HAL_SCHEDULER_DeleteTask(p));
+
+    TraceTask late = {&trace, 'L', 0};
+    TaskHandle l = Stage(&late);
+    EXPECT_EQ(HAL_BUSY, HAL_SCHEDULER_AddDependency(c, l));
+
+    // Thawed, the graph is a completed frame again
+    ASSERT_EQ(HAL_OK, HAL_SCHEDULER_ThawSchedule(schedule));
+    EXPECT_EQ(HAL_ERROR, HAL_SCHEDULER_RunSchedule(schedule));
+    EXPECT_EQ(HAL_ERROR, HAL_SCHEDULER_ThawSchedule(schedule));
+    ASSERT_EQ(HAL_OK, HAL_SCHEDULER_RearmGraph(c));
+    HAL_SCHEDULER_Start();
+    EXPECT_EQ("PCLPC", trace);
+}
+
+TEST_F(SimSchedulerGraphTest, FreezeWaitsForFrameToFinish)
+{
+    TraceTask producer = {&trace, 'P', 0};
+    TraceTask consumer = {&trace, 'C', 0};
+    TaskHandle p = Stage(&producer);
+    TaskHandle c = Stage(&consumer);
+    HAL_SCHEDULER_AddDependency(p, c);
+
+    ScheduleHandle schedule;
+    HAL_SCHEDULER_SuspendTask(c);
+    EXPECT_EQ(HAL_BUSY, HAL_SCHEDULER_FreezeGraph(p, &schedule));
+    HAL_SCHEDULER_Start();
+    EXPECT_EQ(HAL_BUSY, HAL_SCHEDULER_FreezeGraph(p, &schedule)); // P done, C still to run
+
+    HAL_SCHEDULER_ResumeTask(c);
+    HAL_SCHEDULER_Start();
+    EXPECT_EQ(HAL_OK, HAL_SCHEDULER_FreezeGraph(p, &schedule));
+    EXPECT_EQ(HAL_ERROR, HAL_SCHEDULER_FreezeGraph(p, nullptr));
+}
+
+class SimSchedulerParallelTest : public SimSchedulerTest
+{
+   protected:
+    void SetUp() override
+    {
+        HAL_SCHEDULER_Init();
+        ASSERT_EQ(0, SIM_SCHEDULER_SetWorkers(4));
+    }
+
+    void TearDown() override
+    {
+        SIM_SCHEDULER_SetWorkers(0);
+    }
+};
+
+// Fork-join frame: source -> stages -> sink
+struct FrameStage {
+    std::atomic<int>* sourceDone;
+    std::atomic<int>* stagesDone;
+    int stages;
+    bool ordered;
+};
+
+static void FrameSourceFunc(void* args)
+{
+    FrameStage* stage = (FrameStage*) args;
+    stage->sourceDone->fetch_add(1);
+}
+
+static void FrameStageFunc(void* args)
+{
+    FrameStage* stage = (FrameStage*) args;
+    if (stage->sourceDone->load() == 0) {
+        stage->ordered = false;
+    }
+    stage->stagesDone->fetch_add(1);
+}
+
+static void FrameSinkFunc(void* args)
+{
+    FrameStage* stage = (FrameStage*) args;
+    stage->ordered = stage->stagesDone->load() == stage->stages;
+}
+
+TEST_F(SimSchedulerParallelTest, GraphFramesRunOnWorkerPool)
+{
+    const int stages = 48;
+    std::atomic<int> sourceDone(0);
+    std::atomic<int> stagesDone(0);
+    FrameStage source = {&sourceDone, &stagesDone, stages, true};
+    FrameStage sink = {&sourceDone, &stagesDone, stages, false};
+    FrameStage middle[stages];
+    TaskHandle in, out, handles[stages];
+
+    HAL_SCHEDULER_CreateTask(FrameSourceFunc, &source, TASK_PRIORITY_HIGH, &in);
+    HAL_SCHEDULER_CreateTask(FrameSinkFunc, &sink, TASK_PRIORITY_REALTIME, &out);
+    for (int i = 0; i < stages; i++) {
+        middle[i] = source;
+        HAL_SCHEDULER_CreateTask(FrameStageFunc, &middle[i], TASK_PRIORITY_NORMAL, &handles[i]);
+        HAL_SCHEDULER_AddDependency(in, handles[i]);
+        HAL_SCHEDULER_AddDependency(handles[i], out);
+    }
+
+    const int frames = 20;
+    for (int frame = 0; frame < frames; frame++) {
+        sourceDone = 0;
+        stagesDone = 0;
+        sink.ordered = false;
+        ASSERT_EQ(HAL_OK, HAL_SCHEDULER_Start());
+        EXPECT_TRUE(sink.ordered) << "frame " << frame;
+        EXPECT_EQ(TASK_STATE_COMPLETED, HAL_SCHEDULER_GetTaskState(out));
+        ASSERT_EQ(HAL_OK, HAL_SCHEDULER_RearmGraph(in));
+    }
+    for (int i = 0; i < stages; i++) {
+        EXPECT_TRUE(middle[i].ordered);
+    }
+
+    SimSchedulerStats stats;
+    SIM_SCHEDULER_GetStats(&stats);
+    EXPECT_EQ((uint64_t) frames * (stages + 2), stats.completions);
+
+    uint64_t tasksRun = 0;
+    for (uint32_t worker = 0; worker < 4; worker++) {
+        SimSchedulerWorkerStats workerStats;
+        ASSERT_EQ(0, SIM_SCHEDULER_GetWorkerStats(worker, &workerStats));
+        tasksRun += workerStats.tasksRun;
+    }
+    EXPECT_EQ(stats.dispatches, tasksRun);
+
+    SimSchedulerWorkerStats unused;
+    EXPECT_EQ(-1, SIM_SCHEDULER_GetWorkerStats(4, &unused));
+}
+
+struct CountingTask {
+    std::atomic<int>* runs;
+    int yields;
+    bool stop;
+};
+
+static void CountingTaskFunc(void* args)
+{
+    CountingTask* task = (CountingTask*) args;
+    task->runs->fetch_add(1);
+    if (task->stop) {
+        HAL_SCHEDULER_Stop();
+    } else if (task->yields > 0) {
+        task->yields--;
+        HAL_SCHEDULER_Yield();
+    }
+}
+
+TEST_F(SimSchedulerParallelTest, YieldingTasksAllComplete)
+{
+    std::atomic<int> runs(0);
+    CountingTask tasks[32];
+    TaskHandle handles[32];
+
+    for (int i = 0; i < 32; i++) {
+        tasks[i] = {&runs, 10, false};
+        HAL_SCHEDULER_CreateTask(CountingTaskFunc, &tasks[i], (TaskPriority) (i % 4), &handles[i]);
+    }
+
+    ASSERT_EQ(HAL_OK, HAL_SCHEDULER_Start());
+    EXPECT_EQ(32 * 11, runs.load());
+    for (TaskHandle handle : handles) {
+        EXPECT_EQ(TASK_STATE_COMPLETED, HAL_SCHEDULER_GetTaskState(handle));
+    }
+}
+
+TEST_F(SimSchedulerParallelTest, StopLeavesQueuedTasksReady)
+{
+    std::atomic<int> runs(0);
+    CountingTask stopper = {&runs, 0, true};
+    CountingTask tasks[16];
+    TaskHandle handles[16];
+
+    // The stopper runs first; tasks still queued afterwards are ready for the next Start
+    TaskHandle stopHandle;
+    HAL_SCHEDULER_CreateTask(CountingTaskFunc, &stopper, TASK_PRIORITY_REALTIME, &stopHandle);
+    for (int i = 0; i < 16; i++) {
+        tasks[i] = {&runs, 1000, false};
+        HAL_SCHEDULER_CreateTask(CountingTaskFunc, &tasks[i], TASK_PRIORITY_LOW, &handles[i]);
+    }
+
+    ASSERT_EQ(HAL_OK, HAL_SCHEDULER_Start());
+    int finished = 0;
+    for (TaskHandle handle : handles) {
+        TaskState state = HAL_SCHEDULER_GetTaskState(handle);
+        EXPECT_TRUE(state == TASK_STATE_READY || state == TASK_STATE_COMPLETED);
+        finished += state == TASK_STATE_COMPLETED;
+    }
+    EXPECT_LT(finished, 16);
+
+    ASSERT_EQ(HAL_OK, HAL_SCHEDULER_Start());
+    EXPECT_EQ(1 + 16 * 1001, runs.load());
+}
+
+static void GraphEditTaskFunc(void* args)
+{
+    int* result = (int*) args;
+    TaskHandle handle;
+    HAL_SCHEDULER_CreateTask(DummyTaskFunc, nullptr, TASK_PRIORITY_NORMAL, &handle);
+    *result = HAL_SCHEDULER_AddDependency(handle, handle);
+}
+
+TEST_F(SimSchedulerParallelTest, GraphEditsWaitForFrameEnd)
+{
+    int result = HAL_OK;
+    TaskHandle handle;
+    HAL_SCHEDULER_CreateTask(GraphEditTaskFunc, &result, TASK_PRIORITY_NORMAL, &handle);
+
+    ASSERT_EQ(HAL_OK, HAL_SCHEDULER_Start());
+    EXPECT_EQ(HAL_BUSY, result);
+
+    SimSchedulerStats stats;
+    SIM_SCHEDULER_GetStats(&stats);
+    EXPECT_EQ(2u, stats.completions); // Task created from the task ran in the same frame
+}
+
+class SimSchedulerStackfulTest : public SimSchedulerTest
+{
+   protected:
+    void SetUp() override
+    {
+        HAL_SCHEDULER_Init();
+        ASSERT_EQ(0, SIM_SCHEDULER_SetTaskStacks(SIM_SCHEDULER_MIN_STACK_BYTES));
+    }
+
+    void TearDown() override
+    {
+        SIM_SCHEDULER_SetTaskStacks(0);
+        SIM_SCHEDULER_SetWorkers(0);
+    }
+
+    std::string trace;
+};
+
+// Written for an RTOS: loops and yields in the middle of the function
+static void LoopingTaskFunc(void* args)
+{
+    TraceTask* task = (TraceTask*) args;
+    for (int i = 0; i < task->yields; i++) {
+        *task->trace += task->name;
+        HAL_SCHEDULER_Yield();
+    }
+    *task->trace += '.';
+}
+
+TEST_F(SimSchedulerStackfulTest, YieldContinuesMidFunction)
+{
+    TraceTask a = {&trace, 'A', 3};
+    TraceTask b = {&trace, 'B', 3};
+    TaskHandle ha, hb;
+    HAL_SCHEDULER_CreateTask(LoopingTaskFunc, &a, TASK_PRIORITY_NORMAL, &ha);
+    HAL_SCHEDULER_CreateTask(LoopingTaskFunc, &b, TASK_PRIORITY_NORMAL, &hb);
+
+    EXPECT_EQ(HAL_OK, HAL_SCHEDULER_Start());
+    EXPECT_EQ("ABABAB..", trace);
+    EXPECT_EQ(TASK_STATE_COMPLETED, HAL_SCHEDULER_GetTaskState(ha));
+
+    SimSchedulerStats stats;
+    SIM_SCHEDULER_GetStats(&stats);
+    EXPECT_EQ(8u, stats.dispatches);
+    EXPECT_EQ(6u, stats.yields);
+    EXPECT_EQ(2u, stats.completions);
+
+    // Re-arming starts the function from the top again
+    EXPECT_EQ(HAL_OK, HAL_SCHEDULER_RearmGraph(ha));
+    EXPECT_EQ(HAL_OK, HAL_SCHEDULER_Start());
+    EXPECT_EQ("ABABAB..AAA.", trace);
+}
+
+struct SuspendingTask {
+    std::string* trace;
+    TaskHandle other;
+};
+
+static void SelfSuspendTaskFunc(void* args)
+{
+    SuspendingTask* task = (SuspendingTask*) args;
+    *task->trace += 's';
+    HAL_SCHEDULER_SuspendTask(task->other);
+    *task->trace += 'S';
+}
+
+static void ResumerTaskFunc(void* args)
+{
+    SuspendingTask* task = (SuspendingTask*) args;
+    *task->trace += 'r';
+    HAL_SCHEDULER_ResumeTask(task->other);
+    *task->trace += 'R';
+}
+
+TEST_F(SimSchedulerStackfulTest, SuspendSwitchesUntilResumed)
+{
+    SuspendingTask sleeper = {&trace, nullptr};
+    SuspendingTask waker = {&trace, nullptr};
+    TaskHandle hs, hw;
+    HAL_SCHEDULER_CreateTask(SelfSuspendTaskFunc, &sleeper, TASK_PRIORITY_HIGH, &hs);
+    HAL_SCHEDULER_CreateTask(ResumerTaskFunc, &waker, TASK_PRIORITY_LOW, &hw);
+    sleeper.other = hs;
+    waker.other = hs;
+
+    EXPECT_EQ(HAL_OK, HAL_SCHEDULER_Start());
+    EXPECT_EQ("srRS", trace);
+    EXPECT_EQ(TASK_STATE_COMPLETED, HAL_SCHEDULER_GetTaskState(hs));
+}
+
+static void SelfDeleteTaskFunc(void* args)
+{
+    SuspendingTask* task = (SuspendingTask*) args;
+    *task->trace += 'd';
+    HAL_SCHEDULER_DeleteTask(task->other);
+    *task->trace += 'X'; // Never reached
+}
+
+TEST_F(SimSchedulerStackfulTest, DeleteSelfNeverReturns)
+{
+    SuspendingTask task = {&trace, nullptr};
+    HAL_SCHEDULER_CreateTask(SelfDeleteTaskFunc, &task, TASK_PRIORITY_NORMAL, &task.other);
+
+    EXPECT_EQ(HAL_OK, HAL_SCHEDULER_Start());
+    EXPECT_EQ("d", trace);
+
+    // The slot and its stack can be reused
+    TraceTask plain = {&trace, 'p', 0};
+    TaskHandle handle;
+    EXPECT_EQ(HAL_OK, HAL_SCHEDULER_CreateTask(TraceTaskFunc, &plain, TASK_PRIORITY_NORMAL,
+                                               &handle));
+    EXPECT_EQ(HAL_OK, HAL_SCHEDULER_Start());
+    EXPECT_EQ("dp", trace);
+}
+
+TEST_F(SimSchedulerStackfulTest, RunToCompletionTasksStillYieldByReturning)
+{
+    SIM_SCHEDULER_SetTaskStacks(0);
+    TraceTask plain = {&trace, 'P', 2};
+    TaskHandle handle;
+    HAL_SCHEDULER_CreateTask(TraceTaskFunc, &plain, TASK_PRIORITY_NORMAL, &handle);
+
+    SIM_SCHEDULER_SetTaskStacks(SIM_SCHEDULER_MIN_STACK_BYTES);
+    TraceTask looping = {&trace, 'L', 2};
+    HAL_SCHEDULER_CreateTask(LoopingTaskFunc, &looping, TASK_PRIORITY_NORMAL, &handle);
+
+    EXPECT_EQ(HAL_OK, HAL_SCHEDULER_Start());
+    EXPECT_EQ("PLPLP.", trace);
+}
+
+TEST_F(SimSchedulerStackfulTest, RejectsTinyStacks)
+{
+    EXPECT_EQ(-1, SIM_SCHEDULER_SetTaskStacks(SIM_SCHEDULER_MIN_STACK_BYTES - 1));
+}
+
+static int OverflowStack(int depth)
+{
+    volatile char frame[1024];
+    frame[0] = (char) depth;
+    if (depth == 1 << 30)
+        return frame[0];
+    return OverflowStack(depth + 1) + frame[0];
+}
+
+static void OverflowTaskFunc(void* args)
+{
+    (void) args;
+    OverflowStack(0);
+}
+
+TEST_F(SimSchedulerStackfulTest, GuardPageCatchesOverflow)
+{
+    TaskHandle handle;
+    HAL_SCHEDULER_CreateTask(OverflowTaskFunc, nullptr, TASK_PRIORITY_NORMAL, &handle);
+    EXPECT_DEATH(HAL_SCHEDULER_Start(), "");
+}
+
+struct CoroutineCounter {
+    std::atomic<int>* turns;
+    int yields;
+};
+
+static void CoroutineCounterFunc(void* args)
+{
+    CoroutineCounter* task = (CoroutineCounter*) args;
+    for (int i = 0; i < task->yields; i++) {
+        task->turns->fetch_add(1);
+        HAL_SCHEDULER_Yield();
+    }
+}
+
+TEST_F(SimSchedulerStackfulTest, CoroutinesMigrateBetweenWorkers)
+{
+    ASSERT_EQ(0, SIM_SCHEDULER_SetWorkers(4));
+
+    std::atomic<int> turns(0);
+    CoroutineCounter tasks[16];
+    for (int i = 0; i < 16; i++) {
+        TaskHandle handle;
+        tasks[i] = {&turns, 100};
+        HAL_SCHEDULER_CreateTask(CoroutineCounterFunc, &tasks[i], (TaskPriority) (i % 4), &handle);
+    }
+
+    EXPECT_EQ(HAL_OK, HAL_SCHEDULER_Start());
+    EXPECT_EQ(16 * 100, turns.load());
+
+    SimSchedulerStats stats;
+    SIM_SCHEDULER_GetStats(&stats);
+    EXPECT_EQ(16u, stats.completions);
+}
+
+class SimSchedulerProfileTest : public ::testing::Test
+{
+   protected:
+    void SetUp() override
+    {
+        SIM_TIMER_Init();
+        HAL_SCHEDULER_Init();
+    }
+
+    void TearDown() override
+    {
+        SIM_SCHEDULER_StopTrace();
+        SIM_TIMER_Reset();
+    }
+};
+
+// Works 50 us of simulated time per run, yielding until its budget is used
+static void TimedWorkerFunc(void* args)
+{
+    int* runsLeft = (int*) args;
+    HAL_TIMER_DelayUs(50);
+    if (--*runsLeft > 0) {
+        HAL_SCHEDULER_Yield();
+    }
+}
+
+TEST_F(SimSchedulerProfileTest, StatsTrackRunsAndWakeupLatency)
+{
+    int runsLeft = 3;
+    TaskHandle handle;
+    ASSERT_EQ(HAL_OK, HAL_SCHEDULER_CreateTask(TimedWorkerFunc, &runsLeft, TASK_PRIORITY_NORMAL,
+                                               &handle));
+    SIM_TIMER_AdvanceTime(100); // Ready at 0, first run at 100
+
+    ASSERT_EQ(HAL_OK, HAL_SCHEDULER_Start());
+
+    TaskStats stats;
+    ASSERT_EQ(HAL_OK, HAL_SCHEDULER_GetTaskStats(handle, &stats));
+    EXPECT_EQ(0u, stats.createdUs);
+    EXPECT_EQ(3u, stats.runs);
+    EXPECT_EQ(100u, stats.latencyUs); // Re-queued after each yield, run right away
+    EXPECT_EQ(100u, stats.maxLatencyUs);
+    EXPECT_EQ(200u, stats.startUs);
+    EXPECT_EQ(250u, stats.endUs);
+
+    // Host time is only measured while tracing
+    EXPECT_EQ(0u, stats.runNs);
+    EXPECT_EQ(HAL_ERROR, HAL_SCHEDULER_GetTaskStats(handle, nullptr));
+    EXPECT_EQ(HAL_ERROR, HAL_SCHEDULER_GetTaskStats((TaskHandle) 0x7F, &stats));
+}
+
+TEST_F(SimSchedulerProfileTest, TraceRecordsCreationAndEveryRun)
+{
+    ASSERT_EQ(0, SIM_SCHEDULER_StartTrace(64));
+
+    int runsLeft[2] = {2, 1};
+    TaskHandle handles[2];
+    for (int i = 0; i < 2; i++) {
+        ASSERT_EQ(HAL_OK, HAL_SCHEDULER_CreateTask(TimedWorkerFunc, &runsLeft[i],
+                                                   TASK_PRIORITY_NORMAL, &handles[i]));
+    }
+    ASSERT_EQ(HAL_OK, HAL_SCHEDULER_Start());
+
+    SimSchedulerTraceRecord records[16];
+    uint32_t count = 0;
+    ASSERT_EQ(0, SIM_SCHEDULER_ReadTrace(records, 16, &count));
+    ASSERT_EQ(5u, count); // 2 creations, 3 runs
+
+    EXPECT_EQ(SIM_SCHEDULER_TRACE_CREATED, records[0].event);
+    EXPECT_EQ((uint64_t) (uintptr_t) handles[0], records[0].task);
+    EXPECT_EQ(SIM_SCHEDULER_TRACE_CREATED, records[1].event);
+
+    // FIFO within a level: task 0 yields behind task 1, then completes
+    EXPECT_EQ(SIM_SCHEDULER_TRACE_YIELDED, records[2].event);
+    EXPECT_EQ(records[0].index, records[2].index);
+    EXPECT_EQ(SIM_SCHEDULER_TRACE_COMPLETED, records[3].event);
+    EXPECT_EQ(records[1].index, records[3].index);
+    EXPECT_EQ(SIM_SCHEDULER_TRACE_COMPLETED, records[4].event);
+    EXPECT_EQ(50u, records[4].readyUs);
+    EXPECT_EQ(100u, records[4].startUs);
+    EXPECT_EQ(150u, records[4].endUs);
+    for (uint32_t i = 2; i < count; i++) {
+        EXPECT_LE(records[i].startNs, records[i].endNs);
+        EXPECT_LE(records[i].readyNs, records[i].startNs);
+    }
+
+    TaskStats stats;
+    ASSERT_EQ(HAL_OK, HAL_SCHEDULER_GetTaskStats(handles[0], &stats));
+    EXPECT_EQ(50u, stats.latencyUs);
+    uint32_t histogramRuns = 0;
+    for (int b = 0; b < TASK_STATS_RUN_BUCKETS; b++) {
+        histogramRuns += stats.runHistogram[b];
+    }
+    EXPECT_EQ(2u, histogramRuns);
+    EXPECT_GE(stats.runNs, stats.maxRunNs);
+    EXPECT_EQ(0, SIM_SCHEDULER_PrintTaskReport());
+}
+
+TEST_F(SimSchedulerProfileTest, ExportWritesChromeTrace)
+{
+    ASSERT_EQ(0, SIM_SCHEDULER_StartTrace(0));
+
+    int runsLeft = 2;
+    TaskHandle handle;
+    HAL_SCHEDULER_CreateTask(TimedWorkerFunc, &runsLeft, TASK_PRIORITY_HIGH, &handle);
+    ASSERT_EQ(HAL_OK, HAL_SCHEDULER_Start());
+
+    std::string path = ::testing::TempDir() + "sim_scheduler_trace.json";
+    ASSERT_EQ(0, SIM_SCHEDULER_ExportTrace(path.c_str()));
+
+    std::ifstream file(path);
+    std::stringstream json;
+    json << file.rdbuf();
+    std::remove(path.c_str());
+
+    EXPECT_EQ(0u, json.str().find("{\"displayTimeUnit\":\"ns\",\"traceEvents\":["));
+    EXPECT_NE(std::string::npos, json.str().find("\"Scheduler (simulated time)\""));
+    EXPECT_NE(std::string::npos, json.str().find("\"end\":\"yielded\""));
+    EXPECT_NE(std::string::npos, json.str().find("\"end\":\"completed\""));
+    EXPECT_NE(std::string::npos, json.str().find("\"ph\":\"i\""));
+    EXPECT_EQ(-1, SIM_SCHEDULER_ExportTrace(nullptr));
+}
+
+// Job of a periodic task: logs its start, then works for workUs of simulated time
+struct RealtimeJob {
+    const char* name;
+    uint32_t workUs;
+};
+
+static std::vector<std::pair<std::string, uint64_t>> g_jobStarts;
+static std::vector<std::pair<TaskTimingEvent, uint64_t>> g_timingEvents;
+
+static void RealtimeJobFunc(void* args)
+{
+    RealtimeJob* job = (RealtimeJob*) args;
+    g_jobStarts.push_back({job->name, SIM_TIMER_GetCurrentTime()});
+    HAL_TIMER_DelayUs(job->workUs);
+}
+
+static void RecordTimingEvent(TaskHandle task, TaskTimingEvent event, void* userData)
+{
+    (void) task;
+    (*(int*) userData)++;
+    g_timingEvents.push_back({event, SIM_TIMER_GetCurrentTime()});
+}
+
+class SimSchedulerRealtimeTest : public ::testing::Test
+{
+   protected:
+    void SetUp() override
+    {
+        g_jobStarts.clear();
+        g_timingEvents.clear();
+        SIM_TIMER_Init();
+        HAL_SCHEDULER_Init();
+    }
+
+    void TearDown() override
+    {
+        SIM_SCHEDULER_SetPolicy(SIM_SCHEDULER_POLICY_RM);
+        SIM_TIMER_Reset();
+    }
+
+    TaskHandle CreatePeriodic(RealtimeJob* job, uint32_t periodUs, uint32_t deadlineUs,
+                              uint32_t budgetUs)
+    {
+        TaskTiming timing = {.periodUs = periodUs, .deadlineUs = deadlineUs, .budgetUs = budgetUs};
+        TaskHandle handle = nullptr;
+        EXPECT_EQ(HAL_OK, HAL_SCHEDULER_CreatePeriodicTask(RealtimeJobFunc, job, &timing, &handle));
+        return handle;
+    }
+};
+
+TEST_F(SimSchedulerRealtimeTest, RateMonotonicRunsShortestPeriodFirst)
+{
+    RealtimeJob background = {"bg", 10};
+    RealtimeJob slow = {"slow", 10};
+    RealtimeJob fast = {"fast", 10};
+
+    TaskHandle handle;
+    ASSERT_EQ(HAL_OK, HAL_SCHEDULER_CreateTask(RealtimeJobFunc, &background,
+                                               TASK_PRIORITY_REALTIME, &handle));
+    CreatePeriodic(&slow, 200, 0, 0);
+    CreatePeriodic(&fast, 100, 0, 0);
+
+    EXPECT_EQ(0, SIM_Run(250));
+
+    // Periodic tasks go ahead of every priority level; releases due together compete
+    std::vector<std::pair<std::string, uint64_t>> expected = {
+        {"fast", 0}, {"slow", 10}, {"bg", 20}, {"fast", 100}, {"fast", 200}, {"slow", 210}};
+    EXPECT_EQ(expected, g_jobStarts);
+}
+
+TEST_F(SimSchedulerRealtimeTest, EdfRunsEarliestDeadlineFirst)
+{
+    RealtimeJob loose = {"loose", 10};
+    RealtimeJob tight = {"tight", 10};
+
+    ASSERT_EQ(0, SIM_SCHEDULER_SetPolicy(SIM_SCHEDULER_POLICY_EDF));
+    CreatePeriodic(&loose, 50, 50, 10);
+    TaskHandle handle = CreatePeriodic(&tight, 100, 20, 10);
+
+    EXPECT_EQ(0, SIM_Run(30));
+
+    // RM would run the shorter period first and finish tight exactly at its deadline
+    std::vector<std::pair<std::string, uint64_t>> expected = {{"tight", 0}, {"loose", 10}};
+    EXPECT_EQ(expected, g_jobStarts);
+
+    TaskStats stats;
+    ASSERT_EQ(HAL_OK, HAL_SCHEDULER_GetTaskStats(handle, &stats));
+    EXPECT_EQ(1u, stats.jobs);
+    EXPECT_EQ(10u, stats.maxResponseUs);
+    EXPECT_EQ(0u, stats.deadlineMisses);
+    EXPECT_EQ(-1, SIM_SCHEDULER_SetPolicy((SimSchedulerPolicy) 7));
+}
+
+TEST_F(SimSchedulerRealtimeTest, ReportsDeadlineMissAndOverrun)
+{
+    int calls = 0;
+    ASSERT_EQ(HAL_OK, HAL_SCHEDULER_RegisterTimingCallback(RecordTimingEvent, &calls));
+
+    RealtimeJob job = {"job", 60};
+    TaskHandle handle = CreatePeriodic(&job, 100, 50, 30);
+
+    EXPECT_EQ(0, SIM_Run(99));
+
+    // The miss fires while the job still runs, the overrun when its run ends
+    std::vector<std::pair<TaskTimingEvent, uint64_t>> expected = {
+        {TASK_TIMING_DEADLINE_MISS, 51}, {TASK_TIMING_OVERRUN, 60}};
+    EXPECT_EQ(expected, g_timingEvents);
+    EXPECT_EQ(2, calls);
+
+    TaskStats stats;
+    ASSERT_EQ(HAL_OK, HAL_SCHEDULER_GetTaskStats(handle, &stats));
+    EXPECT_EQ(1u, stats.jobs);
+    EXPECT_EQ(1u, stats.deadlineMisses);
+    EXPECT_EQ(1u, stats.overruns);
+    EXPECT_EQ(60u, stats.maxResponseUs);
+    EXPECT_EQ(TASK_STATE_BLOCKED, HAL_SCHEDULER_GetTaskState(handle));
+}
+
+TEST_F(SimSchedulerRealtimeTest, LateJobsRunBackToBack)
+{
+    RealtimeJob job = {"job", 150};
+    TaskHandle handle = CreatePeriodic(&job, 100, 0, 0);
+
+    // Overloaded: the run stops once a job ends past the end time
+    EXPECT_EQ(0, SIM_Run(400));
+    EXPECT_EQ(450u, SIM_TIMER_GetCurrentTime());
+
+    std::vector<std::pair<std::string, uint64_t>> expected = {
+        {"job", 0}, {"job", 150}, {"job", 300}};
+    EXPECT_EQ(expected, g_jobStarts);
+
+    TaskStats stats;
+    ASSERT_EQ(HAL_OK, HAL_SCHEDULER_GetTaskStats(handle, &stats));
+    EXPECT_EQ(5u, stats.jobs); // Released at 0, 100, 200, 300 and 400
+    EXPECT_EQ(3u, stats.deadlineMisses);
+    EXPECT_EQ(250u, stats.maxResponseUs); // Released at 200, completed at 450
+}
+
+TEST_F(SimSchedulerRealtimeTest, AnalysisMatchesSimulatedControlLoop)
+{
+    RealtimeJob control = {"control", 300};
+    RealtimeJob sensor = {"sensor", 500};
+    RealtimeJob logger = {"logger", 400};
+    CreatePeriodic(&logger, 5000, 0, 400);
+    CreatePeriodic(&sensor, 2000, 0, 500);
+    CreatePeriodic(&control, 1000, 0, 300);
+
+    SimSchedulerAnalysis analysis;
+    EXPECT_EQ(-1, SIM_SCHEDULER_Analyze(nullptr));
+    ASSERT_EQ(0, SIM_SCHEDULER_Analyze(&analysis));
+    EXPECT_EQ(3u, analysis.tasks);
+    EXPECT_EQ(630000u, analysis.utilizationPpm);
+    EXPECT_NEAR(779763, (int) analysis.boundPpm, 1);
+    EXPECT_TRUE(analysis.schedulable);
+    EXPECT_EQ(nullptr, analysis.critical);
+
+    int misses = 0;
+    ASSERT_EQ(HAL_OK, HAL_SCHEDULER_RegisterTimingCallback(RecordTimingEvent, &misses));
+    EXPECT_EQ(0, SIM_Run(19999)); // Two hyperperiods
+    EXPECT_EQ(0, misses);
+    EXPECT_EQ(20u + 10u + 4u, g_jobStarts.size());
+}
+
+TEST_F(SimSchedulerRealtimeTest, AnalysisFlagsOverloadedSet)
+{
+    RealtimeJob control = {"control", 600};
+    RealtimeJob sensor = {"sensor", 700};
+    TaskHandle controlTask = CreatePeriodic(&control, 1000, 0, 600);
+    CreatePeriodic(&sensor, 1500, 0, 700);
+
+    SimSchedulerAnalysis analysis;
+    ASSERT_EQ(0, SIM_SCHEDULER_Analyze(&analysis));
+    EXPECT_FALSE(analysis.schedulable);
+    EXPECT_EQ(controlTask, analysis.critical); // Blocked by a sensor job that just started
+
+    ASSERT_EQ(0, SIM_SCHEDULER_SetPolicy(SIM_SCHEDULER_POLICY_EDF));
+    ASSERT_EQ(0, SIM_SCHEDULER_Analyze(&analysis));
+    EXPECT_FALSE(analysis.schedulable);
+    EXPECT_EQ(1000000u, analysis.boundPpm);
+
+    EXPECT_EQ(0, SIM_Run(6000));
+    TaskStats stats;
+    ASSERT_EQ(HAL_OK, HAL_SCHEDULER_GetTaskStats(controlTask, &stats));
+    EXPECT_GT(stats.deadlineMisses, 0u);
+}
+
+TEST_F(SimSchedulerRealtimeTest, RejectsInvalidTimingAndGraphs)
+{
+    TaskHandle handle;
+    TaskTiming timing = {.periodUs = 0, .deadlineUs = 0, .budgetUs = 0};
+    EXPECT_EQ(HAL_ERROR,
+              HAL_SCHEDULER_CreatePeriodicTask(DummyTaskFunc, nullptr, &timing, &handle));
+    timing = {.periodUs = 100, .deadlineUs = 150, .budgetUs = 0};
+    EXPECT_EQ(HAL_ERROR,
+              HAL_SCHEDULER_CreatePeriodicTask(DummyTaskFunc, nullptr, &timing, &handle));
+    timing = {.periodUs = 100, .deadlineUs = 50, .budgetUs = 60};
+    EXPECT_EQ(HAL_ERROR,
+              HAL_SCHEDULER_CreatePeriodicTask(DummyTaskFunc, nullptr, &timing, &handle));
+    EXPECT_EQ(HAL_ERROR,
+              HAL_SCHEDULER_CreatePeriodicTask(DummyTaskFunc, nullptr, nullptr, &handle));
+
+    timing = {.periodUs = 100, .deadlineUs = 0, .budgetUs = 60};
+    ASSERT_EQ(HAL_OK,
+              HAL_SCHEDULER_CreatePeriodicTask(DummyTaskFunc, nullptr, &timing, &handle));
+    TaskHandle other;
+    ASSERT_EQ(HAL_OK,
+              HAL_SCHEDULER_CreateTask(DummyTaskFunc, nullptr, TASK_PRIORITY_NORMAL, &other));
+    EXPECT_EQ(HAL_ERROR, HAL_SCHEDULER_AddDependency(handle, other));
+    EXPECT_EQ(HAL_ERROR, HAL_SCHEDULER_AddDependency(other, handle));
+
+    // Periodic tasks only run on the single-threaded dispatcher
+    EXPECT_EQ(-1, SIM_SCHEDULER_SetWorkers(2));
+
+    // Deleting it withdraws its release and deadline events
+    ASSERT_EQ(HAL_OK, HAL_SCHEDULER_DeleteTask(handle));
+    EXPECT_EQ(UINT64_MAX, SIM_KERNEL_GetNextEventTime());
+}
+
+static std::string g_coreLog;
+
+class SimSchedulerCoreTest : public ::testing::Test
+{
+   protected:
+    void SetUp() override
+    {
+        g_coreLog.clear();
+        SIM_TIMER_Init();
+        HAL_SCHEDULER_Init();
+        ASSERT_EQ(0, SIM_SCHEDULER_SetCores(2, false));
+    }
+
+    void TearDown() override
+    {
+        SIM_SCHEDULER_SetCores(1, false);
+        SIM_TIMER_Reset();
+    }
+};
+
+// Core job: logs its name, then works for 10 us of simulated time
+struct CoreJob {
+    char name;
+    TaskHandle wake;   // Resumed at the end of the run, if set
+    TaskHandle self;   // Set with moveTo
+    uint32_t moveTo;   // Affinity the job gives itself before yielding once, if set
+    int runs;
+};
+
+static void CoreJobFunc(void* args)
+{
+    CoreJob* job = (CoreJob*) args;
+    g_coreLog += job->name;
+    HAL_TIMER_DelayUs(10);
+    if (job->wake) {
+        HAL_SCHEDULER_ResumeTask(job->wake);
+    }
+    if (job->moveTo && job->runs++ == 0) {
+        HAL_SCHEDULER_SetAffinity(job->self, job->moveTo);
+        HAL_SCHEDULER_Yield();
+    }
+}
+
+TEST_F(SimSchedulerCoreTest, CoresTakeTurnsAndAffinityMovesQueuedTasks)
+{
+    CoreJob jobs[4] = {{'A', nullptr, nullptr, 0, 0},
+                       {'B', nullptr, nullptr, 0, 0},
+                       {'C', nullptr, nullptr, 0, 0},
+                       {'D', nullptr, nullptr, 0, 0}};
+    TaskHandle handles[4];
+    for (int i = 0; i < 4; i++) {
+        ASSERT_EQ(HAL_OK, HAL_SCHEDULER_CreateTask(CoreJobFunc, &jobs[i], TASK_PRIORITY_NORMAL,
+                                                   &handles[i]));
+    }
+
+    // New tasks spread A C on core 0, B D on core 1; B then moves to the tail of core 0
+    ASSERT_EQ(HAL_OK, HAL_SCHEDULER_SetAffinity(handles[1], 1u << 0));
+    ASSERT_EQ(HAL_OK, HAL_SCHEDULER_Start());
+    EXPECT_EQ("ADCB", g_coreLog);
+
+    SimSchedulerCoreStats core0, core1;
+    ASSERT_EQ(0, SIM_SCHEDULER_GetCoreStats(0, &core0));
+    ASSERT_EQ(0, SIM_SCHEDULER_GetCoreStats(1, &core1));
+    EXPECT_EQ(3u, core0.tasksRun);
+    EXPECT_EQ(1u, core1.tasksRun);
+    EXPECT_EQ(30u, core0.busyUs);
+    EXPECT_EQ(10u, core1.busyUs);
+
+    // One shared simulated clock: the cores' busy times add up to the elapsed time
+    EXPECT_DOUBLE_EQ(0.75, core0.utilization);
+    EXPECT_DOUBLE_EQ(0.25, core1.utilization);
+    EXPECT_EQ(0u, core0.ipis + core1.ipis + core0.migrations + core1.migrations);
+    EXPECT_EQ(-1, SIM_SCHEDULER_GetCoreStats(2, &core0));
+}
+
+TEST_F(SimSchedulerCoreTest, CrossCoreWakeupGoesThroughMailbox)
+{
+    CoreJob sleeper = {'s', nullptr, nullptr, 0, 0};
+    CoreJob waker = {'w', nullptr, nullptr, 0, 0};
+    TaskHandle sleeperHandle, wakerHandle;
+
+    ASSERT_EQ(HAL_OK, HAL_SCHEDULER_CreateTask(CoreJobFunc, &sleeper, TASK_PRIORITY_NORMAL,
+                                               &sleeperHandle));
+    ASSERT_EQ(HAL_OK, HAL_SCHEDULER_SetAffinity(sleeperHandle, 1u << 1));
+    ASSERT_EQ(HAL_OK, HAL_SCHEDULER_SuspendTask(sleeperHandle));
+    waker.wake = sleeperHandle;
+    ASSERT_EQ(HAL_OK, HAL_SCHEDULER_CreateTask(CoreJobFunc, &waker, TASK_PRIORITY_NORMAL,
+                                               &wakerHandle));
+    ASSERT_EQ(HAL_OK, HAL_SCHEDULER_SetAffinity(wakerHandle, 1u << 0));
+
+    ASSERT_EQ(HAL_OK, HAL_SCHEDULER_Start());
+    EXPECT_EQ("ws", g_coreLog);
+    EXPECT_EQ(TASK_STATE_COMPLETED, HAL_SCHEDULER_GetTaskState(sleeperHandle));
+
+    SimSchedulerCoreStats core0, core1;
+    ASSERT_EQ(0, SIM_SCHEDULER_GetCoreStats(0, &core0));
+    ASSERT_EQ(0, SIM_SCHEDULER_GetCoreStats(1, &core1));
+    EXPECT_EQ(0u, core0.ipis);
+    EXPECT_EQ(1u, core1.ipis);
+    EXPECT_EQ(1u, core1.tasksRun);
+}
+
+TEST_F(SimSchedulerCoreTest, RunningTaskMigratesWhenQueuedNext)
+{
+    CoreJob mover = {'m', nullptr, nullptr, 0, 0};
+    mover.moveTo = 1u << 1;
+
+    ASSERT_EQ(HAL_OK,
+              HAL_SCHEDULER_CreateTask(CoreJobFunc, &mover, TASK_PRIORITY_NORMAL, &mover.self));
+    ASSERT_EQ(HAL_OK, HAL_SCHEDULER_Start());
+    EXPECT_EQ("mm", g_coreLog);
+
+    SimSchedulerCoreStats core0, core1;
+    ASSERT_EQ(0, SIM_SCHEDULER_GetCoreStats(0, &core0));
+    ASSERT_EQ(0, SIM_SCHEDULER_GetCoreStats(1, &core1));
+    EXPECT_EQ(1u, core0.tasksRun);
+    EXPECT_EQ(1u, core1.tasksRun);
+    EXPECT_EQ(1u, core1.ipis);
+    EXPECT_EQ(1u, core1.migrations);
+}
+
+TEST_F(SimSchedulerCoreTest, RejectsInvalidAffinityAndConfiguration)
+{
+    TaskHandle handle;
+    ASSERT_EQ(HAL_OK, HAL_SCHEDULER_CreateTask(DummyTaskFunc, nullptr, TASK_PRIORITY_NORMAL,
+                                               &handle));
+
+    EXPECT_EQ(HAL_ERROR, HAL_SCHEDULER_SetAffinity(handle, 0));
+    EXPECT_EQ(HAL_ERROR, HAL_SCHEDULER_SetAffinity(handle, 1u << 2));
+    EXPECT_EQ(HAL_ERROR, HAL_SCHEDULER_SetAffinity(nullptr, 1));
+    EXPECT_EQ(HAL_OK, HAL_SCHEDULER_SetAffinity(handle, 0x7));
+    EXPECT_EQ(-1, SIM_SCHEDULER_SetCores(SIM_SCHEDULER_MAX_CORES + 1, false));
+
+    // Periodic tasks stay on the single-threaded dispatcher
+    TaskTiming timing = {.periodUs = 100, .deadlineUs = 0, .budgetUs = 0};
+    ASSERT_EQ(HAL_OK, HAL_SCHEDULER_CreatePeriodicTask(DummyTaskFunc, nullptr, &timing, &handle));
+    EXPECT_EQ(-1, SIM_SCHEDULER_SetCores(2, true));
+    EXPECT_EQ(0, SIM_SCHEDULER_SetCores(4, false));
+
+    // Fewer cores: tasks queued on the ones that go away move over
+    EXPECT_EQ(0, SIM_SCHEDULER_SetCores(1, false));
+    HAL_SCHEDULER_DeleteTask(handle);
+    EXPECT_EQ(HAL_OK, HAL_SCHEDULER_Start());
+    SimSchedulerCoreStats core0;
+    ASSERT_EQ(0, SIM_SCHEDULER_GetCoreStats(0, &core0));
+    EXPECT_EQ(1u, core0.tasksRun);
+}
+
+static void CountCoreRunFunc(void* args)
+{
+    std::atomic<int>* runs = (std::atomic<int>*) args;
+    if (runs->fetch_add(1) % 4 != 3) {
+        HAL_SCHEDULER_Yield();
+    }
+}
+
+TEST_F(SimSchedulerCoreTest, HostThreadsKeepPinnedTasksOnTheirCore)
+{
+    const int tasks = 32;
+    std::atomic<int> runs[tasks];
+    TaskHandle handles[tasks];
+
+    ASSERT_EQ(0, SIM_SCHEDULER_SetCores(4, true));
+    ASSERT_EQ(0, SIM_SCHEDULER_StartTrace(1024));
+    for (int i = 0; i < tasks; i++) {
+        runs[i] = 0;
+        ASSERT_EQ(HAL_OK, HAL_SCHEDULER_CreateTask(CountCoreRunFunc, &runs[i],
+                                                   TASK_PRIORITY_NORMAL, &handles[i]));
+        if (i % 2) {
+            ASSERT_EQ(HAL_OK, HAL_SCHEDULER_SetAffinity(handles[i], 1u << 3));
+        }
+    }
+    ASSERT_EQ(HAL_OK, HAL_SCHEDULER_Start());
+
+    std::vector<SimSchedulerTraceRecord> records(1024);
+    uint32_t count = 0;
+    ASSERT_EQ(0, SIM_SCHEDULER_ReadTrace(records.data(), (uint32_t) records.size(), &count));
+    SIM_SCHEDULER_StopTrace();
+
+    uint64_t total = 0;
+    for (uint32_t c = 0; c < 4; c++) {
+        SimSchedulerCoreStats stats;
+        ASSERT_EQ(0, SIM_SCHEDULER_GetCoreStats(c, &stats));
+        total += stats.tasksRun;
+    }
+    EXPECT_EQ((uint64_t) tasks * 4, total);
+
+    for (uint32_t i = 0; i < count; i++) {
+        if (records[i].event != SIM_SCHEDULER_TRACE_CREATED && records[i].index % 2) {
+            EXPECT_EQ(3, records[i].core);
+        }
+    }
+    for (int i = 0; i < tasks; i++) {
+        EXPECT_EQ(4, runs[i].load());
+        EXPECT_EQ(TASK_STATE_COMPLETED, HAL_SCHEDULER_GetTaskState(handles[i]));
+    }
+}
+
+// Sleeper: works 10 us, then sleeps until 1000 us after its wakeup, three runs in all
+struct IdleSleeper {
+    TaskHandle self;
+    std::vector<uint64_t> starts;
+};
+
+static void IdleSleeperFunc(void* args)
+{
+    IdleSleeper* sleeper = (IdleSleeper*) args;
+    uint64_t wakeUs = SIM_TIMER_GetCurrentTime();
+    sleeper->starts.push_back(wakeUs);
+    HAL_TIMER_DelayUs(10);
+    if (sleeper->starts.size() < 3) {
+        SIM_SCHEDULER_ResumeAt(sleeper->self, wakeUs + 1000);
+        HAL_SCHEDULER_SuspendTask(sleeper->self);
+    }
+}
+
+static void CountIdleJump(uint64_t nowUs, uint64_t wakeUs, void* userData)
+{
+    std::vector<std::pair<uint64_t, uint64_t>>* jumps =
+        (std::vector<std::pair<uint64_t, uint64_t>>*) userData;
+    jumps->push_back({nowUs, wakeUs});
+}
+
+class SimSchedulerIdleTest : public ::testing::Test
+{
+   protected:
+    void SetUp() override
+    {
+        SIM_TIMER_Init();
+        HAL_SCHEDULER_Init();
+        ASSERT_EQ(HAL_OK, HAL_SCHEDULER_CreateTask(IdleSleeperFunc, &sleeper,
+                                                   TASK_PRIORITY_NORMAL, &sleeper.self));
+        ASSERT_EQ(0, SIM_SCHEDULER_SetIdleHook(CountIdleJump, &jumps));
+    }
+
+    void TearDown() override
+    {
+        SIM_TIMER_Reset();
+    }
+
+    IdleSleeper sleeper;
+    std::vector<std::pair<uint64_t, uint64_t>> jumps;
+};
+
+TEST_F(SimSchedulerIdleTest, RunJumpsOverIdleStretches)
+{
+    EXPECT_EQ(0, SIM_Run(5000));
+
+    std::vector<uint64_t> starts = {0, 1000, 2000};
+    EXPECT_EQ(starts, sleeper.starts);
+
+    // Straight from the end of one run to the next wakeup, then to the end of the run
+    std::vector<std::pair<uint64_t, uint64_t>> expected = {
+        {10, 1000}, {1010, 2000}, {2010, 5000}};
+    EXPECT_EQ(expected, jumps);
+
+    SimSchedulerIdleStats idle;
+    ASSERT_EQ(0, SIM_SCHEDULER_GetIdleStats(&idle));
+    EXPECT_EQ(5000u, idle.elapsedUs);
+    EXPECT_EQ(4970u, idle.idleUs);
+    EXPECT_EQ(3u, idle.sleeps);
+    EXPECT_EQ(2990u, idle.maxSleepUs);
+    EXPECT_EQ(-1, SIM_SCHEDULER_GetIdleStats(nullptr));
+}
+
+TEST_F(SimSchedulerIdleTest, TicklessStartSleepsUntilNoTaskWaitsForTime)
+{
+    // Without tickless idle Start returns as soon as the ready lists drain
+    ASSERT_EQ(HAL_OK, HAL_SCHEDULER_Start());
+    EXPECT_EQ(1u, sleeper.starts.size());
+    EXPECT_EQ(TASK_STATE_SUSPENDED, HAL_SCHEDULER_GetTaskState(sleeper.self));
+
+    ASSERT_EQ(0, SIM_SCHEDULER_SetTickless(true));
+    ASSERT_EQ(HAL_OK, HAL_SCHEDULER_Start());
+    std::vector<uint64_t> starts = {0, 1000, 2000};
+    EXPECT_EQ(starts, sleeper.starts);
+    EXPECT_EQ(TASK_STATE_COMPLETED, HAL_SCHEDULER_GetTaskState(sleeper.self));
+    EXPECT_EQ(2010u, SIM_TIMER_GetCurrentTime());
+
+    SimSchedulerIdleStats idle;
+    ASSERT_EQ(0, SIM_SCHEDULER_GetIdleStats(&idle));
+    EXPECT_EQ(2000u, idle.elapsedUs);
+    EXPECT_EQ(1980u, idle.idleUs);
+    EXPECT_EQ(2u, idle.sleeps);
+    EXPECT_EQ(2u, jumps.size());
+}
+
+static void StopAfterTenJobsFunc(void* args)
+{
+    HAL_TIMER_DelayUs(10);
+    if (++*(int*) args == 10) {
+        HAL_SCHEDULER_Stop();
+    }
+}
+
+TEST_F(SimSchedulerIdleTest, TicklessStartEndsOnStopWithPeriodicTasks)
+{
+    int jobs = 0;
+    TaskTiming timing = {.periodUs = 100, .deadlineUs = 0, .budgetUs = 0};
+    TaskHandle periodic;
+    ASSERT_EQ(HAL_OK, HAL_SCHEDULER_DeleteTask(sleeper.self));
+    ASSERT_EQ(HAL_OK,
+              HAL_SCHEDULER_CreatePeriodicTask(StopAfterTenJobsFunc, &jobs, &timing, &periodic));
+    ASSERT_EQ(0, SIM_SCHEDULER_SetTickless(true));
+
+    ASSERT_EQ(HAL_OK, HAL_SCHEDULER_Start());
+    EXPECT_EQ(10, jobs);
+    EXPECT_EQ(910u, SIM_TIMER_GetCurrentTime());
+
+    SimSchedulerIdleStats idle;
+    ASSERT_EQ(0, SIM_SCHEDULER_GetIdleStats(&idle));
+    EXPECT_EQ(9u, idle.sleeps);
+    EXPECT_EQ(810u, idle.idleUs);
+    EXPECT_EQ(90u, idle.maxSleepUs);
+}
+
+// Rate group: wakes every periodUs, logs the wake time, then works for workUs
+struct RateGroup {
+    uint32_t periodUs;
+    uint32_t workUs;
+    int cycles;
+    bool delayUntil; // Else HAL_SCHEDULER_Delay(periodUs), which drifts by the work time
+    std::vector<uint64_t> wakes;
+};
+
+static void RateGroupFunc(void* args)
+{
+    RateGroup* group = (RateGroup*) args;
+    uint64_t lastWakeUs = SIM_TIMER_GetCurrentTime();
+    for (int i = 0; i < group->cycles; i++) {
+        if (group->delayUntil) {
+            EXPECT_EQ(HAL_OK, HAL_SCHEDULER_DelayUntil(&lastWakeUs, group->periodUs));
+        } else {
+            EXPECT_EQ(HAL_OK, HAL_SCHEDULER_Delay(group->periodUs));
+        }
+        group->wakes.push_back(SIM_TIMER_GetCurrentTime());
+        HAL_TIMER_DelayUs(group->workUs);
+    }
+}
+
+// Stackful tasks on the simulated clock; the timer HAL needs more than the minimum stack
+class SimSchedulerTimedTest : public SimSchedulerStackfulTest
+{
+   protected:
+    void SetUp() override
+    {
+        SIM_TIMER_Init();
+        HAL_SCHEDULER_Init();
+        ASSERT_EQ(0, SIM_SCHEDULER_SetTaskStacks(SIM_SCHEDULER_DEFAULT_STACK_BYTES));
+    }
+
+    void TearDown() override
+    {
+        HAL_SCHEDULER_Init();
+        SimSchedulerStackfulTest::TearDown();
+        SIM_TIMER_Reset();
+    }
+};
+
+class SimSchedulerDelayTest : public SimSchedulerTimedTest
+{
+};
+
+TEST_F(SimSchedulerDelayTest, DelayUntilHasNoCumulativeDrift)
+{
+    RateGroup fast = {1000, 30, 50, true, {}};
+    RateGroup slow = {5000, 700, 10, true, {}};
+    TaskHandle fastHandle, slowHandle;
+
+    // The slow group runs first and makes the fast one wake late every fifth cycle
+    ASSERT_EQ(HAL_OK,
+              HAL_SCHEDULER_CreateTask(RateGroupFunc, &slow, TASK_PRIORITY_HIGH, &slowHandle));
+    ASSERT_EQ(HAL_OK,
+              HAL_SCHEDULER_CreateTask(RateGroupFunc, &fast, TASK_PRIORITY_NORMAL, &fastHandle));
+    ASSERT_EQ(0, SIM_Run(60000));
+
+    ASSERT_EQ(50u, fast.wakes.size());
+    ASSERT_EQ(10u, slow.wakes.size());
+    for (int i = 0; i < 50; i++) {
+        uint64_t wakeUs = (uint64_t) (i + 1) * 1000;
+        EXPECT_EQ(i % 5 == 4 ? wakeUs + 700 : wakeUs, fast.wakes[i]) << "cycle " << i;
+    }
+    EXPECT_EQ(50000u, slow.wakes.back());
+
+    TaskStats stats;
+    ASSERT_EQ(HAL_OK, HAL_SCHEDULER_GetTaskStats(fastHandle, &stats));
+    EXPECT_EQ(50u, stats.delays);
+    EXPECT_EQ(10u * 700, stats.jitterUs);
+    EXPECT_EQ(700u, stats.maxJitterUs);
+    EXPECT_EQ(0u, stats.lateWakes);
+    EXPECT_EQ(TASK_STATE_COMPLETED, HAL_SCHEDULER_GetTaskState(fastHandle));
+}
+
+TEST_F(SimSchedulerDelayTest, DelayDriftsByTheWorkTime)
+{
+    RateGroup group = {1000, 30, 10, false, {}};
+    TaskHandle handle;
+    ASSERT_EQ(HAL_OK, HAL_SCHEDULER_CreateTask(RateGroupFunc, &group, TASK_PRIORITY_NORMAL,
+                                               &handle));
+    ASSERT_EQ(0, SIM_Run(20000));
+
+    ASSERT_EQ(10u, group.wakes.size());
+    EXPECT_EQ(10u * 1000 + 9 * 30, group.wakes.back());
+}
+
+TEST_F(SimSchedulerDelayTest, LateWakeReturnsTimeoutAndKeepsThePhase)
+{
+    uint64_t lastWakeUs = 0;
+
+    // Outside a task the clock simply runs up to the wake time
+    ASSERT_EQ(HAL_OK, HAL_SCHEDULER_DelayUntil(&lastWakeUs, 100));
+    EXPECT_EQ(100u, SIM_TIMER_GetCurrentTime());
+    SIM_TIMER_AdvanceTime(150);
+    EXPECT_EQ(HAL_TIMEOUT, HAL_SCHEDULER_DelayUntil(&lastWakeUs, 100));
+    EXPECT_EQ(200u, lastWakeUs);
+    EXPECT_EQ(250u, SIM_TIMER_GetCurrentTime());
+    EXPECT_EQ(HAL_OK, HAL_SCHEDULER_DelayUntil(&lastWakeUs, 100));
+    EXPECT_EQ(300u, SIM_TIMER_GetCurrentTime());
+
+    EXPECT_EQ(HAL_ERROR, HAL_SCHEDULER_DelayUntil(nullptr, 100));
+    EXPECT_EQ(HAL_ERROR, HAL_SCHEDULER_DelayUntil(&lastWakeUs, 0));
+    EXPECT_EQ(HAL_OK, HAL_SCHEDULER_Delay(0));
+    EXPECT_EQ(300u, SIM_TIMER_GetCurrentTime());
+}
+
+// Run-to-completion rate group: suspended by DelayUntil, runs again from the top
+struct RtcRateGroup {
+    uint64_t lastWakeUs;
+    std::vector<uint64_t> wakes;
+};
+
+static void RtcRateGroupFunc(void* args)
+{
+    RtcRateGroup* group = (RtcRateGroup*) args;
+    group->wakes.push_back(SIM_TIMER_GetCurrentTime());
+    HAL_TIMER_DelayUs(20);
+    if (group->wakes.size() < 5) {
+        HAL_SCHEDULER_DelayUntil(&group->lastWakeUs, 500);
+    }
+}
+
+TEST_F(SimSchedulerDelayTest, RunToCompletionTaskRunsAgainAtWakeTime)
+{
+    ASSERT_EQ(0, SIM_SCHEDULER_SetTaskStacks(0));
+    RtcRateGroup group = {0, {}};
+    TaskHandle handle;
+    ASSERT_EQ(HAL_OK, HAL_SCHEDULER_CreateTask(RtcRateGroupFunc, &group, TASK_PRIORITY_NORMAL,
+                                               &handle));
+
+    // Tickless Start runs the whole loop without a driver stepping time
+    ASSERT_EQ(0, SIM_SCHEDULER_SetTickless(true));
+    ASSERT_EQ(HAL_OK, HAL_SCHEDULER_Start());
+
+    std::vector<uint64_t> expected = {0, 500, 1000, 1500, 2000};
+    EXPECT_EQ(expected, group.wakes);
+    EXPECT_EQ(TASK_STATE_COMPLETED, HAL_SCHEDULER_GetTaskState(handle));
+
+    TaskStats stats;
+    ASSERT_EQ(HAL_OK, HAL_SCHEDULER_GetTaskStats(handle, &stats));
+    EXPECT_EQ(4u, stats.delays);
+    EXPECT_EQ(0u, stats.jitterUs);
+}
+
+class SimSchedulerPreemptTest : public SimSchedulerTimedTest
+{
+};
+
+// Stackful task doing simulated work in chunks, noting when each run of it starts and ends
+struct Worker {
+    uint32_t chunks;
+    uint32_t chunkUs;
+    uint64_t startUs;
+    uint64_t endUs;
+};
+
+static void WorkerFunc(void* args)
+{
+    Worker* worker = (Worker*) args;
+    worker->startUs = SIM_TIMER_GetCurrentTime();
+    for (uint32_t i = 0; i < worker->chunks; i++) {
+        HAL_TIMER_DelayUs(worker->chunkUs);
+    }
+    worker->endUs = SIM_TIMER_GetCurrentTime();
+}
+
+TEST_F(SimSchedulerPreemptTest, WakingHighPriorityTaskPreemptsLongRun)
+{
+    for (bool preemptive : {false, true}) {
+        HAL_SCHEDULER_Init();
+        SIM_TIMER_Reset();
+        SIM_TIMER_Init();
+        ASSERT_EQ(0, SIM_SCHEDULER_SetPreemptive(preemptive));
+
+        Worker low = {1, 10000, 0, 0};
+        Worker high = {1, 100, 0, 0};
+        TaskHandle lowHandle, highHandle;
+        ASSERT_EQ(HAL_OK,
+                  HAL_SCHEDULER_CreateTask(WorkerFunc, &low, TASK_PRIORITY_NORMAL, &lowHandle));
+        ASSERT_EQ(HAL_OK,
+                  HAL_SCHEDULER_CreateTask(WorkerFunc, &high, TASK_PRIORITY_HIGH, &highHandle));
+        ASSERT_EQ(HAL_OK, HAL_SCHEDULER_SuspendTask(highHandle));
+        ASSERT_EQ(0, SIM_SCHEDULER_ResumeAt(highHandle, 2000));
+        ASSERT_EQ(HAL_OK, HAL_SCHEDULER_Start());
+
+        // Preempted, the low task's 10 ms of work still take 10 ms of its own
+        EXPECT_EQ(preemptive ? 2000u : 10000u, high.startUs);
+        EXPECT_EQ(preemptive ? 10100u : 10000u, low.endUs);
+
+        TaskStats stats;
+        ASSERT_EQ(HAL_OK, HAL_SCHEDULER_GetTaskStats(highHandle, &stats));
+        EXPECT_EQ(1u, stats.responses);
+        EXPECT_EQ(preemptive ? 100u : 8100u, stats.responseUs);
+        EXPECT_EQ(1u, stats.responseHistogram[preemptive ? 7 : 13]);
+        ASSERT_EQ(HAL_OK, HAL_SCHEDULER_GetTaskStats(lowHandle, &stats));
+        EXPECT_EQ(preemptive ? 1u : 0u, stats.preemptions);
+        EXPECT_EQ(preemptive ? 2u : 1u, stats.runs);
+        EXPECT_EQ(1u, stats.responses);
+        EXPECT_EQ(low.endUs, stats.responseUs);
+        EXPECT_EQ(TASK_STATE_COMPLETED, HAL_SCHEDULER_GetTaskState(lowHandle));
+    }
+}
+
+static void SetQuantumFunc(void* args)
+{
+    *(int*) args = SIM_SCHEDULER_SetQuantum(TASK_PRIORITY_NORMAL, 300);
+}
+
+TEST_F(SimSchedulerPreemptTest, QuantumIsFixedWhileRunning)
+{
+    int result = 0;
+    TaskHandle handle;
+    ASSERT_EQ(HAL_OK, HAL_SCHEDULER_CreateTask(SetQuantumFunc, &result, TASK_PRIORITY_NORMAL,
+                                               &handle));
+    ASSERT_EQ(HAL_OK, HAL_SCHEDULER_Start());
+    EXPECT_EQ(-1, result);
+}
+
+TEST_F(SimSchedulerPreemptTest, EqualPriorityTasksTakeTurnsPerQuantum)
+{
+    EXPECT_EQ(-1, SIM_SCHEDULER_SetQuantum((TaskPriority) 99, 300));
+    ASSERT_EQ(0, SIM_SCHEDULER_SetPreemptive(true));
+    ASSERT_EQ(0, SIM_SCHEDULER_SetQuantum(TASK_PRIORITY_NORMAL, 300));
+
+    Worker a = {10, 100, 0, 0};
+    Worker b = {10, 100, 0, 0};
+    TaskHandle aHandle, bHandle;
+    ASSERT_EQ(HAL_OK, HAL_SCHEDULER_CreateTask(WorkerFunc, &a, TASK_PRIORITY_NORMAL, &aHandle));
+    ASSERT_EQ(HAL_OK, HAL_SCHEDULER_CreateTask(WorkerFunc, &b, TASK_PRIORITY_NORMAL, &bHandle));
+    ASSERT_EQ(0, SIM_SCHEDULER_StartTrace(16));
+    ASSERT_EQ(HAL_OK, HAL_SCHEDULER_Start());
+
+    // Slices of 300 us in turn: A 0-300, B 300-600, ..., A ends at 1900, B at 2000
+    EXPECT_EQ(300u, b.startUs);
+    EXPECT_EQ(1900u, a.endUs);
+    EXPECT_EQ(2000u, b.endUs);
+
+    TaskStats stats;
+    ASSERT_EQ(HAL_OK, HAL_SCHEDULER_GetTaskStats(aHandle, &stats));
+    EXPECT_EQ(3u, stats.preemptions);
+    EXPECT_EQ(4u, stats.runs);
+    SimSchedulerStats counters;
+    ASSERT_EQ(0, SIM_SCHEDULER_GetStats(&counters));
+    EXPECT_EQ(6u, counters.preemptions);
+    EXPECT_EQ(2u, counters.completions);
+
+    SimSchedulerTraceRecord records[16];
+    uint32_t count = 0;
+    ASSERT_EQ(0, SIM_SCHEDULER_ReadTrace(records, 16, &count));
+    ASSERT_EQ(8u, count);
+    EXPECT_EQ((uint8_t) SIM_SCHEDULER_TRACE_PREEMPTED, records[0].event);
+    EXPECT_EQ(600u, records[2].startUs);
+    EXPECT_EQ((uint8_t) SIM_SCHEDULER_TRACE_COMPLETED, records[6].event);
+
+    std::string path = ::testing::TempDir() + "sim_scheduler_preempt_trace.json";
+    ASSERT_EQ(0, SIM_SCHEDULER_ExportTrace(path.c_str()));
+    std::ifstream file(path);
+    std::stringstream json;
+    json << file.rdbuf();
+    std::remove(path.c_str());
+    EXPECT_NE(std::string::npos, json.str().find("\"end\":\"preempted\""));
+    SIM_SCHEDULER_StopTrace();
+
+    // Cleared by Init: the two run back to back again
+    HAL_SCHEDULER_Init();
+    a = {10, 100, 0, 0};
+    b = {10, 100, 0, 0};
+    ASSERT_EQ(HAL_OK, HAL_SCHEDULER_CreateTask(WorkerFunc, &a, TASK_PRIORITY_NORMAL, &aHandle));
+    ASSERT_EQ(HAL_OK, HAL_SCHEDULER_CreateTask(WorkerFunc, &b, TASK_PRIORITY_NORMAL, &bHandle));
+    ASSERT_EQ(HAL_OK, HAL_SCHEDULER_Start());
+    EXPECT_EQ(a.endUs, b.startUs);
+}
+
+struct Handoff {
+    TaskHandle high;
+    std::vector<int> order;
+};
+
+static void HandoffLowFunc(void* args)
+{
+    Handoff* handoff = (Handoff*) args;
+    handoff->order.push_back(1);
+    HAL_SCHEDULER_ResumeTask(handoff->high);
+    handoff->order.push_back(3);
+}
+
+static void HandoffHighFunc(void* args)
+{
+    ((Handoff*) args)->order.push_back(2);
+}
+
+TEST_F(SimSchedulerPreemptTest, ResumedHigherPriorityTaskRunsBeforeResumeReturns)
+{
+    ASSERT_EQ(0, SIM_SCHEDULER_SetPreemptive(true));
+    Handoff handoff = {nullptr, {}};
+    TaskHandle low;
+    ASSERT_EQ(HAL_OK, HAL_SCHEDULER_CreateTask(HandoffHighFunc, &handoff, TASK_PRIORITY_HIGH,
+                                               &handoff.high));
+    ASSERT_EQ(HAL_OK, HAL_SCHEDULER_SuspendTask(handoff.high));
+    ASSERT_EQ(HAL_OK, HAL_SCHEDULER_CreateTask(HandoffLowFunc, &handoff, TASK_PRIORITY_LOW, &low));
+    ASSERT_EQ(HAL_OK, HAL_SCHEDULER_Start());
+
+    std::vector<int> expected = {1, 2, 3};
+    EXPECT_EQ(expected, handoff.order);
+    TaskStats stats;
+    ASSERT_EQ(HAL_OK, HAL_SCHEDULER_GetTaskStats(low, &stats));
+    EXPECT_EQ(1u, stats.preemptions);
+}
+
 int main(int argc, char** argv)
 {
     ::testing::InitGoogleTest(&argc, argv);
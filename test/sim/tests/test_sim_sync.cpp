@@ -0,0 +1,433 @@
+/**
+ * @file test_sim_sync.cpp
+ * @brief Semaphore, Event Group and Mutex Simulator Unit Tests
+ */
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+extern "C" {
+#include "hal_event.h"
+#include "hal_mutex.h"
+#include "hal_scheduler.h"
+#include "hal_semaphore.h"
+#include "hal_timer.h"
+#include "sim_kernel.h"
+#include "sim_scheduler.h"
+#include "sim_sync.h"
+#include "sim_timer.h"
+}
+
+class SimSyncTest : public ::testing::Test
+{
+   protected:
+    void SetUp() override
+    {
+        SIM_TIMER_Init();
+        SIM_SYNC_Reset();
+        HAL_SCHEDULER_Init();
+        ASSERT_EQ(0, SIM_SCHEDULER_SetTaskStacks(SIM_SCHEDULER_MIN_STACK_BYTES));
+    }
+
+    void TearDown() override
+    {
+        SIM_SCHEDULER_SetTaskStacks(0);
+        SIM_SYNC_Reset();
+        SIM_TIMER_Reset();
+    }
+
+    std::string trace;
+};
+
+TEST_F(SimSyncTest, CreateRejectsInvalidArguments)
+{
+    SemaphoreHandle semaphore;
+    MutexHandle mutex;
+    EventGroupHandle group;
+    EXPECT_EQ(HAL_ERROR, HAL_SEMAPHORE_Create(0, 0, &semaphore));
+    EXPECT_EQ(HAL_ERROR, HAL_SEMAPHORE_Create(3, 2, &semaphore));
+    EXPECT_EQ(HAL_ERROR, HAL_SEMAPHORE_Create(0, 1, nullptr));
+    EXPECT_EQ(HAL_ERROR, HAL_EVENT_Create(nullptr));
+    EXPECT_EQ(HAL_ERROR, HAL_MUTEX_Create((MutexProtocol) 5, &mutex));
+
+    // Handles of one kind are invalid for the others
+    ASSERT_EQ(HAL_OK, HAL_SEMAPHORE_Create(1, 1, &semaphore));
+    ASSERT_EQ(HAL_OK, HAL_EVENT_Create(&group));
+    EXPECT_EQ(HAL_ERROR, HAL_MUTEX_Lock(semaphore, 0));
+    EXPECT_EQ(HAL_ERROR, HAL_SEMAPHORE_Give(group));
+    EXPECT_EQ(HAL_ERROR, HAL_EVENT_Wait(group, 0, EVENT_WAIT_ANY, false, 0, nullptr));
+
+    // Deleted handles stay invalid
+    EXPECT_EQ(HAL_OK, HAL_SEMAPHORE_Delete(semaphore));
+    EXPECT_EQ(HAL_ERROR, HAL_SEMAPHORE_TryTake(semaphore));
+    SimSyncStats stats;
+    EXPECT_EQ(-1, SIM_SYNC_GetStats(semaphore, &stats));
+    EXPECT_EQ(HAL_OK, HAL_EVENT_Delete(group));
+}
+
+TEST_F(SimSyncTest, SemaphoreCountsAndTimesOut)
+{
+    SemaphoreHandle semaphore;
+    ASSERT_EQ(HAL_OK, HAL_SEMAPHORE_Create(1, 2, &semaphore));
+    EXPECT_EQ(HAL_OK, HAL_SEMAPHORE_TryTake(semaphore));
+    EXPECT_EQ(HAL_BUSY, HAL_SEMAPHORE_TryTake(semaphore));
+    EXPECT_EQ(HAL_OK, HAL_SEMAPHORE_Give(semaphore));
+    EXPECT_EQ(HAL_OK, HAL_SEMAPHORE_Give(semaphore));
+    EXPECT_EQ(HAL_ERROR, HAL_SEMAPHORE_Give(semaphore));
+    EXPECT_EQ(2u, HAL_SEMAPHORE_GetCount(semaphore));
+
+    EXPECT_EQ(HAL_OK, HAL_SEMAPHORE_Take(semaphore, 5));
+    EXPECT_EQ(HAL_OK, HAL_SEMAPHORE_Take(semaphore, 5));
+
+    // Outside tasks nothing can give meanwhile: simulated time runs to the deadline
+    EXPECT_EQ(HAL_TIMEOUT, HAL_SEMAPHORE_Take(semaphore, 3));
+    EXPECT_EQ(3000u, SIM_TIMER_GetCurrentTime());
+
+    SimSyncStats stats;
+    ASSERT_EQ(0, SIM_SYNC_GetStats(semaphore, &stats));
+    EXPECT_EQ(3u, stats.acquired);
+    EXPECT_EQ(1u, stats.contended);
+    EXPECT_EQ(1u, stats.timeouts);
+    EXPECT_EQ(3000u, stats.waitUs);
+    EXPECT_EQ(3000u, stats.maxWaitUs);
+}
+
+struct Taker {
+    SemaphoreHandle semaphore;
+    int takes;
+    uint64_t doneUs;
+};
+
+static void TakerFunc(void* args)
+{
+    Taker* taker = (Taker*) args;
+    while (taker->takes < 3 && HAL_SEMAPHORE_Take(taker->semaphore, 0) == HAL_OK) {
+        taker->takes++;
+    }
+    taker->doneUs = SIM_TIMER_GetCurrentTime();
+}
+
+static void GiveFromInterrupt(TimerHandle timer, void* userData)
+{
+    (void) timer;
+    HAL_SEMAPHORE_Give((SemaphoreHandle) userData);
+}
+
+TEST_F(SimSyncTest, SemaphoreGivenFromTimerWakesTask)
+{
+    Taker taker = {nullptr, 0, 0};
+    ASSERT_EQ(HAL_OK, HAL_SEMAPHORE_Create(0, 1, &taker.semaphore));
+    TaskHandle task;
+    ASSERT_EQ(HAL_OK, HAL_SCHEDULER_CreateTask(TakerFunc, &taker, TASK_PRIORITY_NORMAL, &task));
+
+    TimerConfig config = {.mode = TIMER_MODE_PERIODIC,
+                          .periodUs = 1000,
+                          .callback = GiveFromInterrupt,
+                          .userData = taker.semaphore,
+                          .priority = 0};
+    TimerHandle timer;
+    ASSERT_EQ(HAL_OK, HAL_TIMER_Create(0, &config, &timer));
+    ASSERT_EQ(HAL_OK, HAL_TIMER_Start(timer));
+
+    EXPECT_EQ(0, SIM_Run(5000));
+    EXPECT_EQ(3, taker.takes);
+    EXPECT_EQ(3000u, taker.doneUs);
+    EXPECT_EQ(TASK_STATE_COMPLETED, HAL_SCHEDULER_GetTaskState(task));
+
+    SimSyncStats stats;
+    ASSERT_EQ(0, SIM_SYNC_GetStats(taker.semaphore, &stats));
+    EXPECT_EQ(3u, stats.contended);
+    EXPECT_EQ(3000u, stats.waitUs);
+    EXPECT_EQ(1000u, stats.maxWaitUs);
+    EXPECT_EQ(0u, stats.waiting);
+    HAL_TIMER_Stop(timer);
+}
+
+struct FlagWaiter {
+    EventGroupHandle group;
+    uint32_t bits;
+    EventWaitMode mode;
+    bool clearOnExit;
+    uint32_t setBits;
+    std::string* trace;
+    char name;
+};
+
+static void FlagWaiterFunc(void* args)
+{
+    FlagWaiter* waiter = (FlagWaiter*) args;
+    if (HAL_EVENT_Wait(waiter->group, waiter->bits, waiter->mode, waiter->clearOnExit, 0,
+                       &waiter->setBits) == HAL_OK) {
+        *waiter->trace += waiter->name;
+    }
+}
+
+TEST_F(SimSyncTest, EventGroupWaitsForAnyOrAll)
+{
+    EventGroupHandle group;
+    ASSERT_EQ(HAL_OK, HAL_EVENT_Create(&group));
+
+    FlagWaiter all = {group, 0x3, EVENT_WAIT_ALL, true, 0, &trace, 'A'};
+    FlagWaiter any = {group, 0x4, EVENT_WAIT_ANY, false, 0, &trace, 'N'};
+    TaskHandle ha, hn;
+    HAL_SCHEDULER_CreateTask(FlagWaiterFunc, &all, TASK_PRIORITY_HIGH, &ha);
+    HAL_SCHEDULER_CreateTask(FlagWaiterFunc, &any, TASK_PRIORITY_NORMAL, &hn);
+    EXPECT_EQ(HAL_OK, HAL_SCHEDULER_Start());
+    EXPECT_EQ(HAL_BUSY, HAL_EVENT_Delete(group));
+
+    // One of the two bits does not satisfy the ALL waiter
+    EXPECT_EQ(HAL_OK, HAL_EVENT_Set(group, 0x1));
+    EXPECT_EQ(HAL_OK, HAL_SCHEDULER_Start());
+    EXPECT_EQ("", trace);
+    EXPECT_EQ(TASK_STATE_BLOCKED, HAL_SCHEDULER_GetTaskState(ha));
+
+    EXPECT_EQ(HAL_OK, HAL_EVENT_Set(group, 0x4));
+    EXPECT_EQ(HAL_OK, HAL_SCHEDULER_Start());
+    EXPECT_EQ("N", trace);
+    EXPECT_EQ(0x5u, any.setBits);
+
+    // The ALL waiter clears only the bits it asked for
+    EXPECT_EQ(HAL_OK, HAL_EVENT_Set(group, 0x2));
+    EXPECT_EQ(HAL_OK, HAL_SCHEDULER_Start());
+    EXPECT_EQ("NA", trace);
+    EXPECT_EQ(0x7u, all.setBits);
+    EXPECT_EQ(0x4u, HAL_EVENT_Get(group));
+
+    EXPECT_EQ(HAL_OK, HAL_EVENT_Clear(group, 0x4));
+    uint32_t bits = 0xFF;
+    EXPECT_EQ(HAL_TIMEOUT, HAL_EVENT_Wait(group, 0x8, EVENT_WAIT_ANY, false, 2, &bits));
+    EXPECT_EQ(0u, bits);
+    EXPECT_EQ(HAL_OK, HAL_EVENT_Delete(group));
+}
+
+TEST_F(SimSyncTest, ClearOnExitSatisfiesOneWaiter)
+{
+    EventGroupHandle group;
+    ASSERT_EQ(HAL_OK, HAL_EVENT_Create(&group));
+
+    FlagWaiter low = {group, 0x1, EVENT_WAIT_ANY, true, 0, &trace, 'L'};
+    FlagWaiter high = {group, 0x1, EVENT_WAIT_ANY, true, 0, &trace, 'H'};
+    TaskHandle hl, hh;
+    HAL_SCHEDULER_CreateTask(FlagWaiterFunc, &low, TASK_PRIORITY_LOW, &hl);
+    HAL_SCHEDULER_CreateTask(FlagWaiterFunc, &high, TASK_PRIORITY_HIGH, &hh);
+    EXPECT_EQ(HAL_OK, HAL_SCHEDULER_Start());
+
+    // Both wake; the first to run consumes the flag and the other waits again
+    EXPECT_EQ(HAL_OK, HAL_EVENT_Set(group, 0x1));
+    EXPECT_EQ(HAL_OK, HAL_SCHEDULER_Start());
+    EXPECT_EQ("H", trace);
+    EXPECT_EQ(TASK_STATE_BLOCKED, HAL_SCHEDULER_GetTaskState(hl));
+
+    EXPECT_EQ(HAL_OK, HAL_EVENT_Set(group, 0x1));
+    EXPECT_EQ(HAL_OK, HAL_SCHEDULER_Start());
+    EXPECT_EQ("HL", trace);
+    EXPECT_EQ(0u, HAL_EVENT_Get(group));
+
+    SimSyncStats stats;
+    ASSERT_EQ(0, SIM_SYNC_GetStats(group, &stats));
+    EXPECT_EQ(2u, stats.acquired);
+    EXPECT_EQ(2u, stats.contended);
+}
+
+TEST_F(SimSyncTest, MutexRejectsRecursionAndForeignUnlock)
+{
+    MutexHandle mutex;
+    ASSERT_EQ(HAL_OK, HAL_MUTEX_Create(MUTEX_PROTOCOL_INHERIT, &mutex));
+    EXPECT_EQ(HAL_ERROR, HAL_MUTEX_Unlock(mutex));
+    EXPECT_EQ(HAL_OK, HAL_MUTEX_Lock(mutex, 0));
+    EXPECT_EQ(HAL_ERROR, HAL_MUTEX_Lock(mutex, 0));
+    EXPECT_EQ(HAL_BUSY, HAL_MUTEX_TryLock(mutex));
+    EXPECT_EQ(HAL_BUSY, HAL_MUTEX_Delete(mutex));
+    EXPECT_EQ(HAL_OK, HAL_MUTEX_Unlock(mutex));
+    EXPECT_EQ(HAL_ERROR, HAL_MUTEX_Unlock(mutex));
+    EXPECT_EQ(HAL_OK, HAL_MUTEX_TryLock(mutex));
+    EXPECT_EQ(HAL_OK, HAL_MUTEX_Unlock(mutex));
+    EXPECT_EQ(HAL_OK, HAL_MUTEX_Delete(mutex));
+}
+
+/* Low-priority logger holding a mutex the high-priority motor task needs, while
+   medium-priority work keeps the logger off the CPU */
+struct Inversion {
+    MutexHandle mutex;
+    std::string* trace;
+    uint64_t motorLockUs;
+};
+
+static void LoggerFunc(void* args)
+{
+    Inversion* inversion = (Inversion*) args;
+    HAL_MUTEX_Lock(inversion->mutex, 0);
+    for (int chunk = 0; chunk < 3; chunk++) {
+        HAL_TIMER_DelayUs(100);
+        *inversion->trace += 'l';
+        HAL_SCHEDULER_Yield();
+    }
+    HAL_MUTEX_Unlock(inversion->mutex);
+    *inversion->trace += 'L';
+}
+
+static void BusyFunc(void* args)
+{
+    Inversion* inversion = (Inversion*) args;
+    for (int slice = 0; slice < 5; slice++) {
+        HAL_TIMER_DelayUs(100);
+        *inversion->trace += 'm';
+        HAL_SCHEDULER_Yield();
+    }
+}
+
+static void MotorFunc(void* args)
+{
+    Inversion* inversion = (Inversion*) args;
+    HAL_MUTEX_Lock(inversion->mutex, 0);
+    inversion->motorLockUs = SIM_TIMER_GetCurrentTime();
+    *inversion->trace += 'H';
+    HAL_MUTEX_Unlock(inversion->mutex);
+}
+
+static void RunInversion(MutexProtocol protocol, Inversion* inversion, SimSyncStats* stats)
+{
+    ASSERT_EQ(HAL_OK, HAL_MUTEX_Create(protocol, &inversion->mutex));
+    TaskHandle logger, busy1, busy2, motor;
+    HAL_SCHEDULER_CreateTask(LoggerFunc, inversion, TASK_PRIORITY_LOW, &logger);
+    HAL_SCHEDULER_CreateTask(BusyFunc, inversion, TASK_PRIORITY_NORMAL, &busy1);
+    HAL_SCHEDULER_CreateTask(BusyFunc, inversion, TASK_PRIORITY_NORMAL, &busy2);
+    HAL_SCHEDULER_CreateTask(MotorFunc, inversion, TASK_PRIORITY_HIGH, &motor);
+
+    // The logger takes the mutex first; everyone else shows up while it holds it
+    for (TaskHandle task : {busy1, busy2, motor}) {
+        ASSERT_EQ(HAL_OK, HAL_SCHEDULER_SuspendTask(task));
+        ASSERT_EQ(0, SIM_SCHEDULER_ResumeAt(task, 50));
+    }
+    ASSERT_EQ(0, SIM_Run(10000));
+    ASSERT_EQ(TASK_STATE_COMPLETED, HAL_SCHEDULER_GetTaskState(motor));
+    ASSERT_EQ(0, SIM_SYNC_GetStats(inversion->mutex, stats));
+}
+
+TEST_F(SimSyncTest, MediumTasksDelayMotorWithoutInheritance)
+{
+    Inversion inversion = {nullptr, &trace, 0};
+    SimSyncStats stats;
+    RunInversion(MUTEX_PROTOCOL_NONE, &inversion, &stats);
+
+    // The motor waits for all of the medium work plus the rest of the log
+    EXPECT_EQ("lmmmmmmmmmmllLH", trace);
+    EXPECT_EQ(1300u, inversion.motorLockUs);
+    EXPECT_EQ(1u, stats.contended);
+    EXPECT_EQ(1200u, stats.maxWaitUs);
+    EXPECT_EQ(0u, stats.inheritances);
+}
+
+TEST_F(SimSyncTest, InheritanceBoundsMotorWaitToCriticalSection)
+{
+    Inversion inversion = {nullptr, &trace, 0};
+    SimSyncStats stats;
+    RunInversion(MUTEX_PROTOCOL_INHERIT, &inversion, &stats);
+
+    // The raised logger finishes its critical section ahead of the medium work
+    EXPECT_EQ("lllLHmmmmmmmmmm", trace);
+    EXPECT_EQ(300u, inversion.motorLockUs);
+    EXPECT_EQ(1u, stats.contended);
+    EXPECT_EQ(200u, stats.maxWaitUs);
+    EXPECT_EQ(1u, stats.inheritances);
+}
+
+struct Locker {
+    MutexHandle first;
+    MutexHandle second; /* Locked after first, may be NULL */
+    uint32_t timeoutMs;
+    TaskHandle suspendInside; /* Own handle to suspend itself while holding first, or NULL */
+    std::string* trace;
+    char name;
+};
+
+static void LockerFunc(void* args)
+{
+    Locker* locker = (Locker*) args;
+    if (HAL_MUTEX_Lock(locker->first, locker->timeoutMs) != HAL_OK) {
+        *locker->trace += '-';
+        return;
+    }
+    if (locker->second) {
+        HAL_MUTEX_Lock(locker->second, 0);
+    }
+    if (locker->suspendInside) {
+        HAL_SCHEDULER_SuspendTask(locker->suspendInside);
+    }
+    *locker->trace += locker->name;
+    if (locker->second) {
+        HAL_MUTEX_Unlock(locker->second);
+    }
+    HAL_MUTEX_Unlock(locker->first);
+}
+
+static void MarkFunc(void* args)
+{
+    *((Locker*) args)->trace += 'x';
+}
+
+TEST_F(SimSyncTest, InheritancePassesAlongChainOfOwners)
+{
+    MutexHandle m1, m2;
+    ASSERT_EQ(HAL_OK, HAL_MUTEX_Create(MUTEX_PROTOCOL_INHERIT, &m1));
+    ASSERT_EQ(HAL_OK, HAL_MUTEX_Create(MUTEX_PROTOCOL_INHERIT, &m2));
+
+    // Low holds m1 and sleeps; normal holds m2 and waits for m1
+    Locker low = {m1, nullptr, 0, nullptr, &trace, 'L'};
+    Locker normal = {m2, m1, 0, nullptr, &trace, 'M'};
+    Locker high = {m2, nullptr, 0, nullptr, &trace, 'H'};
+    TaskHandle hl, hn, hh, hx;
+    HAL_SCHEDULER_CreateTask(LockerFunc, &low, TASK_PRIORITY_LOW, &hl);
+    low.suspendInside = hl;
+    EXPECT_EQ(HAL_OK, HAL_SCHEDULER_Start());
+    HAL_SCHEDULER_CreateTask(LockerFunc, &normal, TASK_PRIORITY_NORMAL, &hn);
+    EXPECT_EQ(HAL_OK, HAL_SCHEDULER_Start());
+
+    // High waiting for m2 raises normal, and through it low
+    HAL_SCHEDULER_CreateTask(LockerFunc, &high, TASK_PRIORITY_HIGH, &hh);
+    EXPECT_EQ(HAL_OK, HAL_SCHEDULER_Start());
+    EXPECT_EQ(TASK_STATE_BLOCKED, HAL_SCHEDULER_GetTaskState(hh));
+
+    // Low, resumed after an unrelated normal task, now runs ahead of it
+    HAL_SCHEDULER_CreateTask(MarkFunc, &low, TASK_PRIORITY_NORMAL, &hx);
+    EXPECT_EQ(HAL_OK, HAL_SCHEDULER_ResumeTask(hl));
+    EXPECT_EQ(HAL_OK, HAL_SCHEDULER_Start());
+    EXPECT_EQ("LMHx", trace);
+
+    SimSyncStats stats;
+    ASSERT_EQ(0, SIM_SYNC_GetStats(m1, &stats));
+    EXPECT_EQ(2u, stats.inheritances);
+    ASSERT_EQ(0, SIM_SYNC_GetStats(m2, &stats));
+    EXPECT_EQ(1u, stats.inheritances);
+    EXPECT_EQ(HAL_OK, HAL_MUTEX_Delete(m1));
+    EXPECT_EQ(HAL_OK, HAL_MUTEX_Delete(m2));
+}
+
+TEST_F(SimSyncTest, TimedOutWaiterDropsTheBoost)
+{
+    MutexHandle mutex;
+    ASSERT_EQ(HAL_OK, HAL_MUTEX_Create(MUTEX_PROTOCOL_INHERIT, &mutex));
+
+    Locker low = {mutex, nullptr, 0, nullptr, &trace, 'L'};
+    Locker high = {mutex, nullptr, 2, nullptr, &trace, 'H'};
+    TaskHandle hl, hh, hx;
+    HAL_SCHEDULER_CreateTask(LockerFunc, &low, TASK_PRIORITY_LOW, &hl);
+    low.suspendInside = hl;
+    EXPECT_EQ(HAL_OK, HAL_SCHEDULER_Start());
+    HAL_SCHEDULER_CreateTask(LockerFunc, &high, TASK_PRIORITY_HIGH, &hh);
+    EXPECT_EQ(0, SIM_Run(5000));
+    EXPECT_EQ("-", trace);
+
+    // Back at its own priority, low runs after the normal task again
+    HAL_SCHEDULER_CreateTask(MarkFunc, &low, TASK_PRIORITY_NORMAL, &hx);
+    EXPECT_EQ(HAL_OK, HAL_SCHEDULER_ResumeTask(hl));
+    EXPECT_EQ(HAL_OK, HAL_SCHEDULER_Start());
+    EXPECT_EQ("-xL", trace);
+
+    SimSyncStats stats;
+    ASSERT_EQ(0, SIM_SYNC_GetStats(mutex, &stats));
+    EXPECT_EQ(1u, stats.timeouts);
+    EXPECT_EQ(2000u, stats.waitUs);
+    EXPECT_EQ(1u, stats.inheritances);
+}
@@ -5,9 +5,13 @@
 
 #include <gtest/gtest.h>
 
+#include <cstring>
+
 extern "C" {
 #include "motor_control.h"
 #include "sim_memory.h"
+#include "sim_periph.h"
+#include "sim_timer.h"
 }
 
 class MotorControlTest : public ::testing::Test
@@ -136,6 +140,47 @@ TEST_F(MotorControlTest, SpeedWhileRunning)
     MOTOR_CONTROL_Stop();
 }
 
+TEST_F(MotorControlTest, SetSpeedSendsFrameToDriver)
+{
+    SIM_TIMER_Init();
+    SIM_PERIPH_Reset();
+
+    // Driver consumes 1 byte/us through a 4-byte FIFO
+    SimPeriphConfig config;
+    memset(&config, 0, sizeof(config));
+    config.role = SIM_PERIPH_SINK;
+    config.backend = SIM_PERIPH_BACKEND_FIFO;
+    config.bytesPerUs = 1;
+    config.fifoDepth = 4;
+    void* driver;
+    ASSERT_EQ(0, SIM_PERIPH_Register("motor_driver", &config, &driver));
+
+    MOTOR_CONTROL_Init(0);
+    EXPECT_EQ(HAL_OK, MOTOR_CONTROL_AttachDriver(driver));
+    EXPECT_EQ(HAL_OK, MOTOR_CONTROL_SetSpeed(1200.0f));
+
+    // The frame does not fit the FIFO, a new setpoint must wait for the driver
+    EXPECT_EQ(HAL_BUSY, MOTOR_CONTROL_SetSpeed(1300.0f));
+    MotorStatus status;
+    ASSERT_EQ(HAL_OK, MOTOR_CONTROL_GetStatus(&status));
+    EXPECT_FLOAT_EQ(1200.0f, status.targetSpeed);
+    SIM_TIMER_AdvanceTime(sizeof(MotorControlFrame));
+
+    MotorControlFrame frame;
+    size_t received = 0;
+    SIM_PERIPH_Drain(driver, &frame, sizeof(frame), &received);
+    EXPECT_EQ(sizeof(frame), received);
+    EXPECT_EQ((uint32_t) MOTOR_MODE_SPEED, frame.mode);
+    EXPECT_FLOAT_EQ(1200.0f, frame.targetSpeed);
+
+    EXPECT_EQ(HAL_OK, MOTOR_CONTROL_SetSpeed(1300.0f));
+    ASSERT_EQ(HAL_OK, MOTOR_CONTROL_GetStatus(&status));
+    EXPECT_FLOAT_EQ(1300.0f, status.targetSpeed);
+
+    MOTOR_CONTROL_Deinit();
+    SIM_PERIPH_Reset();
+}
+
 int main(int argc, char** argv)
 {
     ::testing::InitGoogleTest(&argc, argv);